@@ -161,12 +161,12 @@ int main(int argc, char* argv[])
     CheckError(nErrorCode);
     if (nErrorCode <= 0)
     {
-        int nBufEndPos=0;         // Last position in the circular buffer
+        sint64 nBufEndPos=0;      // Last position in the circular buffer
         int nBufSize=0;           // Total buffer size
 
         // Get detailed information about the circular buffer
         // to be able to handle the wrap around
-        nErrorCode = DeWeGetParam_i32( nBoardID, CMD_BUFFER_END_POINTER, &nBufEndPos);
+        nErrorCode = DeWeGetParam_i64( nBoardID, CMD_BUFFER_END_POINTER, &nBufEndPos);
         CheckError(nErrorCode);
         nErrorCode = DeWeGetParam_i32( nBoardID, CMD_BUFFER_TOTAL_MEM_SIZE, &nBufSize);
         CheckError(nErrorCode);
@@ -216,7 +216,7 @@ int main(int argc, char* argv[])
                 nReadPos += sizeof(uint32);
 
                 // Handle the circular buffer wrap around
-                if (nReadPos > nBufEndPos)
+                if (nReadPos >= nBufEndPos)
                 {
                     nReadPos -= nBufSize;
                 }
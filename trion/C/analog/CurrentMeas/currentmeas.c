@@ -219,7 +219,7 @@ int main(int argc, char* argv[])
             // recalculate nReadPos to handle ADC delay
             nReadPos = nReadPos + nADCDelay * Scansize;
             // Handle the circular buffer wrap around
-            if (nReadPos > nBufEndPos)
+            if (nReadPos >= nBufEndPos)
             {
                 nReadPos -= nBufSize;
             }
@@ -244,7 +244,7 @@ int main(int argc, char* argv[])
                 nReadPos += Scansize;
 
                 // Handle the circular buffer wrap around
-                if (nReadPos > nBufEndPos)
+                if (nReadPos >= nBufEndPos)
                 {
                     nReadPos -= nBufSize;
                 }
@@ -240,7 +240,7 @@ int main(int argc, char* argv[])
                 nReadPos += sizeof(uint32);
 
                 // Handle the circular buffer wrap around
-                if (nReadPos > nBufEndPos)
+                if (nReadPos >= nBufEndPos)
                 {
                     nReadPos -= nBufSize;
                 }
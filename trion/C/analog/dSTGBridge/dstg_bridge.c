@@ -300,7 +300,7 @@ int main(int argc, char* argv[])
             // recalculate nReadPos to handle ADC delay
             nReadPos = nReadPos + nADCDelay * Scansize;
             // Handle the circular buffer wrap around
-            if (nReadPos > nBufEndPos)
+            if (nReadPos >= nBufEndPos)
             {
                 nReadPos -= nBufSize;
             }
@@ -326,7 +326,7 @@ int main(int argc, char* argv[])
                 nReadPos += Scansize;
 
                 // Handle the circular buffer wrap around
-                if (nReadPos > nBufEndPos)
+                if (nReadPos >= nBufEndPos)
                 {
                     nReadPos -= nBufSize;
                 }
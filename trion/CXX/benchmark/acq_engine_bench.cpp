@@ -0,0 +1,445 @@
+/**
+ * TRION-SDK acquisition engine service latency benchmark.
+ *
+ * Runs the AcquisitionEngine against the simulated driver library
+ * (dwpxi_api_sim), loaded through DeWePxiLoadByName, with 1, 4 and 16
+ * boards and reports the service latency per board: the time from the
+ * block completion to the consumer receiving it. A block completes when
+ * the sample clock reaches its last scan, known from BoardCnt0.
+ *
+ * Usage: AcqEngineBench [options]
+ *   --driver PATH     simulated driver library (default: the built dwpxi_api_sim)
+ *   --boards 1,4,16   board counts to run
+ *   --rate N          scans/s per board (default 100000)
+ *   --block N         scans per simulated block (default 100)
+ *   --seconds N       duration per run (default 2)
+ *   --cpus 0,1,..     cores to balance the readers on
+ *   --fifo N          SCHED_FIFO priority of the readers
+ *   --mlock           lock the process memory
+ *   --slow-us N       processing time of the consumer of board 0
+ *   --api-calls       interpose the API: thunk overhead and the top calls per run
+ *
+ * This code is licensed under MIT license (see LICENSE.txt for details)
+ * Copyright (c) 2024 by DEWETRON GmbH
+ */
+
+
+#include "dewepxi_load.h"
+#include "dewepxi_apicore.h"
+#include "dewepxi_acq_engine.h"
+#include "dewepxi_api_interposer.h"
+#include "dewepxi_latency_histogram.h"
+#include "dewepxi_scan_decoder.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+namespace
+{
+    std::string boardTarget(uint32 board_id)
+    {
+        std::ostringstream target;
+        target << "BoardID" << board_id;
+        return target.str();
+    }
+
+    void setEnv(const char* name, uint32 value)
+    {
+        std::ostringstream text;
+        text << value;
+#ifdef WIN32
+        _putenv_s(name, text.str().c_str());
+#else
+        setenv(name, text.str().c_str(), 1);
+#endif
+    }
+
+    std::vector<int> parseList(const char* text)
+    {
+        std::vector<int> values;
+        std::stringstream stream(text);
+        std::string item;
+        while (std::getline(stream, item, ','))
+        {
+            values.push_back(std::atoi(item.c_str()));
+        }
+        return values;
+    }
+
+    struct Options
+    {
+        std::string driver;
+        std::vector<int> boards;
+        uint32 rate;
+        uint32 block;
+        double seconds;
+        uint32 slow_us;
+        bool api_calls;
+        trion::ReaderThreadOptions threads;
+    };
+
+    void printRow(const std::string& name, const trion::LatencySummary& s, uint64 overruns)
+    {
+        std::cout << std::setw(8) << name
+                  << std::setw(10) << s.count
+                  << std::setw(10) << std::fixed << std::setprecision(1) << s.p50_ns / 1000.0
+                  << std::setw(10) << s.p99_ns / 1000.0
+                  << std::setw(10) << s.p999_ns / 1000.0
+                  << std::setw(10) << s.max_ns / 1000.0
+                  << std::setw(10) << overruns << std::endl;
+    }
+
+    /**
+     * Mean time of a simulated DeWeGetParam_i32 with the interposer disabled and enabled.
+     */
+    void printApiOverhead()
+    {
+        const uint32 chunks = 100;
+        const uint32 calls = 8192;     // fits the ring of the thread
+        trion::ApiInterposer& interposer = trion::ApiInterposer::instance();
+        double ns[2] = { 0.0, 0.0 };
+        for (int enabled = 0; enabled < 2; ++enabled)
+        {
+            interposer.setEnabled(enabled != 0);
+            uint64 total_ns = 0;
+            for (uint32 chunk = 0; chunk < chunks; ++chunk)
+            {
+                sint32 value = 0;
+                const uint64 start = trion::steadyClockNs();
+                for (uint32 i = 0; i < calls; ++i)
+                {
+                    DeWeGetParam_i32(1, CMD_BUFFER_0_ONE_SCAN_SIZE, &value);
+                }
+                total_ns += trion::steadyClockNs() - start;
+                interposer.flush();
+            }
+            ns[enabled] = static_cast<double>(total_ns) / (static_cast<double>(chunks) * calls);
+        }
+        interposer.setEnabled(true);
+        interposer.flush();
+        interposer.resetStats();
+
+        // The budget is 20 ns, missed where the two time stamp reads alone exceed it (VMs)
+        const double overhead = ns[1] - ns[0];
+        const double clock = 2.0 * interposer.tickCostNs();
+        std::cout << "API interposer: " << std::fixed << std::setprecision(1) << ns[0] << " ns/call disabled, "
+                  << ns[1] << " ns/call enabled, overhead " << overhead << " ns (" << clock
+                  << " ns time stamps), budget 20 ns " << (overhead < 20.0 ? "met" : "MISSED") << std::endl;
+    }
+
+    void printApiCalls()
+    {
+        trion::ApiInterposer& interposer = trion::ApiInterposer::instance();
+        interposer.flush();
+        std::vector<trion::ApiCallStats> stats = interposer.stats();
+
+        std::cout << std::setw(18) << "function" << std::setw(36) << "command" << std::setw(6) << "board"
+                  << std::setw(10) << "calls" << std::setw(10) << "mean us" << std::setw(10) << "p99 us"
+                  << std::setw(10) << "total ms" << std::endl;
+        for (size_t i = 0; i < stats.size() && i < 10; ++i)
+        {
+            const trion::ApiCallStats& s = stats[i];
+            const char* command = trion::apiCommandName(s.command);
+            std::cout << std::setw(18) << s.function << std::setw(36) << (command ? command : "-")
+                      << std::setw(6) << s.board << std::setw(10) << s.calls
+                      << std::setw(10) << std::fixed << std::setprecision(2) << s.latency.mean_ns / 1000.0
+                      << std::setw(10) << s.latency.p99_ns / 1000.0
+                      << std::setw(10) << s.total_ns / 1e6 << std::endl;
+        }
+        if (interposer.dropped())
+        {
+            std::cout << interposer.dropped() << " calls dropped" << std::endl;
+        }
+        interposer.resetStats();
+    }
+
+    /**
+     * One analog channel and BoardCnt0 counting the scans, blocks of options.block scans, 0.5 s buffer.
+     */
+    int configureBoard(uint32 board_id, const Options& options)
+    {
+        const std::string board = boardTarget(board_id);
+        std::ostringstream rate;
+        rate << options.rate;
+
+        DeWeSetParam_i32(board_id, CMD_OPEN_BOARD, 0);
+        DeWeSetParam_i32(board_id, CMD_RESET_BOARD, 0);
+        DeWeSetParamStruct_str((board + "/AIAll").c_str(), "Used", "True");
+        DeWeSetParamStruct_str((board + "/BoardCnt0").c_str(), "Used", "True");
+        DeWeSetParamStruct_str((board + "/BoardCnt0").c_str(), "Source_A", "ACQ_CLK");
+        DeWeSetParamStruct_str((board + "/AcqProp").c_str(), "SampleRate", rate.str().c_str());
+        DeWeSetParamStruct_str((board + "/Sim").c_str(), "Realtime", "True");
+        DeWeSetParam_i32(board_id, CMD_BUFFER_0_BLOCK_SIZE, options.block);
+        DeWeSetParam_i32(board_id, CMD_BUFFER_0_BLOCK_COUNT, std::max<uint32>(options.rate / 2 / options.block, 2));
+        return DeWeSetParam_i32(board_id, CMD_UPDATE_PARAM_ALL, 0);
+    }
+
+    int run(uint32 num_boards, const Options& options)
+    {
+        trion::AcquisitionEngine engine(256);
+        engine.setThreadOptions(options.threads);
+        engine.setBoardMemoryInterval(0);
+        engine.setOverrunRecovery(true);
+
+        std::vector<uint32> counter_offsets;
+        for (uint32 board_id = 1; board_id <= num_boards; ++board_id)
+        {
+            int err = configureBoard(board_id, options);
+            if (err > 0)
+            {
+                std::cerr << boardTarget(board_id) << " configuration failed: " << DeWeErrorConstantToString(err) << std::endl;
+                return 1;
+            }
+
+            char scan_descriptor[32768] = { 0 };
+            DeWeGetParamStruct_str(boardTarget(board_id).c_str(), "ScanDescriptor_V3", scan_descriptor, sizeof(scan_descriptor));
+            trion::ScanDescriptor sd(scan_descriptor);
+            const int counter = sd.findChannel("BoardCnt0");
+            if (counter < 0)
+            {
+                std::cerr << boardTarget(board_id) << ": BoardCnt0 is not in the scan descriptor" << std::endl;
+                return 1;
+            }
+            counter_offsets.push_back(sd.channels()[counter].sample_offset / 8);
+
+            err = engine.addBoard(static_cast<int>(board_id));
+            if (err > 0)
+            {
+                std::cerr << "addBoard failed: " << err << std::endl;
+                return 1;
+            }
+        }
+
+        std::vector<std::unique_ptr<trion::LatencyHistogram>> hists;
+        std::vector<uint64> overruns(num_boards, 0);
+        for (uint32 i = 0; i < num_boards; ++i)
+        {
+            hists.emplace_back(new trion::LatencyHistogram());
+        }
+
+        // The driver starts its sample clock within the start call
+        std::vector<uint64> start_ns(num_boards);
+        for (uint32 i = 0; i < num_boards; ++i)
+        {
+            const uint64 before = trion::steadyClockNs();
+            DeWeSetParam_i32(static_cast<int>(i + 1), CMD_START_ACQUISITION, 0);
+            start_ns[i] = before + (trion::steadyClockNs() - before) / 2;
+        }
+        engine.start();
+
+        // One consumer thread per board
+        std::atomic<bool> consuming(true);
+        std::vector<std::thread> consumers;
+        for (uint32 i = 0; i < num_boards; ++i)
+        {
+            consumers.emplace_back([&, i]()
+            {
+                trion::BlockDescriptor desc;
+                while (consuming.load())
+                {
+                    if (!engine.waitPop(i, desc, 100))
+                    {
+                        continue;
+                    }
+                    if (desc.flags & trion::BLOCK_FLAG_DATA_LOST)
+                    {
+                        ++overruns[i];
+                    }
+                    if (desc.scans == 0 || desc.spans.count == 0)
+                    {
+                        engine.release(desc);
+                        continue;
+                    }
+
+                    // Scan n of the sample clock is complete at start + (n + 1) / rate
+                    uint32 first = 0;
+                    std::memcpy(&first, desc.spans.span[0].data + counter_offsets[i], sizeof(first));
+                    const uint64 end_scan = static_cast<uint64>(first) + desc.scans;
+                    const uint64 done_ns = start_ns[i] + end_scan * 1000000000ull / options.rate;
+                    const uint64 now_ns = trion::steadyClockNs();
+                    hists[i]->record(now_ns > done_ns ? now_ns - done_ns : 0);
+                    if (i == 0 && options.slow_us > 0)
+                    {
+                        std::this_thread::sleep_for(std::chrono::microseconds(options.slow_us));
+                    }
+                    engine.release(desc);
+                }
+            });
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(static_cast<int>(options.seconds * 1000)));
+
+        consuming.store(false);
+        for (auto& consumer : consumers)
+        {
+            consumer.join();
+        }
+        engine.stop();
+        for (uint32 board_id = 1; board_id <= num_boards; ++board_id)
+        {
+            DeWeSetParam_i32(board_id, CMD_STOP_ACQUISITION, 0);
+            DeWeSetParam_i32(board_id, CMD_CLOSE_BOARD, 0);
+        }
+
+        // Report
+        trion::ReaderThreadStatus status = engine.threadStatus(0);
+        std::cout << std::endl << num_boards << " board(s), " << options.rate << " scans/s, "
+                  << options.block << " scans/block"
+                  << (status.pinned ? ", pinned" : "")
+                  << (status.realtime ? ", SCHED_FIFO" : "")
+                  << (status.memory_locked ? ", mlock" : "") << std::endl;
+        std::cout << std::setw(8) << "board" << std::setw(10) << "blocks" << std::setw(10) << "p50 us"
+                  << std::setw(10) << "p99 us" << std::setw(10) << "p99.9 us" << std::setw(10) << "max us"
+                  << std::setw(10) << "overruns" << std::endl;
+
+        trion::LatencySummary worst = trion::LatencySummary();
+        uint64 total_overruns = 0;
+        for (uint32 i = 0; i < num_boards; ++i)
+        {
+            trion::LatencySummary s = hists[i]->summary();
+            printRow(std::to_string(i + 1), s, overruns[i]);
+            total_overruns += overruns[i];
+            if (s.p99_ns > worst.p99_ns)
+            {
+                worst = s;
+            }
+        }
+        if (num_boards > 1)
+        {
+            printRow("worst", worst, total_overruns);
+        }
+        if (options.api_calls)
+        {
+            printApiCalls();
+        }
+        return 0;
+    }
+}
+
+
+int main(int argc, char* argv[])
+{
+    Options options;
+#ifdef DWPXI_API_SIM_PATH
+    options.driver = DWPXI_API_SIM_PATH;
+#endif
+    options.boards = { 1, 4, 16 };
+    options.rate = 100000;
+    options.block = 100;
+    options.seconds = 2.0;
+    options.slow_us = 0;
+    options.api_calls = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (arg == "--mlock")
+        {
+            options.threads.lock_memory = true;
+        }
+        else if (arg == "--api-calls")
+        {
+            options.api_calls = true;
+        }
+        else if (value && arg == "--driver")
+        {
+            options.driver = argv[++i];
+        }
+        else if (value && arg == "--boards")
+        {
+            options.boards = parseList(argv[++i]);
+        }
+        else if (value && arg == "--rate")
+        {
+            options.rate = static_cast<uint32>(std::atoi(argv[++i]));
+        }
+        else if (value && arg == "--block")
+        {
+            options.block = static_cast<uint32>(std::atoi(argv[++i]));
+        }
+        else if (value && arg == "--seconds")
+        {
+            options.seconds = std::atof(argv[++i]);
+        }
+        else if (value && arg == "--cpus")
+        {
+            options.threads.cpus = parseList(argv[++i]);
+        }
+        else if (value && arg == "--fifo")
+        {
+            options.threads.realtime_priority = std::atoi(argv[++i]);
+        }
+        else if (value && arg == "--slow-us")
+        {
+            options.slow_us = static_cast<uint32>(std::atoi(argv[++i]));
+        }
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [--driver PATH] [--boards 1,4,16] [--rate N] [--block N] [--seconds N]"
+                      << " [--cpus 0,1,..] [--fifo N] [--mlock] [--slow-us N] [--api-calls]" << std::endl;
+            return 1;
+        }
+    }
+
+    if (options.driver.empty() || options.boards.empty() || options.rate == 0 || options.block == 0 || options.block > options.rate / 2)
+    {
+        std::cerr << "Invalid driver, board counts, rate or block size" << std::endl;
+        return 1;
+    }
+
+    // The simulated driver reads its board setup at DeWeDriverInit
+    const int max_boards = *std::max_element(options.boards.begin(), options.boards.end());
+    setEnv("DEWEPXI_SIM_BOARDS", static_cast<uint32>(std::max(max_boards, 1)));
+    setEnv("DEWEPXI_SIM_AI", 1);
+    if (!DeWePxiLoadByName(options.driver.c_str()))
+    {
+        std::cerr << options.driver << " could not be loaded" << std::endl;
+        return 1;
+    }
+    int boards = 0;
+    DeWeDriverInit(&boards);
+    if (boards >= 0)
+    {
+        std::cerr << options.driver << " is not the simulated driver" << std::endl;
+        DeWePxiUnload();
+        return 1;
+    }
+    DeWeSetParam_i32(0, CMD_OPEN_BOARD, 0);
+    DeWeSetParam_i32(0, CMD_RESET_BOARD, 0);
+
+    if (options.api_calls)
+    {
+        trion::ApiInterposer::instance().install();
+        printApiOverhead();
+    }
+
+    int result = 0;
+    for (int num_boards : options.boards)
+    {
+        if (num_boards > 0 && run(static_cast<uint32>(num_boards), options) != 0)
+        {
+            result = 1;
+            break;
+        }
+    }
+
+    if (options.api_calls)
+    {
+        trion::ApiInterposer::instance().uninstall();
+    }
+    DeWeSetParam_i32(0, CMD_CLOSE_BOARD, 0);
+    DeWeDriverDeInit();
+    DeWePxiUnload();
+    return result;
+}
@@ -0,0 +1,278 @@
+/**
+ * TRION-SDK sample codec check and benchmark.
+ *
+ * Encodes synthetic 24 bit signals (and optionally the channels of a
+ * recording) with every available instruction set variant of the
+ * sample codec, verifies the lossless round trip and the identical
+ * encoding of all variants and reports the compression ratio and the
+ * encode and decode throughput in GB/s of decoded samples.
+ *
+ * Usage: CodecBench [options]
+ *   --samples N       samples per synthetic signal (default 1048576)
+ *   --iterations N    timed repetitions (default 20)
+ *   --file PATH       also measure the channels of a recording
+ * Returns a non zero exit code if a round trip fails.
+ *
+ * This code is licensed under MIT license (see LICENSE.txt for details)
+ * Copyright (c) 2024 by DEWETRON GmbH
+ */
+
+
+#include "dewepxi_record_reader.h"
+#include "dewepxi_sample_codec.h"
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+
+struct Signal
+{
+    std::string name;
+    std::vector<sint32> samples;
+};
+
+/**
+ * Sine of an amplitude near full scale with noise_bits of uniform noise.
+ */
+std::vector<sint32> makeSine(uint32 count, uint32 noise_bits, uint32 seed)
+{
+    std::mt19937 rng(seed);
+    std::vector<sint32> samples(count);
+    const sint32 noise_range = noise_bits ? (1 << noise_bits) : 1;
+    for (uint32 i = 0; i < count; ++i)
+    {
+        const double value = 7000000.0 * std::sin(2 * 3.14159265358979 * i / 977.0);
+        const sint32 noise = noise_bits ? static_cast<sint32>(rng() % noise_range) - noise_range / 2 : 0;
+        samples[i] = static_cast<sint32>(value) + noise;
+    }
+    return samples;
+}
+
+std::vector<Signal> makeSignals(uint32 count)
+{
+    std::vector<Signal> signals;
+    std::mt19937 rng(42);
+
+    Signal constant = { "constant", std::vector<sint32>(count, -1234) };
+    signals.push_back(constant);
+
+    Signal ramp = { "ramp", std::vector<sint32>(count) };
+    for (uint32 i = 0; i < count; ++i)
+    {
+        ramp.samples[i] = static_cast<sint32>(i % 0x1000000) * 3 - 0x800000;
+    }
+    signals.push_back(ramp);
+
+    Signal sine_clean = { "sine, no noise", makeSine(count, 0, 1) };
+    signals.push_back(sine_clean);
+    Signal sine_4 = { "sine, 4 bit noise", makeSine(count, 4, 2) };
+    signals.push_back(sine_4);
+    Signal sine_12 = { "sine, 12 bit noise", makeSine(count, 12, 3) };
+    signals.push_back(sine_12);
+
+    Signal noise = { "24 bit noise", std::vector<sint32>(count) };
+    for (uint32 i = 0; i < count; ++i)
+    {
+        noise.samples[i] = static_cast<sint32>(rng() & 0xffffff) - 0x800000;
+    }
+    signals.push_back(noise);
+
+    // Not a 24 bit signal, exercises the 32 bit wrap around of the residuals
+    Signal full = { "32 bit noise", std::vector<sint32>(count) };
+    for (uint32 i = 0; i < count; ++i)
+    {
+        full.samples[i] = static_cast<sint32>(i % 5 == 0 ? (i & 8 ? 0x80000000u : 0x7fffffffu) : rng());
+    }
+    signals.push_back(full);
+
+    return signals;
+}
+
+/**
+ * Round trip of all prefixes crossing the block boundaries, compared to the reference encoding.
+ * @return number of mismatches
+ */
+int checkCodec(const trion::SampleCodecKernels& kernels, const Signal& signal)
+{
+    const trion::SampleCodecKernels& reference = *trion::sampleCodecKernels(trion::SIMD_LEVEL_SCALAR);
+    const uint32 counts[] = { 0, 1, 2, 3, 5, 127, 128, 129, 255, 256, 1000, 4096 };
+    int errors = 0;
+
+    for (uint32 count : counts)
+    {
+        count = std::min<uint32>(count, static_cast<uint32>(signal.samples.size()));
+        std::vector<uint8> encoded(trion::sampleCodecMaxSize(count) + 1);
+        std::vector<uint8> expected(encoded.size());
+        const uint64 size = trion::encodeSamples(kernels, signal.samples.data(), count, encoded.data());
+        const uint64 expected_size = trion::encodeSamples(reference, signal.samples.data(), count, expected.data());
+
+        if (size != expected_size || std::memcmp(encoded.data(), expected.data(), static_cast<size_t>(size)) != 0)
+        {
+            std::cerr << trion::simdLevelName(kernels.level) << ": " << signal.name
+                      << ": encoding differs from scalar, count " << count << std::endl;
+            ++errors;
+        }
+
+        for (uint32 prefix = count > 130 ? count - 130 : 0; prefix <= count; ++prefix)
+        {
+            std::vector<sint32> decoded(prefix + 1, 0x5a5a5a5a);
+            if (!trion::decodeSamples(kernels, encoded.data(), size, prefix, decoded.data())
+                || std::memcmp(decoded.data(), signal.samples.data(), prefix * sizeof(sint32)) != 0
+                || decoded[prefix] != 0x5a5a5a5a)
+            {
+                if (errors < 10)
+                {
+                    std::cerr << trion::simdLevelName(kernels.level) << ": " << signal.name
+                              << ": round trip failed, count " << count << ", prefix " << prefix << std::endl;
+                }
+                ++errors;
+            }
+        }
+
+        // Truncated data must be detected
+        if (size > 0 && trion::decodeSamples(kernels, encoded.data(), size - 1, count, std::vector<sint32>(count).data()))
+        {
+            std::cerr << trion::simdLevelName(kernels.level) << ": " << signal.name
+                      << ": truncation not detected, count " << count << std::endl;
+            ++errors;
+        }
+    }
+    return errors;
+}
+
+/**
+ * Encode and decode the signal iterations times.
+ * @return number of mismatches
+ */
+int benchCodec(const trion::SampleCodecKernels& kernels, const Signal& signal, int iterations)
+{
+    const uint32 count = static_cast<uint32>(signal.samples.size());
+    std::vector<uint8> encoded(trion::sampleCodecMaxSize(count));
+    std::vector<sint32> decoded(count);
+    uint64 size = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int it = 0; it < iterations; ++it)
+    {
+        size = trion::encodeSamples(kernels, signal.samples.data(), count, encoded.data());
+    }
+    auto encoded_time = std::chrono::steady_clock::now();
+    bool ok = true;
+    for (int it = 0; it < iterations; ++it)
+    {
+        ok = trion::decodeSamples(kernels, encoded.data(), size, count, decoded.data()) && ok;
+    }
+    auto stop = std::chrono::steady_clock::now();
+    ok = ok && decoded == signal.samples;
+
+    const double bytes = static_cast<double>(count) * sizeof(sint32) * iterations;
+    const double encode_s = std::chrono::duration<double>(encoded_time - start).count();
+    const double decode_s = std::chrono::duration<double>(stop - encoded_time).count();
+
+    std::cout << std::setw(8) << trion::simdLevelName(kernels.level) << "  "
+              << std::left << std::setw(22) << signal.name << std::right
+              << std::fixed << std::setprecision(2)
+              << " ratio " << std::setw(6) << (size ? static_cast<double>(count) * sizeof(sint32) / size : 0.0)
+              << std::setprecision(1)
+              << "  bits/sample " << std::setw(5) << (count ? size * 8.0 / count : 0.0)
+              << std::setprecision(2)
+              << "  encode " << std::setw(6) << (encode_s > 0 ? bytes / encode_s / 1e9 : 0.0) << " GB/s"
+              << "  decode " << std::setw(6) << (decode_s > 0 ? bytes / decode_s / 1e9 : 0.0) << " GB/s"
+              << (ok ? "" : "  MISMATCH") << std::endl;
+    return ok ? 0 : 1;
+}
+
+/**
+ * All channels of a recording, as one signal per channel.
+ */
+bool loadRecording(const std::string& path, std::vector<Signal>& signals)
+{
+    trion::RecordReader reader;
+    if (!reader.open(path))
+    {
+        std::cerr << path << ": " << reader.lastError() << std::endl;
+        return false;
+    }
+
+    const uint32 scans = static_cast<uint32>(std::min<uint64>(reader.totalScans(), 1u << 24));
+    for (uint32 c = 0; c < reader.numChannels(); ++c)
+    {
+        Signal signal = { std::string("rec ") + reader.channel(c).name, std::vector<sint32>(scans) };
+        if (reader.read(c, 0, scans, signal.samples.data()) != scans)
+        {
+            std::cerr << path << ": cannot read channel " << reader.channel(c).name << std::endl;
+            return false;
+        }
+        signals.push_back(signal);
+    }
+    return true;
+}
+
+
+int main(int argc, char* argv[])
+{
+    uint32 samples = 1 << 20;
+    int iterations = 20;
+    std::string path;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (value && arg == "--samples")
+        {
+            samples = static_cast<uint32>(std::atoi(argv[++i]));
+        }
+        else if (value && arg == "--iterations")
+        {
+            iterations = std::atoi(argv[++i]);
+        }
+        else if (value && arg == "--file")
+        {
+            path = argv[++i];
+        }
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [--samples N] [--iterations N] [--file PATH]" << std::endl;
+            return 2;
+        }
+    }
+    if (samples == 0 || iterations <= 0)
+    {
+        std::cerr << "Invalid arguments" << std::endl;
+        return 2;
+    }
+
+    std::vector<Signal> signals = makeSignals(samples);
+    if (!path.empty() && !loadRecording(path, signals))
+    {
+        return 1;
+    }
+
+    std::cout << "Selected: " << trion::simdLevelName(trion::sampleCodecKernels().level)
+              << ", " << samples << " samples per signal, " << iterations << " iterations" << std::endl;
+
+    int errors = 0;
+    for (int level = trion::SIMD_LEVEL_SCALAR; level <= trion::SIMD_LEVEL_AVX512; ++level)
+    {
+        const trion::SampleCodecKernels* kernels = trion::sampleCodecKernels(static_cast<trion::SimdLevel>(level));
+        if (!kernels)
+        {
+            continue;
+        }
+        for (const Signal& signal : signals)
+        {
+            errors += checkCodec(*kernels, signal);
+            errors += benchCodec(*kernels, signal, iterations);
+        }
+    }
+
+    std::cout << (errors ? "FAIL" : "PASS") << std::endl;
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,230 @@
+/**
+ * TRION-SDK envelope pyramid benchmark.
+ *
+ * Appends a long synthetic 24 bit signal to an EnvelopePyramid block by
+ * block and reports the append throughput, then queries one screen of
+ * pixels at zooms from the whole recording down to a few samples per
+ * pixel. The query time depends on the pixels, not on the span.
+ * The envelopes are verified against the samples: pixels covering whole
+ * buckets have the exact min, max and mean, arbitrary spans include all
+ * their samples.
+ *
+ * Usage: EnvelopeBench [options]
+ *   --samples N       appended samples (default 134217728)
+ *   --block N         samples per append (default 10000)
+ *   --pixels N        pixels per query (default 1920)
+ *   --base N          samples per level 0 bucket (default 64)
+ *   --factor N        buckets combined per level (default 8)
+ *   --queries N       queries per zoom (default 1000)
+ *
+ * This code is licensed under MIT license (see LICENSE.txt for details)
+ * Copyright (c) 2024 by DEWETRON GmbH
+ */
+
+
+#include "dewepxi_apicore.h"
+#include "dewepxi_acq_engine.h"
+#include "dewepxi_envelope.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+
+namespace
+{
+    /**
+     * Sample i of a slow triangle with noise, cheap to recompute for the checks.
+     */
+    sint32 sampleAt(uint64 i)
+    {
+        const sint32 triangle = static_cast<sint32>((i >> 4) & 0x7fffff);
+        const sint32 ramp = (i >> 27) & 1 ? 0x7fffff - triangle : triangle;
+        const uint32 hash = static_cast<uint32>(i * 2654435761u) >> 16;
+        return ramp - 0x400000 + static_cast<sint32>(hash & 0xffff) - 0x8000;
+    }
+
+    struct Reference
+    {
+        sint32 min;
+        sint32 max;
+        double mean;
+        uint64 count;
+    };
+
+    Reference bruteForce(uint64 first, uint64 end)
+    {
+        Reference ref = { sampleAt(first), sampleAt(first), 0.0, end - first };
+        double sum = 0.0;
+        for (uint64 i = first; i < end; ++i)
+        {
+            const sint32 value = sampleAt(i);
+            ref.min = std::min(ref.min, value);
+            ref.max = std::max(ref.max, value);
+            sum += value;
+        }
+        ref.mean = sum / ref.count;
+        return ref;
+    }
+
+    /**
+     * Check a query against the samples of every pixel.
+     * @param exact pixels cover whole buckets, min, max and mean have to match
+     */
+    bool verify(const trion::EnvelopePyramid& envelope, uint64 first, uint64 end, uint32 pixels, bool exact)
+    {
+        std::vector<trion::EnvelopeBucket> out;
+        envelope.query(first, end, pixels, out);
+        end = std::min(end, envelope.samples());
+        const uint64 span = end - first;
+        for (uint32 p = 0; p < pixels; ++p)
+        {
+            const uint64 s0 = first + span * p / pixels;
+            const uint64 s1 = std::max(first + span * (p + 1) / pixels, s0 + 1);
+            const trion::EnvelopeBucket& pixel = out[p];
+            const Reference ref = bruteForce(s0, s1);
+            bool ok = pixel.count >= ref.count && pixel.min <= ref.min && pixel.max >= ref.max;
+            if (exact)
+            {
+                ok = pixel.count == ref.count && pixel.min == ref.min && pixel.max == ref.max
+                    && std::fabs(pixel.mean - ref.mean) <= 16.0;
+            }
+            if (!ok)
+            {
+                std::cerr << "Mismatch at pixel " << p << " [" << s0 << ", " << s1 << "): envelope "
+                          << pixel.min << " / " << pixel.max << " / " << pixel.mean << " (" << pixel.count
+                          << "), samples " << ref.min << " / " << ref.max << " / " << ref.mean
+                          << " (" << ref.count << ")" << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+
+int main(int argc, char* argv[])
+{
+    uint64 total = 1ull << 27;
+    uint32 block = 10000;
+    uint32 pixels = 1920;
+    uint32 base = 64;
+    uint32 factor = 8;
+    uint32 queries = 1000;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (value && arg == "--samples")
+        {
+            total = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else if (value && arg == "--block")
+        {
+            block = static_cast<uint32>(std::atoi(argv[++i]));
+        }
+        else if (value && arg == "--pixels")
+        {
+            pixels = static_cast<uint32>(std::atoi(argv[++i]));
+        }
+        else if (value && arg == "--base")
+        {
+            base = static_cast<uint32>(std::atoi(argv[++i]));
+        }
+        else if (value && arg == "--factor")
+        {
+            factor = static_cast<uint32>(std::atoi(argv[++i]));
+        }
+        else if (value && arg == "--queries")
+        {
+            queries = static_cast<uint32>(std::atoi(argv[++i]));
+        }
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [--samples N] [--block N] [--pixels N] [--base N]"
+                      << " [--factor N] [--queries N]" << std::endl;
+            return 1;
+        }
+    }
+
+    if (total < pixels || block == 0 || pixels == 0 || base == 0 || factor < 2 || queries == 0)
+    {
+        std::cerr << "Invalid samples, block, pixels, base or factor" << std::endl;
+        return 1;
+    }
+
+    trion::EnvelopePyramid envelope(base, factor);
+    std::vector<sint32> samples(block);
+    uint64 append_ns = 0;
+    for (uint64 pos = 0; pos < total;)
+    {
+        const uint32 count = static_cast<uint32>(std::min<uint64>(block, total - pos));
+        for (uint32 i = 0; i < count; ++i)
+        {
+            samples[i] = sampleAt(pos + i);
+        }
+        const uint64 start_ns = trion::steadyClockNs();
+        envelope.append(samples.data(), count);
+        append_ns += trion::steadyClockNs() - start_ns;
+        pos += count;
+    }
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Appended " << total << " samples in blocks of " << block << ", base " << base
+              << ", factor " << factor << ", " << envelope.numLevels() << " levels" << std::endl;
+    std::cout << "  append          " << total / (append_ns * 1e-9) / 1e6 << " MS/s, "
+              << total * sizeof(sint32) / (append_ns * 1e-9) / 1e9 << " GB/s" << std::endl;
+    std::cout << "  memory          " << envelope.memoryBytes() / 1e6 << " MB, "
+              << 100.0 * envelope.memoryBytes() / (total * sizeof(sint32)) << " % of the samples" << std::endl;
+
+    // One screen at zooms from the whole recording down to a few samples per pixel
+    std::mt19937_64 random(42);
+    std::vector<trion::EnvelopeBucket> out;
+    std::cout << "  query of " << pixels << " pixels" << std::endl;
+    for (uint64 span = total; span >= pixels; span /= 16)
+    {
+        const uint64 start_ns = trion::steadyClockNs();
+        uint32 filled = 0;
+        for (uint32 q = 0; q < queries; ++q)
+        {
+            const uint64 first = total > span ? random() % (total - span) : 0;
+            filled += envelope.query(first, first + span, pixels, out);
+        }
+        const double query_us = (trion::steadyClockNs() - start_ns) * 1e-3 / queries;
+        std::cout << "    span " << std::setw(12) << span << " samples, " << std::setw(10)
+                  << static_cast<double>(span) / pixels << " samples/pixel: " << std::setw(8)
+                  << query_us << " us" << (filled == queries * pixels ? "" : " (incomplete)") << std::endl;
+    }
+
+    // Exact at bucket aligned pixels of the first levels, covering at arbitrary spans and the open end
+    bool ok = true;
+    for (uint32 level = 0; level < std::min(envelope.numLevels(), 3u) && ok; ++level)
+    {
+        const uint64 bucket = envelope.bucketSamples(level);
+        if (bucket * pixels <= total)
+        {
+            const uint64 first = (random() % (total / bucket - pixels + 1)) * bucket;
+            ok = verify(envelope, first, first + bucket * pixels, pixels, true);
+        }
+    }
+    for (uint32 q = 0; q < 20 && ok; ++q)
+    {
+        const uint64 span = std::min<uint64>(total, pixels + random() % (1u << 22));
+        const uint64 first = random() % (total - span + 1);
+        ok = verify(envelope, first, first + span, pixels, false);
+    }
+    if (ok)
+    {
+        const uint64 span = std::min<uint64>(total, 1u << 20);
+        ok = verify(envelope, total - span, total + 1000, pixels, false);
+    }
+
+    std::cout << (ok ? "PASS" : "FAIL") << ": envelopes " << (ok ? "match" : "do not match")
+              << " the samples" << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,237 @@
+/**
+ * TRION-SDK recorder throughput benchmark.
+ *
+ * Records the scans of a synthetic circular buffer as fast as possible
+ * and reports the sustained recording rate and the CPU time per GB.
+ * By default every block is decoded and written with the Recorder, the
+ * time spent in decode and Recorder::write() is the load of the consumer
+ * core while the writer thread stores the chunks in parallel. With --raw
+ * the RawRecorder writes the scans straight from the circular buffer.
+ * The run passes if the recorder keeps up with the target rate,
+ * including the final flush.
+ *
+ * Usage: RecorderBench [options]
+ *   --channels N      channels per scan (default 64)
+ *   --rate N          target scans/s (default 1000000)
+ *   --seconds N       recorded duration at the target rate (default 5)
+ *   --block N         scans per block read from the buffer (default 10000)
+ *   --chunk N         scans per file chunk (default 65536)
+ *   --packed          encode the columns (RECORD_ENCODING_DELTA_PACKED)
+ *   --raw             record the raw scans (RawRecorder)
+ *   --file PATH       recording file (default recorder_bench.trec)
+ *   --keep            keep the file
+ *
+ * This code is licensed under MIT license (see LICENSE.txt for details)
+ * Copyright (c) 2024 by DEWETRON GmbH
+ */
+
+
+#include "dewepxi_apicore.h"
+#include "dewepxi_acq_engine.h"
+#include "dewepxi_recorder.h"
+#include "dewepxi_scan_decoder.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+
+namespace
+{
+    /**
+     * ScanDescriptor_V3 of a board with 24 bit analog channels in 32 bit slots.
+     */
+    std::string scanDescriptor(uint32 channels)
+    {
+        std::ostringstream xml;
+        xml << "<?xml version=\"1.0\"?>\n<ScanDescriptor>\n<BoardId1>\n"
+            << "<ScanDescription version=\"3\" buffer=\"BUFFER0\" buffer_direction=\"from_trion_board\" scan_size=\""
+            << channels * 32 << "\" byte_order=\"little_endian\" unit=\"bit\">\n";
+        for (uint32 i = 0; i < channels; ++i)
+        {
+            xml << "<Channel type=\"Analog\" index=\"" << i << "\" name=\"AI" << i << "\">\n"
+                << "<Sample offset=\"" << i * 32 << "\" size=\"24\"/>\n</Channel>\n";
+        }
+        xml << "</ScanDescription>\n</BoardId1>\n</ScanDescriptor>\n";
+        return xml.str();
+    }
+}
+
+
+int main(int argc, char* argv[])
+{
+    uint32 channels = 64;
+    uint32 rate = 1000000;
+    double seconds = 5.0;
+    uint32 block_scans = 10000;
+    uint32 chunk_scans = 65536;
+    std::string path = "recorder_bench.trec";
+    bool keep = false;
+    bool packed = false;
+    bool raw = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (arg == "--keep")
+        {
+            keep = true;
+        }
+        else if (arg == "--packed")
+        {
+            packed = true;
+        }
+        else if (arg == "--raw")
+        {
+            raw = true;
+        }
+        else if (value && arg == "--channels")
+        {
+            channels = static_cast<uint32>(std::atoi(argv[++i]));
+        }
+        else if (value && arg == "--rate")
+        {
+            rate = static_cast<uint32>(std::atoi(argv[++i]));
+        }
+        else if (value && arg == "--seconds")
+        {
+            seconds = std::atof(argv[++i]);
+        }
+        else if (value && arg == "--block")
+        {
+            block_scans = static_cast<uint32>(std::atoi(argv[++i]));
+        }
+        else if (value && arg == "--chunk")
+        {
+            chunk_scans = static_cast<uint32>(std::atoi(argv[++i]));
+        }
+        else if (value && arg == "--file")
+        {
+            path = argv[++i];
+        }
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [--channels N] [--rate N] [--seconds N] [--block N]"
+                      << " [--chunk N] [--packed] [--raw] [--file PATH] [--keep]" << std::endl;
+            return 1;
+        }
+    }
+
+    if (channels == 0 || rate == 0 || block_scans == 0 || chunk_scans == 0 || seconds <= 0.0)
+    {
+        std::cerr << "Invalid channels, rate, block or chunk size" << std::endl;
+        return 1;
+    }
+
+    trion::ScanDescriptor sd(scanDescriptor(channels));
+    trion::ScanDecoder decoder(sd);
+    for (uint32 c = 0; c < channels; ++c)
+    {
+        trion::ChannelScaling scaling = { 10.0 / 8388608.0, 0.0 };
+        decoder.setScaling(c, scaling);
+    }
+
+    // Circular buffer of a ramp per channel, not a multiple of the block size so reads wrap
+    const uint32 scan_words = channels;
+    const uint32 ring_scans = block_scans * 8 + block_scans / 2 + 1;
+    std::vector<uint32> ring_memory(static_cast<size_t>(ring_scans) * scan_words);
+    for (uint32 i = 0; i < ring_scans; ++i)
+    {
+        for (uint32 c = 0; c < channels; ++c)
+        {
+            ring_memory[static_cast<size_t>(i) * scan_words + c] = (i * 97 + c * 1021) & 0xffffff;
+        }
+    }
+    trion::RingBufferView ring(0);
+    const sint64 ring_start = reinterpret_cast<sint64>(ring_memory.data());
+    ring.setGeometry(ring_start, ring_start + static_cast<sint64>(ring_memory.size() * sizeof(uint32)), sd.scanSize());
+
+    trion::DecodedBlock block(channels, block_scans);
+    trion::Recorder recorder;
+    trion::RawRecorder raw_recorder;
+    recorder.setEncoding(packed ? trion::RECORD_ENCODING_DELTA_PACKED : trion::RECORD_ENCODING_RAW_I32);
+    const bool opened = raw ? raw_recorder.open(path, sd, decoder, rate)
+                            : recorder.open(path, sd, decoder, rate, chunk_scans);
+    if (!opened)
+    {
+        std::cerr << (raw ? raw_recorder.lastError() : recorder.lastError()) << std::endl;
+        return 1;
+    }
+
+    const uint64 total_scans = static_cast<uint64>(seconds * rate);
+    uint64 busy_ns = 0;
+    const std::clock_t start_cpu = std::clock();
+    const uint64 start_ns = trion::steadyClockNs();
+    sint64 read_pos = ring_start;
+    for (uint64 scans = 0; scans < total_scans;)
+    {
+        const uint32 count = static_cast<uint32>(std::min<uint64>(block_scans, total_scans - scans));
+        const trion::ScanSpans spans = ring.spansAt(read_pos, count);
+        const uint64 write_ns = trion::steadyClockNs();
+        bool ok = false;
+        if (raw)
+        {
+            ok = raw_recorder.write(spans);
+        }
+        else
+        {
+            decoder.decode(spans, block);
+            ok = recorder.write(block);
+        }
+        if (!ok)
+        {
+            std::cerr << "Write failed: " << (raw ? raw_recorder.lastError() : recorder.lastError()) << std::endl;
+            return 1;
+        }
+        busy_ns += trion::steadyClockNs() - write_ns;
+
+        // The scans may be released now
+        read_pos = ring.advance(read_pos, count);
+        scans += count;
+    }
+    const uint64 close_ns = trion::steadyClockNs();
+    if (!(raw ? raw_recorder.close() : recorder.close()))
+    {
+        std::cerr << "Close failed: " << (raw ? raw_recorder.lastError() : recorder.lastError()) << std::endl;
+        return 1;
+    }
+    const uint64 end_ns = trion::steadyClockNs();
+    const double cpu_s = static_cast<double>(std::clock() - start_cpu) / CLOCKS_PER_SEC;
+
+    const double elapsed = (end_ns - start_ns) * 1e-9;
+    const double recorded = static_cast<double>(total_scans) / rate;
+    const double scans_per_s = total_scans / elapsed;
+    const double bytes = static_cast<double>(raw ? raw_recorder.bytesWritten() : recorder.bytesWritten());
+    const double sample_bytes = static_cast<double>(total_scans) * sd.scanSize();
+    const uint64 stall_ns = raw ? 0 : recorder.stallNs();
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Recorded " << channels << " channels, " << total_scans << " scans ("
+              << recorded << " s at " << rate / 1e6 << " MS/s) in "
+              << (raw ? raw_recorder.chunks() : recorder.chunks()) << " chunks"
+              << (raw ? ", raw scans" : packed ? ", packed" : "") << std::endl;
+    std::cout << "  elapsed         " << elapsed << " s (close " << (end_ns - close_ns) * 1e-6 << " ms)" << std::endl;
+    std::cout << "  throughput      " << scans_per_s / 1e6 << " MS/s, " << bytes / elapsed / 1e6 << " MB/s" << std::endl;
+    std::cout << "  file size       " << bytes / 1e6 << " MB, compression ratio " << sample_bytes / bytes << std::endl;
+    std::cout << "  CPU time        " << cpu_s << " s, " << cpu_s / (sample_bytes / 1e9) << " s per GB of scans" << std::endl;
+    std::cout << "  consumer load   " << 100.0 * (busy_ns - stall_ns) * 1e-9 / recorded
+              << " % of one core at the target rate" << (raw ? ", in the file writes" : ", without stalls") << std::endl;
+    if (!raw)
+    {
+        std::cout << "  writer stalls   " << recorder.stalls() << " (" << stall_ns * 1e-6 << " ms)" << std::endl;
+    }
+    std::cout << (scans_per_s >= rate ? "PASS" : "FAIL") << ": sustained "
+              << scans_per_s / 1e6 << " MS/s, target " << rate / 1e6 << " MS/s" << std::endl;
+
+    if (!keep)
+    {
+        std::remove(path.c_str());
+    }
+    return scans_per_s >= rate ? 0 : 1;
+}
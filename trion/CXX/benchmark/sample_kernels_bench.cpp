@@ -0,0 +1,346 @@
+/**
+ * TRION-SDK sample kernel check and benchmark.
+ *
+ * Verifies every available instruction set variant of the 24 bit
+ * sample kernels (plain, scaled and channel groups) against formatRawData()
+ * and measures the deinterleave throughput in scans/s.
+ *
+ * Usage: SampleKernelsBench [channels] [scans] [iterations]
+ * Returns a non zero exit code if a kernel result does not match.
+ *
+ * This code is licensed under MIT license (see LICENSE.txt for details)
+ * Copyright (c) 2024 by DEWETRON GmbH
+ */
+
+
+#include "dewepxi_apicore.h"
+#include "dewepxi_sample_kernels.h"
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+// after the standard headers, trion_sdk_util.h defines min/max macros
+extern "C" {
+#include "trion_sdk_util.h"
+}
+
+
+// Range -5 V .. 15 V
+const double SCALE_GAIN = 10.0 / 8388607;
+const double SCALE_OFFSET = 5.0;
+
+
+/**
+ * Random scan words including the sign and boundary cases.
+ */
+std::vector<uint32> makeScanWords(size_t count, uint32 seed)
+{
+    static const uint32 edge_values[] = {
+        0x00000000, 0x000000ff, 0x00000100, 0x007fffff, 0x00800000, 0x00ffffff,
+        0x7fffff00, 0x7fffffff, 0x80000100, 0xff000000, 0xffffff00, 0xffffff01,
+        0xffffffff, 0xfffffe01, 0x12800000, 0xabcdef12
+    };
+
+    std::mt19937 rng(seed);
+    std::vector<uint32> words(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        words[i] = (i % 7 == 0) ? edge_values[(i / 7) % (sizeof(edge_values) / sizeof(edge_values[0]))]
+                                : static_cast<uint32>(rng());
+    }
+    return words;
+}
+
+/**
+ * Compare one kernel variant with formatRawData
+ * @return number of mismatches
+ */
+int checkKernels(const trion::SampleKernels& kernels)
+{
+    int errors = 0;
+    const auto words = makeScanWords(4096, 42);
+
+    for (uint32 stride = 1; stride <= 9; ++stride)
+    {
+        // odd counts exercise the kernel tails
+        for (uint32 count = 0; count <= 67; count += (count < 20 ? 1 : 13))
+        {
+            for (uint32 chn = 0; chn < stride && chn < 3; ++chn)
+            {
+                for (int offset = 0; offset <= 8; offset += 8)
+                {
+                    std::vector<sint32> out_i32(count + 1, 0x5a5a5a5a);
+                    std::vector<float> out_f32(count + 1, 0.0f);
+                    std::vector<float> out_scaled_f32(count + 1, 0.0f);
+                    std::vector<double> out_scaled_f64(count + 1, 0.0);
+
+                    if (offset)
+                    {
+                        kernels.left_i32(&words[chn], stride, count, out_i32.data());
+                        kernels.left_f32(&words[chn], stride, count, out_f32.data());
+                        kernels.left_scaled_f32(&words[chn], stride, count, SCALE_GAIN, SCALE_OFFSET, out_scaled_f32.data());
+                        kernels.left_scaled_f64(&words[chn], stride, count, SCALE_GAIN, SCALE_OFFSET, out_scaled_f64.data());
+                    }
+                    else
+                    {
+                        kernels.right_i32(&words[chn], stride, count, out_i32.data());
+                        kernels.right_f32(&words[chn], stride, count, out_f32.data());
+                        kernels.right_scaled_f32(&words[chn], stride, count, SCALE_GAIN, SCALE_OFFSET, out_scaled_f32.data());
+                        kernels.right_scaled_f64(&words[chn], stride, count, SCALE_GAIN, SCALE_OFFSET, out_scaled_f64.data());
+                    }
+
+                    for (uint32 i = 0; i < count; ++i)
+                    {
+                        uint32 raw = words[chn + i * stride];
+                        // formatRawData negates the value: undefined for INT_MIN
+                        if (offset && raw == 0x80000000)
+                        {
+                            continue;
+                        }
+
+                        sint32 expected = formatRawData(static_cast<sint32>(raw), 24, offset);
+                        double expected_scaled = expected * SCALE_GAIN + SCALE_OFFSET;
+
+                        // the scaled results may differ in rounding (fused multiply add)
+                        bool scaled_ok = std::fabs(out_scaled_f64[i] - expected_scaled) <= 1e-12
+                            && std::fabs(out_scaled_f32[i] - expected_scaled) <= 1e-5;
+
+                        if (out_i32[i] != expected || out_f32[i] != static_cast<float>(expected) || !scaled_ok)
+                        {
+                            if (errors < 10)
+                            {
+                                std::cerr << trion::simdLevelName(kernels.level)
+                                          << ": mismatch raw=0x" << std::hex << raw << std::dec
+                                          << " offset=" << offset << " expected=" << expected
+                                          << " i32=" << out_i32[i] << " f32=" << out_f32[i]
+                                          << " scaled f32=" << out_scaled_f32[i] << " f64=" << out_scaled_f64[i] << std::endl;
+                            }
+                            ++errors;
+                        }
+                    }
+
+                    // must not write behind count
+                    if (out_i32[count] != 0x5a5a5a5a)
+                    {
+                        std::cerr << trion::simdLevelName(kernels.level) << ": write behind count " << count << std::endl;
+                        ++errors;
+                    }
+                }
+            }
+        }
+    }
+
+    return errors;
+}
+
+/**
+ * Compare the channel group kernels of one variant with formatRawData
+ * @return number of mismatches
+ */
+int checkGroupKernels(const trion::SampleKernels& kernels)
+{
+    const uint32 G = trion::SAMPLE24_GROUP;
+    int errors = 0;
+    const auto words = makeScanWords(16384, 43);
+
+    for (uint32 stride = G; stride <= 2 * G + 3; stride += 3)
+    {
+        for (uint32 count = 0; count <= 67; count += (count < 20 ? 1 : 13))
+        {
+            for (int offset = 0; offset <= 8; offset += 8)
+            {
+                double gain[8];
+                double scale_offset[8];
+                std::vector<std::vector<sint32>> out_i32(G, std::vector<sint32>(count + 1, 0x5a5a5a5a));
+                std::vector<std::vector<float>> out_f32(G, std::vector<float>(count + 1, 0.0f));
+                std::vector<std::vector<float>> out_scaled_f32(G, std::vector<float>(count + 1, 0.0f));
+                std::vector<std::vector<double>> out_scaled_f64(G, std::vector<double>(count + 1, 0.0));
+                sint32* dst_i32[8];
+                float* dst_f32[8];
+                float* dst_scaled_f32[8];
+                double* dst_scaled_f64[8];
+                for (uint32 c = 0; c < G; ++c)
+                {
+                    gain[c] = SCALE_GAIN * (c + 1);
+                    scale_offset[c] = SCALE_OFFSET - c;
+                    dst_i32[c] = out_i32[c].data();
+                    dst_f32[c] = out_f32[c].data();
+                    dst_scaled_f32[c] = out_scaled_f32[c].data();
+                    dst_scaled_f64[c] = out_scaled_f64[c].data();
+                }
+
+                const uint32* src = &words[1];
+                (offset ? kernels.left_x8_i32 : kernels.right_x8_i32)(src, stride, count, dst_i32);
+                (offset ? kernels.left_x8_f32 : kernels.right_x8_f32)(src, stride, count, dst_f32);
+                (offset ? kernels.left_x8_scaled_f32 : kernels.right_x8_scaled_f32)(src, stride, count, gain, scale_offset, dst_scaled_f32);
+                (offset ? kernels.left_x8_scaled_f64 : kernels.right_x8_scaled_f64)(src, stride, count, gain, scale_offset, dst_scaled_f64);
+
+                for (uint32 c = 0; c < G; ++c)
+                {
+                    for (uint32 i = 0; i < count; ++i)
+                    {
+                        uint32 raw = src[c + i * stride];
+                        // formatRawData negates the value: undefined for INT_MIN
+                        if (offset && raw == 0x80000000)
+                        {
+                            continue;
+                        }
+
+                        sint32 expected = formatRawData(static_cast<sint32>(raw), 24, offset);
+                        double expected_scaled = expected * gain[c] + scale_offset[c];
+                        bool scaled_ok = std::fabs(out_scaled_f64[c][i] - expected_scaled) <= 1e-12
+                            && std::fabs(out_scaled_f32[c][i] - expected_scaled) <= 1e-5 * (c + 1);
+
+                        if (out_i32[c][i] != expected || out_f32[c][i] != static_cast<float>(expected) || !scaled_ok)
+                        {
+                            if (errors < 10)
+                            {
+                                std::cerr << trion::simdLevelName(kernels.level)
+                                          << ": group mismatch raw=0x" << std::hex << raw << std::dec
+                                          << " channel=" << c << " offset=" << offset << " expected=" << expected
+                                          << " i32=" << out_i32[c][i] << " f32=" << out_f32[c][i]
+                                          << " scaled f32=" << out_scaled_f32[c][i] << " f64=" << out_scaled_f64[c][i] << std::endl;
+                            }
+                            ++errors;
+                        }
+                    }
+
+                    if (out_i32[c][count] != 0x5a5a5a5a)
+                    {
+                        std::cerr << trion::simdLevelName(kernels.level) << ": group write behind count " << count << std::endl;
+                        ++errors;
+                    }
+                }
+            }
+        }
+    }
+
+    return errors;
+}
+
+/**
+ * Deinterleave all channels of a scan block, repeated iterations times.
+ * Groups of SAMPLE24_GROUP channels use the group kernels, like the
+ * ScanDecoder, unless per_channel is set.
+ * @return scans per second
+ */
+enum BenchMode
+{
+    BENCH_INT32,
+    BENCH_FLOAT,
+    BENCH_SCALED_F64
+};
+
+double benchKernels(const trion::SampleKernels& kernels, BenchMode mode,
+                    uint32 channels, uint32 scans, int iterations, bool per_channel = false)
+{
+    const uint32 G = trion::SAMPLE24_GROUP;
+    const auto words = makeScanWords(static_cast<size_t>(channels) * scans, 7);
+    std::vector<sint32> out_i32(static_cast<size_t>(channels) * scans);
+    std::vector<float> out_f32(static_cast<size_t>(channels) * scans);
+    std::vector<double> out_f64(static_cast<size_t>(channels) * scans);
+    const double gain[8] = { SCALE_GAIN, SCALE_GAIN, SCALE_GAIN, SCALE_GAIN, SCALE_GAIN, SCALE_GAIN, SCALE_GAIN, SCALE_GAIN };
+    const double offset[8] = { SCALE_OFFSET, SCALE_OFFSET, SCALE_OFFSET, SCALE_OFFSET, SCALE_OFFSET, SCALE_OFFSET, SCALE_OFFSET, SCALE_OFFSET };
+
+    auto start = std::chrono::steady_clock::now();
+    for (int it = 0; it < iterations; ++it)
+    {
+        uint32 chn = 0;
+        for (; !per_channel && chn + G <= channels; chn += G)
+        {
+            sint32* dst_i32[8];
+            float* dst_f32[8];
+            double* dst_f64[8];
+            for (uint32 c = 0; c < G; ++c)
+            {
+                const size_t dst = static_cast<size_t>(chn + c) * scans;
+                dst_i32[c] = &out_i32[dst];
+                dst_f32[c] = &out_f32[dst];
+                dst_f64[c] = &out_f64[dst];
+            }
+            switch (mode)
+            {
+            case BENCH_INT32:
+                kernels.left_x8_i32(&words[chn], channels, scans, dst_i32);
+                break;
+            case BENCH_FLOAT:
+                kernels.left_x8_f32(&words[chn], channels, scans, dst_f32);
+                break;
+            case BENCH_SCALED_F64:
+                kernels.left_x8_scaled_f64(&words[chn], channels, scans, gain, offset, dst_f64);
+                break;
+            }
+        }
+        for (; chn < channels; ++chn)
+        {
+            const size_t dst = static_cast<size_t>(chn) * scans;
+            switch (mode)
+            {
+            case BENCH_INT32:
+                kernels.left_i32(&words[chn], channels, scans, &out_i32[dst]);
+                break;
+            case BENCH_FLOAT:
+                kernels.left_f32(&words[chn], channels, scans, &out_f32[dst]);
+                break;
+            case BENCH_SCALED_F64:
+                kernels.left_scaled_f64(&words[chn], channels, scans, SCALE_GAIN, SCALE_OFFSET, &out_f64[dst]);
+                break;
+            }
+        }
+    }
+    auto stop = std::chrono::steady_clock::now();
+
+    double seconds = std::chrono::duration<double>(stop - start).count();
+    return seconds > 0 ? (static_cast<double>(scans) * iterations) / seconds : 0.0;
+}
+
+
+int main(int argc, char* argv[])
+{
+    uint32 channels = argc > 1 ? static_cast<uint32>(std::atoi(argv[1])) : 8;
+    uint32 scans = argc > 2 ? static_cast<uint32>(std::atoi(argv[2])) : 100000;
+    int iterations = argc > 3 ? std::atoi(argv[3]) : 50;
+
+    if (channels == 0 || scans == 0 || iterations <= 0)
+    {
+        std::cerr << "Usage: " << argv[0] << " [channels] [scans] [iterations]" << std::endl;
+        return 2;
+    }
+
+    std::cout << "Detected: " << trion::simdLevelName(trion::detectSimdLevel())
+              << ", selected: " << trion::simdLevelName(trion::sampleKernels().level) << std::endl;
+    std::cout << channels << " channels, " << scans << " scans, " << iterations << " iterations" << std::endl;
+
+    int errors = 0;
+    for (int level = trion::SIMD_LEVEL_SCALAR; level <= trion::SIMD_LEVEL_AVX512; ++level)
+    {
+        const trion::SampleKernels* kernels = trion::sampleKernels(static_cast<trion::SimdLevel>(level));
+        if (!kernels)
+        {
+            std::cout << std::setw(8) << trion::simdLevelName(static_cast<trion::SimdLevel>(level))
+                      << ": not available" << std::endl;
+            continue;
+        }
+
+        int level_errors = checkKernels(*kernels) + checkGroupKernels(*kernels);
+        errors += level_errors;
+
+        double i32_rate = benchKernels(*kernels, BENCH_INT32, channels, scans, iterations);
+        double f32_rate = benchKernels(*kernels, BENCH_FLOAT, channels, scans, iterations);
+        double f64_rate = benchKernels(*kernels, BENCH_SCALED_F64, channels, scans, iterations);
+        double single_rate = benchKernels(*kernels, BENCH_INT32, channels, scans, iterations, true);
+
+        std::cout << std::setw(8) << trion::simdLevelName(kernels->level)
+                  << ": check " << (level_errors ? "FAILED" : "ok")
+                  << std::fixed << std::setprecision(1)
+                  << ", int32 " << std::setw(8) << i32_rate / 1e6 << " Mscans/s"
+                  << ", float " << std::setw(8) << f32_rate / 1e6 << " Mscans/s"
+                  << ", scaled double " << std::setw(8) << f64_rate / 1e6 << " Mscans/s"
+                  << ", int32 per channel " << std::setw(8) << single_rate / 1e6 << " Mscans/s" << std::endl;
+    }
+
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,342 @@
+/**
+ * TRION-SDK end to end throughput benchmark with the simulated driver.
+ *
+ * Loads the simulated driver library (dwpxi_api_sim) through
+ * DeWePxiLoadByName and runs the AcquisitionEngine, the ScanDecoder
+ * (decode and scale to float) and the GapDetector on every board.
+ * Reports the decoded scans and samples per second, the gaps found in
+ * BoardCnt0 and the overruns of the engine.
+ *
+ * In realtime mode the driver produces the scans at the sample rate,
+ * the benchmark shows if the consumers keep up. With --free-running
+ * the driver fills the buffer as fast as it is freed, the result is
+ * the maximum throughput of the consumer chain.
+ *
+ * Usage: SimThroughputBench [options]
+ *   --driver PATH         simulated driver library (default: the built dwpxi_api_sim)
+ *   --boards N            boards (default 1, environment DEWEPXI_SIM_BOARDS)
+ *   --ai N                analog channels per board (default 8, environment DEWEPXI_SIM_AI)
+ *   --rate N              scans/s per board (default 100000)
+ *   --seconds N           duration (default 3)
+ *   --free-running        produce scans as fast as they are consumed
+ *   --overrun-period N    inject an overrun every N scans
+ *
+ * This code is licensed under MIT license (see LICENSE.txt for details)
+ * Copyright (c) 2024 by DEWETRON GmbH
+ */
+
+
+#include "dewepxi_load.h"
+#include "dewepxi_apicore.h"
+#include "dewepxi_acq_engine.h"
+#include "dewepxi_gap_detector.h"
+#include "dewepxi_scan_decoder.h"
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+namespace
+{
+    struct Options
+    {
+        std::string driver;
+        uint32 boards;
+        uint32 ai;
+        uint32 rate;
+        double seconds;
+        bool free_running;
+        uint32 overrun_period;
+    };
+
+    /**
+     * Consumer of one board: decode, scale and check the gaps.
+     */
+    struct BoardConsumer
+    {
+        uint32 consumer;
+        std::unique_ptr<trion::ScanDecoder> decoder;
+        trion::ScaledBlockF32 block;
+        trion::GapDetector gaps;
+        uint64 scans;
+        uint64 blocks;
+        uint64 data_lost;
+        double checksum;
+        std::thread thread;
+    };
+
+    std::string boardTarget(uint32 board_id)
+    {
+        std::ostringstream target;
+        target << "BoardID" << board_id;
+        return target.str();
+    }
+
+    int configureBoard(uint32 board_id, const Options& options)
+    {
+        const std::string board = boardTarget(board_id);
+        std::ostringstream rate;
+        rate << options.rate;
+        std::ostringstream period;
+        period << options.overrun_period;
+
+        DeWeSetParam_i32(board_id, CMD_OPEN_BOARD, 0);
+        DeWeSetParam_i32(board_id, CMD_RESET_BOARD, 0);
+        DeWeSetParamStruct_str((board + "/AIAll").c_str(), "Used", "True");
+        DeWeSetParamStruct_str((board + "/BoardCnt0").c_str(), "Used", "True");
+        DeWeSetParamStruct_str((board + "/BoardCnt0").c_str(), "Source_A", "ACQ_CLK");
+        DeWeSetParamStruct_str((board + "/AcqProp").c_str(), "SampleRate", rate.str().c_str());
+        DeWeSetParamStruct_str((board + "/Sim").c_str(), "Realtime", options.free_running ? "False" : "True");
+        DeWeSetParamStruct_str((board + "/Sim").c_str(), "OverrunPeriod", period.str().c_str());
+
+        // 10 ms blocks, 2 s of buffer
+        const uint32 block_size = options.rate / 100 ? options.rate / 100 : 1;
+        DeWeSetParam_i32(board_id, CMD_BUFFER_0_BLOCK_SIZE, block_size);
+        DeWeSetParam_i32(board_id, CMD_BUFFER_0_BLOCK_COUNT, 200);
+        return DeWeSetParam_i32(board_id, CMD_UPDATE_PARAM_ALL, 0);
+    }
+
+    void consume(trion::AcquisitionEngine& engine, BoardConsumer& board)
+    {
+        trion::BlockDescriptor desc;
+        trion::GapRecord gap;
+        for (;;)
+        {
+            if (!engine.waitPop(board.consumer, desc, 100))
+            {
+                if (!engine.isRunning())
+                {
+                    break;
+                }
+                continue;
+            }
+            if (desc.error > 0 || (desc.flags & trion::BLOCK_FLAG_CONSUMER_DROPPED))
+            {
+                break;
+            }
+            if (desc.flags & trion::BLOCK_FLAG_DATA_LOST)
+            {
+                ++board.data_lost;
+            }
+            board.gaps.process(desc, gap);
+            if (desc.scans)
+            {
+                board.decoder->decode(desc.spans, board.block);
+                // Touch the result, so the decode cannot be optimized away
+                board.checksum += board.block.channel(0)[board.block.scans() - 1];
+                board.scans += desc.scans;
+                ++board.blocks;
+            }
+            engine.release(desc);
+        }
+    }
+
+    int run(const Options& options)
+    {
+        if (!DeWePxiLoadByName(options.driver.c_str()))
+        {
+            std::cerr << options.driver << " could not be loaded" << std::endl;
+            return 1;
+        }
+
+        int boards = 0;
+        DeWeDriverInit(&boards);
+        if (boards >= 0)
+        {
+            std::cerr << options.driver << " is not the simulated driver" << std::endl;
+            DeWePxiUnload();
+            return 1;
+        }
+        boards = -boards;
+        if (boards <= static_cast<int>(options.boards))
+        {
+            std::cerr << "The driver simulates " << boards - 1 << " boards, set DEWEPXI_SIM_BOARDS" << std::endl;
+            DeWeDriverDeInit();
+            DeWePxiUnload();
+            return 1;
+        }
+
+        DeWeSetParam_i32(0, CMD_OPEN_BOARD, 0);
+        DeWeSetParam_i32(0, CMD_RESET_BOARD, 0);
+
+        trion::AcquisitionEngine engine;
+        engine.setOverrunRecovery(true);
+        std::vector<std::unique_ptr<BoardConsumer>> consumers;
+        uint32 channels = 0;
+        for (uint32 board_id = 1; board_id <= options.boards; ++board_id)
+        {
+            int nErrorCode = configureBoard(board_id, options);
+            if (nErrorCode > 0)
+            {
+                std::cerr << boardTarget(board_id) << " configuration failed: "
+                          << DeWeErrorConstantToString(nErrorCode) << std::endl;
+                return 1;
+            }
+
+            char scan_descriptor[32768] = { 0 };
+            DeWeGetParamStruct_str(boardTarget(board_id).c_str(), "ScanDescriptor_V3", scan_descriptor, sizeof(scan_descriptor));
+            trion::ScanDescriptor sd(scan_descriptor);
+
+            std::unique_ptr<BoardConsumer> board(new BoardConsumer());
+            board->decoder.reset(new trion::ScanDecoder(sd));
+            board->decoder->readScaling();
+            if (board->gaps.init(sd) > 0)
+            {
+                std::cerr << boardTarget(board_id) << ": BoardCnt0 is not in the scan descriptor" << std::endl;
+                return 1;
+            }
+            board->scans = 0;
+            board->blocks = 0;
+            board->data_lost = 0;
+            board->checksum = 0;
+
+            engine.addBoard(board_id);
+            board->consumer = engine.addConsumer(board_id - 1);
+            board->block.resize(board->decoder->numChannels(), engine.ring(board_id - 1).capacity());
+            channels += board->decoder->numChannels();
+            consumers.push_back(std::move(board));
+        }
+
+        for (uint32 board_id = 1; board_id <= options.boards; ++board_id)
+        {
+            DeWeSetParam_i32(board_id, CMD_START_ACQUISITION, 0);
+        }
+        const auto start = std::chrono::steady_clock::now();
+        engine.start();
+        for (auto& board : consumers)
+        {
+            BoardConsumer* consumer = board.get();
+            board->thread = std::thread([&engine, consumer]() { consume(engine, *consumer); });
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(static_cast<long long>(options.seconds * 1000)));
+        engine.stop();
+        for (auto& board : consumers)
+        {
+            board->thread.join();
+        }
+        const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        for (uint32 board_id = 1; board_id <= options.boards; ++board_id)
+        {
+            DeWeSetParam_i32(board_id, CMD_STOP_ACQUISITION, 0);
+        }
+
+        uint64 scans = 0;
+        uint64 samples = 0;
+        uint64 bytes = 0;
+        std::cout << std::fixed << std::setprecision(1);
+        std::cout << "Board  scans/s      blocks  data lost  gaps  lost scans  resyncs" << std::endl;
+        for (uint32 i = 0; i < consumers.size(); ++i)
+        {
+            const BoardConsumer& board = *consumers[i];
+            scans += board.scans;
+            samples += board.scans * board.decoder->numChannels();
+            bytes += board.scans * board.decoder->scanSize();
+            std::cout << std::setw(5) << i + 1
+                      << std::setw(10) << board.scans / elapsed
+                      << std::setw(12) << board.blocks
+                      << std::setw(11) << board.data_lost
+                      << std::setw(6) << board.gaps.gaps()
+                      << std::setw(12) << board.gaps.lostSamples()
+                      << std::setw(9) << board.gaps.resyncs()
+                      << std::endl;
+        }
+        std::cout << "Total: " << options.boards << " boards, " << channels << " channels, "
+                  << elapsed << " s" << std::endl;
+        std::cout << "  " << scans / elapsed / 1e6 << " Mscans/s, "
+                  << samples / elapsed / 1e6 << " Msamples/s, "
+                  << bytes / elapsed / 1e6 << " MB/s raw" << std::endl;
+
+        for (uint32 board_id = 0; board_id <= options.boards; ++board_id)
+        {
+            DeWeSetParam_i32(board_id, CMD_CLOSE_BOARD, 0);
+        }
+        DeWeDriverDeInit();
+        DeWePxiUnload();
+        return 0;
+    }
+
+    void setEnv(const char* name, uint32 value)
+    {
+        std::ostringstream text;
+        text << value;
+#ifdef WIN32
+        _putenv_s(name, text.str().c_str());
+#else
+        setenv(name, text.str().c_str(), 1);
+#endif
+    }
+}
+
+
+int main(int argc, char* argv[])
+{
+    Options options;
+#ifdef DWPXI_API_SIM_PATH
+    options.driver = DWPXI_API_SIM_PATH;
+#endif
+    options.boards = 1;
+    options.ai = 8;
+    options.rate = 100000;
+    options.seconds = 3.0;
+    options.free_running = false;
+    options.overrun_period = 0;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (arg == "--free-running")
+        {
+            options.free_running = true;
+        }
+        else if (value && arg == "--driver")
+        {
+            options.driver = argv[++i];
+        }
+        else if (value && arg == "--boards")
+        {
+            options.boards = static_cast<uint32>(std::atoi(argv[++i]));
+        }
+        else if (value && arg == "--ai")
+        {
+            options.ai = static_cast<uint32>(std::atoi(argv[++i]));
+        }
+        else if (value && arg == "--rate")
+        {
+            options.rate = static_cast<uint32>(std::atoi(argv[++i]));
+        }
+        else if (value && arg == "--seconds")
+        {
+            options.seconds = std::atof(argv[++i]);
+        }
+        else if (value && arg == "--overrun-period")
+        {
+            options.overrun_period = static_cast<uint32>(std::atoi(argv[++i]));
+        }
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [--driver PATH] [--boards N] [--ai N] [--rate N] [--seconds N]"
+                      << " [--free-running] [--overrun-period N]" << std::endl;
+            return 1;
+        }
+    }
+
+    if (options.driver.empty() || options.boards == 0 || options.ai == 0 || options.rate == 0)
+    {
+        std::cerr << "Invalid driver, board count, channel count or rate" << std::endl;
+        return 1;
+    }
+
+    // The simulated driver reads its board setup at DeWeDriverInit
+    setEnv("DEWEPXI_SIM_BOARDS", options.boards);
+    setEnv("DEWEPXI_SIM_AI", options.ai);
+    return run(options);
+}
@@ -0,0 +1,149 @@
+/**
+ * TRION-SDK example recovering from buffer overruns.
+ *
+ * C++ counterpart of error/DataLostHandling: the AcquisitionEngine
+ * acknowledges ERR_BUFFER_OVERWRITE (CMD_BUFFER_0_CLEAR_ERROR) and keeps
+ * acquiring, the GapDetector computes the exact lost range from BoardCnt0.
+ * The lost samples are filled with NaN, so the decoded stream keeps one
+ * value per sample clock edge.
+ *
+ * Every 10th block the processing sleeps long enough to overrun the buffer.
+ *
+ * THIS EXAMPLE CAN NOT BE RUN IN SIMULATION MODE
+ *
+ * This code is licensed under MIT license (see LICENSE.txt for details)
+ * Copyright (c) 2024 by DEWETRON GmbH
+ */
+
+
+#include "dewepxi_load.h"
+#include "dewepxi_apicore.h"
+#include "dewepxi_apiutil.h"
+#include "dewepxi_acq_engine.h"
+#include "dewepxi_gap_detector.h"
+#include "dewepxi_scan_decoder.h"
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+
+int main(int argc, char* argv[])
+{
+    int boards = 0;
+    const int num_blocks = 100;
+    const double sample_rate = 10000.0;
+    char scan_descriptor[8192] = { 0 };
+
+    // Basic SDK Initialization
+    DeWePxiLoad();
+    DeWeDriverInit(&boards);
+
+    DeWeSetParam_i32(1, CMD_OPEN_BOARD, 0);
+    DeWeSetParam_i32(1, CMD_RESET_BOARD, 0);
+
+    DeWeSetParamStruct_str("BoardID1/AIAll", "Used", "True");
+    DeWeSetParamStruct_str("BoardID1/AcqProp", "OperationMode", "Slave");
+    DeWeSetParamStruct_str("BoardID1/AcqProp", "ExtTrigger", "False");
+    DeWeSetParamStruct_str("BoardID1/AcqProp", "ExtClk", "False");
+    DeWeSetParamStruct_str("BoardID1/AcqProp", "SampleRate", "10000");
+
+    // BoardCnt0 counts the sample clock, reset on start
+    DeWeSetParamStruct_str("BoardID1/BoardCnt0", "Used", "True");
+    DeWeSetParamStruct_str("BoardID1/BoardCnt0", "Source_A", "ACQ_CLK");
+    DeWeSetParamStruct_str("BoardID1/BoardCnt0", "Reset", "OnRestart");
+
+    // 100 ms blocks, 5 s buffer
+    DeWeSetParam_i32(1, CMD_BUFFER_0_BLOCK_SIZE, 1000);
+    DeWeSetParam_i32(1, CMD_BUFFER_0_BLOCK_COUNT, 50);
+    DeWeSetParam_i32(1, CMD_UPDATE_PARAM_ALL, 0);
+
+    DeWeGetParamStruct_str("BoardId1", "ScanDescriptor_V3", scan_descriptor, sizeof(scan_descriptor));
+    trion::ScanDescriptor sd(scan_descriptor);
+    trion::ScanDecoder decoder(sd);
+
+    trion::GapDetector gaps;
+    if (gaps.init(1, sd) > 0)
+    {
+        std::cout << "BoardCnt0 not found in the scan descriptor" << std::endl;
+        return 1;
+    }
+
+    trion::AcquisitionEngine engine;
+    engine.addBoard(1);
+    engine.setOverrunRecovery(true);
+
+    trion::ScaledBlockF32 block(decoder.numChannels(), engine.ring(0).capacity());
+    trion::GapFiller<float> filler(trion::GAP_FILL_NAN);
+
+    DeWeSetParam_i32(1, CMD_START_ACQUISITION, 0);
+    engine.start();
+
+    for (int n = 0; n < num_blocks; )
+    {
+        trion::BlockDescriptor desc;
+        if (!engine.waitPop(0, desc, 1000))
+        {
+            if (!engine.isRunning() || engine.lastError(0) > 0)
+            {
+                break;
+            }
+            continue;
+        }
+
+        if (desc.error > 0)
+        {
+            std::cout << "Reader error: " << desc.error << std::endl;
+            break;
+        }
+
+        if (desc.flags & trion::BLOCK_FLAG_DATA_LOST)
+        {
+            std::cout << "Buffer overrun acknowledged" << std::endl;
+        }
+
+        trion::GapRecord gap;
+        if (gaps.process(desc, gap))
+        {
+            std::cout << "Lost " << gap.samples << " samples from sample " << gap.first_sample
+                      << " (analog " << gap.first_analog_sample << ", " << gap.samples / sample_rate << " s)"
+                      << ", recovered after " << gap.recovery_ns / 1000000.0 << " ms" << std::endl;
+
+            // Hand the gap downstream as NaN, in chunks of the block capacity
+            for (uint64 filled = 0; filled < gap.samples; )
+            {
+                filled += filler.fill(block, 0, gap.samples - filled);
+                // process(block)
+            }
+        }
+
+        if (desc.scans > 0)
+        {
+            decoder.decode(desc.spans, block);
+            filler.observe(block);
+            ++n;
+        }
+        engine.release(desc);
+
+        // Enforce a data lost
+        if (n > 0 && n % 10 == 0 && desc.scans > 0)
+        {
+            std::cout << "Enforcing data lost for 8 s" << std::endl;
+            std::this_thread::sleep_for(std::chrono::seconds(8));
+        }
+    }
+
+    engine.stop();
+    DeWeSetParam_i32(1, CMD_STOP_ACQUISITION, 0);
+
+    auto recovery = engine.recoveryHistogram(0).summary();
+    std::cout << "Gaps: " << gaps.gaps() << ", lost samples: " << gaps.lostSamples() << std::endl;
+    std::cout << "Recovery: " << recovery.count << " overruns"
+              << ", p50 " << recovery.p50_ns / 1000000.0 << " ms"
+              << ", max " << recovery.max_ns / 1000000.0 << " ms" << std::endl;
+
+    DeWeSetParam_i32(1, CMD_CLOSE_BOARD, 0);
+    DeWeDriverDeInit();
+    DeWePxiUnload();
+
+    return 0;
+}
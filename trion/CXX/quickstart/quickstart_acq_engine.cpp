@@ -0,0 +1,191 @@
+/**
+ * TRION-SDK Quickstart example with a blocking reader thread.
+ *
+ * The AcquisitionEngine waits on CMD_BUFFER_0_WAIT_AVAIL_NO_SAMPLE in a
+ * dedicated thread and hands new blocks to the main thread, instead of
+ * polling with Sleep(). A second consumer (eg a display) reads the same
+ * scans in an own thread, the scans are freed when both released them.
+ * The buffer block size follows a latency target (BufferController),
+ * the processing time is observed to retune it for the next run.
+ * The reader latency and consumer lag are printed at the end.
+ *
+ * This code is licensed under MIT license (see LICENSE.txt for details)
+ * Copyright (c) 2024 by DEWETRON GmbH
+ */
+
+
+#include "dewepxi_load.h"
+#include "dewepxi_apicore.h"
+#include "dewepxi_apiutil.h"
+#include "dewepxi_acq_engine.h"
+#include "dewepxi_buffer_controller.h"
+#include "dewepxi_latency_histogram.h"
+#include "dewepxi_scan_decoder.h"
+#include <atomic>
+#include <iostream>
+#include <thread>
+
+
+static void printLatency(const char* name, const trion::LatencyHistogram& hist)
+{
+    auto s = hist.summary();
+    std::cout << name << ": " << s.count << " samples"
+              << ", p50 " << s.p50_ns / 1000.0 << " us"
+              << ", p99 " << s.p99_ns / 1000.0 << " us"
+              << ", p99.9 " << s.p999_ns / 1000.0 << " us"
+              << ", max " << s.max_ns / 1000.0 << " us" << std::endl;
+}
+
+
+int main(int argc, char* argv[])
+{
+    int boards = 0;
+    const int num_blocks = 500;     // Blocks to process before stopping
+    char scan_descriptor[8192] = { 0 };
+
+    // Basic SDK Initialization
+    DeWePxiLoad();
+
+    // boards is negative for simulation
+    DeWeDriverInit(&boards);
+
+    // Open boards
+    // 0: chassis controller
+    // 1: TRION3-1850-MULTI
+    DeWeSetParam_i32(0, CMD_OPEN_BOARD, 0);
+    DeWeSetParam_i32(0, CMD_RESET_BOARD, 0);
+    DeWeSetParam_i32(1, CMD_OPEN_BOARD, 0);
+    DeWeSetParam_i32(1, CMD_RESET_BOARD, 0);
+
+    // Enable all analog channels
+    DeWeSetParamStruct_str("BoardID1/AIAll", "Used", "True");
+
+    // Configure acquisition properties
+    DeWeSetParamStruct_str("BoardID1/AcqProp", "SampleRate", "10000");
+
+    // Apply settings
+    DeWeSetParam_i32(1, CMD_UPDATE_PARAM_ALL, 0);
+
+    // Buffer for a wake-up every 10 ms
+    trion::BufferController buffer_ctrl(1);
+    buffer_ctrl.setLatencyTarget(10.0);
+    buffer_ctrl.setLog([](const std::string& line) { std::cout << line << std::endl; });
+    buffer_ctrl.configure();
+
+    // Get scan descriptor
+    DeWeGetParamStruct_str("BoardId1", "ScanDescriptor_V3", scan_descriptor, sizeof(scan_descriptor));
+    trion::ScanDecoder sd_decoder(scan_descriptor);
+
+    // One reader thread for board 1, two consumers
+    trion::AcquisitionEngine engine;
+    engine.addBoard(1);
+    uint32 processor = engine.addConsumer(0);
+    uint32 display = engine.addConsumer(0);
+
+    // Drop the display instead of overrunning the buffer
+    engine.setDropSlowest(true);
+
+    trion::DecodedBlock block(sd_decoder.numChannels(), engine.ring(0).capacity());
+
+    // Start acquisition, then the reader
+    DeWeSetParam_i32(1, CMD_START_ACQUISITION, 0);
+    engine.start();
+
+    std::atomic<bool> done(false);
+    std::thread display_thread([&]()
+    {
+        trion::BlockDescriptor desc;
+        while (!done)
+        {
+            if (engine.waitPop(display, desc, 100))
+            {
+                if (desc.error > 0 || (desc.flags & trion::BLOCK_FLAG_CONSUMER_DROPPED))
+                {
+                    break;
+                }
+                // Show the latest scan only
+                engine.release(desc);
+            }
+        }
+    });
+
+    trion::LatencyHistogram decode_hist;
+    for (int n = 0; n < num_blocks; )
+    {
+        trion::BlockDescriptor desc;
+        if (!engine.waitPop(processor, desc, 1000))
+        {
+            if (!engine.isRunning() || engine.lastError(0) > 0)
+            {
+                break;
+            }
+            continue;
+        }
+
+        if (desc.error > 0)
+        {
+            std::cout << "Reader error: " << desc.error << std::endl;
+            break;
+        }
+
+        // Process the block: samples are still in the circular buffer
+        uint64 process_start = trion::steadyClockNs();
+        sd_decoder.decode(desc.spans, block);
+        decode_hist.record(trion::steadyClockNs() - process_start);
+        std::cout << "Scan " << desc.first_scan << " +" << desc.scans;
+        if (block.numChannels() > 0)
+        {
+            std::cout << "  " << sd_decoder.channel(0).name << ": " << block.channel(0)[0];
+        }
+        std::cout << std::endl;
+
+        // Free the scans
+        engine.release(desc);
+        buffer_ctrl.observeService(desc.scans, trion::steadyClockNs() - process_start);
+        buffer_ctrl.observeFill(static_cast<uint32>(engine.consumerStats(processor).lag_scans));
+        ++n;
+    }
+
+    done = true;
+    display_thread.join();
+    engine.stop();
+
+    // Stop acquisition
+    DeWeSetParam_i32(1, CMD_STOP_ACQUISITION, 0);
+
+    auto stats = engine.latency(0);
+    std::cout << "Wake-up to publish latency: " << stats.count << " blocks"
+              << ", min " << stats.min_ns / 1000.0 << " us"
+              << ", mean " << stats.meanNs() / 1000.0 << " us"
+              << ", max " << stats.max_ns / 1000.0 << " us" << std::endl;
+    printLatency("Reader loop", engine.loopHistogram(0));
+    printLatency("Driver free", engine.driverHistogram(0));
+    printLatency("Decode", decode_hist);
+
+    trion::BufferTelemetry health;
+    engine.telemetry(0, health);
+    std::cout << "Buffer high-water mark: " << health.high_water_scans << " of " << health.capacity_scans << " scans"
+              << ", " << health.scans_per_second << " scans/s"
+              << ", overruns " << health.overruns << std::endl;
+    for (uint32 c = 0; c < engine.numConsumers(); ++c)
+    {
+        auto consumer = engine.consumerStats(c);
+        std::cout << "Consumer " << c << ": max lag " << consumer.max_lag_scans << " scans"
+                  << ", queue full " << consumer.queue_full
+                  << (consumer.dropped ? ", dropped" : "") << std::endl;
+    }
+
+    // Buffer setup for the next run
+    if (buffer_ctrl.retune())
+    {
+        buffer_ctrl.apply();
+    }
+
+    // Free boards and unload SDK
+    DeWeSetParam_i32(0, CMD_CLOSE_BOARD, 0);
+    DeWeSetParam_i32(1, CMD_CLOSE_BOARD, 0);
+    DeWeDriverDeInit();
+    DeWePxiUnload();
+
+    return 0;
+}
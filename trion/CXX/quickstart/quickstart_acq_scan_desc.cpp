@@ -9,229 +9,51 @@
 #include "dewepxi_load.h"
 #include "dewepxi_apicore.h"
 #include "dewepxi_apiutil.h"
-#include "pugixml.hpp"
-#include <functional>
+#include "dewepxi_release_manager.h"
+#include "dewepxi_ringbuffer.h"
+#include "dewepxi_scan_decoder.h"
 #include <iomanip>
 #include <iostream>
 #include <string>
 #include <vector>
 
 
-/**
- * Functor to be implemented by applications interested in sample data.
- */
-using AddSampleFunctor = std::function<void(const char*, uint32_t,
-    const void*, uint32_t, uint32_t, uint32_t, uint32_t)>;
-
-
-/**
- * ScanDescripterDecode
- * Uses ScanDescriptor_V3 xml allowing generic
- * sample decoding and processing.
- */
-class ScanDescriptorDecoder
-{
-public:
-    ScanDescriptorDecoder(const std::string& sd_xml, AddSampleFunctor f)
-        : m_datasink(f)
-    {
-        parseScanDescriptor(sd_xml);
-    }
-
-    /**
-     * parseScanDescriptor - parses V3 xml and build internal processing vector
-     */
-    void parseScanDescriptor(const std::string& sd_xml)
-    {
-        pugi::xml_document sd_doc;
-        if (pugi::status_ok == sd_doc.load_string(sd_xml.c_str()).status)
-        {
-            auto scan_description_node =
-                sd_doc.select_node("ScanDescriptor/*/ScanDescription").node();
-            if (scan_description_node)
-            {
-                if (3 != scan_description_node.attribute("version").as_int())
-                {
-                    throw std::runtime_error("Unsupported version");
-                }
-
-                m_scan_size_bytes
-                    = scan_description_node.attribute("scan_size").as_int() / 8;
-                // Can be safely ignored:
-                // bit
-                // byte_order
-                // buffer_direction
-                // buffer
-
-                auto channel_nodes = scan_description_node.select_nodes("Channel");
-                for (auto channelx : channel_nodes)
-                {
-                    auto channel = channelx.node();
-
-                    auto sample = channel.child("Sample");
-
-                    m_scan_desc_vec.push_back(
-                        SDData{ std::string(channel.attribute("name").as_string())
-                                , std::string(channel.attribute("type").as_string())
-                                , channel.attribute("index").as_uint()
-                                , sample.attribute("size").as_uint()
-                                , sample.attribute("offset").as_uint()
-                        });
-                }
-            }
-            else
-            {
-                throw std::runtime_error("ScanDescriptor unexpected element");
-            }
-        }
-        else
-        {
-            throw std::runtime_error("ScanDescriptor parse error");
-        }
-    }
-
-    /**
-     * Process sample blocks
-     * @param avail_samples a continuous block of samples
-     * @return incremented read_pos
-     */
-    sint64 processSamples(sint64 read_pos, int avail_samples)
-    {
-        auto read_pos_ptr = reinterpret_cast<const char*>(read_pos);
-
-        for (const auto& sd : m_scan_desc_vec)
-        {
-            uint32_t offset_bytes = sd.sample_offset / 8;
-            auto read_pos_ptr_chn = read_pos_ptr + offset_bytes;
-            uint32_t channel_bit_mask = (1 << sd.sample_size) - 1;
-            uint32_t channel_bit_msb = sd.sample_size;
-
-            m_datasink(sd.name.c_str(), sd.index, read_pos_ptr_chn, avail_samples,
-                channel_bit_mask, channel_bit_msb, m_scan_size_bytes);
-        }
-
-        return read_pos + (avail_samples * m_scan_size_bytes);
-    }
-
-private:
-    AddSampleFunctor m_datasink;
-    uint32_t m_scan_size_bytes;
-
-    struct SDData
-    {
-        std::string name;
-        std::string channel_type;
-        uint32_t index;
-        uint32_t sample_size;
-        uint32_t sample_offset;
-    };
-    std::vector<SDData> m_scan_desc_vec;
-};
-
-
-/**
- * Data Sink - App interface
- * @param channel is the name of the channel
- * @param first_sample pointer to the first sample
- * @param nr_samples number of samples available
- * @param bitmask bit mask to apply to get the valid sample value
- * @param stride is the offset to the next sample
- */
-void addSample(const char* channel_name,
-            uint32_t channel_index,
-            const void* first_sample,
-            uint32_t nr_samples,
-            uint32_t channel_bitmask,
-            uint32_t channel_bit_msb,
-            uint32_t stride)
-{
-    const char* data_ptr = static_cast<const char*>(first_sample);
-
-    for (uint32_t i = 0; i < nr_samples; ++i)
-    {
-        uint32_t value = (*reinterpret_cast<const uint32_t*>(data_ptr)) & channel_bitmask;
-        std::cout << channel_name << ": " << std::hex << value  << std::endl;
-        data_ptr += stride;
-    }
-}
-
 /**
  * Print samples in channel per column
- * Uses Functor interface like "addSample"
+ * The decoder delivers all samples of a channel contiguously
+ * (structure of arrays), already masked and sign extended.
  */
 class FormattedOutput
 {
 public:
-    FormattedOutput(int num_channels, int block_size)
-        : m_num_channels(num_channels)
-        , m_block_size(block_size)
+    explicit FormattedOutput(const trion::ScanDecoder& decoder)
+        : m_decoder(decoder)
     {
-        m_output_buffer.resize(m_num_channels);
     }
 
-    void operator()(const char* channel_name,
-        uint32_t channel_index,
-        const void* first_sample,
-        uint32_t nr_samples,
-        uint32_t channel_bitmask,
-        uint32_t channel_bit_msb,
-        uint32_t stride)
+    void operator()(const trion::DecodedBlock& block)
     {
-        const char* data_ptr = static_cast<const char*>(first_sample);
-
-        m_output_buffer[channel_index].chn_name = channel_name;
-
-        // copy samples in separate buffer per channel
-        for (uint32_t i = 0; i < nr_samples; ++i)
+        // Channel names
+        for (uint32_t chn = 0; chn < block.numChannels(); ++chn)
         {
-            // The bitmask has to be applied to cut out the correct value.
-            // The MSB has to be checked to sign extend negative values
-            int32_t value = (*reinterpret_cast<const int32_t*>(data_ptr)) & channel_bitmask;
-            if ((value & (1 << (channel_bit_msb - 1))) != 0)
-            {
-                value |= ~channel_bitmask;
-            }
-
-            m_output_buffer[channel_index].chn_sample_buffer.push_back(value);
-            data_ptr += stride;
+            std::cout << std::setw(10) << m_decoder.channel(chn).name << ", ";
         }
+        std::cout << std::endl;
 
-        // print channels in separate columns
-        if (channel_index + 1 >= m_num_channels)
+        for (uint32_t i = 0; i < block.scans(); ++i)
         {
-            // Channel names
-            for (uint32_t chn = 0; chn < m_num_channels; ++chn)
-            {
-                std::cout << std::setw(10) << m_output_buffer[chn].chn_name << ", ";
-            }
-            std::cout << std::endl;
-
-
-            for (uint32_t i = 0; i < nr_samples; ++i)
+            for (uint32_t chn = 0; chn < block.numChannels(); ++chn)
             {
-                for (uint32_t chn = 0; chn < m_num_channels; ++chn)
-                {
-                    auto value = m_output_buffer[chn].chn_sample_buffer[i];
-                    std::cout << std::setw(10) << std::hex << value << ", ";
-                }
-
-                std::cout << std::endl;
+                auto value = block.channel(chn)[i];
+                std::cout << std::setw(10) << std::hex << value << ", ";
             }
 
-            m_output_buffer.clear();
-            m_output_buffer.resize(m_num_channels);
+            std::cout << std::endl;
         }
     }
 
-    struct ChannelSamples
-    {
-        std::string chn_name;
-        std::vector<int32_t> chn_sample_buffer;
-    };
-
-    std::vector<ChannelSamples> m_output_buffer;
-    uint32_t m_num_channels;
-    int m_block_size;
+private:
+    const trion::ScanDecoder& m_decoder;
 };
 
 
@@ -239,14 +61,9 @@ public:
 int main(int argc, char* argv[])
 {
     int boards = 0;
-    int avail_samples = 0;
     const int32_t buffer_block_size = 10;
-    int64_t buf_end_pos = 0;        // Last position in the circular buffer
-    int buff_size = 0;              // Total size of the circular buffer
     char scan_descriptor[8192] = { 0 };
 
-    FormattedOutput output(4, buffer_block_size);
-
     // Basic SDK Initialization
     DeWePxiLoad();
 
@@ -273,59 +90,54 @@ int main(int argc, char* argv[])
     DeWeSetParam_i32(1, CMD_UPDATE_PARAM_ALL, 0);
 
     // Get buffer configuration
-    DeWeGetParam_i64(1, CMD_BUFFER_0_END_POINTER, &buf_end_pos);
-    DeWeGetParam_i32(1, CMD_BUFFER_0_TOTAL_MEM_SIZE, &buff_size);
+    trion::RingBufferView ring(1);
+    ring.init();
 
     // Get scan descriptor
     DeWeGetParamStruct_str("BoardId1", "ScanDescriptor_V3", scan_descriptor, sizeof(scan_descriptor));
 
-#if 1
+    // Compile the scan descriptor into a decode plan once
+    trion::ScanDecoder sd_decoder(scan_descriptor);
+    trion::DecodedBlock block(sd_decoder.numChannels(), ring.capacity());
+
     // Connect to formatted output
-    ScanDescriptorDecoder sd_decoder(scan_descriptor, output);
+    FormattedOutput output(sd_decoder);
 
-#else
-    // or addSample function
-    //ScanDescriptorDecoder sd_decoder(scan_descriptor, &addSample);
-#endif
+    // Free the scans in chunks of 5 blocks, immediately if less than
+    // a quarter of the buffer is free
+    trion::ReleaseManager releaser(ring);
+    releaser.setChunk(5 * buffer_block_size);
+    releaser.setWatermark(ring.totalSize() / 4);
 
     // Start acquisition
     DeWeSetParam_i32(1, CMD_START_ACQUISITION, 0);
+    releaser.start();
 
     // Measurement loop and sample processing
-    int64_t read_pos = 0;
-    int64_t* read_pos_ptr = 0;
-    int sample_value = 0;
+    trion::ScanSpans spans;
+    int iterations = 0;
 
     // Break with CTRL+C only
     while (1)
     {
-        // Get the number of samples available
-        DeWeGetParam_i32(1, CMD_BUFFER_0_AVAIL_NO_SAMPLE, &avail_samples);
-        if (avail_samples <= 0)
+        // Get the available samples as (at most two) contiguous spans
+        releaser.acquire(spans);
+        if (spans.count == 0)
         {
             Sleep(100);
             continue;
         }
 
-        // Get the current read pointer
-        DeWeGetParam_i64(1, CMD_BUFFER_0_ACT_SAMPLE_POS, &read_pos);
+        // Deinterleave all channels in one pass
+        sd_decoder.decode(spans, block);
+        output(block);
 
-        // Process samples in CMD_0_BUFFER_BLOCK_SIZE
-        // to handle circular buffer wrap arounds only here:
-        auto avail_samples_to_process = avail_samples;
-        while (avail_samples_to_process > 0)
-        {
-            read_pos = sd_decoder.processSamples(read_pos, buffer_block_size);
-            avail_samples_to_process -= buffer_block_size;
+        releaser.release(spans.totalScans());
 
-            // Handle the circular buffer wrap around
-            if (read_pos >= buf_end_pos)
-            {
-                read_pos -= buff_size;
-            }
+        if (++iterations % 50 == 0)
+        {
+            std::cout << std::dec << "Driver calls/s: " << releaser.driverCallsPerSecond() << std::endl;
         }
-
-        DeWeSetParam_i32(1, CMD_BUFFER_0_FREE_NO_SAMPLE, avail_samples);
     }
 
 
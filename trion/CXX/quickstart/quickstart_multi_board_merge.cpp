@@ -0,0 +1,165 @@
+/**
+ * TRION-SDK Quickstart example merging the scans of several boards.
+ *
+ * The boards share the sample clock of the master (TRION-SYNC-BUS).
+ * BoardCnt0 counts the sample clock on every board, the ScanMerger uses it
+ * together with the ADC delay to align all boards into one frame stream.
+ * The samples stay in the circular buffers, only spans are handed out.
+ *
+ * This code is licensed under MIT license (see LICENSE.txt for details)
+ * Copyright (c) 2024 by DEWETRON GmbH
+ */
+
+
+#include "dewepxi_load.h"
+#include "dewepxi_apicore.h"
+#include "dewepxi_apiutil.h"
+#include "dewepxi_acq_engine.h"
+#include "dewepxi_config_executor.h"
+#include "dewepxi_scan_decoder.h"
+#include "dewepxi_scan_merger.h"
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+int main(int argc, char* argv[])
+{
+    int boards = 0;
+    const int board_ids[] = { 1, 2 };   // master first
+    const int num_boards = sizeof(board_ids) / sizeof(board_ids[0]);
+    const int num_merges = 200;
+    char scan_descriptor[8192] = { 0 };
+
+    // Basic SDK Initialization
+    DeWePxiLoad();
+
+    // boards is negative for simulation
+    DeWeDriverInit(&boards);
+
+    // Chassis controller and master first, the slaves are configured concurrently
+    trion::ConfigExecutor config;
+    trion::BoardSetup controller(0, trion::BOARD_ROLE_CONTROLLER);
+    controller.update = false;
+    config.addBoard(controller);
+
+    for (int i = 0; i < num_boards; ++i)
+    {
+        trion::BoardSetup setup(board_ids[i], i == 0 ? trion::BOARD_ROLE_MASTER : trion::BOARD_ROLE_SLAVE);
+
+        setup.set("AIAll", "Used", "True");
+
+        // BoardCnt0 counts the sample clock, reset on start
+        setup.set("BoardCnt0", "Used", "True");
+        setup.set("BoardCnt0", "Source_A", "ACQ_CLK");
+        setup.set("BoardCnt0", "Reset", "OnRestart");
+
+        // First board is the master, all others are clocked by it
+        setup.set("AcqProp", "OperationMode", i == 0 ? "Master" : "Slave");
+        setup.set("AcqProp", "ExtTrigger", i == 0 ? "False" : "PosEdge");
+        setup.set("AcqProp", "ExtClk", "False");
+        setup.set("AcqProp", "SampleRate", "10000");
+
+        setup.command(CMD_BUFFER_0_BLOCK_SIZE, 100);
+        setup.command(CMD_BUFFER_0_BLOCK_COUNT, 50);
+        config.addBoard(setup);
+    }
+
+    int err = config.run();
+    const trion::StartupReport& report = config.report();
+    std::cout << "Startup " << report.total_ns / 1000000 << " ms (open " << report.phase_ns[trion::CONFIG_PHASE_OPEN] / 1000000
+              << ", reset " << report.phase_ns[trion::CONFIG_PHASE_RESET] / 1000000
+              << ", configure " << report.phase_ns[trion::CONFIG_PHASE_CONFIGURE] / 1000000
+              << ", update " << report.phase_ns[trion::CONFIG_PHASE_UPDATE] / 1000000 << ")"
+              << (report.serial_fallback ? " serialized by the driver" : "") << std::endl;
+    if (err > 0)
+    {
+        std::cout << "Configuration: " << DeWeErrorConstantToString(err) << std::endl;
+        return 1;
+    }
+
+    // One reader and one merger consumer per board
+    trion::AcquisitionEngine engine;
+    trion::ScanMerger merger(engine);
+    std::vector<std::unique_ptr<trion::ScanDecoder>> decoders;
+
+    for (int i = 0; i < num_boards; ++i)
+    {
+        const std::string board = "BoardId" + std::to_string(board_ids[i]);
+        DeWeGetParamStruct_str(board.c_str(), "ScanDescriptor_V3", scan_descriptor, sizeof(scan_descriptor));
+        trion::ScanDescriptor sd(scan_descriptor);
+
+        engine.addBoard(board_ids[i]);
+        err = merger.addBoard(i, engine.addConsumer(i), sd);
+        if (err > 0)
+        {
+            std::cout << board << ": " << DeWeErrorConstantToString(err) << std::endl;
+            return 1;
+        }
+        decoders.emplace_back(new trion::ScanDecoder(sd));
+    }
+
+    // Start the slaves first, the master starts the sample clock
+    for (int i = num_boards - 1; i >= 0; --i)
+    {
+        DeWeSetParam_i32(board_ids[i], CMD_START_ACQUISITION, 0);
+    }
+    engine.start();
+
+    std::vector<trion::DecodedBlock> counter_blocks(num_boards);
+    std::vector<trion::DecodedBlock> analog_blocks(num_boards);
+    for (int i = 0; i < num_boards; ++i)
+    {
+        counter_blocks[i].resize(decoders[i]->numChannels(), engine.ring(i).capacity());
+        analog_blocks[i].resize(decoders[i]->numChannels(), engine.ring(i).capacity());
+    }
+
+    for (int n = 0; n < num_merges; ++n)
+    {
+        trion::MergedFrame frame;
+        if (!merger.next(frame, 1000, 1000))
+        {
+            continue;
+        }
+        if (frame.error > 0)
+        {
+            std::cout << "Reader error: " << frame.error << std::endl;
+            break;
+        }
+
+        // Frame i of every board belongs to the same sample clock edge:
+        // analog channels are decoded from the ADC delay shifted spans
+        std::cout << "Frame " << frame.first_frame << " +" << frame.frames;
+        for (int i = 0; i < num_boards; ++i)
+        {
+            const trion::ScanDecoder& decoder = *decoders[i];
+            decoder.decode(frame.boards[i].spans, counter_blocks[i]);
+            decoder.decode(frame.boards[i].analog_spans, analog_blocks[i]);
+
+            int cnt = decoder.findChannel("BoardCnt0");
+            std::cout << "  Board" << board_ids[i] << " cnt " << counter_blocks[i].channel(cnt)[0];
+            if (decoder.numChannels() > 0 && decoder.channel(0).channel_type == trion::CHANNEL_TYPE_ANALOG)
+            {
+                std::cout << " " << decoder.channel(0).name << " " << analog_blocks[i].channel(0)[0];
+            }
+        }
+        std::cout << std::endl;
+
+        merger.release(frame);
+    }
+
+    engine.stop();
+    std::cout << "Misaligned board blocks: " << merger.misalignments() << std::endl;
+
+    for (int i = 0; i < num_boards; ++i)
+    {
+        DeWeSetParam_i32(board_ids[i], CMD_STOP_ACQUISITION, 0);
+        DeWeSetParam_i32(board_ids[i], CMD_CLOSE_BOARD, 0);
+    }
+    DeWeSetParam_i32(0, CMD_CLOSE_BOARD, 0);
+    DeWeDriverDeInit();
+    DeWePxiUnload();
+
+    return 0;
+}
@@ -0,0 +1,111 @@
+/**
+ * TRION-SDK example: absolute timestamps of PTP synchronized samples.
+ *
+ * The ClockModel pairs a change of the PTP second with the sample count
+ * once per second and fits offset and drift. Every block received from the
+ * AcquisitionEngine is stamped with nanosecond timestamps in one pass,
+ * blocks with a timing state other than LOCKED are marked degraded.
+ *
+ * This code is licensed under MIT license (see LICENSE.txt for details)
+ * Copyright (c) 2024 by DEWETRON GmbH
+ */
+
+
+#include "dewepxi_load.h"
+#include "dewepxi_apicore.h"
+#include "dewepxi_apiutil.h"
+#include "dewepxi_acq_engine.h"
+#include "dewepxi_clock_model.h"
+#include <iostream>
+#include <vector>
+
+
+int main(int argc, char* argv[])
+{
+    int boards = 0;
+    const int num_blocks = 600;
+
+    // Basic SDK Initialization
+    DeWePxiLoad();
+
+    // boards is negative for simulation
+    DeWeDriverInit(&boards);
+
+    DeWeSetParam_i32(0, CMD_OPEN_BOARD, 0);
+    DeWeSetParam_i32(0, CMD_RESET_BOARD, 0);
+
+    DeWeSetParamStruct_str("BoardID0/AIAll", "Used", "True");
+    DeWeSetParam_i32(0, CMD_BUFFER_0_BLOCK_SIZE, 200);
+    DeWeSetParam_i32(0, CMD_BUFFER_0_BLOCK_COUNT, 50);
+    DeWeSetParamStruct_str("BoardID0/AcqProp", "SampleRate", "2000");
+
+    // Sync-in by PTP, the start counter has to be set equal to the sample rate
+    DeWeSetParamStruct_str("BoardID0/AcqProp/SyncSettings/SyncIn", "Mode", "PTP");
+    DeWeSetParamStruct_str("BoardID0/AcqProp", "StartCounter", "2000");
+
+    DeWeSetParam_i32(0, CMD_UPDATE_PARAM_ALL, 0);
+
+    // Issue resync and wait for a good sync-state
+    DeWeSetParam_i32(0, CMD_TIMING_STATE, 0);
+    {
+        sint32 timing_state;
+        // Break with success or CTRL+C only
+        do
+        {
+            Sleep(100);
+            DeWeGetParam_i32(0, CMD_TIMING_STATE, &timing_state);
+        } while (timing_state != TIMINGSTATE_LOCKED);
+    }
+
+    trion::AcquisitionEngine engine;
+    engine.addBoard(0);
+
+    DeWeSetParam_i32(0, CMD_START_ACQUISITION, 0);
+    engine.start();
+
+    // One time point per second
+    trion::ClockModel clock(0, 2000.0);
+    clock.start(1000);
+
+    std::vector<uint64> time_ns(engine.ring(0).capacity());
+    for (int n = 0; n < num_blocks; )
+    {
+        trion::BlockDescriptor desc;
+        if (!engine.waitPop(0, desc, 1000))
+        {
+            continue;
+        }
+        if (desc.error > 0)
+        {
+            std::cout << "Reader error: " << desc.error << std::endl;
+            break;
+        }
+
+        // Scan index since start == sample index, without data loss
+        uint32 flags = clock.stamp(desc.first_scan, desc.scans, time_ns.data());
+        if (desc.scans > 0 && n % 20 == 0)
+        {
+            const uint64 ns = time_ns[0];
+            std::cout << "Scan " << desc.first_scan << " +" << desc.scans
+                      << " at " << ns / 1000000000ull << "." << (ns % 1000000000ull) / 1000 << " s"
+                      << ((flags & trion::CLOCK_FLAG_DEGRADED) ? " degraded" : "")
+                      << ((flags & trion::CLOCK_FLAG_UNFITTED) ? " unfitted" : "") << std::endl;
+        }
+        engine.release(desc);
+        ++n;
+    }
+
+    clock.stop();
+    engine.stop();
+    DeWeSetParam_i32(0, CMD_STOP_ACQUISITION, 0);
+
+    trion::ClockFit fit = clock.fit();
+    std::cout << "Clock fit: " << fit.points << " points"
+              << ", " << fit.ns_per_sample << " ns/sample"
+              << ", residual " << fit.residual_ns / 1000.0 << " us" << std::endl;
+
+    DeWeSetParam_i32(0, CMD_CLOSE_BOARD, 0);
+    DeWeDriverDeInit();
+    DeWePxiUnload();
+    return 0;
+}
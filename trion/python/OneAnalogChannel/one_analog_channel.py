@@ -142,8 +142,9 @@ def main(argv):
                     data = np.frombuffer(raw_data, dtype=np.int16)[::2]
                     data = data * 2**-15 # convert int16 to floats between -1 and 1
                 elif RESOLUTION_AI == 24:
-                    data = np.frombuffer(raw_data, dtype=np.uint8)
-                    data = data[::4] | data[1::4].astype(int) << 8 | data[2::4].view(np.int8).astype(int) << 16
+                    # 24 bit samples in 32 bit words: sign extend bit 23 in place
+                    data = np.frombuffer(raw_data, dtype=np.int32)
+                    data = (data << 8) >> 8
                     data = data * 2**-23 # convert int24 to floats between -1 and 1
                 else:
                     data = None
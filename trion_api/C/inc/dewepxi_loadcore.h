@@ -219,6 +219,10 @@ static void* loadFunction(
 #endif
 
 
+// API call profiler (DEWEPXI_API_PROFILER)
+#include "dewepxi_profiler.h"
+
+
 //######################################################################################################################################################
 // Load
 //######################################################################################################################################################
@@ -247,6 +251,9 @@ int DeWePxiLoadByName(const char* name)
     BOOLEAN        bTotResult = TRUE;
     char*          error = NULL;
     int revision = 0;
+#ifdef DEWEPXI_API_PROFILER
+    double load_start_us = profilerNow();
+#endif
     //Trap multiple Loads
     if ( LoadedRevision > 0 ) {
         return LoadedRevision;
@@ -372,6 +379,12 @@ int DeWePxiLoadByName(const char* name)
     {
         DeWePxiUnload();
     }
+#ifdef DEWEPXI_API_PROFILER
+    else
+    {
+        profilerInstall(load_start_us);
+    }
+#endif
 
     return revision;
 }
@@ -387,6 +400,9 @@ void DeWePxiUnload(void)
         if(DeWeDriverDeInit != 0) {
             DeWeDriverDeInit();
         }
+#ifdef DEWEPXI_API_PROFILER
+        profilerUninstall();
+#endif
         CLOSE_LIBRARY(hLib);
         LoadedRevision = 0;
         hLib    = 0;
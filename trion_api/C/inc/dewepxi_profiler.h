@@ -0,0 +1,692 @@
+/*
+ * Copyright (c) 2024 DEWETRON
+ * License: MIT
+ *
+ * API call profiler, enabled by defining DEWEPXI_API_PROFILER
+ * Private header: Do not include directly! (included by dewepxi_loadcore.h)
+ *
+ * DeWePxiLoad replaces the loaded API function pointers by wrappers
+ * timestamping every call. Each call is attributed to its board
+ * (board_no or the BoardIDx of the target) and to its command, the
+ * calls are written as Chrome trace events (chrome://tracing, Perfetto).
+ *
+ * The trace covers the startup: DeWePxiLoad, DeWeDriverInit, the board
+ * configuration, ScanDescriptor and BoardProperties queries, up to and
+ * including the first CMD_START_ACQUISITION. The trace file is written
+ * then (or at DeWePxiUnload / exit). The sample and frame read functions
+ * are not traced.
+ *
+ * Environment:
+ *   DEWEPXI_PROFILE         trace file name (default dewepxi_trace.json)
+ *   DEWEPXI_PROFILE_ALL     1: keep tracing after the start of the acquisition
+ *   DEWEPXI_PROFILE_EVENTS  maximum number of traced calls (default 32768)
+ */
+
+#ifndef __DEWE_PXI_PROFILER_H__
+#define __DEWE_PXI_PROFILER_H__
+
+#if defined(DEWEPXI_API_PROFILER) && !defined(STATIC_DLL)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef WIN32
+#  include <time.h>
+#endif
+
+
+#ifdef WIN32
+#  define DEWEPXI_PROFILER_CLAIM(counter) (InterlockedIncrement(counter) - 1)
+#else
+#  define DEWEPXI_PROFILER_CLAIM(counter) __sync_fetch_and_add(counter, 1)
+#endif
+
+#define DEWEPXI_PROFILER_NO_BOARD  (-1)
+#define DEWEPXI_PROFILER_TEXT      64
+
+typedef struct
+{
+    double          start_us;
+    double          dur_us;
+    const char*     func;
+    int             board;
+    int             err;
+    int             has_command;
+    unsigned int    command;
+    int             has_value;
+    sint64          value;
+    char            target[DEWEPXI_PROFILER_TEXT];
+    char            item[DEWEPXI_PROFILER_TEXT];
+} DEWEPXI_PROFILER_EVENT;
+
+static DEWEPXI_PROFILER_EVENT*  ProfilerEvents = NULL;
+static long                     ProfilerCapacity = 0;
+static volatile long            ProfilerCount = 0;
+static volatile int             ProfilerActive = 0;
+static int                      ProfilerAll = 0;
+static int                      ProfilerWritten = 0;
+static double                   ProfilerOrigin = 0.0;
+
+static const struct
+{
+    unsigned int    id;
+    const char*     name;
+} ProfilerCommands[] =
+{
+#define TRION_COMMAND(name, val) { val, "CMD_" #name },
+#include "dewepxi_commands.inc"
+#undef TRION_COMMAND
+};
+
+// Original API functions
+static PDEWEDRIVERINIT              ProfiledDriverInit;
+static PDEWEDRIVERDEINIT            ProfiledDriverDeInit;
+static PDEWEGETPARAM_I32            ProfiledGetParam_i32;
+static PDEWESETPARAM_I32            ProfiledSetParam_i32;
+static PDEWEGETPARAM_I64            ProfiledGetParam_i64;
+static PDEWESETPARAM_I64            ProfiledSetParam_i64;
+static PDEWESETPARAMSTRUCT_STR      ProfiledSetParamStruct_str;
+static PDEWEGETPARAMSTRUCT_STR      ProfiledGetParamStruct_str;
+static PDEWEGETPARAMSTRUCT_STRLEN   ProfiledGetParamStruct_strLEN;
+static PDEWEGETPARAMSTRUCTEX_STR    ProfiledGetParamStructEx_str;
+static PDEWESETPARAMXML_STR         ProfiledSetParamXML_str;
+static PDEWEGETPARAMXML_STR         ProfiledGetParamXML_str;
+static PDEWEGETPARAMXML_STRLEN      ProfiledGetParamXML_strLEN;
+static PDEWEOPENCAN                 ProfiledOpenCAN;
+static PDEWECLOSECAN                ProfiledCloseCAN;
+static PDEWESETCHANNELPROPCAN       ProfiledSetChannelPropCAN;
+static PDEWESTARTCAN                ProfiledStartCAN;
+static PDEWESTOPCAN                 ProfiledStopCAN;
+static PDEWEOPENDMAUART             ProfiledOpenDmaUart;
+static PDEWECLOSEDMAUART            ProfiledCloseDmaUart;
+static PDEWESETCHANNELPROPDMAUART   ProfiledSetChannelPropDmaUart;
+static PDEWESTARTDMAUART            ProfiledStartDmaUart;
+static PDEWESTOPDMAUART             ProfiledStopDmaUart;
+
+
+//*************************************************************************************
+// Recording
+//*************************************************************************************
+
+/**
+ * Monotonic time in microseconds.
+ */
+static double profilerNow(void)
+{
+#ifdef WIN32
+    LARGE_INTEGER count;
+    LARGE_INTEGER frequency;
+    QueryPerformanceCounter(&count);
+    QueryPerformanceFrequency(&frequency);
+    return (double)count.QuadPart * 1e6 / (double)frequency.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e6 + (double)ts.tv_nsec * 1e-3;
+#endif
+}
+
+/**
+ * Start of a call, negative while not tracing.
+ */
+static double profilerBegin(void)
+{
+    return ProfilerActive ? profilerNow() : -1.0;
+}
+
+/**
+ * Board of a target like "BoardID2/AI0", DEWEPXI_PROFILER_NO_BOARD otherwise.
+ */
+static int profilerTargetBoard(const char* target)
+{
+    static const char prefix[] = "boardid";
+    size_t i;
+    if (!target)
+    {
+        return DEWEPXI_PROFILER_NO_BOARD;
+    }
+    for (i = 0; i < sizeof(prefix) - 1; ++i)
+    {
+        if (target[i] == 0 || (target[i] | 0x20) != prefix[i])
+        {
+            return DEWEPXI_PROFILER_NO_BOARD;
+        }
+    }
+    if (target[i] < '0' || target[i] > '9')
+    {
+        return DEWEPXI_PROFILER_NO_BOARD;
+    }
+    return atoi(target + i);
+}
+
+static void profilerCopy(char* dst, const char* src)
+{
+    if (src)
+    {
+        strncpy(dst, src, DEWEPXI_PROFILER_TEXT - 1);
+        dst[DEWEPXI_PROFILER_TEXT - 1] = 0;
+    }
+    else
+    {
+        dst[0] = 0;
+    }
+}
+
+static void profilerWrite(void);
+
+static DEWEPXI_PROFILER_EVENT* profilerRecord(const char* func, double start_us, int board, int err)
+{
+    DEWEPXI_PROFILER_EVENT* event;
+    long index;
+    double end_us;
+    if (start_us < 0.0)
+    {
+        return NULL;
+    }
+    end_us = profilerNow();
+    index = DEWEPXI_PROFILER_CLAIM(&ProfilerCount);
+    if (index >= ProfilerCapacity)
+    {
+        return NULL;
+    }
+    event = &ProfilerEvents[index];
+    event->start_us = start_us;
+    event->dur_us = end_us - start_us;
+    event->func = func;
+    event->board = board;
+    event->err = err;
+    event->has_command = 0;
+    event->command = 0;
+    event->has_value = 0;
+    event->value = 0;
+    event->target[0] = 0;
+    event->item[0] = 0;
+    return event;
+}
+
+static void profilerRecordCommand(const char* func, double start_us, int board, unsigned int command, int has_value, sint64 value, int err)
+{
+    DEWEPXI_PROFILER_EVENT* event = profilerRecord(func, start_us, board, err);
+    if (event)
+    {
+        event->has_command = 1;
+        event->command = command;
+        event->has_value = has_value;
+        event->value = value;
+    }
+
+    // The startup ends with the start of the acquisition
+    if (start_us >= 0.0 && command == CMD_START_ACQUISITION && !ProfilerAll)
+    {
+        ProfilerActive = 0;
+        profilerWrite();
+    }
+}
+
+static void profilerRecordString(const char* func, double start_us, const char* target, const char* item, int err)
+{
+    DEWEPXI_PROFILER_EVENT* event = profilerRecord(func, start_us, profilerTargetBoard(target), err);
+    if (event)
+    {
+        profilerCopy(event->target, target);
+        profilerCopy(event->item, item);
+    }
+}
+
+
+//*************************************************************************************
+// Wrappers
+//*************************************************************************************
+
+static int RT_IMPORT profiledDriverInit(int* num_boards)
+{
+    double start = profilerBegin();
+    int err = ProfiledDriverInit(num_boards);
+    DEWEPXI_PROFILER_EVENT* event = profilerRecord("DeWeDriverInit", start, DEWEPXI_PROFILER_NO_BOARD, err);
+    if (event && num_boards)
+    {
+        event->has_value = 1;
+        event->value = *num_boards;
+    }
+    return err;
+}
+
+static int RT_IMPORT profiledDriverDeInit(void)
+{
+    double start = profilerBegin();
+    int err = ProfiledDriverDeInit();
+    profilerRecord("DeWeDriverDeInit", start, DEWEPXI_PROFILER_NO_BOARD, err);
+    return err;
+}
+
+static int RT_IMPORT profiledGetParam_i32(int board_no, unsigned int command_id, sint32* val)
+{
+    double start = profilerBegin();
+    int err = ProfiledGetParam_i32(board_no, command_id, val);
+    profilerRecordCommand("DeWeGetParam_i32", start, board_no, command_id, val && err <= 0, val ? *val : 0, err);
+    return err;
+}
+
+static int RT_IMPORT profiledSetParam_i32(int board_no, unsigned int command_id, sint32 val)
+{
+    double start = profilerBegin();
+    int err = ProfiledSetParam_i32(board_no, command_id, val);
+    profilerRecordCommand("DeWeSetParam_i32", start, board_no, command_id, 1, val, err);
+    return err;
+}
+
+static int RT_IMPORT profiledGetParam_i64(int board_no, unsigned int command_id, sint64* val)
+{
+    double start = profilerBegin();
+    int err = ProfiledGetParam_i64(board_no, command_id, val);
+    profilerRecordCommand("DeWeGetParam_i64", start, board_no, command_id, val && err <= 0, val ? *val : 0, err);
+    return err;
+}
+
+static int RT_IMPORT profiledSetParam_i64(int board_no, unsigned int command_id, sint64 val)
+{
+    double start = profilerBegin();
+    int err = ProfiledSetParam_i64(board_no, command_id, val);
+    profilerRecordCommand("DeWeSetParam_i64", start, board_no, command_id, 1, val, err);
+    return err;
+}
+
+static int RT_IMPORT profiledSetParamStruct_str(const char* target, const char* command, const char* val)
+{
+    double start = profilerBegin();
+    int err = ProfiledSetParamStruct_str(target, command, val);
+    profilerRecordString("DeWeSetParamStruct_str", start, target, command, err);
+    return err;
+}
+
+static int RT_IMPORT profiledGetParamStruct_str(const char* target, const char* command, char* val, uint32 val_size)
+{
+    double start = profilerBegin();
+    int err = ProfiledGetParamStruct_str(target, command, val, val_size);
+    profilerRecordString("DeWeGetParamStruct_str", start, target, command, err);
+    return err;
+}
+
+static int RT_IMPORT profiledGetParamStruct_strLEN(const char* target, const char* command, uint32* val_size)
+{
+    double start = profilerBegin();
+    int err = ProfiledGetParamStruct_strLEN(target, command, val_size);
+    profilerRecordString("DeWeGetParamStruct_strLEN", start, target, command, err);
+    return err;
+}
+
+static int RT_IMPORT profiledGetParamStructEx_str(const char* target, const char* command, const char* arg, char* val, uint32 val_size)
+{
+    double start = profilerBegin();
+    int err = ProfiledGetParamStructEx_str(target, command, arg, val, val_size);
+    profilerRecordString("DeWeGetParamStructEx_str", start, target, command, err);
+    return err;
+}
+
+static int RT_IMPORT profiledSetParamXML_str(const char* target, const char* command, const char* val)
+{
+    double start = profilerBegin();
+    int err = ProfiledSetParamXML_str(target, command, val);
+    profilerRecordString("DeWeSetParamXML_str", start, target, command, err);
+    return err;
+}
+
+static int RT_IMPORT profiledGetParamXML_str(const char* target, const char* command, char* val, uint32 val_size)
+{
+    double start = profilerBegin();
+    int err = ProfiledGetParamXML_str(target, command, val, val_size);
+    profilerRecordString("DeWeGetParamXML_str", start, target, command, err);
+    return err;
+}
+
+static int RT_IMPORT profiledGetParamXML_strLEN(const char* target, const char* command, uint32* val_size)
+{
+    double start = profilerBegin();
+    int err = ProfiledGetParamXML_strLEN(target, command, val_size);
+    profilerRecordString("DeWeGetParamXML_strLEN", start, target, command, err);
+    return err;
+}
+
+static int RT_IMPORT profiledOpenCAN(int board_no)
+{
+    double start = profilerBegin();
+    int err = ProfiledOpenCAN(board_no);
+    profilerRecord("DeWeOpenCAN", start, board_no, err);
+    return err;
+}
+
+static int RT_IMPORT profiledCloseCAN(int board_no)
+{
+    double start = profilerBegin();
+    int err = ProfiledCloseCAN(board_no);
+    profilerRecord("DeWeCloseCAN", start, board_no, err);
+    return err;
+}
+
+static int RT_IMPORT profiledSetChannelPropCAN(int board_no, int nChannelNo, BOARD_CAN_CHANNEL_PROP rProp)
+{
+    double start = profilerBegin();
+    int err = ProfiledSetChannelPropCAN(board_no, nChannelNo, rProp);
+    profilerRecord("DeWeSetChannelPropCAN", start, board_no, err);
+    return err;
+}
+
+static int RT_IMPORT profiledStartCAN(int board_no, int nChannelNo)
+{
+    double start = profilerBegin();
+    int err = ProfiledStartCAN(board_no, nChannelNo);
+    profilerRecord("DeWeStartCAN", start, board_no, err);
+    return err;
+}
+
+static int RT_IMPORT profiledStopCAN(int board_no, int nChannelNo)
+{
+    double start = profilerBegin();
+    int err = ProfiledStopCAN(board_no, nChannelNo);
+    profilerRecord("DeWeStopCAN", start, board_no, err);
+    return err;
+}
+
+static int RT_IMPORT profiledOpenDmaUart(int board_no)
+{
+    double start = profilerBegin();
+    int err = ProfiledOpenDmaUart(board_no);
+    profilerRecord("DeWeOpenDmaUart", start, board_no, err);
+    return err;
+}
+
+static int RT_IMPORT profiledCloseDmaUart(int board_no)
+{
+    double start = profilerBegin();
+    int err = ProfiledCloseDmaUart(board_no);
+    profilerRecord("DeWeCloseDmaUart", start, board_no, err);
+    return err;
+}
+
+static int RT_IMPORT profiledSetChannelPropDmaUart(int board_no, int nChannelNo, BOARD_UART_CHANNEL_PROP rProp)
+{
+    double start = profilerBegin();
+    int err = ProfiledSetChannelPropDmaUart(board_no, nChannelNo, rProp);
+    profilerRecord("DeWeSetChannelPropDmaUart", start, board_no, err);
+    return err;
+}
+
+static int RT_IMPORT profiledStartDmaUart(int board_no, int nChannelNo)
+{
+    double start = profilerBegin();
+    int err = ProfiledStartDmaUart(board_no, nChannelNo);
+    profilerRecord("DeWeStartDmaUart", start, board_no, err);
+    return err;
+}
+
+static int RT_IMPORT profiledStopDmaUart(int board_no, int nChannelNo)
+{
+    double start = profilerBegin();
+    int err = ProfiledStopDmaUart(board_no, nChannelNo);
+    profilerRecord("DeWeStopDmaUart", start, board_no, err);
+    return err;
+}
+
+
+//*************************************************************************************
+// Trace file
+//*************************************************************************************
+
+static const char* profilerCommandName(unsigned int command)
+{
+    size_t i;
+    for (i = 0; i < sizeof(ProfilerCommands) / sizeof(ProfilerCommands[0]); ++i)
+    {
+        if (ProfilerCommands[i].id == command)
+        {
+            return ProfilerCommands[i].name;
+        }
+    }
+    return NULL;
+}
+
+static void profilerWriteString(FILE* file, const char* text)
+{
+    fputc('"', file);
+    for (; *text; ++text)
+    {
+        unsigned char c = (unsigned char)*text;
+        if (c == '"' || c == '\\')
+        {
+            fprintf(file, "\\%c", c);
+        }
+        else if (c < 0x20)
+        {
+            fprintf(file, "\\u%04x", c);
+        }
+        else
+        {
+            fputc(c, file);
+        }
+    }
+    fputc('"', file);
+}
+
+static void profilerWriteBoardName(FILE* file, int board, int* first)
+{
+    fprintf(file, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":", *first ? "" : ",", board);
+    if (board == DEWEPXI_PROFILER_NO_BOARD)
+    {
+        fprintf(file, "\"API\"}}");
+    }
+    else
+    {
+        fprintf(file, "\"BoardID%d\"}}", board);
+    }
+    *first = 0;
+}
+
+/**
+ * Write the trace file and a summary per board to stderr.
+ */
+static void profilerWrite(void)
+{
+    const char* name = getenv("DEWEPXI_PROFILE");
+    long count = ProfilerCount < ProfilerCapacity ? ProfilerCount : ProfilerCapacity;
+    int max_board = DEWEPXI_PROFILER_NO_BOARD;
+    int first = 1;
+    int board;
+    long i;
+    FILE* file;
+
+    if (ProfilerWritten || !ProfilerEvents)
+    {
+        return;
+    }
+    ProfilerWritten = 1;
+
+    if (!name || !*name)
+    {
+        name = "dewepxi_trace.json";
+    }
+    file = fopen(name, "w");
+    if (!file)
+    {
+        fprintf(stderr, "DEWEPXI_API_PROFILER: cannot write %s\n", name);
+        return;
+    }
+
+    for (i = 0; i < count; ++i)
+    {
+        if (ProfilerEvents[i].board > max_board)
+        {
+            max_board = ProfilerEvents[i].board;
+        }
+    }
+
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    fprintf(file, "\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"TRION API\"}}");
+    first = 0;
+
+    // One trace row per board, the calls without board in the row "API"
+    for (board = DEWEPXI_PROFILER_NO_BOARD; board <= max_board; ++board)
+    {
+        for (i = 0; i < count; ++i)
+        {
+            if (ProfilerEvents[i].board == board)
+            {
+                profilerWriteBoardName(file, board, &first);
+                break;
+            }
+        }
+    }
+
+    for (i = 0; i < count; ++i)
+    {
+        const DEWEPXI_PROFILER_EVENT* event = &ProfilerEvents[i];
+        const char* command = event->has_command ? profilerCommandName(event->command) : NULL;
+
+        // Name: the command, the item of a string call or the function
+        fprintf(file, ",\n{\"name\":");
+        if (command)
+        {
+            profilerWriteString(file, command);
+        }
+        else if (event->has_command)
+        {
+            fprintf(file, "\"0x%04X\"", event->command);
+        }
+        else if (event->item[0])
+        {
+            profilerWriteString(file, event->item);
+        }
+        else
+        {
+            profilerWriteString(file, event->func);
+        }
+        fprintf(file, ",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"err\":%d",
+                event->func, event->board, event->start_us - ProfilerOrigin, event->dur_us, event->err);
+        if (event->target[0])
+        {
+            fprintf(file, ",\"target\":");
+            profilerWriteString(file, event->target);
+        }
+        if (event->has_value)
+        {
+            fprintf(file, ",\"value\":%lld", (long long)event->value);
+        }
+        fprintf(file, "}}");
+    }
+    fprintf(file, "\n]}\n");
+    fclose(file);
+
+    fprintf(stderr, "DEWEPXI_API_PROFILER: %ld calls written to %s%s\n", count, name,
+            ProfilerCount > ProfilerCapacity ? " (DEWEPXI_PROFILE_EVENTS exceeded)" : "");
+    for (board = DEWEPXI_PROFILER_NO_BOARD; board <= max_board; ++board)
+    {
+        double busy_us = 0.0;
+        long calls = 0;
+        for (i = 0; i < count; ++i)
+        {
+            if (ProfilerEvents[i].board == board)
+            {
+                busy_us += ProfilerEvents[i].dur_us;
+                ++calls;
+            }
+        }
+        if (calls)
+        {
+            if (board == DEWEPXI_PROFILER_NO_BOARD)
+            {
+                fprintf(stderr, "  API       %6ld calls %10.1f ms\n", calls, busy_us * 1e-3);
+            }
+            else
+            {
+                fprintf(stderr, "  BoardID%-2d %6ld calls %10.1f ms\n", board, calls, busy_us * 1e-3);
+            }
+        }
+    }
+}
+
+static void profilerAtExit(void)
+{
+    ProfilerActive = 0;
+    profilerWrite();
+}
+
+
+//*************************************************************************************
+// Install / Uninstall
+//*************************************************************************************
+
+#define DEWEPXI_PROFILE_FUNCTION(name, wrapper, original) \
+    if (name) { original = name; name = wrapper; }
+
+/**
+ * Wrap the loaded API functions, called by DeWePxiLoadByName.
+ * @param load_start_us start of the load, traced as DeWePxiLoad
+ */
+static void profilerInstall(double load_start_us)
+{
+    static int at_exit = 0;
+    const char* env_events = getenv("DEWEPXI_PROFILE_EVENTS");
+    const char* env_all = getenv("DEWEPXI_PROFILE_ALL");
+
+    ProfilerCapacity = env_events ? atol(env_events) : 0;
+    if (ProfilerCapacity <= 0)
+    {
+        ProfilerCapacity = 32768;
+    }
+    free(ProfilerEvents);
+    ProfilerEvents = (DEWEPXI_PROFILER_EVENT*)malloc(sizeof(DEWEPXI_PROFILER_EVENT) * ProfilerCapacity);
+    if (!ProfilerEvents)
+    {
+        return;
+    }
+    ProfilerCount = 0;
+    ProfilerWritten = 0;
+    ProfilerAll = env_all && atoi(env_all) != 0;
+    ProfilerOrigin = load_start_us;
+    ProfilerActive = 1;
+    profilerRecord("DeWePxiLoad", load_start_us, DEWEPXI_PROFILER_NO_BOARD, 0);
+
+    DEWEPXI_PROFILE_FUNCTION(DeWeDriverInit, profiledDriverInit, ProfiledDriverInit);
+    DEWEPXI_PROFILE_FUNCTION(DeWeDriverDeInit, profiledDriverDeInit, ProfiledDriverDeInit);
+    DEWEPXI_PROFILE_FUNCTION(DeWeGetParam_i32, profiledGetParam_i32, ProfiledGetParam_i32);
+    DEWEPXI_PROFILE_FUNCTION(DeWeSetParam_i32, profiledSetParam_i32, ProfiledSetParam_i32);
+    DEWEPXI_PROFILE_FUNCTION(DeWeGetParam_i64, profiledGetParam_i64, ProfiledGetParam_i64);
+    DEWEPXI_PROFILE_FUNCTION(DeWeSetParam_i64, profiledSetParam_i64, ProfiledSetParam_i64);
+    DEWEPXI_PROFILE_FUNCTION(DeWeSetParamStruct_str, profiledSetParamStruct_str, ProfiledSetParamStruct_str);
+    DEWEPXI_PROFILE_FUNCTION(DeWeGetParamStruct_str, profiledGetParamStruct_str, ProfiledGetParamStruct_str);
+    DEWEPXI_PROFILE_FUNCTION(DeWeGetParamStruct_strLEN, profiledGetParamStruct_strLEN, ProfiledGetParamStruct_strLEN);
+    DEWEPXI_PROFILE_FUNCTION(DeWeGetParamStructEx_str, profiledGetParamStructEx_str, ProfiledGetParamStructEx_str);
+    DEWEPXI_PROFILE_FUNCTION(DeWeSetParamXML_str, profiledSetParamXML_str, ProfiledSetParamXML_str);
+    DEWEPXI_PROFILE_FUNCTION(DeWeGetParamXML_str, profiledGetParamXML_str, ProfiledGetParamXML_str);
+    DEWEPXI_PROFILE_FUNCTION(DeWeGetParamXML_strLEN, profiledGetParamXML_strLEN, ProfiledGetParamXML_strLEN);
+    DEWEPXI_PROFILE_FUNCTION(DeWeOpenCAN, profiledOpenCAN, ProfiledOpenCAN);
+    DEWEPXI_PROFILE_FUNCTION(DeWeCloseCAN, profiledCloseCAN, ProfiledCloseCAN);
+    DEWEPXI_PROFILE_FUNCTION(DeWeSetChannelPropCAN, profiledSetChannelPropCAN, ProfiledSetChannelPropCAN);
+    DEWEPXI_PROFILE_FUNCTION(DeWeStartCAN, profiledStartCAN, ProfiledStartCAN);
+    DEWEPXI_PROFILE_FUNCTION(DeWeStopCAN, profiledStopCAN, ProfiledStopCAN);
+    DEWEPXI_PROFILE_FUNCTION(DeWeOpenDmaUart, profiledOpenDmaUart, ProfiledOpenDmaUart);
+    DEWEPXI_PROFILE_FUNCTION(DeWeCloseDmaUart, profiledCloseDmaUart, ProfiledCloseDmaUart);
+    DEWEPXI_PROFILE_FUNCTION(DeWeSetChannelPropDmaUart, profiledSetChannelPropDmaUart, ProfiledSetChannelPropDmaUart);
+    DEWEPXI_PROFILE_FUNCTION(DeWeStartDmaUart, profiledStartDmaUart, ProfiledStartDmaUart);
+    DEWEPXI_PROFILE_FUNCTION(DeWeStopDmaUart, profiledStopDmaUart, ProfiledStopDmaUart);
+
+    if (!at_exit)
+    {
+        atexit(profilerAtExit);
+        at_exit = 1;
+    }
+}
+
+/**
+ * Write the trace, called by DeWePxiUnload after DeWeDriverDeInit.
+ */
+static void profilerUninstall(void)
+{
+    ProfilerActive = 0;
+    profilerWrite();
+}
+
+#undef DEWEPXI_PROFILE_FUNCTION
+
+#endif // DEWEPXI_API_PROFILER && !STATIC_DLL
+
+#endif //__DEWE_PXI_PROFILER_H__
@@ -0,0 +1,518 @@
+// Copyright DEWETRON 2024
+// Exported DeWe* functions of the simulation driver
+
+#include "dewepxi_apicore.h"
+#include "dewepxi_sim_board.h"
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+
+namespace
+{
+    const uint32 DEFAULT_BOARDS = 1;
+    const uint32 DEFAULT_AI_CHANNELS = 8;
+    const uint32 MAX_BOARDS = 64;
+    const uint32 MAX_AI_CHANNELS = 64;
+
+    std::mutex g_mutex;
+    std::vector<std::unique_ptr<trion::SimBoard>> g_boards;
+
+    uint32 envValue(const char* name, uint32 default_value, uint32 max_value)
+    {
+        const char* text = std::getenv(name);
+        if (!text || !*text)
+        {
+            return default_value;
+        }
+        const long value = std::strtol(text, nullptr, 10);
+        return value < 0 ? 0 : (static_cast<unsigned long>(value) > max_value ? max_value : static_cast<uint32>(value));
+    }
+
+    trion::SimBoard* findBoard(int board_no)
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        return board_no >= 0 && static_cast<size_t>(board_no) < g_boards.size() ? g_boards[board_no].get() : nullptr;
+    }
+
+    std::string toLower(const char* text)
+    {
+        std::string lower(text ? text : "");
+        for (char& c : lower)
+        {
+            c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        }
+        return lower;
+    }
+
+    /**
+     * Split "BoardID3/AI0" into board 3 and the lower case target "ai0".
+     * @return false if the target does not address a board
+     */
+    bool splitTarget(const char* target, int& board_no, std::string& board_target)
+    {
+        const std::string lower = toLower(target);
+        if (lower.compare(0, 7, "boardid") != 0 || lower.size() == 7 || !std::isdigit(static_cast<unsigned char>(lower[7])))
+        {
+            return false;
+        }
+        board_no = std::atoi(lower.c_str() + 7);
+        const size_t slash = lower.find('/');
+        board_target = slash == std::string::npos ? std::string() : lower.substr(slash + 1);
+        return true;
+    }
+
+    int copyString(const std::string& value, char* val, uint32 val_size)
+    {
+        if (!val || val_size == 0)
+        {
+            return ERROR_BUFFER_TOO_SMALL;
+        }
+        const size_t length = value.size() < val_size ? value.size() : val_size - 1;
+        std::memcpy(val, value.data(), length);
+        val[length] = 0;
+        return value.size() < val_size ? ERR_NONE : ERROR_BUFFER_TOO_SMALL;
+    }
+
+    int getItem(const char* target, const char* command, std::string& value)
+    {
+        int board_no = 0;
+        std::string board_target;
+        if (!splitTarget(target, board_no, board_target))
+        {
+            return WARNING_FUNCTION_NOT_IMPLEMENTED;
+        }
+        trion::SimBoard* board = findBoard(board_no);
+        return board ? board->getItem(board_target, toLower(command), value) : ERR_BOARD_NOT_FOUND;
+    }
+
+    /**
+     * Commands addressing all boards.
+     */
+    int setParamAll(uint32 command)
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        for (auto& board : g_boards)
+        {
+            if (command == CMD_RESET_BOARD_ALL)
+            {
+                board->setParam(CMD_RESET_BOARD, 0);
+            }
+            else if (command == CMD_CLOSE_BOARD_ALL)
+            {
+                board->setParam(CMD_STOP_ACQUISITION, 0);
+            }
+        }
+        return ERR_NONE;
+    }
+
+    struct ErrorName
+    {
+        int code;
+        const char* name;
+    };
+
+    const ErrorName ERROR_NAMES[] =
+    {
+#define TRION_CONSTS_BEGIN
+#define TRION_CONSTS_END
+#define TRION_ERROR(name, val) { val, "ERR_" #name },
+#define TRION_ERROR2(name, val) { val, "ERROR_" #name },
+#define TRION_WARNING(name, val) { val, "WARNING_" #name },
+#include "dewepxi_err.inc"
+#undef TRION_CONSTS_BEGIN
+#undef TRION_CONSTS_END
+#undef TRION_ERROR
+#undef TRION_ERROR2
+#undef TRION_WARNING
+    };
+}
+
+
+extern "C"
+{
+
+// Driver Init
+int RT_IMPORT DeWeDriverInit(int *nNumOfBoard)
+{
+    std::lock_guard<std::mutex> lock(g_mutex);
+    if (g_boards.empty())
+    {
+        // Board 0 is the chassis controller
+        const uint32 boards = envValue("DEWEPXI_SIM_BOARDS", DEFAULT_BOARDS, MAX_BOARDS);
+        const uint32 ai_channels = envValue("DEWEPXI_SIM_AI", DEFAULT_AI_CHANNELS, MAX_AI_CHANNELS);
+        g_boards.emplace_back(new trion::SimBoard(0, 0));
+        for (uint32 i = 1; i <= boards; ++i)
+        {
+            g_boards.emplace_back(new trion::SimBoard(static_cast<int>(i), ai_channels));
+        }
+    }
+    if (nNumOfBoard)
+    {
+        // Negative: simulation
+        *nNumOfBoard = -static_cast<int>(g_boards.size());
+    }
+    return ERR_NONE;
+}
+
+int RT_IMPORT DeWeDriverDeInit( void )
+{
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_boards.clear();
+    return ERR_NONE;
+}
+
+// _i32 functions
+int RT_IMPORT DeWeGetParam_i32(int board_no, unsigned int command_id, sint32 *val)
+{
+    sint64 value = 0;
+    int err = DeWeGetParam_i64(board_no, command_id, &value);
+    if (val)
+    {
+        *val = static_cast<sint32>(value);
+    }
+    return err;
+}
+
+int RT_IMPORT DeWeSetParam_i32(int board_no, unsigned int command_id, sint32 val)
+{
+    return DeWeSetParam_i64(board_no, command_id, val);
+}
+
+// _i64 functions
+int RT_IMPORT DeWeGetParam_i64(int board_no, unsigned int command_id, sint64 *val)
+{
+    if (!val)
+    {
+        return ERR_INVALID_VALUE;
+    }
+    *val = 0;
+    trion::SimBoard* board = findBoard(board_no);
+    return board ? board->getParam(command_id, *val) : ERR_BOARD_NOT_FOUND;
+}
+
+int RT_IMPORT DeWeSetParam_i64(int board_no, unsigned int command_id, sint64 val)
+{
+    if (command_id == CMD_OPEN_BOARD_ALL || command_id == CMD_CLOSE_BOARD_ALL || command_id == CMD_RESET_BOARD_ALL)
+    {
+        return setParamAll(command_id);
+    }
+    trion::SimBoard* board = findBoard(board_no);
+    return board ? board->setParam(command_id, val) : ERR_BOARD_NOT_FOUND;
+}
+
+// string based functions
+int RT_IMPORT DeWeSetParamStruct_str (const char *target, const char *command, const char *val)
+{
+    int board_no = 0;
+    std::string board_target;
+    if (!splitTarget(target, board_no, board_target))
+    {
+        // Driver wide settings are accepted without effect
+        return ERR_NONE;
+    }
+    trion::SimBoard* board = findBoard(board_no);
+    return board ? board->setItem(board_target, toLower(command), val ? val : "") : ERR_BOARD_NOT_FOUND;
+}
+
+int RT_IMPORT DeWeGetParamStruct_str (const char *target, const char *command, char *val, uint32 num)
+{
+    std::string value;
+    int err = getItem(target, command, value);
+    if (err > 0)
+    {
+        return err;
+    }
+    int copy_err = copyString(value, val, num);
+    return copy_err > 0 ? copy_err : err;
+}
+
+int RT_IMPORT DeWeGetParamStruct_strLEN( const char	*target, const char	*command, uint32 *val_size)
+{
+    std::string value;
+    int err = getItem(target, command, value);
+    if (val_size)
+    {
+        *val_size = static_cast<uint32>(value.size() + 1);
+    }
+    return err;
+}
+
+int RT_IMPORT DeWeGetParamStructEx_str (const char *target, const char *command, const char *arg, char *val, uint32 val_size)
+{
+    (void)arg;
+    return DeWeGetParamStruct_str(target, command, val, val_size);
+}
+
+int RT_IMPORT DeWeSetParamXML_str (const char *target, const char *command, const char *val)
+{
+    (void)target;
+    (void)command;
+    (void)val;
+    return WARNING_FUNCTION_NOT_IMPLEMENTED;
+}
+
+int RT_IMPORT DeWeGetParamXML_str (const char *target, const char *command, char *val, uint32 num)
+{
+    (void)target;
+    (void)command;
+    copyString(std::string(), val, num);
+    return WARNING_FUNCTION_NOT_IMPLEMENTED;
+}
+
+int RT_IMPORT DeWeGetParamXML_strLEN( const char *target, const char *command, uint32 *val_size)
+{
+    (void)target;
+    (void)command;
+    if (val_size)
+    {
+        *val_size = 1;
+    }
+    return WARNING_FUNCTION_NOT_IMPLEMENTED;
+}
+
+// CAN functions
+int RT_IMPORT DeWeOpenCAN(int board_no)
+{
+    trion::SimBoard* board = findBoard(board_no);
+    return board ? board->openCan(true) : ERR_BOARD_NOT_FOUND;
+}
+
+int RT_IMPORT DeWeCloseCAN(int board_no)
+{
+    trion::SimBoard* board = findBoard(board_no);
+    return board ? board->openCan(false) : ERR_BOARD_NOT_FOUND;
+}
+
+int RT_IMPORT DeWeGetChannelPropCAN(int board_no, int nChannelNo, PBOARD_CAN_CHANNEL_PROP pProp)
+{
+    (void)nChannelNo;
+    if (pProp)
+    {
+        pProp->_deprecated = 0;
+    }
+    return findBoard(board_no) ? ERR_NONE : ERR_BOARD_NOT_FOUND;
+}
+
+int RT_IMPORT DeWeSetChannelPropCAN(int board_no, int nChannelNo, BOARD_CAN_CHANNEL_PROP rProp)
+{
+    (void)nChannelNo;
+    (void)rProp;
+    return findBoard(board_no) ? ERR_NONE : ERR_BOARD_NOT_FOUND;
+}
+
+int RT_IMPORT DeWeStartCAN(int board_no, int nChannelNo)
+{
+    trion::SimBoard* board = findBoard(board_no);
+    return board ? board->startCan(nChannelNo, true) : ERR_BOARD_NOT_FOUND;
+}
+
+int RT_IMPORT DeWeStopCAN(int board_no, int nChannelNo)
+{
+    trion::SimBoard* board = findBoard(board_no);
+    return board ? board->startCan(nChannelNo, false) : ERR_BOARD_NOT_FOUND;
+}
+
+int RT_IMPORT DeWeFreeFramesCAN(int board_no, int nFrameCount)
+{
+    trion::SimBoard* board = findBoard(board_no);
+    return board ? board->freeCan(nFrameCount) : ERR_BOARD_NOT_FOUND;
+}
+
+int RT_IMPORT DeWeErrorCntCAN(int board_no, int nChannelNo, int *nErrorCount)
+{
+    int count = 0;
+    trion::SimBoard* board = findBoard(board_no);
+    int err = board ? board->errorCountCan(nChannelNo, count) : ERR_BOARD_NOT_FOUND;
+    if (nErrorCount)
+    {
+        *nErrorCount = count;
+    }
+    return err;
+}
+
+// CAN Read/Write
+int RT_IMPORT DeWeReadCAN(int board_no, PBOARD_CAN_FRAME pCanFrames, int nMaxFrameCount, int* nRealFrameCount)
+{
+    int count = 0;
+    trion::SimBoard* board = findBoard(board_no);
+    int err = board ? board->readCan(pCanFrames, nMaxFrameCount, count) : ERR_BOARD_NOT_FOUND;
+    if (nRealFrameCount)
+    {
+        *nRealFrameCount = count;
+    }
+    return err;
+}
+
+int RT_IMPORT DeWeReadCANRawFrame(int board_no, PBOARD_CAN_RAW_FRAME* pCanFrames, int* nRealFrameCount)
+{
+    int count = 0;
+    trion::SimBoard* board = findBoard(board_no);
+    int err = board && pCanFrames ? board->readCanRaw(pCanFrames, count) : ERR_BOARD_NOT_FOUND;
+    if (nRealFrameCount)
+    {
+        *nRealFrameCount = count;
+    }
+    return err;
+}
+
+int RT_IMPORT DeWeWriteCAN(int board_no, PBOARD_CAN_FRAME pCanFrames, int nFrameCount, int* nRealFrameCount)
+{
+    // Sent frames are discarded
+    (void)pCanFrames;
+    if (nRealFrameCount)
+    {
+        *nRealFrameCount = findBoard(board_no) ? nFrameCount : 0;
+    }
+    return findBoard(board_no) ? ERR_NONE : ERR_BOARD_NOT_FOUND;
+}
+
+// CAN FD Read/Write
+int RT_IMPORT DeWeReadCANEx(int board_no, BOARD_CAN_FD_FRAME* pCanFrames, int nMaxFrameCount, int *nRealFrameCount)
+{
+    int count = 0;
+    trion::SimBoard* board = findBoard(board_no);
+    int err = board ? board->readCan(pCanFrames, nMaxFrameCount, count) : ERR_BOARD_NOT_FOUND;
+    if (nRealFrameCount)
+    {
+        *nRealFrameCount = count;
+    }
+    return err;
+}
+
+int RT_IMPORT DeWeReadCANRawFrameEx(int board_no, PBOARD_CAN_FD_RAW_FRAME* pCanFrames, int nMaxFrameCount, int *nRealFrameCount)
+{
+    // The loaded function (PDEWEREADCANRAWFRAMEEX) fills a frame array, unlike the static prototype
+    BOARD_CAN_FD_RAW_FRAME* frames = reinterpret_cast<BOARD_CAN_FD_RAW_FRAME*>(pCanFrames);
+    int count = 0;
+    trion::SimBoard* board = findBoard(board_no);
+    int err = board ? board->readCan(frames, nMaxFrameCount, count) : ERR_BOARD_NOT_FOUND;
+    if (nRealFrameCount)
+    {
+        *nRealFrameCount = count;
+    }
+    return err;
+}
+
+int RT_IMPORT DeWeWriteCANEx(int board, BOARD_CAN_FD_FRAME* frames, int max_frame_cnt, int* frame_cnt)
+{
+    (void)frames;
+    if (frame_cnt)
+    {
+        *frame_cnt = findBoard(board) ? max_frame_cnt : 0;
+    }
+    return findBoard(board) ? ERR_NONE : ERR_BOARD_NOT_FOUND;
+}
+
+int RT_IMPORT DeWeReadCANNg(int board_no, BOARD_CAN_FD_FRAME_NG* pCanFrames, int nMaxFrameCount, int *nRealFrameCount)
+{
+    int count = 0;
+    trion::SimBoard* board = findBoard(board_no);
+    int err = board ? board->readCan(pCanFrames, nMaxFrameCount, count) : ERR_BOARD_NOT_FOUND;
+    if (nRealFrameCount)
+    {
+        *nRealFrameCount = count;
+    }
+    return err;
+}
+
+// Asynchronous channel(UART) functions
+int RT_IMPORT DeWeOpenDmaUart(int board_no)
+{
+    trion::SimBoard* board = findBoard(board_no);
+    return board ? board->openUart(true) : ERR_BOARD_NOT_FOUND;
+}
+
+int RT_IMPORT DeWeCloseDmaUart(int board_no)
+{
+    trion::SimBoard* board = findBoard(board_no);
+    return board ? board->openUart(false) : ERR_BOARD_NOT_FOUND;
+}
+
+int RT_IMPORT DeWeGetChannelPropDmaUart(int board_no, int nChannelNo, PBOARD_UART_CHANNEL_PROP pProp)
+{
+    (void)nChannelNo;
+    if (pProp)
+    {
+        pProp->_deprecated = 0;
+    }
+    return findBoard(board_no) ? ERR_NONE : ERR_BOARD_NOT_FOUND;
+}
+
+int RT_IMPORT DeWeSetChannelPropDmaUart(int board_no, int nChannelNo, BOARD_UART_CHANNEL_PROP rProp)
+{
+    (void)nChannelNo;
+    (void)rProp;
+    return findBoard(board_no) ? ERR_NONE : ERR_BOARD_NOT_FOUND;
+}
+
+int RT_IMPORT DeWeStartDmaUart(int board_no, int nChannelNo)
+{
+    trion::SimBoard* board = findBoard(board_no);
+    return board ? board->startUart(nChannelNo, true) : ERR_BOARD_NOT_FOUND;
+}
+
+int RT_IMPORT DeWeStopDmaUart(int board_no, int nChannelNo)
+{
+    trion::SimBoard* board = findBoard(board_no);
+    return board ? board->startUart(nChannelNo, false) : ERR_BOARD_NOT_FOUND;
+}
+
+int RT_IMPORT DeWeReadDmaUart(int board_no, PBOARD_UART_FRAME pUartFrames, int nMaxFrameCount, int *nRealFrameCount)
+{
+    int count = 0;
+    trion::SimBoard* board = findBoard(board_no);
+    int err = board ? board->readUart(pUartFrames, nMaxFrameCount, count) : ERR_BOARD_NOT_FOUND;
+    if (nRealFrameCount)
+    {
+        *nRealFrameCount = count;
+    }
+    return err;
+}
+
+int RT_IMPORT DeWeReadDmaUartRawFrame(int board_no, PBOARD_UART_RAW_FRAME *pUartFrames, int *nRealFrameCount)
+{
+    int count = 0;
+    trion::SimBoard* board = findBoard(board_no);
+    int err = board && pUartFrames ? board->readUartRaw(pUartFrames, count) : ERR_BOARD_NOT_FOUND;
+    if (nRealFrameCount)
+    {
+        *nRealFrameCount = count;
+    }
+    return err;
+}
+
+int RT_IMPORT DeWeFreeDmaUartRawFrame(int board_no, int nFrameCount)
+{
+    trion::SimBoard* board = findBoard(board_no);
+    return board ? board->freeUart(nFrameCount) : ERR_BOARD_NOT_FOUND;
+}
+
+int RT_IMPORT DeWeWriteDmaUart(int board_no, PBOARD_UART_FRAME pUartFrames, int nFrameCount, int *nRealFrameCount)
+{
+    (void)pUartFrames;
+    if (nRealFrameCount)
+    {
+        *nRealFrameCount = findBoard(board_no) ? nFrameCount : 0;
+    }
+    return findBoard(board_no) ? ERR_NONE : ERR_BOARD_NOT_FOUND;
+}
+
+// Obtain readable ErrorMessage from ErrorCode
+const char* RT_IMPORT DeWeErrorConstantToString ( int nErrorCode )
+{
+    for (const ErrorName& error : ERROR_NAMES)
+    {
+        if (error.code == nErrorCode)
+        {
+            return error.name;
+        }
+    }
+    return "Unknown error";
+}
+
+}
@@ -0,0 +1,1411 @@
+// Copyright DEWETRON 2024
+
+#include "dewepxi_sim_board.h"
+#include "dewepxi_const.h"
+#include "dewepxi_err.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+
+namespace trion
+{
+    namespace
+    {
+        const double DEFAULT_SAMPLE_RATE = 2000.0;
+        const uint32 DEFAULT_BLOCK_SIZE = 200;
+        const uint32 DEFAULT_BLOCK_COUNT = 50;
+        const double DEFAULT_RANGE = 10.0;
+        const double DEFAULT_AMPLITUDE = 0.8;
+        const double DEFAULT_CAN_FRAME_RATE = 1000.0;
+        const double DEFAULT_UART_CHAR_RATE = 960.0;    // 9600 baud
+
+        const uint32 SINE_TABLE_BITS = 12;
+        const sint32 FULL_SCALE_LSB = 0x7fffff;         // 24 bit samples
+        const uint32 COUNTER_SLOT = ~0u;
+
+        const int CAN_CHANNELS = 2;
+        const int UART_CHANNELS = 1;
+        const size_t MAX_PENDING_FRAMES = 65536;
+        const uint32 WAIT_TIMEOUT_MS = 100;
+
+        uint64 steadyNs()
+        {
+            return static_cast<uint64>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count());
+        }
+
+        uint64 systemNs()
+        {
+            return static_cast<uint64>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count());
+        }
+
+        std::string toLower(std::string text)
+        {
+            for (char& c : text)
+            {
+                c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+            }
+            return text;
+        }
+
+        bool parseBool(const std::string& value, bool& result)
+        {
+            const std::string lower = toLower(value);
+            if (lower == "true" || lower == "1")
+            {
+                result = true;
+                return true;
+            }
+            if (lower == "false" || lower == "0")
+            {
+                result = false;
+                return true;
+            }
+            return false;
+        }
+
+        /**
+         * Leading number of a value like "10 V".
+         */
+        bool parseNumber(const std::string& value, double& result)
+        {
+            char* end = nullptr;
+            const double number = std::strtod(value.c_str(), &end);
+            if (end == value.c_str() || !std::isfinite(number))
+            {
+                return false;
+            }
+            result = number;
+            return true;
+        }
+
+        std::string formatNumber(double value)
+        {
+            char buffer[64];
+            std::snprintf(buffer, sizeof(buffer), "%.17g", value);
+            return buffer;
+        }
+
+        /**
+         * Index of a channel target like "ai3", -1 if the prefix does not match.
+         */
+        int channelIndex(const std::string& target, const char* prefix)
+        {
+            const size_t length = std::strlen(prefix);
+            if (target.compare(0, length, prefix) != 0 || target.size() == length
+                || !std::isdigit(static_cast<unsigned char>(target[length])))
+            {
+                return -1;
+            }
+            return std::atoi(target.c_str() + length);
+        }
+
+        uint64 mix(uint64 x)
+        {
+            // splitmix64 finalizer
+            x += 0x9e3779b97f4a7c15ull;
+            x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+            x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+            return x ^ (x >> 31);
+        }
+
+        bool isLeapYear(uint64 year)
+        {
+            return (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+        }
+
+        /**
+         * Legacy CMD_BUFFER_* commands address buffer 0.
+         */
+        uint32 bufferZeroCommand(uint32 command)
+        {
+            switch (command)
+            {
+            case CMD_BUFFER_BLOCK_SIZE: return CMD_BUFFER_0_BLOCK_SIZE;
+            case CMD_BUFFER_BLOCK_COUNT: return CMD_BUFFER_0_BLOCK_COUNT;
+            case CMD_BUFFER_START_POINTER: return CMD_BUFFER_0_START_POINTER;
+            case CMD_BUFFER_END_POINTER: return CMD_BUFFER_0_END_POINTER;
+            case CMD_BUFFER_TOTAL_MEM_SIZE: return CMD_BUFFER_0_TOTAL_MEM_SIZE;
+            case CMD_BUFFER_CLEAR_ERROR: return CMD_BUFFER_0_CLEAR_ERROR;
+            case CMD_BUFFER_AVAIL_NO_SAMPLE: return CMD_BUFFER_0_AVAIL_NO_SAMPLE;
+            case CMD_BUFFER_ACT_SAMPLE_POS: return CMD_BUFFER_0_ACT_SAMPLE_POS;
+            case CMD_BUFFER_FREE_NO_SAMPLE: return CMD_BUFFER_0_FREE_NO_SAMPLE;
+            case CMD_BUFFER_ONE_SCAN_SIZE: return CMD_BUFFER_0_ONE_SCAN_SIZE;
+            case CMD_BUFFER_WAIT_AVAIL_NO_SAMPLE: return CMD_BUFFER_0_WAIT_AVAIL_NO_SAMPLE;
+            default: return command;
+            }
+        }
+
+        bool isBufferCommand(uint32 command)
+        {
+            return command >= CMD_BUFFER_0_BLOCK_SIZE && command < CMD_BUFFER_0_BLOCK_SIZE + 0x0100;
+        }
+
+        struct TimingStateName
+        {
+            const char* name;
+            sint32 state;
+        };
+
+        const TimingStateName TIMING_STATE_NAMES[] =
+        {
+            { "locked", TIMINGSTATE_LOCKED },
+            { "notresynced", TIMINGSTATE_NOTRESYNCED },
+            { "unlocked", TIMINGSTATE_UNLOCKED },
+            { "lockedoor", TIMINGSTATE_LOCKEDOOR },
+            { "timeerror", TIMINGSTATE_TIMEERROR },
+            { "relockoor", TIMINGSTATE_RELOCKOOR },
+            { "notimingmode", TIMINGSTATE_NOTIMINGMODE },
+        };
+    }
+
+
+    SimBoard::SimBoard(int board_id, uint32 ai_channels)
+        : m_board_id(board_id)
+        , m_state_generation(0)
+        , m_channels(ai_channels)
+    {
+        reset();
+    }
+
+    void SimBoard::reset()
+    {
+        m_items.clear();
+        for (size_t i = 0; i < m_channels.size(); ++i)
+        {
+            SimChannel& channel = m_channels[i];
+            channel.used = false;
+            channel.waveform = SIM_WAVEFORM_SINE;
+            channel.frequency = 10.0 * static_cast<double>(i + 1);
+            channel.amplitude = DEFAULT_AMPLITUDE;
+            channel.range = DEFAULT_RANGE;
+        }
+        m_board_counter = false;
+        m_sample_rate = DEFAULT_SAMPLE_RATE;
+        m_block_size = DEFAULT_BLOCK_SIZE;
+        m_block_count = DEFAULT_BLOCK_COUNT;
+        m_adc_delay = 0;
+
+        m_realtime = true;
+        m_overrun_period = 0;
+        m_pending_loss = 0;
+        m_timing_state = TIMINGSTATE_LOCKED;
+        m_timing_loss_period = 0;
+        m_timing_loss_duration = 0;
+        m_can_frame_rate = DEFAULT_CAN_FRAME_RATE;
+        m_uart_char_rate = DEFAULT_UART_CHAR_RATE;
+        m_start_time = 0.0;
+
+        m_mem.clear();
+        m_slots.clear();
+        m_scan_words = 0;
+
+        m_running = false;
+        m_start_ns = 0;
+        m_start_utc_ns = 0;
+        m_clock = 0;
+        m_written = 0;
+        m_freed = 0;
+        m_lost = 0;
+        m_next_overrun = 0;
+        m_overrun = false;
+        m_latched_sample = 0;
+
+        m_can_open = false;
+        m_can_started = 0;
+        m_can_next = 0;
+        m_can_errors = 0;
+        m_can.clear();
+
+        m_uart_open = false;
+        m_uart_started = 0;
+        m_uart_next = 0;
+        m_uart_sentence.clear();
+        m_uart_sentences = 0;
+        m_uart.clear();
+
+        ++m_state_generation;
+        m_state_cv.notify_all();
+    }
+
+
+    int SimBoard::setParam(uint32 command, sint64 value)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        command = bufferZeroCommand(command);
+
+        switch (command)
+        {
+        case CMD_RESET_BOARD:
+            reset();
+            return ERR_NONE;
+        case CMD_START_ACQUISITION:
+            return startAcquisition();
+        case CMD_STOP_ACQUISITION:
+            stopAcquisition();
+            return ERR_NONE;
+        case CMD_UPDATE_PARAM_ALL:
+        case CMD_UPDATE_PARAM_ACQ_ALL:
+        case CMD_UPDATE_PARAM_ACQ:
+        case CMD_UPDATE_PARAM_ACQ_SR:
+        case CMD_UPDATE_PARAM_ACQ_BUFFER:
+        case CMD_UPDATE_PARAM_AI:
+        case CMD_UPDATE_PARAM_BOARD_CNT:
+            return configureBuffer();
+        case CMD_CAN_OPEN:
+        case CMD_CAN_CLOSE:
+            m_can_open = command == CMD_CAN_OPEN;
+            return ERR_NONE;
+        default:
+            break;
+        }
+
+        if (isBufferCommand(command))
+        {
+            return bufferParam(command, true, value);
+        }
+
+        // Accepted without effect, like the settings of other channel types
+        return ERR_NONE;
+    }
+
+    int SimBoard::getParam(uint32 command, sint64& value)
+    {
+        value = 0;
+        command = bufferZeroCommand(command);
+        if (command == CMD_BUFFER_0_WAIT_AVAIL_NO_SAMPLE)
+        {
+            return waitAvailable(value);
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        advance();
+
+        switch (command)
+        {
+        case CMD_START_ACQUISITION:
+            value = m_running ? 1 : 0;
+            return ERR_NONE;
+        case CMD_ACT_SAMPLE_COUNT:
+        case CMD_BOARD_ACT_SAMPLE_COUNT:
+            value = static_cast<sint64>(m_clock);
+            return ERR_NONE;
+        case CMD_BOARD_ADC_DELAY:
+            value = m_adc_delay;
+            return ERR_NONE;
+        case CMD_TIMING_STATE:
+            value = timingState(m_clock);
+            return ERR_NONE;
+        case CMD_TIMING_TIME:
+            // Latch the time for AcqProp/Timing/SystemTime, returns the sample count of the latch
+            m_latched_sample = m_clock;
+            value = static_cast<sint64>(m_latched_sample);
+            return ERR_NONE;
+        default:
+            break;
+        }
+
+        if (isBufferCommand(command))
+        {
+            return bufferParam(command, false, value);
+        }
+        return WARNING_FUNCTION_NOT_IMPLEMENTED;
+    }
+
+    int SimBoard::bufferParam(uint32 command, bool set, sint64& value)
+    {
+        if (command >= CMD_BUFFER_0_BLOCK_SIZE + 0x0020)
+        {
+            return ERR_BUFFER_NOT_SUPPORTED;
+        }
+        if (isController())
+        {
+            return ERR_BUFFER_NOT_ASSIGNED;
+        }
+
+        const sint64 start = reinterpret_cast<sint64>(m_mem.data());
+        const sint64 scan_size = static_cast<sint64>(m_scan_words) * 4;
+
+        if (set)
+        {
+            switch (command)
+            {
+            case CMD_BUFFER_0_BLOCK_SIZE:
+            case CMD_BUFFER_0_BLOCK_COUNT:
+                if (value <= 0 || value > 0x100000)
+                {
+                    return command == CMD_BUFFER_0_BLOCK_SIZE ? ERR_INVALID_VALUE : ERR_BUFFER_INVALID_BLOCK_COUNT;
+                }
+                if (command == CMD_BUFFER_0_BLOCK_SIZE)
+                {
+                    m_block_size = static_cast<uint32>(value);
+                }
+                else
+                {
+                    m_block_count = static_cast<uint32>(value);
+                }
+                return ERR_NONE;
+            case CMD_BUFFER_0_FREE_NO_SAMPLE:
+                if (value < 0 || static_cast<uint64>(value) > available())
+                {
+                    return ERR_BUFFER_INVALID_FREE_POS;
+                }
+                m_freed += static_cast<uint64>(value);
+                return ERR_NONE;
+            case CMD_BUFFER_0_CLEAR_ERROR:
+                // Continue behind the overrun, the buffered scans are discarded
+                m_overrun = false;
+                m_freed = m_written;
+                return ERR_NONE;
+            default:
+                return ERR_NONE;
+            }
+        }
+
+        switch (command)
+        {
+        case CMD_BUFFER_0_BLOCK_SIZE:
+            value = m_block_size;
+            return ERR_NONE;
+        case CMD_BUFFER_0_BLOCK_COUNT:
+            value = m_block_count;
+            return ERR_NONE;
+        case CMD_BUFFER_0_START_POINTER:
+            value = start;
+            return ERR_NONE;
+        case CMD_BUFFER_0_END_POINTER:
+            value = start + static_cast<sint64>(m_mem.size()) * 4;
+            return ERR_NONE;
+        case CMD_BUFFER_0_TOTAL_MEM_SIZE:
+            value = static_cast<sint64>(m_mem.size()) * 4;
+            return ERR_NONE;
+        case CMD_BUFFER_0_ONE_SCAN_SIZE:
+            value = scan_size;
+            return ERR_NONE;
+        case CMD_BUFFER_0_AVAIL_NO_SAMPLE:
+            value = available();
+            return m_overrun ? ERR_BUFFER_OVERWRITE : ERR_NONE;
+        case CMD_BUFFER_0_ACT_SAMPLE_POS:
+            value = m_mem.empty() ? 0 : start + static_cast<sint64>(m_freed % ringCapacity()) * scan_size;
+            return ERR_NONE;
+        case CMD_BUFFER_0_WRITE_SAMPLE_POS:
+            value = m_mem.empty() ? 0 : start + static_cast<sint64>(m_written % ringCapacity()) * scan_size;
+            return ERR_NONE;
+        case CMD_BUFFER_0_AVAIL_FREE_MEM:
+            value = static_cast<sint64>(ringCapacity() - available()) * scan_size;
+            return ERR_NONE;
+        case CMD_BUFFER_0_SAMPLE_COUNT:
+            value = static_cast<sint64>(m_written);
+            return ERR_NONE;
+        case CMD_BUFFER_0_BOARD_MEM_SIZE:
+        case CMD_BUFFER_0_FREE_BOARD_MEM_SIZE:
+        case CMD_BUFFER_0_NUM_SAMPLES_IN_BOARD_MEM:
+            // No memory on the board, the scans go to the buffer directly
+            value = 0;
+            return ERR_NONE;
+        default:
+            return WARNING_FUNCTION_NOT_IMPLEMENTED;
+        }
+    }
+
+    int SimBoard::waitAvailable(sint64& value)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (isController())
+        {
+            return ERR_BUFFER_NOT_ASSIGNED;
+        }
+
+        const uint64 generation = m_state_generation;
+        const auto timeout = std::chrono::steady_clock::now() + std::chrono::milliseconds(WAIT_TIMEOUT_MS);
+        advance();
+
+        // Sleep until the scans completing the next block are due
+        while (m_running && m_realtime && !m_overrun && available() < m_block_size)
+        {
+            const uint64 due = m_clock + (m_block_size - available());
+            const uint64 due_ns = m_start_ns + static_cast<uint64>(static_cast<double>(due) * 1e9 / m_sample_rate);
+            const uint64 now_ns = steadyNs();
+            auto wake = std::chrono::steady_clock::now() + std::chrono::nanoseconds(due_ns > now_ns ? due_ns - now_ns : 0);
+            if (wake > timeout)
+            {
+                wake = timeout;
+            }
+            m_state_cv.wait_until(lock, wake, [&]() { return m_state_generation != generation; });
+            advance();
+            if (m_state_generation != generation || std::chrono::steady_clock::now() >= timeout)
+            {
+                break;
+            }
+        }
+
+        if (!m_running && available() == 0 && m_state_generation == generation)
+        {
+            // Nothing will arrive, wait like the driver does before its timeout
+            m_state_cv.wait_until(lock, timeout, [&]() { return m_state_generation != generation; });
+        }
+
+        value = available();
+        return m_overrun ? ERR_BUFFER_OVERWRITE : ERR_NONE;
+    }
+
+
+    int SimBoard::setItem(const std::string& target, const std::string& item, const std::string& value)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if (target == "acqprop" && item == "samplerate")
+        {
+            double rate = 0.0;
+            if (!parseNumber(value, rate) || rate <= 0.0)
+            {
+                return ERR_INVALID_VALUE;
+            }
+            if (m_running)
+            {
+                return ERR_BOARD_ALREADY_STARTED;
+            }
+            m_sample_rate = rate;
+            return ERR_NONE;
+        }
+
+        if (target == "sim")
+        {
+            return applySimItem(item, value);
+        }
+
+        if (target == "boardcnt0" && item == "used")
+        {
+            bool used = false;
+            if (!parseBool(value, used))
+            {
+                return ERR_INVALID_VALUE;
+            }
+            m_board_counter = used;
+            return ERR_NONE;
+        }
+
+        if (target == "aiall")
+        {
+            for (SimChannel& channel : m_channels)
+            {
+                int err = applyChannelItem(channel, item, value);
+                if (err > 0)
+                {
+                    return err;
+                }
+            }
+            return ERR_NONE;
+        }
+
+        const int index = channelIndex(target, "ai");
+        if (index >= 0)
+        {
+            if (static_cast<size_t>(index) >= m_channels.size())
+            {
+                return ERR_INVALID_CHANNEL_NO;
+            }
+            return applyChannelItem(m_channels[index], item, value);
+        }
+
+        m_items[target + "/" + item] = value;
+        return ERR_NONE;
+    }
+
+    int SimBoard::applyChannelItem(SimChannel& channel, const std::string& item, const std::string& value)
+    {
+        if (m_running && (item == "used" || item == "range"))
+        {
+            return ERR_BOARD_ALREADY_STARTED;
+        }
+
+        if (item == "used")
+        {
+            return parseBool(value, channel.used) ? ERR_NONE : ERR_INVALID_VALUE;
+        }
+        if (item == "range")
+        {
+            double range = 0.0;
+            if (!parseNumber(value, range) || range <= 0.0)
+            {
+                return ERR_INVALID_VALUE;
+            }
+            channel.range = range;
+            return ERR_NONE;
+        }
+        if (item == "simwaveform")
+        {
+            const std::string lower = toLower(value);
+            if (lower == "sine") channel.waveform = SIM_WAVEFORM_SINE;
+            else if (lower == "square") channel.waveform = SIM_WAVEFORM_SQUARE;
+            else if (lower == "ramp") channel.waveform = SIM_WAVEFORM_RAMP;
+            else if (lower == "noise") channel.waveform = SIM_WAVEFORM_NOISE;
+            else if (lower == "dc") channel.waveform = SIM_WAVEFORM_DC;
+            else return ERR_INVALID_VALUE;
+            return ERR_NONE;
+        }
+        if (item == "simfrequency" || item == "simamplitude")
+        {
+            double number = 0.0;
+            if (!parseNumber(value, number) || number < 0.0 || (item == "simamplitude" && number > 1.0))
+            {
+                return ERR_INVALID_VALUE;
+            }
+            if (item == "simfrequency")
+            {
+                channel.frequency = number;
+            }
+            else
+            {
+                channel.amplitude = number;
+            }
+            return ERR_NONE;
+        }
+        // Eg Mode, Excitation: accepted without effect
+        return ERR_NONE;
+    }
+
+    int SimBoard::applySimItem(const std::string& item, const std::string& value)
+    {
+        if (item == "realtime")
+        {
+            if (m_running)
+            {
+                return ERR_BOARD_ALREADY_STARTED;
+            }
+            return parseBool(value, m_realtime) ? ERR_NONE : ERR_INVALID_VALUE;
+        }
+        if (item == "timingstate")
+        {
+            const std::string lower = toLower(value);
+            for (const TimingStateName& name : TIMING_STATE_NAMES)
+            {
+                if (lower == name.name)
+                {
+                    m_timing_state = name.state;
+                    return ERR_NONE;
+                }
+            }
+            double number = 0.0;
+            if (!parseNumber(value, number))
+            {
+                return ERR_INVALID_VALUE;
+            }
+            m_timing_state = static_cast<sint32>(number);
+            return ERR_NONE;
+        }
+
+        double number = 0.0;
+        if (!parseNumber(value, number) || number < 0.0)
+        {
+            return ERR_INVALID_VALUE;
+        }
+
+        if (item == "overrun")
+        {
+            // Lose the next scans as if the buffer had overflowed
+            m_pending_loss += static_cast<uint64>(number);
+            return ERR_NONE;
+        }
+        if (item == "overrunperiod")
+        {
+            const uint64 period = static_cast<uint64>(number);
+            if (period != 0 && period <= m_block_size)
+            {
+                return ERR_INVALID_VALUE;
+            }
+            m_overrun_period = period;
+            m_next_overrun = m_clock + period;
+            return ERR_NONE;
+        }
+        if (item == "timinglossperiod")
+        {
+            m_timing_loss_period = static_cast<uint64>(number);
+            return ERR_NONE;
+        }
+        if (item == "timinglossduration")
+        {
+            m_timing_loss_duration = static_cast<uint64>(number);
+            return ERR_NONE;
+        }
+        if (item == "canframerate")
+        {
+            m_can_frame_rate = number;
+            return ERR_NONE;
+        }
+        if (item == "uartcharrate")
+        {
+            m_uart_char_rate = number;
+            return ERR_NONE;
+        }
+        if (item == "starttime")
+        {
+            m_start_time = number;
+            return ERR_NONE;
+        }
+        if (item == "adcdelay")
+        {
+            m_adc_delay = static_cast<sint32>(number);
+            return ERR_NONE;
+        }
+        return ERR_INVALID_PARAM_ID;
+    }
+
+    int SimBoard::getItem(const std::string& target, const std::string& item, std::string& value)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        value.clear();
+
+        if (target.empty())
+        {
+            if (item == "scandescriptor_v3")
+            {
+                value = scanDescriptor();
+                return ERR_NONE;
+            }
+            if (item == "boardname")
+            {
+                value = isController() ? "TRION-SIM-CONTROLLER" : "TRION-SIM-" + std::to_string(m_channels.size()) + "AI";
+                return ERR_NONE;
+            }
+            if (item == "serialnumber")
+            {
+                value = "SIM" + std::to_string(m_board_id);
+                return ERR_NONE;
+            }
+        }
+
+        if (target == "acqprop" && item == "samplerate")
+        {
+            value = formatNumber(m_sample_rate);
+            return ERR_NONE;
+        }
+
+        if (target == "acqprop/timing/systemtime")
+        {
+            uint64 ns = sampleTimeNs(m_latched_sample);
+            uint64 days = ns / 86400000000000ull;
+            ns %= 86400000000000ull;
+            uint64 year = 1970;
+            while (days >= (isLeapYear(year) ? 366u : 365u))
+            {
+                days -= isLeapYear(year) ? 366 : 365;
+                ++year;
+            }
+            char buffer[64];
+            if (item == "year")
+            {
+                std::snprintf(buffer, sizeof(buffer), "%u", static_cast<unsigned>(year));
+            }
+            else if (item == "day")
+            {
+                std::snprintf(buffer, sizeof(buffer), "%u", static_cast<unsigned>(days + 1));
+            }
+            else if (item == "sec")
+            {
+                std::snprintf(buffer, sizeof(buffer), "%.9f", static_cast<double>(ns) * 1e-9);
+            }
+            else
+            {
+                return ERR_INVALID_PARAM_ID;
+            }
+            value = buffer;
+            return ERR_NONE;
+        }
+
+        if (target == "boardcnt0" && item == "used")
+        {
+            value = m_board_counter ? "True" : "False";
+            return ERR_NONE;
+        }
+
+        const int index = channelIndex(target, "ai");
+        if (index >= 0)
+        {
+            if (static_cast<size_t>(index) >= m_channels.size())
+            {
+                return ERR_INVALID_CHANNEL_NO;
+            }
+            const SimChannel& channel = m_channels[index];
+            if (item == "used")
+            {
+                value = channel.used ? "True" : "False";
+                return ERR_NONE;
+            }
+            if (item == "range")
+            {
+                value = formatNumber(channel.range) + " V";
+                return ERR_NONE;
+            }
+            if (item == "scalevalue")
+            {
+                value = formatNumber(channel.range / (FULL_SCALE_LSB + 1));
+                return ERR_NONE;
+            }
+            if (item == "scaleoffset")
+            {
+                value = "0";
+                return ERR_NONE;
+            }
+        }
+
+        auto found = m_items.find(target + "/" + item);
+        if (found != m_items.end())
+        {
+            value = found->second;
+            return ERR_NONE;
+        }
+        return WARNING_FUNCTION_NOT_IMPLEMENTED;
+    }
+
+
+    void SimBoard::configureChannel(SimChannel& channel)
+    {
+        // Phase increment modulo one period, exact for any sample index
+        const double cycles = channel.frequency / m_sample_rate;
+        const double fraction = cycles - std::floor(cycles);
+        channel.phase_step = static_cast<uint32>(std::min(fraction * 4294967296.0, 4294967295.0));
+        channel.amplitude_lsb = static_cast<sint32>(std::floor(channel.amplitude * FULL_SCALE_LSB + 0.5));
+
+        const uint32 size = 1u << SINE_TABLE_BITS;
+        channel.table.resize(size);
+        for (uint32 i = 0; i < size; ++i)
+        {
+            const double phase = 2.0 * 3.14159265358979323846 * i / size;
+            channel.table[i] = static_cast<sint32>(std::floor(std::sin(phase) * channel.amplitude_lsb + 0.5));
+        }
+    }
+
+    int SimBoard::configureBuffer()
+    {
+        if (m_running || isController())
+        {
+            return ERR_NONE;
+        }
+
+        m_slots.clear();
+        for (size_t i = 0; i < m_channels.size(); ++i)
+        {
+            if (m_channels[i].used)
+            {
+                configureChannel(m_channels[i]);
+                m_slots.push_back(static_cast<uint32>(i));
+            }
+        }
+        if (m_board_counter)
+        {
+            m_slots.push_back(COUNTER_SLOT);
+        }
+
+        m_scan_words = static_cast<uint32>(m_slots.size());
+        m_mem.assign(static_cast<size_t>(m_block_size) * m_block_count * m_scan_words, 0);
+        m_written = 0;
+        m_freed = 0;
+        m_overrun = false;
+        return ERR_NONE;
+    }
+
+    uint32 SimBoard::scanWords() const
+    {
+        uint32 words = m_board_counter ? 1 : 0;
+        for (const SimChannel& channel : m_channels)
+        {
+            words += channel.used ? 1 : 0;
+        }
+        return words;
+    }
+
+    uint64 SimBoard::ringCapacity() const
+    {
+        return m_scan_words ? m_mem.size() / m_scan_words : 0;
+    }
+
+    std::string SimBoard::scanDescriptor() const
+    {
+        // 24 bit analog samples and the 32 bit BoardCnt0 in 32 bit words, in channel order
+        std::ostringstream xml;
+        const std::string board = "BoardId" + std::to_string(m_board_id);
+        xml << "<?xml version=\"1.0\"?>\n<ScanDescriptor>\n<" << board << ">\n"
+            << "<ScanDescription version=\"3\" buffer=\"BUFFER0\" buffer_direction=\"from_trion_board\" scan_size=\""
+            << scanWords() * 32 << "\" byte_order=\"little_endian\" unit=\"bit\">\n";
+
+        uint32 offset = 0;
+        for (size_t i = 0; i < m_channels.size(); ++i)
+        {
+            if (m_channels[i].used)
+            {
+                xml << "<Channel type=\"Analog\" index=\"" << i << "\" name=\"AI" << i << "\">\n"
+                    << "<Sample offset=\"" << offset << "\" size=\"24\"/>\n</Channel>\n";
+                offset += 32;
+            }
+        }
+        if (m_board_counter)
+        {
+            xml << "<Channel type=\"Counter\" index=\"0\" name=\"BoardCnt0\">\n"
+                << "<Sample offset=\"" << offset << "\" size=\"32\"/>\n</Channel>\n";
+        }
+        xml << "</ScanDescription>\n</" << board << ">\n</ScanDescriptor>\n";
+        return xml.str();
+    }
+
+
+    int SimBoard::startAcquisition()
+    {
+        if (isController())
+        {
+            return ERR_NONE;
+        }
+        if (m_running)
+        {
+            return ERR_DAQ_ALREADY_STARTED;
+        }
+
+        configureBuffer();
+        if (m_scan_words == 0)
+        {
+            return ERR_DAQ_CHANNEL_NOT_ASSIGNED;
+        }
+
+        m_running = true;
+        m_start_ns = steadyNs();
+        m_start_utc_ns = m_start_time > 0.0 ? static_cast<uint64>(m_start_time * 1e9) : systemNs();
+        m_clock = 0;
+        m_written = 0;
+        m_freed = 0;
+        m_lost = 0;
+        m_next_overrun = m_overrun_period;
+        m_overrun = false;
+        m_latched_sample = 0;
+        m_can_next = 0;
+        m_can.clear();
+        m_uart_next = 0;
+        m_uart_sentence.clear();
+        m_uart_sentences = 0;
+        m_uart.clear();
+
+        ++m_state_generation;
+        m_state_cv.notify_all();
+        return ERR_NONE;
+    }
+
+    void SimBoard::stopAcquisition()
+    {
+        advance();
+        m_running = false;
+        ++m_state_generation;
+        m_state_cv.notify_all();
+    }
+
+    void SimBoard::advance()
+    {
+        if (!m_running)
+        {
+            return;
+        }
+
+        uint64 clock = 0;
+        if (m_realtime)
+        {
+            clock = static_cast<uint64>(static_cast<double>(steadyNs() - m_start_ns) * 1e-9 * m_sample_rate);
+        }
+        else
+        {
+            // Free running: fill the buffer
+            clock = m_clock + (ringCapacity() - available()) + m_pending_loss;
+        }
+
+        if (clock > m_clock)
+        {
+            produce(clock);
+        }
+    }
+
+    void SimBoard::produce(uint64 clock)
+    {
+        const uint64 capacity = ringCapacity();
+        while (m_clock < clock)
+        {
+            if (m_overrun_period && m_clock >= m_next_overrun)
+            {
+                m_pending_loss += m_block_size;
+                m_next_overrun += m_overrun_period;
+            }
+
+            uint64 todo = clock - m_clock;
+            if (m_pending_loss)
+            {
+                const uint64 lost = std::min(todo, m_pending_loss);
+                m_pending_loss -= lost;
+                m_lost += lost;
+                m_clock += lost;
+                m_overrun = true;
+                continue;
+            }
+            if (m_overrun_period)
+            {
+                todo = std::min(todo, m_next_overrun - m_clock);
+            }
+
+            const uint64 scans = std::min(todo, capacity - available());
+            uint64 index = m_written % capacity;
+            for (uint64 done = 0; done < scans; )
+            {
+                const uint64 chunk = std::min(scans - done, capacity - index);
+                writeScans(m_clock + done, static_cast<uint32>(index), static_cast<uint32>(chunk));
+                done += chunk;
+                index = 0;
+            }
+            m_written += scans;
+            m_clock += scans;
+
+            if (scans < todo)
+            {
+                // Buffer full: the scans are lost, the sample clock continues
+                m_lost += todo - scans;
+                m_clock += todo - scans;
+                m_overrun = true;
+            }
+        }
+
+        produceCan(clock);
+        produceUart(clock);
+    }
+
+    void SimBoard::writeScans(uint64 first_sample, uint32 first_index, uint32 count)
+    {
+        const uint32 words = m_scan_words;
+        uint32* scans = m_mem.data() + static_cast<size_t>(first_index) * words;
+
+        for (uint32 slot = 0; slot < words; ++slot)
+        {
+            uint32* dst = scans + slot;
+            if (m_slots[slot] == COUNTER_SLOT)
+            {
+                for (uint32 i = 0; i < count; ++i)
+                {
+                    dst[static_cast<size_t>(i) * words] = static_cast<uint32>(first_sample + i);
+                }
+                continue;
+            }
+
+            const SimChannel& channel = m_channels[m_slots[slot]];
+            const sint64 amplitude = channel.amplitude_lsb;
+            uint32 phase = static_cast<uint32>(first_sample * channel.phase_step);
+            for (uint32 i = 0; i < count; ++i)
+            {
+                sint32 value = 0;
+                switch (channel.waveform)
+                {
+                case SIM_WAVEFORM_SINE:
+                    value = channel.table[phase >> (32 - SINE_TABLE_BITS)];
+                    break;
+                case SIM_WAVEFORM_SQUARE:
+                    value = phase < 0x80000000u ? channel.amplitude_lsb : -channel.amplitude_lsb;
+                    break;
+                case SIM_WAVEFORM_RAMP:
+                    value = static_cast<sint32>(((static_cast<sint64>(phase >> 8) - 0x800000) * amplitude) >> 23);
+                    break;
+                case SIM_WAVEFORM_NOISE:
+                {
+                    const uint64 hash = mix((first_sample + i) ^ (static_cast<uint64>(m_slots[slot]) << 56));
+                    value = static_cast<sint32>(((static_cast<sint64>(hash >> 40) - 0x800000) * amplitude) >> 23);
+                    break;
+                }
+                case SIM_WAVEFORM_DC:
+                    value = channel.amplitude_lsb;
+                    break;
+                }
+                dst[static_cast<size_t>(i) * words] = static_cast<uint32>(value);
+                phase += channel.phase_step;
+            }
+        }
+    }
+
+    void SimBoard::produceCan(uint64 clock)
+    {
+        const uint64 end = static_cast<uint64>(std::ceil(static_cast<double>(clock) * m_can_frame_rate / m_sample_rate));
+        if (!m_can_open || !m_can_started || m_can_frame_rate <= 0.0)
+        {
+            m_can_next = end;
+            return;
+        }
+
+        if (end - m_can_next > MAX_PENDING_FRAMES)
+        {
+            m_can_errors += static_cast<uint32>(end - m_can_next - MAX_PENDING_FRAMES);
+            m_can_next = end - MAX_PENDING_FRAMES;
+        }
+
+        for (; m_can_next < end; ++m_can_next)
+        {
+            const uint64 k = m_can_next;
+            for (int channel = 0; channel < CAN_CHANNELS; ++channel)
+            {
+                if (!(m_can_started & (1u << channel)))
+                {
+                    continue;
+                }
+                if (m_can.size() >= MAX_PENDING_FRAMES)
+                {
+                    ++m_can_errors;
+                    continue;
+                }
+                SimCanFrame frame;
+                frame.channel = static_cast<uint8>(channel);
+                frame.id = 0x100 + 0x10 * channel + static_cast<uint32>(k % 8);
+                for (int b = 0; b < 8; ++b)
+                {
+                    frame.data[b] = static_cast<uint8>(k >> (8 * b));
+                }
+                frame.sample = static_cast<uint64>(static_cast<double>(k) * m_sample_rate / m_can_frame_rate);
+                frame.errors = m_can_errors;
+                m_can.push_back(frame);
+            }
+        }
+    }
+
+    void SimBoard::produceUart(uint64 clock)
+    {
+        const uint64 end = static_cast<uint64>(std::ceil(static_cast<double>(clock) * m_uart_char_rate / m_sample_rate));
+        if (!m_uart_open || !m_uart_started || m_uart_char_rate <= 0.0)
+        {
+            m_uart_next = end;
+            return;
+        }
+
+        const uint64 pps_period = std::max<uint64>(1, static_cast<uint64>(m_sample_rate));
+        for (; m_uart_next < end; ++m_uart_next)
+        {
+            // NMEA like sentences "$SIMUL,<n>*<checksum>"
+            if (m_uart_sentence.empty())
+            {
+                char body[32];
+                std::snprintf(body, sizeof(body), "SIMUL,%u", m_uart_sentences++);
+                uint8 checksum = 0;
+                for (const char* c = body; *c; ++c)
+                {
+                    checksum ^= static_cast<uint8>(*c);
+                }
+                char sentence[48];
+                std::snprintf(sentence, sizeof(sentence), "$%s*%02X\r\n", body, checksum);
+                m_uart_sentence = sentence;
+            }
+            const uint8 data = static_cast<uint8>(m_uart_sentence[0]);
+            m_uart_sentence.erase(0, 1);
+
+            const uint64 sample = static_cast<uint64>(static_cast<double>(m_uart_next) * m_sample_rate / m_uart_char_rate);
+            for (int channel = 0; channel < UART_CHANNELS; ++channel)
+            {
+                if (!(m_uart_started & (1u << channel)) || m_uart.size() >= MAX_PENDING_FRAMES)
+                {
+                    continue;
+                }
+                SimUartChar c;
+                c.data = data;
+                c.channel = static_cast<uint8>(channel);
+                c.sample = sample;
+                c.last_pps = sample / pps_period * pps_period;
+                m_uart.push_back(c);
+            }
+        }
+    }
+
+    sint32 SimBoard::timingState(uint64 sample) const
+    {
+        if (m_timing_loss_period && m_timing_loss_duration
+            && sample % m_timing_loss_period >= m_timing_loss_period - std::min(m_timing_loss_duration, m_timing_loss_period))
+        {
+            return TIMINGSTATE_UNLOCKED;
+        }
+        return m_timing_state;
+    }
+
+    uint64 SimBoard::sampleTimeNs(uint64 sample) const
+    {
+        return m_start_utc_ns + static_cast<uint64>(static_cast<double>(sample) * 1e9 / m_sample_rate);
+    }
+
+
+    namespace
+    {
+        void fillTimestamp(uint64 ns, uint32& sec, uint32& usec)
+        {
+            sec = static_cast<uint32>(ns / 1000000000ull);
+            usec = static_cast<uint32>(ns % 1000000000ull / 1000);
+        }
+
+        void fillCanFrame(const SimCanFrame& src, uint64, BOARD_CAN_FRAME& dst)
+        {
+            std::memset(&dst, 0, sizeof(dst));
+            dst.CanNo = src.channel;
+            dst.MessageId = src.id;
+            dst.DataLength = 8;
+            std::memcpy(dst.CanData, src.data, 8);
+            dst.SyncCounter = static_cast<uint32>(src.sample);
+            dst.ErrorCounter = src.errors;
+            dst.SyncCounterEx = src.sample;
+        }
+
+        void fillCanFrame(const SimCanFrame& src, uint64, BOARD_CAN_FD_FRAME& dst)
+        {
+            std::memset(&dst, 0, sizeof(dst));
+            dst.CanNo = src.channel;
+            dst.MessageId = src.id;
+            dst.DataLength = 8;
+            std::memcpy(dst.CanData, src.data, 8);
+            dst.SyncCounter = static_cast<uint32>(src.sample);
+            dst.ErrorCounter = src.errors;
+            dst.SyncCounterEx = src.sample;
+        }
+
+        void fillCanFrame(const SimCanFrame& src, uint64 time_ns, BOARD_CAN_FD_FRAME_NG& dst)
+        {
+            std::memset(&dst, 0, sizeof(dst));
+            dst.Version = CURRENT_CAN_FD_FRAME_NG_VERSION;
+            dst.CanNo = src.channel;
+            dst.MessageId = src.id;
+            dst.DataLength = 8;
+            dst.ErrorCounter = src.errors;
+            dst.TimeStampSeconds = time_ns / 1000000000ull;
+            dst.TimeStampNanoSeconds = static_cast<uint32>(time_ns % 1000000000ull);
+            std::memcpy(dst.CanData, src.data, 8);
+        }
+
+        /**
+         * The simulation fills the raw frames with the decoded values:
+         * Hdr the message id, Pos the sample count, Err the error counter.
+         */
+        void fillCanFrame(const SimCanFrame& src, uint64 time_ns, BOARD_CAN_RAW_FRAME& dst)
+        {
+            std::memset(&dst, 0, sizeof(dst));
+            dst.Hdr = src.id;
+            dst.Err = src.errors;
+            dst.Pos = static_cast<uint32>(src.sample);
+            std::memcpy(dst.Data, src.data, 8);
+            fillTimestamp(time_ns, dst.tv_sec, dst.tv_usec);
+            dst.flags = CAN_RAW_FLAG_EXTENDED_TS;
+        }
+
+        void fillCanFrame(const SimCanFrame& src, uint64 time_ns, BOARD_CAN_FD_RAW_FRAME& dst)
+        {
+            std::memset(&dst, 0, sizeof(dst));
+            dst.Hdr = src.id;
+            dst.Err = src.errors;
+            dst.Pos = static_cast<uint32>(src.sample);
+            std::memcpy(dst.Data, src.data, 8);
+            fillTimestamp(time_ns, dst.tv_sec, dst.tv_usec);
+            dst.flags = CAN_RAW_FLAG_EXTENDED_TS;
+        }
+    }
+
+
+    int SimBoard::openCan(bool open)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        advance();
+        m_can_open = open;
+        if (!open)
+        {
+            m_can_started = 0;
+            m_can.clear();
+        }
+        return ERR_NONE;
+    }
+
+    int SimBoard::startCan(int channel, bool start)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_can_open)
+        {
+            return ERR_CAN_NOT_OPEN;
+        }
+        if (channel >= CAN_CHANNELS || channel < -1)
+        {
+            return ERR_INVALID_CHANNEL_NO;
+        }
+        advance();
+        const uint32 mask = channel < 0 ? (1u << CAN_CHANNELS) - 1 : 1u << channel;
+        m_can_started = start ? (m_can_started | mask) : (m_can_started & ~mask);
+        return ERR_NONE;
+    }
+
+    int SimBoard::errorCountCan(int channel, int& count)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (channel >= CAN_CHANNELS || channel < 0)
+        {
+            return ERR_INVALID_CHANNEL_NO;
+        }
+        count = static_cast<int>(m_can_errors);
+        return ERR_NONE;
+    }
+
+    template <typename Frame>
+    int SimBoard::readCanFrames(Frame* frames, int max_frames, int& count)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        count = 0;
+        if (!m_can_open)
+        {
+            return ERR_CAN_NOT_OPEN;
+        }
+        advance();
+
+        const size_t n = std::min(m_can.size(), static_cast<size_t>(std::max(max_frames, 0)));
+        for (size_t i = 0; i < n; ++i)
+        {
+            fillCanFrame(m_can[i], sampleTimeNs(m_can[i].sample), frames[i]);
+        }
+        m_can.erase(m_can.begin(), m_can.begin() + n);
+        count = static_cast<int>(n);
+        return ERR_NONE;
+    }
+
+    int SimBoard::readCan(BOARD_CAN_FRAME* frames, int max_frames, int& count)
+    {
+        return readCanFrames(frames, max_frames, count);
+    }
+
+    int SimBoard::readCan(BOARD_CAN_FD_FRAME* frames, int max_frames, int& count)
+    {
+        return readCanFrames(frames, max_frames, count);
+    }
+
+    int SimBoard::readCan(BOARD_CAN_FD_FRAME_NG* frames, int max_frames, int& count)
+    {
+        return readCanFrames(frames, max_frames, count);
+    }
+
+    int SimBoard::readCan(BOARD_CAN_FD_RAW_FRAME* frames, int max_frames, int& count)
+    {
+        return readCanFrames(frames, max_frames, count);
+    }
+
+    int SimBoard::readCanRaw(BOARD_CAN_RAW_FRAME** frames, int& count)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        count = 0;
+        *frames = nullptr;
+        if (!m_can_open)
+        {
+            return ERR_CAN_NOT_OPEN;
+        }
+        advance();
+
+        m_can_raw.resize(m_can.size());
+        for (size_t i = 0; i < m_can.size(); ++i)
+        {
+            fillCanFrame(m_can[i], sampleTimeNs(m_can[i].sample), m_can_raw[i]);
+        }
+        *frames = m_can_raw.empty() ? nullptr : m_can_raw.data();
+        count = static_cast<int>(m_can_raw.size());
+        return ERR_NONE;
+    }
+
+    int SimBoard::freeCan(int count)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (count < 0 || static_cast<size_t>(count) > m_can.size())
+        {
+            return ERR_INVALID_VALUE;
+        }
+        m_can.erase(m_can.begin(), m_can.begin() + count);
+        return ERR_NONE;
+    }
+
+
+    int SimBoard::openUart(bool open)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        advance();
+        m_uart_open = open;
+        if (!open)
+        {
+            m_uart_started = 0;
+            m_uart.clear();
+        }
+        return ERR_NONE;
+    }
+
+    int SimBoard::startUart(int channel, bool start)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_uart_open)
+        {
+            return ERR_UART_NOT_OPEN;
+        }
+        if (channel >= UART_CHANNELS || channel < -1)
+        {
+            return ERR_INVALID_CHANNEL_NO;
+        }
+        advance();
+        const uint32 mask = channel < 0 ? (1u << UART_CHANNELS) - 1 : 1u << channel;
+        m_uart_started = start ? (m_uart_started | mask) : (m_uart_started & ~mask);
+        return ERR_NONE;
+    }
+
+    int SimBoard::readUart(BOARD_UART_FRAME* frames, int max_frames, int& count)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        count = 0;
+        if (!m_uart_open)
+        {
+            return ERR_UART_NOT_OPEN;
+        }
+        advance();
+
+        const size_t n = std::min(m_uart.size(), static_cast<size_t>(std::max(max_frames, 0)));
+        for (size_t i = 0; i < n; ++i)
+        {
+            BOARD_UART_FRAME& frame = frames[i];
+            std::memset(&frame, 0, sizeof(frame));
+            frame.Data = m_uart[i].data;
+            frame.UartNo = m_uart[i].channel;
+            frame.LastPPS = m_uart[i].last_pps;
+            frame.SyncCounter = m_uart[i].sample;
+        }
+        m_uart.erase(m_uart.begin(), m_uart.begin() + n);
+        count = static_cast<int>(n);
+        return ERR_NONE;
+    }
+
+    int SimBoard::readUartRaw(BOARD_UART_RAW_FRAME** frames, int& count)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        count = 0;
+        *frames = nullptr;
+        if (!m_uart_open)
+        {
+            return ERR_UART_NOT_OPEN;
+        }
+        advance();
+
+        m_uart_raw.resize(m_uart.size());
+        for (size_t i = 0; i < m_uart.size(); ++i)
+        {
+            m_uart_raw[i].data_lastpps = m_uart[i].data | (static_cast<uint32>(m_uart[i].last_pps) << 8);
+            m_uart_raw[i].SyncCounter = static_cast<uint32>(m_uart[i].sample);
+        }
+        *frames = m_uart_raw.empty() ? nullptr : m_uart_raw.data();
+        count = static_cast<int>(m_uart_raw.size());
+        return ERR_NONE;
+    }
+
+    int SimBoard::freeUart(int count)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (count < 0 || static_cast<size_t>(count) > m_uart.size())
+        {
+            return ERR_INVALID_VALUE;
+        }
+        m_uart.erase(m_uart.begin(), m_uart.begin() + count);
+        return ERR_NONE;
+    }
+}
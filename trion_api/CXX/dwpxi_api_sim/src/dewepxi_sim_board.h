@@ -0,0 +1,209 @@
+// Copyright DEWETRON 2024
+// One simulated TRION board of the simulation driver
+
+#pragma once
+
+#include "dewepxi_types.h"
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+
+namespace trion
+{
+    enum SimWaveform
+    {
+        SIM_WAVEFORM_SINE,
+        SIM_WAVEFORM_SQUARE,
+        SIM_WAVEFORM_RAMP,
+        SIM_WAVEFORM_NOISE,
+        SIM_WAVEFORM_DC
+    };
+
+    /**
+     * Signal of one simulated analog channel.
+     */
+    struct SimChannel
+    {
+        bool used;
+        SimWaveform waveform;
+        double frequency;           // Hz
+        double amplitude;           // fraction of the range
+        double range;               // V, full scale
+        uint32 phase_step;          // 2^32 per period, per sample
+        sint32 amplitude_lsb;
+        std::vector<sint32> table;  // one sine period
+    };
+
+    /**
+     * One frame of the CAN stream before conversion to a BOARD_CAN_* layout.
+     */
+    struct SimCanFrame
+    {
+        uint8 channel;
+        uint32 id;
+        uint8 data[8];
+        uint64 sample;
+        uint32 errors;
+    };
+
+    /**
+     * One character of the UART stream.
+     */
+    struct SimUartChar
+    {
+        uint8 data;
+        uint8 channel;
+        uint64 sample;
+        uint64 last_pps;
+    };
+
+
+    /**
+     * Simulated TRION board: settings, circular buffer, CAN and UART.
+     *
+     * There is no producer thread. Every call catches up with the sample
+     * clock, elapsed time since the start times the sample rate, and writes
+     * the scans, CAN frames and UART characters due until then. In free
+     * running mode (Sim/Realtime False) the clock advances by the free
+     * buffer space instead, to measure consumers at their maximum rate.
+     *
+     * Samples are functions of the sample index only: the same settings
+     * give the same data in every run, overruns only lose scans. CAN
+     * frames and UART characters follow the sample clock too, they are
+     * produced while the acquisition runs and stamped with the sample count.
+     *
+     * Board 0 is the chassis controller without channels.
+     */
+    class SimBoard
+    {
+    public:
+        SimBoard(int board_id, uint32 ai_channels);
+
+        int boardId() const { return m_board_id; }
+
+        /**
+         * DeWeSetParam_i32/_i64 and DeWeGetParam_i32/_i64.
+         */
+        int setParam(uint32 command, sint64 value);
+        int getParam(uint32 command, sint64& value);
+
+        /**
+         * DeWeSetParamStruct_str and DeWeGetParamStruct_str,
+         * target relative to the board (eg "AI0"), case insensitive.
+         */
+        int setItem(const std::string& target, const std::string& item, const std::string& value);
+        int getItem(const std::string& target, const std::string& item, std::string& value);
+
+        int openCan(bool open);
+        int startCan(int channel, bool start);
+        int errorCountCan(int channel, int& count);
+        int readCan(BOARD_CAN_FRAME* frames, int max_frames, int& count);
+        int readCan(BOARD_CAN_FD_FRAME* frames, int max_frames, int& count);
+        int readCan(BOARD_CAN_FD_FRAME_NG* frames, int max_frames, int& count);
+        int readCan(BOARD_CAN_FD_RAW_FRAME* frames, int max_frames, int& count);
+
+        /**
+         * Raw frames stay valid until freeCan().
+         */
+        int readCanRaw(BOARD_CAN_RAW_FRAME** frames, int& count);
+        int freeCan(int count);
+
+        int openUart(bool open);
+        int startUart(int channel, bool start);
+        int readUart(BOARD_UART_FRAME* frames, int max_frames, int& count);
+        int readUartRaw(BOARD_UART_RAW_FRAME** frames, int& count);
+        int freeUart(int count);
+
+    private:
+        SimBoard(const SimBoard&);
+        SimBoard& operator=(const SimBoard&);
+
+        void reset();
+        bool isController() const { return m_channels.empty(); }
+
+        int applyChannelItem(SimChannel& channel, const std::string& item, const std::string& value);
+        int applySimItem(const std::string& item, const std::string& value);
+        void configureChannel(SimChannel& channel);
+        int configureBuffer();
+        std::string scanDescriptor() const;
+        uint32 scanWords() const;
+
+        int startAcquisition();
+        void stopAcquisition();
+        int waitAvailable(sint64& value);
+        int bufferParam(uint32 command, bool set, sint64& value);
+        uint32 available() const { return static_cast<uint32>(m_written - m_freed); }
+        uint64 ringCapacity() const;
+
+        void advance();
+        void produce(uint64 clock);
+        void writeScans(uint64 first_sample, uint32 first_index, uint32 count);
+        void produceCan(uint64 clock);
+        void produceUart(uint64 clock);
+        sint32 timingState(uint64 sample) const;
+        uint64 sampleTimeNs(uint64 sample) const;
+
+        template <typename Frame>
+        int readCanFrames(Frame* frames, int max_frames, int& count);
+
+        const int m_board_id;
+        mutable std::mutex m_mutex;
+        std::condition_variable m_state_cv;     // start, stop and reset wake the waiting reader
+        uint64 m_state_generation;
+
+        std::map<std::string, std::string> m_items;     // "target/item" of settings without effect
+        std::vector<SimChannel> m_channels;
+        bool m_board_counter;
+        double m_sample_rate;
+        uint32 m_block_size;
+        uint32 m_block_count;
+        sint32 m_adc_delay;
+
+        // Injection and simulation settings
+        bool m_realtime;
+        uint64 m_overrun_period;                // scans, 0: off
+        uint64 m_pending_loss;                  // scans
+        sint32 m_timing_state;
+        uint64 m_timing_loss_period;            // scans, 0: off
+        uint64 m_timing_loss_duration;          // scans
+        double m_can_frame_rate;                // frames/s of every started channel
+        double m_uart_char_rate;                // characters/s of every started channel
+        double m_start_time;                    // s since 1970, 0: system clock at the start
+
+        // Circular buffer
+        std::vector<uint32> m_mem;
+        std::vector<uint32> m_slots;            // channel index per 32 bit word, ~0u: BoardCnt0
+        uint32 m_scan_words;
+
+        // Acquisition
+        bool m_running;
+        uint64 m_start_ns;                      // steady clock
+        uint64 m_start_utc_ns;
+        uint64 m_clock;                         // scans since the start, written or lost
+        uint64 m_written;
+        uint64 m_freed;
+        uint64 m_lost;
+        uint64 m_next_overrun;
+        bool m_overrun;
+        uint64 m_latched_sample;                // CMD_TIMING_TIME
+
+        // CAN and UART streams
+        bool m_can_open;
+        uint32 m_can_started;                   // bit per channel
+        uint64 m_can_next;                      // next frame index
+        uint32 m_can_errors;
+        std::vector<SimCanFrame> m_can;
+        std::vector<BOARD_CAN_RAW_FRAME> m_can_raw;
+
+        bool m_uart_open;
+        uint32 m_uart_started;
+        uint64 m_uart_next;                     // next character index
+        std::string m_uart_sentence;
+        uint32 m_uart_sentences;
+        std::vector<SimUartChar> m_uart;
+        std::vector<BOARD_UART_RAW_FRAME> m_uart_raw;
+    };
+}
@@ -0,0 +1,295 @@
+// Copyright DEWETRON 2024
+
+#pragma once
+
+#include "dewepxi_buffer_telemetry.h"
+#include "dewepxi_latency_histogram.h"
+#include "dewepxi_ringbuffer.h"
+#include "dewepxi_types.h"
+#include <memory>
+#include <vector>
+
+
+namespace trion
+{
+    enum BlockFlags
+    {
+        BLOCK_FLAG_CONSUMER_DROPPED = 0x0001,   // last block: consumer was dropped by the engine
+        BLOCK_FLAG_DATA_LOST = 0x0002           // scans were lost by a buffer overrun, the stream resumes with the next block
+    };
+
+    /**
+     * A range of new scans published by a board reader, whole blocks of
+     * CMD_BUFFER_0_BLOCK_SIZE scans counted from start() or the last overrun.
+     * Only the last block published by stop() may be incomplete.
+     */
+    struct BlockDescriptor
+    {
+        uint32 board_index;     // index within the AcquisitionEngine
+        int board_id;
+        uint32 consumer;        // receiving consumer
+        int error;              // TRION API error code of the reader, scans is 0 on error
+        uint32 flags;           // BlockFlags
+        ScanSpans spans;        // zero-copy view into the circular buffer
+        uint64 first_scan;      // index of the first scan since start()
+        uint32 scans;           // == spans.totalScans()
+        uint64 wake_ns;         // reader returned from the wait that found the scans (steady clock)
+        uint64 publish_ns;      // descriptor was queued (steady clock)
+    };
+
+    /**
+     * Wake-up to publish latency of a board reader.
+     */
+    struct LatencyStats
+    {
+        uint64 count;
+        uint64 min_ns;
+        uint64 max_ns;
+        uint64 total_ns;
+
+        double meanNs() const
+        {
+            return count ? static_cast<double>(total_ns) / count : 0.0;
+        }
+    };
+
+    /**
+     * Progress of one consumer.
+     */
+    struct ConsumerStats
+    {
+        uint64 released_scans;  // scans released so far
+        uint64 lag_scans;       // scans available on the board but not yet released
+        uint64 max_lag_scans;
+        uint64 queue_full;      // deferred publishes because the queue was full
+        bool dropped;
+    };
+
+    /**
+     * Scheduling of the reader threads.
+     */
+    struct ReaderThreadOptions
+    {
+        ReaderThreadOptions()
+            : realtime_priority(0)
+            , lock_memory(false)
+        {
+        }
+
+        std::vector<int> cpus;      // cores the readers are balanced on, empty: not pinned
+        int realtime_priority;      // SCHED_FIFO priority 1..99, 0: normal scheduling
+        bool lock_memory;           // lock the process memory (mlockall) on start()
+    };
+
+    /**
+     * Applied scheduling of a reader thread.
+     */
+    struct ReaderThreadStatus
+    {
+        int cpu;                    // -1 if not pinned
+        bool pinned;
+        bool realtime;
+        bool memory_locked;
+    };
+
+    /**
+     * Monotonic clock in nanoseconds, used for all engine timestamps.
+     */
+    uint64 steadyClockNs();
+
+
+    /**
+     * Acquisition engine with one dedicated reader thread per board.
+     *
+     * Each reader blocks on CMD_BUFFER_0_WAIT_AVAIL_NO_SAMPLE instead of
+     * polling, and hands every completed block as BlockDescriptor to its
+     * consumers, each through an own lock-free single producer / single
+     * consumer queue.
+     *
+     * All consumers of a board read the same circular buffer region
+     * (zero-copy) and receive the same blocks. A consumer with a full
+     * queue receives its deferred blocks one by one once it pops. Every consumer has an own release cursor, the reader
+     * frees scans (FREE_NO_SAMPLE) only up to the slowest consumer.
+     * The driver wait returns once a block is unfreed, including scans the
+     * consumers still hold and released scans not yet freed (release policy). Then the reader sleeps until the next block is
+     * due at the measured scan rate, or until a release() or pop().
+     *
+     * Usage:
+     *  - addBoard() after CMD_UPDATE_PARAM_ALL
+     *  - addConsumer() per consumer, without any every board gets one
+     *    consumer with consumer id == board index
+     *  - start() after CMD_START_ACQUISITION
+     *  - one thread per consumer calling pop() or waitPop()
+     *    and release() for every block, in order
+     *  - stop() before CMD_STOP_ACQUISITION
+     */
+    class AcquisitionEngine
+    {
+    public:
+        /**
+         * @param queue_capacity number of descriptors queued per consumer
+         */
+        explicit AcquisitionEngine(uint32 queue_capacity = 64);
+        ~AcquisitionEngine();
+
+        /**
+         * Add a board, the board index is the number of boards added before.
+         * Reads the circular buffer geometry.
+         * @return TRION API error code
+         */
+        int addBoard(int board_id, int buffer = 0);
+
+        uint32 numBoards() const;
+        const RingBufferView& ring(uint32 board_index) const;
+
+        /**
+         * Add a consumer of a board before start().
+         * @return the consumer id
+         */
+        uint32 addConsumer(uint32 board_index);
+
+        uint32 numConsumers() const;
+
+        /**
+         * Drop the slowest consumer of a board instead of overrunning the
+         * circular buffer. A consumer is dropped when the unreleased scans
+         * exceed fill_threshold of the buffer capacity and other consumers
+         * are ahead. The dropped consumer receives a last descriptor with
+         * BLOCK_FLAG_CONSUMER_DROPPED.
+         */
+        void setDropSlowest(bool enable, double fill_threshold = 0.9);
+
+        /**
+         * Coalesce CMD_BUFFER_0_FREE_NO_SAMPLE calls, see ReleaseManager.
+         * @param chunk_scans free once this many scans are released, 0 frees immediately
+         * @param watermark_bytes free immediately below this free memory, 0 disables
+         */
+        void setReleasePolicy(uint32 chunk_scans, uint32 watermark_bytes = 0);
+
+        /**
+         * Recover from ERR_BUFFER_OVERWRITE instead of stopping the reader.
+         * The reader acknowledges the overrun (CMD_BUFFER_0_CLEAR_ERROR),
+         * skips one read and continues at the new read position. Every
+         * consumer receives a descriptor with BLOCK_FLAG_DATA_LOST and no
+         * scans before the first block after the overrun, its wake_ns is
+         * the time the overrun was detected. Blocks received before may
+         * have been overwritten, blocks still queued are discarded.
+         * Use GapDetector for the lost range.
+         */
+        void setOverrunRecovery(bool enable);
+
+        /**
+         * Interval of the board memory telemetry, 0 disables it.
+         */
+        void setBoardMemoryInterval(uint32 interval_ms);
+
+        /**
+         * Pinning, priority and memory locking of the reader threads,
+         * applied by start(). Boards without setBoardCpu() are balanced
+         * on the cores with the fewest readers.
+         */
+        void setThreadOptions(const ReaderThreadOptions& options);
+
+        /**
+         * Pin the reader of a board to a core. Boards pinned to the same
+         * core form a group sharing it.
+         */
+        void setBoardCpu(uint32 board_index, int cpu);
+
+        /**
+         * Scheduling applied to a reader, valid once the reader is running.
+         * Pinning or real-time priority fail without the permissions.
+         */
+        ReaderThreadStatus threadStatus(uint32 board_index) const;
+
+        /**
+         * Start the reader threads.
+         * @return ERR_NONE or the error of the first failing reader setup
+         */
+        int start();
+
+        /**
+         * Stop and join the reader threads.
+         * A reader blocked in the wait returns with the next block
+         * or when the acquisition is stopped. The scans of the incomplete
+         * last block are published as a shorter block.
+         */
+        void stop();
+
+        bool isRunning() const;
+
+        /**
+         * Get the next block of a consumer without blocking.
+         * A reader error is delivered as last block, after all queued blocks.
+         * @return false if no block is available
+         */
+        bool pop(uint32 consumer, BlockDescriptor& block);
+
+        /**
+         * Get the next block of a consumer, wait up to timeout_ms.
+         * @return false on timeout or if the engine was stopped
+         */
+        bool waitPop(uint32 consumer, BlockDescriptor& block, uint32 timeout_ms);
+
+        /**
+         * Release the scans of a block for the receiving consumer.
+         * Blocks have to be released in the order they were received.
+         */
+        void release(const BlockDescriptor& block);
+
+        LatencyStats latency(uint32 board_index) const;
+
+        /**
+         * Reader busy time per iteration, from the wake-up to the publish.
+         */
+        const LatencyHistogram& loopHistogram(uint32 board_index) const;
+
+        /**
+         * Duration of the CMD_BUFFER_0_FREE_NO_SAMPLE calls of the reader.
+         */
+        const LatencyHistogram& driverHistogram(uint32 board_index) const;
+
+        /**
+         * Time from a detected overrun to the first block published after
+         * the recovery, see setOverrunRecovery().
+         */
+        const LatencyHistogram& recoveryHistogram(uint32 board_index) const;
+
+        /**
+         * Driver calls (wait and free) of the board reader since start().
+         */
+        uint64 driverCalls(uint32 board_index) const;
+
+        /**
+         * Buffer health of a board, lock-free, may be called from any thread.
+         */
+        void telemetry(uint32 board_index, BufferTelemetry& telemetry) const;
+
+        ConsumerStats consumerStats(uint32 consumer) const;
+
+        /**
+         * Last TRION API error of the board reader, ERR_NONE while healthy.
+         */
+        int lastError(uint32 board_index) const;
+
+    private:
+        AcquisitionEngine(const AcquisitionEngine&);
+        AcquisitionEngine& operator=(const AcquisitionEngine&);
+
+        struct BoardReader;
+        struct Consumer;
+
+        uint32 m_queue_capacity;
+        std::vector<std::unique_ptr<BoardReader>> m_readers;
+        std::vector<std::unique_ptr<Consumer>> m_consumers;
+        bool m_drop_slowest;
+        double m_drop_threshold;
+        uint32 m_release_chunk;
+        uint32 m_release_watermark;
+        uint32 m_board_mem_interval_ms;
+        bool m_overrun_recovery;
+        ReaderThreadOptions m_thread_options;
+        bool m_memory_locked;
+        bool m_running;
+    };
+}
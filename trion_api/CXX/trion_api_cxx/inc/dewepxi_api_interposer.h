@@ -0,0 +1,167 @@
+// Copyright DEWETRON 2024
+
+#pragma once
+
+#include "dewepxi_latency_histogram.h"
+#include "dewepxi_types.h"
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+namespace trion
+{
+    /**
+     * One intercepted API call.
+     */
+    struct ApiCallRecord
+    {
+        uint64 start_ns;            // steady clock
+        uint64 duration_ns;
+        const char* function;       // eg "DeWeGetParam_i32"
+        uint32 command;             // CMD_* of the _i32 and _i64 functions, 0 otherwise
+        sint32 board;               // -1 if the call has no board
+        sint32 error;               // TRION API error code
+        uint32 thread;              // index of the calling thread
+    };
+
+    /**
+     * Aggregated calls of one function, command and board.
+     */
+    struct ApiCallStats
+    {
+        const char* function;
+        uint32 command;
+        sint32 board;
+        uint64 calls;
+        uint64 errors;              // error > 0
+        uint64 warnings;            // error < 0
+        uint64 total_ns;
+        LatencySummary latency;
+    };
+
+    /**
+     * Name of a CMD_* command id, nullptr if unknown.
+     */
+    const char* apiCommandName(uint32 command);
+
+
+    /**
+     * Interposes the loaded TRION API function pointers (DeWeGetParam_i32,
+     * DeWeReadCAN, ...) to count calls and measure their latency.
+     *
+     * install() replaces every loaded pointer by a thunk calling the
+     * original. The thunk records function, command, board, duration and
+     * error into a lock-free ring of the calling thread (time stamp counter,
+     * no locks, no allocation), a flush thread drains the rings into per
+     * command statistics and passes the raw calls to an optional sink.
+     * Without install() the pointers are untouched and cost nothing, after
+     * setEnabled(false) the thunks only forward the call.
+     *
+     * Calls are dropped, not blocked, if a ring is full.
+     *
+     * The budget of the thunk is 20 ns per call. Its own work takes a few
+     * ns, the rest are the two time stamp reads: a few ns each on bare
+     * metal, but 20 to 30 ns each in VMs trapping rdtsc, where the budget
+     * is missed (about 43 ns measured). tickCostNs() tells which case applies.
+     */
+    class ApiInterposer
+    {
+    public:
+        typedef std::function<void(const ApiCallRecord* records, size_t count)> Sink;
+
+        static ApiInterposer& instance();
+
+        /**
+         * Wrap the loaded API functions, call after DeWePxiLoad.
+         * @param ring_capacity calls buffered per thread
+         * @param flush_interval_ms period of the flush thread
+         */
+        void install(uint32 ring_capacity = 16384, uint32 flush_interval_ms = 10);
+
+        /**
+         * Restore the original functions and stop the flush thread.
+         * No API call may be running.
+         */
+        void uninstall();
+
+        bool installed() const { return m_flush_thread.joinable(); }
+
+        /**
+         * Record calls (default after install), false only forwards.
+         */
+        void setEnabled(bool enabled);
+        bool enabled() const;
+
+        /**
+         * Receives every recorded call on the flush thread, eg for a trace file.
+         * The sink runs unlocked and in order, it may not call flush().
+         */
+        void setSink(const Sink& sink);
+
+        /**
+         * Drain the rings now.
+         */
+        void flush();
+
+        /**
+         * Statistics of all calls flushed so far, the most expensive first.
+         */
+        std::vector<ApiCallStats> stats() const;
+        void resetStats();
+
+        /**
+         * Calls lost because a ring was full.
+         */
+        uint64 dropped() const;
+
+        /**
+         * Cost of one time stamp read measured at install(), in ns.
+         */
+        double tickCostNs() const;
+
+    private:
+        ApiInterposer();
+        ~ApiInterposer();
+        ApiInterposer(const ApiInterposer&);
+        ApiInterposer& operator=(const ApiInterposer&);
+
+        struct Key
+        {
+            uint32 function;
+            uint32 command;
+            sint32 board;
+            bool operator<(const Key& other) const;
+        };
+
+        struct Entry
+        {
+            uint64 calls;
+            uint64 errors;
+            uint64 warnings;
+            uint64 total_ns;
+            std::unique_ptr<LatencyHistogram> latency;
+        };
+
+        void run(uint32 interval_ms);
+        void drain();
+
+        std::mutex m_drain_mutex;           // one drain at a time, the batch
+        std::vector<ApiCallRecord> m_batch;
+
+        mutable std::mutex m_mutex;         // statistics, sink and ticks conversion
+        std::map<Key, Entry> m_stats;
+        Sink m_sink;
+        uint64 m_tick_origin;
+        uint64 m_ns_origin;
+        double m_ns_per_tick;
+        double m_tick_cost_ns;
+
+        std::thread m_flush_thread;
+        std::atomic<bool> m_running;
+    };
+}
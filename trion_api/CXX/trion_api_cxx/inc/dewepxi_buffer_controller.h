@@ -0,0 +1,142 @@
+// Copyright DEWETRON 2024
+
+#pragma once
+
+#include "dewepxi_types.h"
+#include <functional>
+#include <string>
+
+
+namespace trion
+{
+    /**
+     * Circular buffer setup: CMD_BUFFER_0_BLOCK_SIZE and CMD_BUFFER_0_BLOCK_COUNT.
+     */
+    struct BufferConfig
+    {
+        uint32 block_size;      // scans per block
+        uint32 block_count;
+    };
+
+    /**
+     * Measured headroom of the current configuration.
+     */
+    struct BufferHeadroom
+    {
+        double service_utilization;     // consumer busy time / acquired time
+        double fill_peak;               // peak unfreed scans / capacity
+        double max_service_ms;          // slowest observed service of one block
+    };
+
+    /**
+     * Chooses block size and block count of a board's circular buffer.
+     *
+     * The block size follows the latency target: a reader waiting on
+     * CMD_BUFFER_0_WAIT_AVAIL_NO_SAMPLE wakes up once per block. It is only
+     * increased if the consumer cannot service blocks that small with the
+     * required headroom, as every block costs a fixed overhead.
+     * The block count covers the reserve time and the slowest observed
+     * service, so a stalled consumer does not overrun the buffer.
+     *
+     * The service model is fit from observeService(), the fill from
+     * observeFill(). retune() computes a new configuration, apply() writes
+     * it with CMD_UPDATE_PARAM_ACQ_BUFFER while the acquisition is stopped.
+     */
+    class BufferController
+    {
+    public:
+        typedef std::function<void(const std::string&)> LogFunction;
+
+        explicit BufferController(int board_id, int buffer = 0);
+
+        void setLatencyTarget(double latency_ms);
+
+        /**
+         * Consumer busy time share that has to stay free, eg 0.3 for 30 %.
+         */
+        void setMinHeadroom(double headroom);
+
+        /**
+         * Time the buffer has to bridge at least.
+         */
+        void setReserve(double reserve_ms);
+
+        void setMaxBufferBytes(uint32 bytes);
+
+        /**
+         * Receives a line per decision.
+         */
+        void setLog(LogFunction log);
+
+        void setSampleRate(double sample_rate);
+        void setScanSize(uint32 scan_size);
+
+        /**
+         * Read the sample rate and the scan size of the board, compute
+         * the initial configuration and apply it.
+         * Has to be called after CMD_UPDATE_PARAM_ALL.
+         * @return TRION API error code
+         */
+        int configure();
+
+        /**
+         * Record the time a consumer needed to process a block.
+         */
+        void observeService(uint32 scans, uint64 service_ns);
+
+        /**
+         * Record the unfreed scans in the buffer (eg the available count).
+         */
+        void observeFill(uint32 unfreed_scans);
+
+        /**
+         * Compute a configuration from the latency target and the
+         * observations.
+         * @return true if it differs enough from the current one to apply it
+         */
+        bool retune();
+
+        /**
+         * Write the computed configuration to the board.
+         * @return TRION API error code
+         */
+        int apply();
+
+        /**
+         * Forget all observations, eg after apply().
+         */
+        void resetObservations();
+
+        const BufferConfig& config() const { return m_config; }
+        const BufferConfig& applied() const { return m_applied; }
+        BufferHeadroom headroom() const;
+
+    private:
+        BufferConfig compute(std::string& reason) const;
+        void log(const std::string& message) const;
+
+        int m_board_id;
+        int m_buffer;
+
+        double m_latency_ms;
+        double m_min_headroom;
+        double m_reserve_ms;
+        uint32 m_max_bytes;
+        LogFunction m_log;
+
+        double m_sample_rate;
+        uint32 m_scan_size;
+
+        // Linear service model: ns = overhead + per_scan * scans
+        double m_n;
+        double m_sum_x;
+        double m_sum_y;
+        double m_sum_xx;
+        double m_sum_xy;
+        double m_max_service_ns;
+        uint32 m_fill_peak;
+
+        BufferConfig m_config;
+        BufferConfig m_applied;
+    };
+}
@@ -0,0 +1,100 @@
+// Copyright DEWETRON 2024
+
+#pragma once
+
+#include "dewepxi_types.h"
+#include <atomic>
+
+
+namespace trion
+{
+    /**
+     * Health of one circular buffer of a board.
+     */
+    struct BufferTelemetry
+    {
+        int board_id;
+        int buffer;                     // 0: BUFFER_0, 1: BUFFER_1
+        uint32 capacity_scans;
+        uint32 fill_scans;              // unfreed scans at the last update
+        uint32 high_water_scans;        // maximum fill since start
+        double fill_level;              // fill_scans / capacity_scans
+        double headroom_ms;             // time until the free space is filled
+        sint32 board_mem_size;          // CMD_BUFFER_0_BOARD_MEM_SIZE, -1 if not available
+        sint32 board_mem_free;          // CMD_BUFFER_0_FREE_BOARD_MEM_SIZE
+        sint32 board_mem_samples;       // CMD_BUFFER_0_NUM_SAMPLES_IN_BOARD_MEM
+        uint64 overruns;
+        double scans_per_second;        // measured scan rate
+        uint64 scans_total;
+        uint64 update_ns;               // steady clock of the last update
+    };
+
+
+    /**
+     * Collects the telemetry of one circular buffer.
+     *
+     * The acquisition loop is the only writer: update() only does
+     * arithmetic, the board memory is read at a lower rate.
+     * Any number of monitoring threads read it with snapshot(), a seqlock
+     * that never blocks the writer.
+     */
+    class BufferMonitor
+    {
+    public:
+        BufferMonitor(int board_id, int buffer = 0);
+
+        /**
+         * Writer: reset all values.
+         * @param capacity_scans circular buffer capacity
+         * @param sample_rate nominal rate for the headroom, 0 uses the measured rate
+         */
+        void reset(uint32 capacity_scans, double sample_rate = 0.0);
+
+        /**
+         * Writer: read the board memory every interval_ms in update(), 0 disables.
+         */
+        void setBoardMemoryInterval(uint32 interval_ms);
+
+        /**
+         * Writer: record the unfreed scans and the number of new scans.
+         * @param now_ns steady clock
+         */
+        void update(uint32 avail_scans, uint32 new_scans, uint64 now_ns);
+
+        /**
+         * Writer: count an ERR_BUFFER_OVERWRITE.
+         */
+        void overrun(uint64 now_ns);
+
+        /**
+         * Writer: read the board side memory (three driver calls).
+         * @return TRION API error code
+         */
+        int pollBoardMemory();
+
+        /**
+         * Reader: consistent copy of the latest values, lock-free.
+         */
+        void snapshot(BufferTelemetry& telemetry) const;
+
+    private:
+        BufferMonitor(const BufferMonitor&);
+        BufferMonitor& operator=(const BufferMonitor&);
+
+        void publish();
+
+        static const uint32 WORDS = (sizeof(BufferTelemetry) + 7) / 8;
+
+        // Writer state
+        BufferTelemetry m_data;
+        double m_sample_rate;
+        uint32 m_board_mem_interval_ms;
+        uint64 m_board_mem_ns;
+        uint64 m_rate_ns;
+        uint64 m_rate_scans;
+
+        // Published copy
+        std::atomic<uint32> m_seq;
+        std::atomic<uint64> m_words[WORDS];
+    };
+}
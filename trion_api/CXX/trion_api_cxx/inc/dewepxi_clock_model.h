@@ -0,0 +1,157 @@
+// Copyright DEWETRON 2024
+
+#pragma once
+
+#include "dewepxi_timeline.h"
+#include "dewepxi_types.h"
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+namespace trion
+{
+    enum ClockFlags
+    {
+        CLOCK_FLAG_DEGRADED = 0x0001,       // timing state was not TIMINGSTATE_LOCKED within the block
+        CLOCK_FLAG_UNFITTED = 0x0002        // less than two time points, nominal sample rate used
+    };
+
+    /**
+     * Current fit of a ClockModel: time_ns = ref_ns + (sample - ref_sample) * ns_per_sample
+     */
+    struct ClockFit
+    {
+        uint64 ref_sample;
+        uint64 ref_ns;              // nanoseconds since 1970-01-01 (timing source time)
+        double ns_per_sample;
+        double residual_ns;         // rms residual of the fit
+        uint32 points;
+        sint32 timing_state;        // last TIMINGSTATE_*
+    };
+
+
+    /**
+     * Absolute time of the sample clock of one board, for boards
+     * synchronized to PTP, IRIG or GPS.
+     *
+     * update() latches the timing source time with CMD_TIMING_TIME, which
+     * returns the sample count of the latch, and reads
+     * /AcqProp/Timing/SystemTime. Sec only has a resolution of one second,
+     * so a poll on its own is off by up to one second, and polls at a fixed
+     * rate would keep that error constant. A time point is therefore only
+     * taken when the second changes between two polls less than 5 ms apart:
+     * the new second started between the two latches. The thread of start()
+     * sleeps until shortly before the expected change and then polls every
+     * millisecond, each point is accurate to about half a millisecond.
+     * Offset and drift are fitted by least squares over the last points.
+     *
+     * stamp() converts a block of sample indices (counted since the
+     * acquisition start, eg BoardCnt0 or GapDetector::nextSample()) into
+     * nanosecond timestamps in one integer SIMD pass. Blocks overlapping a
+     * timing state other than TIMINGSTATE_LOCKED are marked degraded.
+     *
+     * update() and stamp() may be called from different threads.
+     */
+    class ClockModel
+    {
+    public:
+        /**
+         * @param sample_rate nominal sample rate, used until two time points exist
+         */
+        ClockModel(int board_id, double sample_rate);
+        ~ClockModel();
+
+        /**
+         * Number of time points of the least squares fit (default 64).
+         */
+        void setWindow(uint32 points);
+
+        /**
+         * Poll the time source once. Adds a time point if the second changed
+         * since the previous poll and both are less than 5 ms apart.
+         * Must not be called while the thread of start() runs.
+         * @return TRION API error code
+         */
+        int update();
+
+        /**
+         * Add a time point measured by the caller.
+         */
+        void addPoint(uint64 sample, uint64 time_ns);
+
+        /**
+         * Record a timing state (TIMINGSTATE_*) valid from sample on.
+         */
+        void setTimingState(uint64 sample, sint32 state);
+
+        /**
+         * Call update() in an own thread, around one second change every
+         * interval_ms (rounded to whole seconds).
+         */
+        void start(uint32 interval_ms);
+        void stop();
+
+        /**
+         * Timestamps of count consecutive samples starting at first_sample.
+         * @return ClockFlags of the block
+         */
+        uint32 stamp(uint64 first_sample, uint32 count, uint64* time_ns) const;
+
+        /**
+         * Timestamp of one sample.
+         */
+        uint64 timeOf(uint64 sample) const;
+
+        ClockFit fit() const;
+
+        /**
+         * Last error of update(), ERR_NONE while healthy.
+         */
+        int lastError() const { return m_last_error.load(); }
+
+    private:
+        ClockModel(const ClockModel&);
+        ClockModel& operator=(const ClockModel&);
+
+        struct Point
+        {
+            uint64 sample;
+            uint64 time_ns;
+        };
+
+        struct StateChange
+        {
+            uint64 sample;
+            sint32 state;
+        };
+
+        void refit();
+        bool degraded(uint64 first_sample, uint64 end_sample) const;
+        void run(uint32 interval_ms);
+        void sleepUntil(uint64 steady_ns) const;
+
+        int m_board_id;
+        double m_nominal_ns_per_sample;
+        uint32 m_window;
+        CounterUnwrapper m_sample_count;
+        uint64 m_rollover_samples;          // longest distance of two polls bracketing a second change
+
+        // Previous poll of update()
+        bool m_poll_locked;
+        uint64 m_poll_sample;
+        uint64 m_poll_second;               // seconds since 1970-01-01
+        uint64 m_rollover_steady_ns;        // steady clock of the last second change, 0 if none
+
+        mutable std::mutex m_mutex;
+        std::vector<Point> m_points;        // ring of the last m_window points
+        uint32 m_next_point;
+        std::vector<StateChange> m_states;  // recent timing state changes
+        ClockFit m_fit;
+
+        std::thread m_thread;
+        std::atomic<bool> m_running;
+        std::atomic<int> m_last_error;
+    };
+}
@@ -0,0 +1,152 @@
+// Copyright DEWETRON 2024
+
+#pragma once
+
+#include "dewepxi_types.h"
+#include <string>
+#include <vector>
+
+
+namespace trion
+{
+    enum BoardRole
+    {
+        BOARD_ROLE_CONTROLLER,      // chassis controller (BoardID0 of a DEWE3)
+        BOARD_ROLE_MASTER,          // acquisition master, drives the sample clock
+        BOARD_ROLE_SLAVE
+    };
+
+    enum ConfigPhase
+    {
+        CONFIG_PHASE_OPEN,          // CMD_OPEN_BOARD
+        CONFIG_PHASE_RESET,         // CMD_RESET_BOARD
+        CONFIG_PHASE_CONFIGURE,     // the steps of the board setup
+        CONFIG_PHASE_UPDATE,        // CMD_UPDATE_PARAM_ALL
+        CONFIG_PHASE_COUNT
+    };
+
+    /**
+     * One configuration call: DeWeSetParamStruct_str if target
+     * is set, DeWeSetParam_i32 otherwise.
+     */
+    struct ConfigStep
+    {
+        std::string target;
+        std::string item;
+        std::string value;
+        uint32 command;
+        sint32 command_value;
+    };
+
+    /**
+     * Open, reset and configuration of one board.
+     */
+    struct BoardSetup
+    {
+        explicit BoardSetup(int board_id = 0, BoardRole role = BOARD_ROLE_SLAVE);
+
+        /**
+         * Add DeWeSetParamStruct_str(target, item, value), the target
+         * is relative to the board, eg set("AcqProp", "SampleRate", "10000").
+         */
+        BoardSetup& set(const std::string& target, const std::string& item, const std::string& value);
+
+        /**
+         * Add DeWeSetParam_i32(board_id, command, value).
+         */
+        BoardSetup& command(uint32 command, sint32 value);
+
+        /**
+         * "BoardIDx/" + target
+         */
+        std::string boardTarget(const std::string& target) const;
+
+        int board_id;
+        BoardRole role;
+        bool open;                  // CMD_OPEN_BOARD
+        bool reset;                 // CMD_RESET_BOARD
+        bool update;                // CMD_UPDATE_PARAM_ALL
+        std::vector<ConfigStep> steps;
+    };
+
+    /**
+     * Startup time of one board.
+     */
+    struct BoardStartupReport
+    {
+        int board_id;
+        int error;                      // first TRION API error, the later phases are skipped
+        uint64 phase_ns[CONFIG_PHASE_COUNT];
+    };
+
+    /**
+     * Wall clock time of a ConfigExecutor::run().
+     */
+    struct StartupReport
+    {
+        uint64 total_ns;
+        uint64 phase_ns[CONFIG_PHASE_COUNT];
+        bool phase_parallel[CONFIG_PHASE_COUNT];    // slaves of the phase ran concurrently
+        bool serial_fallback;                       // the driver serialized the calls
+        std::vector<BoardStartupReport> boards;
+    };
+
+
+    /**
+     * Runs the open, reset and configuration of several boards concurrently.
+     *
+     * The boards run phase by phase (open, reset, configure, update).
+     * Within every phase the chassis controller and then the master run
+     * first, one after the other, then all slaves run on a pool of worker
+     * threads. Before the start exactly one board may drive TRIG7
+     * (Trig7/Source not Disable, SYNC_OUT7/Source on the chassis
+     * controller), see setTrig7Driver().
+     *
+     * If a parallel phase is not faster than its slaves one after the
+     * other the driver serializes the calls, the remaining phases then run
+     * serially to save the thread overhead.
+     */
+    class ConfigExecutor
+    {
+    public:
+        /**
+         * @param workers worker threads per phase, 0: hardware concurrency
+         */
+        explicit ConfigExecutor(uint32 workers = 0);
+
+        /**
+         * @return the index of the board setup
+         */
+        uint32 addBoard(const BoardSetup& setup);
+
+        uint32 numBoards() const { return static_cast<uint32>(m_boards.size()); }
+        BoardSetup& board(uint32 index) { return m_boards[index]; }
+
+        /**
+         * Drive the SYNC-OUT TRIG7 line by one board: Trig7 Source=Low on
+         * this board, Source=Disable on all other boards except the
+         * chassis controller (see the Synchronization documentation).
+         * With a Chassis-Controller-V2 pass the controller: it drives
+         * SYNC_OUT7 Source=Low, all other boards are set to Disable.
+         */
+        void setTrig7Driver(int board_id);
+
+        /**
+         * Run all phases, parallel if workers > 1.
+         * @return ERR_NONE, the first board error, or ERR_INVALID_VALUE
+         *         if more than one board drives TRIG7
+         */
+        int run();
+
+        const StartupReport& report() const { return m_report; }
+
+    private:
+        bool trig7Unique() const;
+        int runStep(BoardSetup& setup, ConfigPhase phase);
+        void runPhase(ConfigPhase phase);
+
+        uint32 m_workers;
+        std::vector<BoardSetup> m_boards;
+        StartupReport m_report;
+    };
+}
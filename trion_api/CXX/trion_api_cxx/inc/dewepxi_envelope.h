@@ -0,0 +1,148 @@
+// Copyright DEWETRON 2024
+
+#pragma once
+
+#include "dewepxi_scan_decoder.h"
+#include "dewepxi_types.h"
+#include <memory>
+#include <mutex>
+#include <vector>
+
+
+namespace trion
+{
+    /**
+     * Minimum, maximum and mean of count consecutive samples.
+     */
+    struct EnvelopeBucket
+    {
+        float min;
+        float max;
+        float mean;
+        uint32 count;               // 0: no samples
+    };
+
+    /**
+     * Min/max/mean pyramid of one channel, built incrementally.
+     *
+     * Level 0 holds one bucket per base_samples samples, every further
+     * level combines factor buckets of the level below. A bucket is
+     * complete once all its samples arrived, the incomplete buckets at the
+     * end are kept as running accumulators. The memory is about
+     * samples / base_samples * factor / (factor - 1) buckets.
+     *
+     * query() answers any time span at any zoom in O(pixels * factor):
+     * it picks the coarsest level with at least one bucket per pixel and
+     * combines at most factor + 1 buckets per pixel. Zooms finer than
+     * base_samples per pixel return the level 0 buckets.
+     *
+     * Values are stored as float: raw 24 bit samples are exact, scaled
+     * values are rounded to single precision. A negative scaling gain
+     * swaps min and max.
+     *
+     * append() and query() may be called from different threads.
+     */
+    class EnvelopePyramid
+    {
+    public:
+        /**
+         * @param base_samples samples per level 0 bucket
+         * @param factor buckets combined per level, at least 2
+         */
+        explicit EnvelopePyramid(uint32 base_samples = 64, uint32 factor = 8);
+
+        void append(const sint32* samples, uint32 count);
+        void append(const float* samples, uint32 count);
+        void append(const double* samples, uint32 count);
+
+        /**
+         * Drop all samples.
+         */
+        void clear();
+
+        uint64 samples() const;
+        uint32 numLevels() const;
+        uint32 baseSamples() const { return m_base_samples; }
+        uint32 factor() const { return m_factor; }
+
+        /**
+         * Samples per bucket of a level.
+         */
+        uint64 bucketSamples(uint32 level) const;
+
+        /**
+         * Envelope of the samples [first_sample, end_sample), one bucket per pixel.
+         * Pixels behind the appended samples have count 0.
+         * @return the pixels holding samples
+         */
+        uint32 query(uint64 first_sample, uint64 end_sample, uint32 pixels, std::vector<EnvelopeBucket>& out) const;
+
+        /**
+         * Bytes held by the complete buckets.
+         */
+        uint64 memoryBytes() const;
+
+    private:
+        EnvelopePyramid(const EnvelopePyramid&);
+        EnvelopePyramid& operator=(const EnvelopePyramid&);
+
+        struct Accumulator
+        {
+            float min;
+            float max;
+            double sum;
+            uint32 count;
+        };
+
+        struct Level
+        {
+            std::vector<EnvelopeBucket> buckets;
+            Accumulator open;       // buckets of the level below since the last complete one
+        };
+
+        template <typename T>
+        void appendSamples(const T* samples, uint32 count);
+        void completeBase();
+        EnvelopeBucket openBucket(uint32 level) const;
+
+        const uint32 m_base_samples;
+        const uint32 m_factor;
+        mutable std::mutex m_mutex;
+        std::vector<Level> m_levels;
+        Accumulator m_base;         // samples of the open level 0 bucket
+        uint64 m_samples;
+    };
+
+
+    /**
+     * Envelope pyramids of all channels of a board, fed with decoded blocks
+     * by an acquisition consumer or by the Recorder (Recorder::setEnvelopes()).
+     */
+    class EnvelopeSet
+    {
+    public:
+        EnvelopeSet(uint32 num_channels, uint32 base_samples = 64, uint32 factor = 8);
+
+        uint32 numChannels() const { return static_cast<uint32>(m_channels.size()); }
+        EnvelopePyramid& channel(uint32 channel_index) { return *m_channels[channel_index]; }
+        const EnvelopePyramid& channel(uint32 channel_index) const { return *m_channels[channel_index]; }
+
+        /**
+         * Append the valid scans of a block, its channels beyond numChannels() are ignored.
+         */
+        void append(const DecodedBlock& block);
+        void append(const ScaledBlockF32& block);
+        void append(const ScaledBlockF64& block);
+
+        void clear();
+
+    private:
+        EnvelopeSet(const EnvelopeSet&);
+        EnvelopeSet& operator=(const EnvelopeSet&);
+
+        template <typename T>
+        void appendBlock(const SampleBlock<T>& block);
+
+        std::vector<std::unique_ptr<EnvelopePyramid>> m_channels;
+    };
+}
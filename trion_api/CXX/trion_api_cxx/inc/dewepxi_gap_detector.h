@@ -0,0 +1,188 @@
+// Copyright DEWETRON 2024
+
+#pragma once
+
+#include "dewepxi_acq_engine.h"
+#include "dewepxi_scan_decoder.h"
+#include "dewepxi_types.h"
+#include <limits>
+#include <vector>
+
+
+namespace trion
+{
+    /**
+     * A range of samples lost by a buffer overrun.
+     * Sample indices are BoardCnt0 values (sample clock edges),
+     * extended to 64 bit.
+     */
+    struct GapRecord
+    {
+        uint64 first_sample;    // first lost sample
+        uint64 samples;         // number of lost samples
+        uint64 first_analog_sample; // first lost analog sample, first_sample minus the ADC delay
+        uint64 first_scan;      // engine scan index of the first block after the gap
+        uint64 recovery_ns;     // overrun detection to the first block after the gap, 0 if unknown
+    };
+
+
+    /**
+     * Data loss detection of one board, based on BoardCnt0.
+     *
+     * BoardCnt0 has to be used with Source_A=ACQ_CLK, so it counts
+     * one per scan. The counter of the first scan of every block is
+     * compared with the expected value, a difference is a gap. This
+     * finds the exact lost range of an overrun recovered by the
+     * AcquisitionEngine (BLOCK_FLAG_DATA_LOST), and any other
+     * discontinuity of the sample stream.
+     *
+     * The analog samples of a scan belong to the sample clock edge
+     * CMD_BOARD_ADC_DELAY scans earlier, their gap starts at
+     * GapRecord::first_analog_sample.
+     *
+     * Has to be used by the consumer thread of the blocks.
+     */
+    class GapDetector
+    {
+    public:
+        GapDetector();
+
+        /**
+         * Locate BoardCnt0 in the scan descriptor and read CMD_BOARD_ADC_DELAY.
+         * @return ERR_NONE, ERR_BOARDCNT_CHANNEL_NOT_VALID without BoardCnt0
+         *         or the error of reading the delay
+         */
+        int init(sint32 board_id, const ScanDescriptor& sd);
+
+        /**
+         * Locate BoardCnt0 in the scan descriptor.
+         * @param adc_delay analog delay in scans
+         * @return ERR_NONE or ERR_BOARDCNT_CHANNEL_NOT_VALID without BoardCnt0
+         */
+        int init(const ScanDescriptor& sd, uint32 adc_delay = 0);
+
+        /**
+         * @param counter_offset byte offset of BoardCnt0 within a scan
+         * @param adc_delay analog delay in scans
+         */
+        void init(uint32 counter_offset, uint32 adc_delay = 0);
+
+        /**
+         * Forget the stream position, eg after a restart of the acquisition.
+         */
+        void reset();
+
+        /**
+         * Check a block, in the order received from the engine.
+         * A BLOCK_FLAG_DATA_LOST descriptor starts the recovery time
+         * measurement and is not a gap itself.
+         * @return true if samples were lost before the block, gap is set
+         */
+        bool process(const BlockDescriptor& block, GapRecord& gap);
+
+        /**
+         * Sample index following the last processed block.
+         */
+        uint64 nextSample() const { return m_next_sample; }
+
+        uint32 adcDelay() const { return m_adc_delay; }
+
+        uint64 gaps() const { return m_gaps; }
+        uint64 lostSamples() const { return m_lost_samples; }
+
+        /**
+         * Counter jumps backwards (eg a counter reset), the detector
+         * resyncs to the new counter without reporting a gap.
+         */
+        uint64 resyncs() const { return m_resyncs; }
+
+    private:
+        uint32 m_counter_offset;
+        uint32 m_adc_delay;
+        bool m_started;
+        uint64 m_next_sample;
+        uint64 m_lost_ns;           // detection time of a pending data lost marker
+        uint64 m_gaps;
+        uint64 m_lost_samples;
+        uint64 m_resyncs;
+    };
+
+
+    enum GapFill
+    {
+        GAP_FILL_NAN,               // NaN, integer blocks use the minimum value
+        GAP_FILL_HOLD               // repeat the last sample before the gap
+    };
+
+    /**
+     * Fills lost samples in decoded blocks, so downstream
+     * processing keeps one value per sample clock edge.
+     */
+    template <typename T>
+    class GapFiller
+    {
+    public:
+        explicit GapFiller(GapFill mode = GAP_FILL_NAN)
+            : m_mode(mode)
+        {
+        }
+
+        /**
+         * Remember the last scan of a decoded block for GAP_FILL_HOLD.
+         */
+        void observe(const SampleBlock<T>& block)
+        {
+            if (block.scans() == 0)
+            {
+                return;
+            }
+            m_last.resize(block.numChannels());
+            for (uint32 c = 0; c < block.numChannels(); ++c)
+            {
+                m_last[c] = block.channel(c)[block.scans() - 1];
+            }
+        }
+
+        /**
+         * Write fill values for up to scans samples, starting at dst_offset,
+         * and set the number of valid scans of the block.
+         * Large gaps are filled by repeated calls.
+         * @return the number of filled scans (limited by the block capacity)
+         */
+        uint32 fill(SampleBlock<T>& block, uint32 dst_offset, uint64 scans) const
+        {
+            if (dst_offset >= block.capacity())
+            {
+                return 0;
+            }
+            const uint32 count = scans < block.capacity() - dst_offset
+                ? static_cast<uint32>(scans) : block.capacity() - dst_offset;
+
+            for (uint32 c = 0; c < block.numChannels(); ++c)
+            {
+                T value = fillValue();
+                if (m_mode == GAP_FILL_HOLD)
+                {
+                    value = c < m_last.size() ? m_last[c] : T();
+                }
+                T* dst = block.channel(c) + dst_offset;
+                for (uint32 i = 0; i < count; ++i)
+                {
+                    dst[i] = value;
+                }
+            }
+            block.setScans(dst_offset + count);
+            return count;
+        }
+
+    private:
+        static T fillValue()
+        {
+            return std::numeric_limits<T>::has_quiet_NaN
+                ? std::numeric_limits<T>::quiet_NaN() : std::numeric_limits<T>::min();
+        }
+
+        GapFill m_mode;
+        std::vector<T> m_last;
+    };
+}
@@ -0,0 +1,112 @@
+// Copyright DEWETRON 2024
+
+#pragma once
+
+#include "dewepxi_types.h"
+#include <atomic>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+
+namespace trion
+{
+    /**
+     * Percentiles of a LatencyHistogram in nanoseconds.
+     */
+    struct LatencySummary
+    {
+        uint64 count;
+        uint64 p50_ns;
+        uint64 p99_ns;
+        uint64 p999_ns;
+        uint64 max_ns;
+        double mean_ns;
+    };
+
+
+    /**
+     * Log-bucketed latency histogram (HDR style).
+     *
+     * Values below 64 ns are counted exactly, above that every power of
+     * two is split into 32 sub-buckets, so a reported percentile is at most
+     * about 3 % above the recorded value. The range covers the full uint64.
+     *
+     * record() is lock-free and may be called from several threads.
+     * Percentiles may be read at any time, they are consistent once the
+     * writers are idle.
+     */
+    class LatencyHistogram
+    {
+    public:
+        LatencyHistogram();
+
+        void record(uint64 ns)
+        {
+            m_counts[bucketIndex(ns)].fetch_add(1, std::memory_order_relaxed);
+            m_count.fetch_add(1, std::memory_order_relaxed);
+            m_total.fetch_add(ns, std::memory_order_relaxed);
+
+            uint64 max = m_max.load(std::memory_order_relaxed);
+            while (ns > max && !m_max.compare_exchange_weak(max, ns, std::memory_order_relaxed))
+            {
+            }
+        }
+
+        /**
+         * Clear all counts, not concurrently with record().
+         */
+        void reset();
+
+        uint64 count() const { return m_count.load(std::memory_order_relaxed); }
+        uint64 max() const { return m_max.load(std::memory_order_relaxed); }
+        double mean() const;
+
+        /**
+         * Highest value equivalent to the bucket holding the percentile.
+         * @param percentile 0..100
+         */
+        uint64 percentile(double percentile) const;
+
+        LatencySummary summary() const;
+
+        static uint32 bucketIndex(uint64 ns)
+        {
+            if (ns < 2 * SUB_BUCKETS)
+            {
+                return static_cast<uint32>(ns);
+            }
+            const uint32 shift = highestBit(ns) - SUB_BUCKET_BITS;
+            return shift * SUB_BUCKETS + static_cast<uint32>(ns >> shift);
+        }
+
+        /**
+         * Highest value counted in a bucket.
+         */
+        static uint64 bucketUpper(uint32 index);
+
+    private:
+        LatencyHistogram(const LatencyHistogram&);
+        LatencyHistogram& operator=(const LatencyHistogram&);
+
+        static const uint32 SUB_BUCKET_BITS = 5;
+        static const uint32 SUB_BUCKETS = 1u << SUB_BUCKET_BITS;
+        static const uint32 NUM_BUCKETS = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+        static uint32 highestBit(uint64 value)
+        {
+#if defined(_MSC_VER)
+            unsigned long bit;
+            _BitScanReverse64(&bit, value);
+            return static_cast<uint32>(bit);
+#else
+            return 63 - static_cast<uint32>(__builtin_clzll(value));
+#endif
+        }
+
+        std::atomic<uint64> m_counts[NUM_BUCKETS];
+        std::atomic<uint64> m_count;
+        std::atomic<uint64> m_total;
+        std::atomic<uint64> m_max;
+    };
+}
@@ -0,0 +1,116 @@
+// Copyright DEWETRON 2024
+
+#pragma once
+
+#include "dewepxi_types.h"
+
+
+namespace trion
+{
+    /**
+     * Chunked columnar recording file written by the Recorder.
+     *
+     * Layout, little endian:
+     *   RecordFileHeader
+     *   RecordChannelInfo[num_channels]
+     *   ScanDescriptor_V3 document (xml_size bytes, no terminating zero)
+     *   padding up to header_size
+     *   chunks
+     *
+     * A chunk holds chunk_scans consecutive scans (the last one may be
+     * shorter), stored as one column per channel:
+     *   RecordChunkHeader
+     *   RecordColumn[num_columns]
+     *   column data, every column starts on a RECORD_COLUMN_ALIGNMENT boundary
+     *   padding up to chunk_size
+     *
+     * Raw columns hold scans * 4 bytes. Packed columns (see
+     * dewepxi_sample_codec.h) vary in size, a chunk may mix both encodings.
+     *
+     * A raw scan recording (RawRecorder) stores the scans as read from the
+     * circular buffer instead, one chunk per written block with a single
+     * RECORD_ENCODING_RAW_SCANS column of scans * scan_size bytes. The
+     * channels are decoded at read time with the embedded ScanDescriptor.
+     * Raw scan chunks are not padded, chunk_size is a multiple of 4 only.
+     *
+     * header_size and chunk_size of decoded recordings are multiples of
+     * RECORD_ALIGNMENT, so every chunk is one aligned write and can be
+     * mapped directly.
+     * The scaled value of a raw sample is raw * scale_value - scale_offset,
+     * like the "scalevalue" and "scaleoffset" reported by the API.
+     *
+     * time_ns of a chunk is the absolute time of its first scan (ns since
+     * 1970-01-01, timing source time), 0 while the timing was not locked.
+     *
+     * total_scans and num_chunks are written when the recording is closed.
+     * They are 0 in a file of an interrupted recording, its chunks can
+     * still be read by following chunk_size.
+     */
+
+    const uint32 RECORD_VERSION = 1;
+    const uint32 RECORD_ALIGNMENT = 4096;
+    const uint32 RECORD_COLUMN_ALIGNMENT = 64;
+
+    enum RecordEncoding
+    {
+        RECORD_ENCODING_RAW_I32 = 0,       // sint32 per sample, as decoded by the ScanDecoder
+        RECORD_ENCODING_DELTA_PACKED = 1,  // RAW_I32 samples encoded by encodeSamples()
+        RECORD_ENCODING_RAW_SCANS = 2      // whole scans of the circular buffer, all channels
+    };
+
+    struct RecordFileHeader
+    {
+        char magic[8];                      // "TRIONREC"
+        uint32 version;                     // RECORD_VERSION
+        uint32 header_size;                 // bytes before the first chunk
+        double sample_rate;                 // scans/s
+        uint32 num_channels;
+        uint32 chunk_scans;                 // scans of a full chunk
+        uint32 channel_offset;              // RecordChannelInfo table, from the file start
+        uint32 xml_offset;                  // ScanDescriptor_V3, from the file start
+        uint32 xml_size;
+        uint32 scan_size;                   // bytes per scan of raw scan chunks, 0 if decoded
+        uint64 total_scans;
+        uint64 num_chunks;
+    };
+
+    struct RecordChannelInfo
+    {
+        char name[48];                      // zero terminated, eg "AI0"
+        uint32 channel_type;                // ChannelType
+        uint32 index;                       // channel index of the ScanDescriptor
+        uint32 sample_size;                 // bits within the scan
+        uint32 sample_offset;               // bit position within the scan
+        double scale_value;
+        double scale_offset;
+    };
+
+    struct RecordChunkHeader
+    {
+        char magic[4];                      // "TRCK"
+        uint32 scans;
+        uint64 first_scan;                  // scan index since the recording start
+        uint64 chunk_size;                  // bytes up to the next chunk
+        uint32 num_columns;
+        uint32 header_size;                 // header and column table, aligned
+        uint64 time_ns;                     // time of the first scan, 0 if unknown
+    };
+
+    struct RecordColumn
+    {
+        uint32 encoding;                    // RecordEncoding
+        uint32 reserved;
+        uint64 offset;                      // from the chunk start
+        uint64 size;                        // bytes
+    };
+
+    static_assert(sizeof(RecordFileHeader) == 64, "RecordFileHeader layout");
+    static_assert(sizeof(RecordChannelInfo) == 80, "RecordChannelInfo layout");
+    static_assert(sizeof(RecordChunkHeader) == 40, "RecordChunkHeader layout");
+    static_assert(sizeof(RecordColumn) == 24, "RecordColumn layout");
+
+    inline uint64 recordAlign(uint64 size, uint32 alignment)
+    {
+        return (size + alignment - 1) / alignment * alignment;
+    }
+}
@@ -0,0 +1,148 @@
+// Copyright DEWETRON 2024
+
+#pragma once
+
+#include "dewepxi_record_format.h"
+#include "dewepxi_scan_decoder.h"
+#include "dewepxi_types.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+
+namespace trion
+{
+    /**
+     * Index entry of one chunk.
+     */
+    struct RecordChunkIndex
+    {
+        uint64 first_scan;
+        uint32 scans;
+        uint64 offset;              // from the file start
+        uint64 time_ns;             // time of the first scan, 0 if unknown
+    };
+
+    /**
+     * Samples of one channel within one chunk, pointing into the mapped file.
+     */
+    struct RecordSpan
+    {
+        const sint32* data;         // nullptr unless stored as RAW_I32, see RecordReader::read()
+        uint64 first_scan;
+        uint32 scans;
+    };
+
+
+    /**
+     * Random access reader of a recording file (see dewepxi_record_format.h).
+     *
+     * open() maps the file and builds a sparse index with one entry per
+     * chunk by following the chunk headers, no sample is read. Queries by
+     * scan range or time range return spans into the mapped chunks, one per
+     * chunk touched (zero copy). They stay valid until close(). Packed
+     * columns and raw scans cannot be referenced, read() decodes them into
+     * a buffer. Raw scans are decoded with the embedded ScanDescriptor.
+     *
+     * Times are either seconds since the recording start (sample rate) or
+     * absolute nanoseconds interpolated from the chunk time stamps, which
+     * exist for chunks recorded with a locked clock.
+     */
+    class RecordReader
+    {
+    public:
+        RecordReader();
+        ~RecordReader();
+
+        /**
+         * @return false if the file cannot be mapped or is no recording, see lastError()
+         */
+        bool open(const std::string& path);
+        void close();
+        bool isOpen() const { return m_data != nullptr; }
+
+        const RecordFileHeader& header() const { return m_header; }
+        double sampleRate() const { return m_header.sample_rate; }
+        uint32 numChannels() const { return static_cast<uint32>(m_channels.size()); }
+        const RecordChannelInfo& channel(uint32 channel_index) const { return m_channels[channel_index]; }
+
+        /**
+         * @return the index of the channel or -1
+         */
+        int findChannel(const std::string& name) const;
+
+        /**
+         * The embedded ScanDescriptor_V3 document.
+         */
+        std::string scanDescriptor() const;
+
+        /**
+         * Scans of all complete chunks, also of an interrupted recording.
+         */
+        uint64 totalScans() const { return m_total_scans; }
+        const std::vector<RecordChunkIndex>& chunks() const { return m_index; }
+
+        /**
+         * Zero-copy spans of the scans [first_scan, end_scan) of a channel.
+         * @return the number of scans in spans, less if the range exceeds the recording
+         */
+        uint64 spans(uint32 channel_index, uint64 first_scan, uint64 end_scan, std::vector<RecordSpan>& spans) const;
+
+        /**
+         * Copy the scans [first_scan, end_scan) of a channel to dst, decoding
+         * packed columns and raw scans. A packed column is decoded from the
+         * start of its chunk.
+         * @return the number of scans copied, less if the range exceeds the recording
+         *         or a packed column is corrupt
+         */
+        uint64 read(uint32 channel_index, uint64 first_scan, uint64 end_scan, sint32* dst) const;
+
+        /**
+         * Spans of the time range [t0, t1), in seconds since the recording start.
+         */
+        uint64 spansForTime(uint32 channel_index, double t0, double t1, std::vector<RecordSpan>& spans) const;
+
+        /**
+         * Spans of the absolute time range [t0_ns, t1_ns).
+         * @return the number of scans, 0 without time stamps
+         */
+        uint64 spansForAbsoluteTime(uint32 channel_index, uint64 t0_ns, uint64 t1_ns, std::vector<RecordSpan>& spans) const;
+
+        /**
+         * First scan at or after an absolute time.
+         * @return false if no chunk has a time stamp
+         */
+        bool scanAtTime(uint64 time_ns, uint64& scan) const;
+
+        /**
+         * Absolute time of a scan, from the time stamp of its chunk.
+         * @return false if the chunk has no time stamp
+         */
+        bool timeOfScan(uint64 scan, uint64& time_ns) const;
+
+        const std::string& lastError() const { return m_error; }
+
+    private:
+        RecordReader(const RecordReader&);
+        RecordReader& operator=(const RecordReader&);
+
+        bool buildIndex();
+        size_t chunkOf(uint64 scan) const;
+        RecordColumn column(const RecordChunkIndex& entry, uint32 channel_index) const;
+
+        std::string m_error;
+        const uint8* m_data;
+        uint64 m_size;
+#if defined(_WIN32)
+        void* m_file;
+        void* m_mapping;
+#endif
+
+        RecordFileHeader m_header;
+        std::vector<RecordChannelInfo> m_channels;
+        std::unique_ptr<ScanDecoder> m_decoder;     // of raw scan recordings
+        std::vector<RecordChunkIndex> m_index;
+        std::vector<size_t> m_stamped;      // index entries with a time stamp
+        uint64 m_total_scans;
+    };
+}
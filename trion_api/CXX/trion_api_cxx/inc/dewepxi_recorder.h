@@ -0,0 +1,249 @@
+// Copyright DEWETRON 2024
+
+#pragma once
+
+#include "dewepxi_clock_model.h"
+#include "dewepxi_record_format.h"
+#include "dewepxi_ringbuffer.h"
+#include "dewepxi_scan_decoder.h"
+#include "dewepxi_types.h"
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+namespace trion
+{
+    class EnvelopeSet;
+
+    /**
+     * Records decoded blocks into a chunked columnar file
+     * (see dewepxi_record_format.h).
+     *
+     * write() copies the channels of a DecodedBlock into the columns of the
+     * chunk being filled. A full chunk is handed to a writer thread, which
+     * stores it with one aligned write while the next chunk is filled in
+     * the second buffer. write() only waits if the writer is still busy
+     * with the previous chunk, see stalls().
+     *
+     * With RECORD_ENCODING_DELTA_PACKED the writer thread encodes the
+     * columns of a chunk before storing it, a column which does not get
+     * smaller is stored raw.
+     *
+     * Has to be used by a single thread.
+     */
+    class Recorder
+    {
+    public:
+        Recorder();
+        ~Recorder();
+
+        /**
+         * Create the file and write its header.
+         * @param sd scan descriptor of the recorded board, embedded into the header
+         * @param decoder channels and scaling (ScanDecoder::readScaling) of the blocks
+         * @param sample_rate scans/s
+         * @param chunk_scans scans per chunk
+         * @return false if the file cannot be created, see lastError()
+         */
+        bool open(const std::string& path, const ScanDescriptor& sd, const ScanDecoder& decoder,
+                  double sample_rate, uint32 chunk_scans = 65536);
+
+        /**
+         * Write the pending scans, update the header and close the file.
+         * @return false if a write failed
+         */
+        bool close();
+
+        bool isOpen() const { return m_file != nullptr; }
+
+        /**
+         * Column encoding of the next recording, RECORD_ENCODING_RAW_I32 by default.
+         * Has no effect on an open recording.
+         */
+        void setEncoding(RecordEncoding encoding);
+        RecordEncoding encoding() const { return m_encoding; }
+
+        /**
+         * Feed the raw samples of every stored chunk into envelopes, from the
+         * writer thread, so they trail the recorded scans by at most one chunk.
+         * Has no effect on an open recording, nullptr disables it.
+         */
+        void setEnvelopes(EnvelopeSet* envelopes);
+
+        /**
+         * Stamp the chunks with the absolute time of their first scan,
+         * while the clock is locked and fitted.
+         * @param first_sample sample index of the clock of the first recorded scan
+         */
+        void setClock(const ClockModel* clock, uint64 first_sample = 0);
+
+        /**
+         * Append the scans of a block decoded by the decoder passed to open().
+         * @return false if a previous write failed
+         */
+        bool write(const DecodedBlock& block);
+
+        uint64 scans() const { return m_scans; }
+        uint64 chunks() const { return m_chunk_index; }
+
+        /**
+         * Bytes written to the file so far, including headers and padding.
+         */
+        uint64 bytesWritten() const;
+
+        /**
+         * Number of write() calls that waited for the writer thread and their total wait.
+         */
+        uint64 stalls() const { return m_stalls; }
+        uint64 stallNs() const { return m_stall_ns; }
+
+        const std::string& lastError() const { return m_error; }
+
+    private:
+        Recorder(const Recorder&);
+        Recorder& operator=(const Recorder&);
+
+        struct ChunkBuffer
+        {
+            uint8* data;
+            uint64 size;            // bytes to write
+        };
+
+        void startChunk();
+        bool submitChunk();
+        void run();
+        void appendEnvelopes(const uint8* chunk) const;
+        uint64 packChunk(const uint8* chunk, uint8* dst) const;
+        bool writeFile(const void* data, uint64 size);
+
+        std::FILE* m_file;
+        std::string m_error;
+        uint32 m_num_channels;
+        uint32 m_chunk_scans;
+        uint32 m_chunk_header_size;
+        uint64 m_column_size;
+        uint64 m_chunk_size;
+        RecordEncoding m_encoding;
+        EnvelopeSet* m_envelopes;
+        RecordFileHeader m_header;
+
+        uint8* m_memory;            // both chunk buffers, RECORD_ALIGNMENT aligned
+        ChunkBuffer m_buffers[2];
+        uint8* m_packed;            // packed chunk of the writer thread
+        uint32 m_fill_buffer;
+        uint32 m_fill_scans;
+        uint64 m_scans;
+        uint64 m_chunk_index;
+
+        uint64 m_stalls;
+        uint64 m_stall_ns;
+
+        const ClockModel* m_clock;
+        uint64 m_clock_first_sample;
+
+        // Writer thread
+        mutable std::mutex m_mutex;
+        std::condition_variable m_cv;
+        std::thread m_writer;
+        ChunkBuffer* m_pending;     // chunk handed to the writer
+        bool m_stop;
+        bool m_failed;
+        uint64 m_bytes_written;
+    };
+
+
+    /**
+     * Records the scans of a board as read from the circular buffer,
+     * without decoding (see RECORD_ENCODING_RAW_SCANS).
+     *
+     * write() stores the spans of a block as one chunk, its header and
+     * both spans of a wrapped range go to the file with a single gathering
+     * write (writev) straight from the circular buffer. It returns once the
+     * kernel has accepted all bytes, the scans can then be released.
+     * RecordReader decodes the channels when they are read.
+     *
+     * Has to be used by a single thread.
+     */
+    class RawRecorder
+    {
+    public:
+        RawRecorder();
+        ~RawRecorder();
+
+        /**
+         * Create the file and write its header.
+         * @param sd scan descriptor of the recorded board, embedded into the header
+         * @param decoder channel names and scaling (ScanDecoder::readScaling) stored in the header
+         * @param sample_rate scans/s
+         * @return false if the file cannot be created, see lastError()
+         */
+        bool open(const std::string& path, const ScanDescriptor& sd, const ScanDecoder& decoder, double sample_rate);
+
+        /**
+         * Update the header and close the file.
+         * @return false if a write failed
+         */
+        bool close();
+
+        bool isOpen() const { return m_fd >= 0; }
+
+        /**
+         * Stamp the chunks with the absolute time of their first scan,
+         * see Recorder::setClock().
+         */
+        void setClock(const ClockModel* clock, uint64 first_sample = 0);
+
+        /**
+         * Append the scans of spans as one chunk.
+         * @return false if the write failed, see lastError()
+         */
+        bool write(const ScanSpans& spans);
+
+        uint64 scans() const { return m_scans; }
+        uint64 chunks() const { return m_chunks; }
+
+        /**
+         * Bytes written to the file so far, including headers.
+         */
+        uint64 bytesWritten() const { return m_bytes_written; }
+
+        /**
+         * Time spent in the file writes.
+         */
+        uint64 writeNs() const { return m_write_ns; }
+
+        const std::string& lastError() const { return m_error; }
+
+    private:
+        RawRecorder(const RawRecorder&);
+        RawRecorder& operator=(const RawRecorder&);
+
+        struct WritePart
+        {
+            const void* data;
+            uint64 size;
+        };
+
+        /**
+         * Write up to 3 parts with one gathering write, repeated for the rest
+         * of a partial write.
+         */
+        bool writeParts(const WritePart* parts, uint32 count);
+
+        int m_fd;
+        std::string m_error;
+        uint32 m_scan_size;
+        RecordFileHeader m_header;
+        uint64 m_scans;
+        uint64 m_chunks;
+        uint64 m_bytes_written;
+        uint64 m_write_ns;
+
+        const ClockModel* m_clock;
+        uint64 m_clock_first_sample;
+    };
+}
@@ -0,0 +1,131 @@
+// Copyright DEWETRON 2024
+
+#pragma once
+
+#include "dewepxi_ringbuffer.h"
+#include "dewepxi_types.h"
+
+
+namespace trion
+{
+    /**
+     * Coalesced access to the circular buffer of one board.
+     *
+     * Reduces the driver round trips per processing iteration:
+     *  - the buffer geometry is read once (RingBufferView::init)
+     *  - the read position is tracked locally, CMD_BUFFER_0_ACT_SAMPLE_POS
+     *    is only read by start()
+     *  - released scans are collected and freed in chunks, or immediately
+     *    when the free memory drops below a watermark
+     *
+     * The free memory is estimated from the last available count, which is
+     * what CMD_BUFFER_0_AVAIL_FREE_MEM reports, without an extra round trip.
+     *
+     * Released scans stay available to the driver until they are freed:
+     * CMD_BUFFER_0_WAIT_AVAIL_NO_SAMPLE returns at once while the collected
+     * scans fill a block. Callers waiting for new scans use unfreed().
+     */
+    class ReleaseManager
+    {
+    public:
+        /**
+         * @param ring initialized buffer view, has to outlive the manager
+         */
+        explicit ReleaseManager(RingBufferView& ring);
+
+        /**
+         * Free released scans once at least chunk_scans are collected.
+         * 0 or 1 frees with every release().
+         */
+        void setChunk(uint32 chunk_scans);
+
+        /**
+         * Free released scans immediately while the free memory
+         * is below watermark_bytes. 0 disables the watermark.
+         */
+        void setWatermark(uint32 watermark_bytes);
+
+        /**
+         * Read the current read position, has to be called after
+         * CMD_START_ACQUISITION. Resets all counters.
+         * @return TRION API error code
+         */
+        int start();
+
+        /**
+         * Query the available scans (one driver call) and return
+         * the scans not handed out before as spans.
+         * @return TRION API error code (eg ERR_BUFFER_OVERWRITE)
+         */
+        int acquire(ScanSpans& spans, uint32 max_scans = 0xffffffff);
+
+        /**
+         * Update the free memory estimate with an available count
+         * queried by the caller (eg CMD_BUFFER_0_WAIT_AVAIL_NO_SAMPLE).
+         */
+        void noteAvailable(uint32 avail_scans);
+
+        /**
+         * Release scans, they are freed according to chunk and watermark.
+         * @return TRION API error code of the free, ERR_NONE if deferred
+         */
+        int release(uint32 scans);
+
+        /**
+         * Free all collected scans now.
+         * @return TRION API error code
+         */
+        int commit();
+
+        /**
+         * Query CMD_BUFFER_0_AVAIL_FREE_MEM from the driver.
+         * @return TRION API error code
+         */
+        int queryFreeMemory(sint32& free_bytes);
+
+        /**
+         * Estimated free memory of the circular buffer in bytes.
+         */
+        uint32 freeMemory() const;
+
+        /**
+         * First scan not yet handed out by acquire().
+         */
+        sint64 readPos() const { return m_read_pos; }
+
+        uint32 pending() const { return m_pending; }
+
+        /**
+         * Scans the driver counts as available: the last available count
+         * minus the scans freed since, including pending().
+         */
+        uint32 unfreed() const { return m_unfreed; }
+        uint64 freedScans() const { return m_freed; }
+        uint64 freeCalls() const { return m_free_calls; }
+        uint64 driverCalls() const { return m_driver_calls; }
+
+        /**
+         * Driver calls per second since the previous call of this method
+         * (or since start()).
+         */
+        double driverCallsPerSecond();
+
+        const RingBufferView& ring() const { return m_ring; }
+
+    private:
+        RingBufferView& m_ring;
+        uint32 m_chunk;
+        uint32 m_watermark;
+
+        sint64 m_read_pos;          // first scan not yet handed out
+        uint32 m_outstanding;       // handed out, not yet freed
+        uint32 m_unfreed;           // held by the driver at the last available count
+        uint32 m_pending;           // released, not yet freed
+        uint64 m_freed;
+
+        uint64 m_free_calls;
+        uint64 m_driver_calls;
+        uint64 m_rate_calls;
+        uint64 m_rate_start_ns;
+    };
+}
@@ -0,0 +1,188 @@
+// Copyright DEWETRON 2024
+
+#pragma once
+
+#include "dewepxi_apicore.h"
+#include "dewepxi_types.h"
+#include <vector>
+
+
+namespace trion
+{
+    /**
+     * Map a CMD_BUFFER_0_* command id to the command of another buffer.
+     * Rule: BUFFER_i+1_ = BUFFER_i_ + offset (0x0020)
+     */
+    inline uint32 bufferCommand(uint32 buffer0_command, int buffer)
+    {
+        return buffer0_command + 0x0020 * buffer;
+    }
+
+    /**
+     * One contiguous run of scans within the circular buffer.
+     */
+    struct ScanSpan
+    {
+        const uint8* data;      // first byte of the first scan
+        uint32 scans;           // number of complete scans
+    };
+
+    /**
+     * A range of scans split at the buffer end.
+     * span[0] starts at the read position, span[1] (if count == 2)
+     * continues at the buffer start.
+     */
+    struct ScanSpans
+    {
+        ScanSpan span[2];
+        uint32 count;
+
+        uint32 totalScans() const
+        {
+            return (count > 0 ? span[0].scans : 0) + (count > 1 ? span[1].scans : 0);
+        }
+
+        bool wrapped() const
+        {
+            return count > 1;
+        }
+    };
+
+
+    /**
+     * Zero-copy view on the sample circular buffer of one board.
+     *
+     * The buffer geometry (start, end, total size, scan size) is read once
+     * with init(). Available scans are then handed out as at most two
+     * contiguous spans, so consumers can iterate whole runs without the
+     * per-sample wrap around check.
+     */
+    class RingBufferView
+    {
+    public:
+        explicit RingBufferView(int board_id, int buffer = 0);
+
+        /**
+         * Read the buffer geometry from the API.
+         * Has to be called after CMD_UPDATE_PARAM_ALL (or
+         * CMD_UPDATE_PARAM_ACQ_BUFFER) and before acquisition start.
+         * @return TRION API error code
+         */
+        int init();
+
+        /**
+         * Set the buffer geometry without querying the API.
+         * @param start_pos first byte of the circular buffer
+         * @param end_pos first byte behind the circular buffer
+         * @param scan_size size of one scan in bytes
+         */
+        void setGeometry(sint64 start_pos, sint64 end_pos, uint32 scan_size);
+
+        /**
+         * Query the available scans and the current read position
+         * and return them as spans.
+         * @param spans receives the available scans
+         * @param max_scans limits the number of returned scans
+         * @return TRION API error code (eg ERR_BUFFER_OVERWRITE)
+         */
+        int acquire(ScanSpans& spans, uint32 max_scans = 0xffffffff);
+
+        /**
+         * Split a range of scans starting at read_pos into spans.
+         * Does not access the API.
+         */
+        ScanSpans spansAt(sint64 read_pos, uint32 scans) const;
+
+        /**
+         * Advance a buffer position by a number of scans, handling the wrap around.
+         */
+        sint64 advance(sint64 pos, uint32 scans) const;
+
+        /**
+         * Release scans to the driver (CMD_BUFFER_0_FREE_NO_SAMPLE).
+         * @return TRION API error code
+         */
+        int release(uint32 scans);
+
+        int boardId() const { return m_board_id; }
+        int buffer() const { return m_buffer; }
+        sint64 startPos() const { return m_start_pos; }
+        sint64 endPos() const { return m_end_pos; }
+        uint32 totalSize() const { return m_total_size; }
+        uint32 scanSize() const { return m_scan_size; }
+
+        /**
+         * Capacity of the circular buffer in scans.
+         */
+        uint32 capacity() const { return m_scan_size ? m_total_size / m_scan_size : 0; }
+
+    private:
+        int m_board_id;
+        int m_buffer;
+        sint64 m_start_pos;
+        sint64 m_end_pos;
+        uint32 m_total_size;
+        uint32 m_scan_size;
+    };
+
+
+    /**
+     * Hands out the scans of ScanSpans as contiguous blocks of a fixed size.
+     *
+     * Blocks within one span point into the circular buffer (zero copy).
+     * Only the block crossing the buffer end is stitched: its tail before
+     * the end and its head behind the start are copied into a scratch area
+     * allocated once by the constructor. A block is valid until the next
+     * call of next() and until the scans are released.
+     *
+     * Usage:
+     *   stitcher.begin(spans);
+     *   while (stitcher.next(block)) process(block.data, block.scans);
+     */
+    class ScanStitcher
+    {
+    public:
+        /**
+         * @param scan_size size of one scan in bytes
+         * @param block_scans maximum number of scans per block
+         */
+        ScanStitcher(uint32 scan_size, uint32 block_scans);
+
+        /**
+         * Start handing out the scans of spans.
+         */
+        void begin(const ScanSpans& spans);
+
+        /**
+         * Get the next contiguous block of up to blockScans() scans.
+         * The last block of the spans may be shorter.
+         * @return false if all scans were handed out
+         */
+        bool next(ScanSpan& block);
+
+        uint32 scanSize() const { return m_scan_size; }
+        uint32 blockScans() const { return m_block_scans; }
+
+        /**
+         * Bytes copied into the scratch area and bytes handed out in place.
+         */
+        uint64 stitchedBytes() const { return m_stitched_bytes; }
+        uint64 passedBytes() const { return m_passed_bytes; }
+        uint64 stitchedBlocks() const { return m_stitched_blocks; }
+        uint64 passedBlocks() const { return m_passed_blocks; }
+        void resetStats();
+
+    private:
+        uint32 m_scan_size;
+        uint32 m_block_scans;
+        std::vector<uint8> m_scratch;
+        ScanSpans m_spans;
+        uint32 m_span;                  // current span
+        uint32 m_offset;                // scans handed out of the current span
+
+        uint64 m_stitched_bytes;
+        uint64 m_passed_bytes;
+        uint64 m_stitched_blocks;
+        uint64 m_passed_blocks;
+    };
+}
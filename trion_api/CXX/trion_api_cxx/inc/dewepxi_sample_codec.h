@@ -0,0 +1,100 @@
+// Copyright DEWETRON 2024
+
+#pragma once
+
+#include "dewepxi_sample_kernels.h"
+#include "dewepxi_types.h"
+
+
+namespace trion
+{
+    /**
+     * Lossless block codec for decoded sample columns (sint32 per sample).
+     *
+     * A column is split into blocks of SAMPLE_CODEC_BLOCK samples, the last
+     * block is padded with its last sample. Every block stores the residuals
+     * of one predictor, chosen per block for the smallest bit width:
+     *   SAMPLE_PREDICTOR_NONE      r[i] = x[i]
+     *   SAMPLE_PREDICTOR_DELTA     r[i] = x[i] - x[i-1]
+     *   SAMPLE_PREDICTOR_LINEAR    r[i] = x[i] - 2 * x[i-1] + x[i-2]
+     * The prediction continues over block boundaries, x[-1] and x[-2] of the
+     * first block are 0. Residuals are computed modulo 2^32 and zigzag
+     * mapped (0, -1, 1, -2, ... to 0, 1, 2, 3, ...).
+     *
+     * Block layout:
+     *   uint8 predictor << 6 | width (0..32)
+     *   width * 16 bytes: 4 interleaved lanes of width uint32 words, lane j
+     *   packs the residuals j, j + 4, j + 8, ... from the lowest bit up
+     *
+     * A 24 bit signal with n bits of noise is stored with about n + 2 bits
+     * per sample instead of 32.
+     */
+
+    const uint32 SAMPLE_CODEC_BLOCK = 128;
+
+    enum SamplePredictor
+    {
+        SAMPLE_PREDICTOR_NONE = 0,
+        SAMPLE_PREDICTOR_DELTA = 1,
+        SAMPLE_PREDICTOR_LINEAR = 2
+    };
+
+    /**
+     * Encode one full block.
+     * @param history x[-2] and x[-1] of the block
+     * @return bytes written to dst, at most sampleCodecMaxSize(SAMPLE_CODEC_BLOCK)
+     */
+    typedef uint32 (*EncodeSampleBlock)(const sint32* src, const sint32 history[2], uint8* dst);
+
+    /**
+     * Decode one full block.
+     * @param size bytes available at src
+     * @return bytes read from src, 0 if the block is corrupt or truncated
+     */
+    typedef uint32 (*DecodeSampleBlock)(const uint8* src, uint64 size, const sint32 history[2], sint32* dst);
+
+    /**
+     * Codec kernel table of one instruction set.
+     */
+    struct SampleCodecKernels
+    {
+        SimdLevel level;
+        EncodeSampleBlock encode_block;
+        DecodeSampleBlock decode_block;
+    };
+
+    /**
+     * Codec kernels of the highest supported instruction set.
+     */
+    const SampleCodecKernels& sampleCodecKernels();
+
+    /**
+     * Codec kernels of a specific instruction set.
+     * @return nullptr if not built in or not supported by the CPU
+     */
+    const SampleCodecKernels* sampleCodecKernels(SimdLevel level);
+
+    /**
+     * Worst case encoded size of count samples.
+     */
+    inline uint64 sampleCodecMaxSize(uint64 count)
+    {
+        return (count + SAMPLE_CODEC_BLOCK - 1) / SAMPLE_CODEC_BLOCK * (1 + SAMPLE_CODEC_BLOCK * sizeof(sint32));
+    }
+
+    /**
+     * Encode count samples.
+     * @param dst at least sampleCodecMaxSize(count) bytes
+     * @return encoded bytes
+     */
+    uint64 encodeSamples(const sint32* src, uint32 count, uint8* dst);
+    uint64 encodeSamples(const SampleCodecKernels& kernels, const sint32* src, uint32 count, uint8* dst);
+
+    /**
+     * Decode the first count samples of an encoded column.
+     * @param size encoded bytes at src
+     * @return false if the data is corrupt or holds less than count samples
+     */
+    bool decodeSamples(const uint8* src, uint64 size, uint32 count, sint32* dst);
+    bool decodeSamples(const SampleCodecKernels& kernels, const uint8* src, uint64 size, uint32 count, sint32* dst);
+}
@@ -0,0 +1,168 @@
+// Copyright DEWETRON 2024
+
+#pragma once
+
+#include "dewepxi_types.h"
+
+
+namespace trion
+{
+    /**
+     * Instruction set used by the sample kernels.
+     */
+    enum SimdLevel
+    {
+        SIMD_LEVEL_SCALAR = 0,
+        SIMD_LEVEL_SSE41,
+        SIMD_LEVEL_AVX2,
+        SIMD_LEVEL_AVX512
+    };
+
+    /**
+     * Position of a 24 bit sample within its 32 bit scan word.
+     */
+    enum Sample24Alignment
+    {
+        SAMPLE24_RIGHT_ALIGNED,     // bits 0..23, same as formatRawData(value, 24, 0)
+        SAMPLE24_LEFT_ALIGNED       // bits 8..31, same as formatRawData(value, 24, 8)
+    };
+
+    /**
+     * Extract count 24 bit samples of one channel.
+     * @param src scan word of the channel in the first scan
+     * @param stride distance between two samples in 32 bit words (scan size / 4)
+     * @param count number of samples
+     * @param dst sign extended samples, contiguous
+     */
+    typedef void (*Extract24ToInt32)(const uint32* src, uint32 stride, uint32 count, sint32* dst);
+    typedef void (*Extract24ToFloat)(const uint32* src, uint32 stride, uint32 count, float* dst);
+
+    /**
+     * Extract and scale count 24 bit samples of one channel in one pass.
+     * dst[i] = sample[i] * gain + offset, float kernels compute in single precision.
+     */
+    typedef void (*Scale24ToFloat)(const uint32* src, uint32 stride, uint32 count,
+                                   double gain, double offset, float* dst);
+    typedef void (*Scale24ToDouble)(const uint32* src, uint32 stride, uint32 count,
+                                    double gain, double offset, double* dst);
+
+    /**
+     * Number of channels deinterleaved together by the group kernels.
+     */
+    const uint32 SAMPLE24_GROUP = 8;
+
+    /**
+     * Extract count scans of SAMPLE24_GROUP adjacent channels at once.
+     * The kernels load whole scan words and transpose them in registers,
+     * which is much faster than extracting the channels one by one.
+     * @param src scan word of the first channel in the first scan
+     * @param stride distance between two scans in 32 bit words (scan size / 4)
+     * @param dst one contiguous destination per channel
+     */
+    typedef void (*Extract24x8ToInt32)(const uint32* src, uint32 stride, uint32 count, sint32* const* dst);
+    typedef void (*Extract24x8ToFloat)(const uint32* src, uint32 stride, uint32 count, float* const* dst);
+
+    /**
+     * Extract and scale SAMPLE24_GROUP adjacent channels, each with its own gain and offset.
+     */
+    typedef void (*Scale24x8ToFloat)(const uint32* src, uint32 stride, uint32 count,
+                                     const double* gain, const double* offset, float* const* dst);
+    typedef void (*Scale24x8ToDouble)(const uint32* src, uint32 stride, uint32 count,
+                                      const double* gain, const double* offset, double* const* dst);
+
+    /**
+     * Kernel table of one instruction set.
+     */
+    struct SampleKernels
+    {
+        SimdLevel level;
+        Extract24ToInt32 right_i32;
+        Extract24ToInt32 left_i32;
+        Extract24ToFloat right_f32;
+        Extract24ToFloat left_f32;
+        Scale24ToFloat right_scaled_f32;
+        Scale24ToFloat left_scaled_f32;
+        Scale24ToDouble right_scaled_f64;
+        Scale24ToDouble left_scaled_f64;
+        Extract24x8ToInt32 right_x8_i32;
+        Extract24x8ToInt32 left_x8_i32;
+        Extract24x8ToFloat right_x8_f32;
+        Extract24x8ToFloat left_x8_f32;
+        Scale24x8ToFloat right_x8_scaled_f32;
+        Scale24x8ToFloat left_x8_scaled_f32;
+        Scale24x8ToDouble right_x8_scaled_f64;
+        Scale24x8ToDouble left_x8_scaled_f64;
+    };
+
+    /**
+     * Highest instruction set supported by CPU and operating system.
+     */
+    SimdLevel detectSimdLevel();
+
+    const char* simdLevelName(SimdLevel level);
+
+    /**
+     * Kernels of the highest supported instruction set.
+     * The selection is done once on first use.
+     */
+    const SampleKernels& sampleKernels();
+
+    /**
+     * Kernels of a specific instruction set.
+     * @return nullptr if not built in or not supported by the CPU
+     */
+    const SampleKernels* sampleKernels(SimdLevel level);
+
+
+    inline void extract24(const uint32* src, uint32 stride, uint32 count, Sample24Alignment alignment, sint32* dst)
+    {
+        const SampleKernels& k = sampleKernels();
+        (alignment == SAMPLE24_LEFT_ALIGNED ? k.left_i32 : k.right_i32)(src, stride, count, dst);
+    }
+
+    inline void extract24(const uint32* src, uint32 stride, uint32 count, Sample24Alignment alignment, float* dst)
+    {
+        const SampleKernels& k = sampleKernels();
+        (alignment == SAMPLE24_LEFT_ALIGNED ? k.left_f32 : k.right_f32)(src, stride, count, dst);
+    }
+
+    inline void scale24(const uint32* src, uint32 stride, uint32 count, Sample24Alignment alignment,
+                        double gain, double offset, float* dst)
+    {
+        const SampleKernels& k = sampleKernels();
+        (alignment == SAMPLE24_LEFT_ALIGNED ? k.left_scaled_f32 : k.right_scaled_f32)(src, stride, count, gain, offset, dst);
+    }
+
+    inline void scale24(const uint32* src, uint32 stride, uint32 count, Sample24Alignment alignment,
+                        double gain, double offset, double* dst)
+    {
+        const SampleKernels& k = sampleKernels();
+        (alignment == SAMPLE24_LEFT_ALIGNED ? k.left_scaled_f64 : k.right_scaled_f64)(src, stride, count, gain, offset, dst);
+    }
+
+    inline void extract24x8(const uint32* src, uint32 stride, uint32 count, Sample24Alignment alignment, sint32* const* dst)
+    {
+        const SampleKernels& k = sampleKernels();
+        (alignment == SAMPLE24_LEFT_ALIGNED ? k.left_x8_i32 : k.right_x8_i32)(src, stride, count, dst);
+    }
+
+    inline void extract24x8(const uint32* src, uint32 stride, uint32 count, Sample24Alignment alignment, float* const* dst)
+    {
+        const SampleKernels& k = sampleKernels();
+        (alignment == SAMPLE24_LEFT_ALIGNED ? k.left_x8_f32 : k.right_x8_f32)(src, stride, count, dst);
+    }
+
+    inline void scale24x8(const uint32* src, uint32 stride, uint32 count, Sample24Alignment alignment,
+                          const double* gain, const double* offset, float* const* dst)
+    {
+        const SampleKernels& k = sampleKernels();
+        (alignment == SAMPLE24_LEFT_ALIGNED ? k.left_x8_scaled_f32 : k.right_x8_scaled_f32)(src, stride, count, gain, offset, dst);
+    }
+
+    inline void scale24x8(const uint32* src, uint32 stride, uint32 count, Sample24Alignment alignment,
+                          const double* gain, const double* offset, double* const* dst)
+    {
+        const SampleKernels& k = sampleKernels();
+        (alignment == SAMPLE24_LEFT_ALIGNED ? k.left_x8_scaled_f64 : k.right_x8_scaled_f64)(src, stride, count, gain, offset, dst);
+    }
+}
@@ -0,0 +1,281 @@
+// Copyright DEWETRON 2024
+
+#pragma once
+
+#include "dewepxi_ringbuffer.h"
+#include "dewepxi_types.h"
+#include <string>
+#include <vector>
+
+
+namespace trion
+{
+    enum ChannelType
+    {
+        CHANNEL_TYPE_ANALOG,
+        CHANNEL_TYPE_COUNTER,
+        CHANNEL_TYPE_DISCRETE,
+        CHANNEL_TYPE_OTHER
+    };
+
+    /**
+     * One Channel/Sample entry of a ScanDescriptor_V3 document.
+     * Counter channels may have several samples (sub channels).
+     */
+    struct ScanChannel
+    {
+        std::string name;
+        std::string type;
+        ChannelType channel_type;
+        uint32 index;
+        uint32 sample_size;         // in bits
+        uint32 sample_offset;       // in bits, relative to the scan start
+        int sub_channel;            // -1 if the sample has no subChannel attribute
+    };
+
+
+    /**
+     * ScanDescriptor_V3 document of one board.
+     * Throws std::runtime_error if the document cannot be parsed.
+     */
+    class ScanDescriptor
+    {
+    public:
+        explicit ScanDescriptor(const std::string& sd_xml);
+
+        /**
+         * Size of one scan in bytes.
+         */
+        uint32 scanSize() const { return m_scan_size_bytes; }
+
+        const std::vector<ScanChannel>& channels() const { return m_channels; }
+
+        /**
+         * @return the index of the channel in channels() or -1
+         */
+        int findChannel(const std::string& name) const;
+
+        /**
+         * The original xml document.
+         */
+        const std::string& xml() const { return m_xml; }
+
+        /**
+         * Board element of the document, eg "BoardId1".
+         */
+        const std::string& boardTarget() const { return m_board_target; }
+
+    private:
+        std::string m_xml;
+        std::string m_board_target;
+        uint32 m_scan_size_bytes;
+        std::vector<ScanChannel> m_channels;
+    };
+
+
+    /**
+     * Structure of arrays storage for decoded samples.
+     * Samples of one channel are stored contiguously.
+     */
+    template <typename T>
+    class SampleBlock
+    {
+    public:
+        SampleBlock()
+            : m_num_channels(0)
+            , m_capacity(0)
+            , m_stride(0)
+            , m_scans(0)
+        {
+        }
+
+        SampleBlock(uint32 num_channels, uint32 capacity)
+            : m_num_channels(0)
+            , m_capacity(0)
+            , m_stride(0)
+            , m_scans(0)
+        {
+            resize(num_channels, capacity);
+        }
+
+        void resize(uint32 num_channels, uint32 capacity)
+        {
+            m_num_channels = num_channels;
+            m_capacity = capacity;
+            // Start every channel on a 64 byte boundary relative to the first one
+            m_stride = (capacity + 15) & ~15u;
+            size_t size = static_cast<size_t>(m_stride) * num_channels;
+            m_samples.assign(size ? size : 1, T());
+            m_scans = 0;
+        }
+
+        T* channel(uint32 channel_index)
+        {
+            return &m_samples[channel_index * m_stride];
+        }
+
+        const T* channel(uint32 channel_index) const
+        {
+            return &m_samples[channel_index * m_stride];
+        }
+
+        uint32 numChannels() const { return m_num_channels; }
+        uint32 capacity() const { return m_capacity; }
+
+        /**
+         * Number of valid scans per channel.
+         */
+        uint32 scans() const { return m_scans; }
+        void setScans(uint32 scans) { m_scans = scans; }
+
+    private:
+        std::vector<T> m_samples;
+        uint32 m_num_channels;
+        uint32 m_capacity;
+        uint32 m_stride;
+        uint32 m_scans;
+    };
+
+    /**
+     * Raw samples, counter and discrete channels hold the zero extended raw bits.
+     */
+    typedef SampleBlock<sint32> DecodedBlock;
+
+    /**
+     * Samples scaled to engineering units.
+     */
+    typedef SampleBlock<float> ScaledBlockF32;
+    typedef SampleBlock<double> ScaledBlockF64;
+
+
+    /**
+     * Linear scaling to engineering units: value = raw * gain + offset
+     */
+    struct ChannelScaling
+    {
+        double gain;
+        double offset;
+    };
+
+    /**
+     * Read the range scaling of an analog channel from the API.
+     * The API reports "scalevalue" and "scaleoffset" for
+     * value = raw * scalevalue - scaleoffset (see SetScaling in trion_sdk_util).
+     * @param target the channel, eg "BoardID1/AI0"
+     * @return TRION API error code
+     */
+    int readChannelScaling(const std::string& target, ChannelScaling& scaling);
+
+
+    /**
+     * Sample extraction kernel.
+     * Extracts nr_scans samples of one channel. src points to the
+     * sample container of the first scan, stride is the scan size.
+     */
+    typedef void (*ExtractKernel)(const uint8* src, uint32 stride, uint32 nr_scans, sint32* dst,
+                                  uint32 bit_shift, uint32 bit_size);
+
+
+    /**
+     * ScanDescriptor_V3 based sample decoder.
+     *
+     * The descriptor is compiled once into a decode plan, which holds one
+     * extraction kernel per channel specialized for the sample size,
+     * bit offset and type. decode() deinterleaves whole spans of scans
+     * into a DecodedBlock without any per sample dispatch.
+     *
+     * Signed 24 bit samples in 32 bit words, right aligned (offset 0) or
+     * left aligned (offset 8), use the runtime selected SIMD kernels.
+     * Groups of SAMPLE24_GROUP such channels in adjacent scan words are
+     * deinterleaved together by the group kernels. Left aligned samples are divided by 256 rounding toward zero,
+     * like formatRawData(value, 24, 8), for every scan size.
+     */
+    class ScanDecoder
+    {
+    public:
+        explicit ScanDecoder(const ScanDescriptor& sd);
+        explicit ScanDecoder(const std::string& sd_xml);
+
+        uint32 scanSize() const { return m_scan_size_bytes; }
+        uint32 numChannels() const { return static_cast<uint32>(m_channels.size()); }
+        const ScanChannel& channel(uint32 channel_index) const { return m_channels[channel_index]; }
+
+        /**
+         * @return the index of the channel within the decoded block or -1
+         */
+        int findChannel(const std::string& name) const;
+
+        /**
+         * Decode a span of scans into block, starting at scan dst_offset.
+         * The block has to be sized for numChannels().
+         * @return the number of decoded scans (limited by the block capacity)
+         */
+        uint32 decode(const ScanSpan& span, DecodedBlock& block, uint32 dst_offset = 0) const;
+
+        /**
+         * Decode up to two spans into block and set the number of valid scans.
+         * @return the number of decoded scans
+         */
+        uint32 decode(const ScanSpans& spans, DecodedBlock& block) const;
+
+        /**
+         * Decode one channel of a span of scans.
+         * @param dst span.scans samples
+         * @return the number of decoded scans, 0 for an invalid channel
+         */
+        uint32 decodeChannel(uint32 channel_index, const ScanSpan& span, sint32* dst) const;
+
+        /**
+         * Read the scaling of all analog channels from the API.
+         * Has to be called once after CMD_UPDATE_PARAM_ALL.
+         * Other channels keep gain 1 and offset 0.
+         * @return TRION API error code
+         */
+        int readScaling();
+
+        void setScaling(uint32 channel_index, const ChannelScaling& scaling);
+        const ChannelScaling& scaling(uint32 channel_index) const { return m_scaling[channel_index]; }
+
+        /**
+         * Decode and scale a span of scans in one pass.
+         * 24 bit analog channels in 32 bit words are converted by the fused SIMD kernels,
+         * the raw values are never stored.
+         * @return the number of decoded scans (limited by the block capacity)
+         */
+        uint32 decode(const ScanSpan& span, ScaledBlockF32& block, uint32 dst_offset = 0) const;
+        uint32 decode(const ScanSpan& span, ScaledBlockF64& block, uint32 dst_offset = 0) const;
+
+        uint32 decode(const ScanSpans& spans, ScaledBlockF32& block) const;
+        uint32 decode(const ScanSpans& spans, ScaledBlockF64& block) const;
+
+    private:
+        void compile();
+
+        template <typename T>
+        uint32 decodeScaled(const ScanSpan& span, SampleBlock<T>& block, uint32 dst_offset) const;
+
+        enum Simd24
+        {
+            SIMD24_NONE,
+            SIMD24_RIGHT,
+            SIMD24_LEFT
+        };
+
+        struct DecodeStep
+        {
+            ExtractKernel kernel;
+            uint32 byte_offset;         // offset of the sample container within the scan
+            uint32 bit_shift;           // bit position within the container
+            uint32 bit_size;
+            bool is_signed;
+            Simd24 simd24;              // 24 bit in a 32 bit word, usable by the fused kernels
+            uint32 group;               // SAMPLE24_GROUP: first channel of a group, decoded by the group kernels
+        };
+
+        std::string m_board_target;
+        uint32 m_scan_size_bytes;
+        std::vector<ScanChannel> m_channels;
+        std::vector<DecodeStep> m_plan;
+        std::vector<ChannelScaling> m_scaling;
+    };
+}
@@ -0,0 +1,142 @@
+// Copyright DEWETRON 2024
+
+#pragma once
+
+#include "dewepxi_acq_engine.h"
+#include "dewepxi_ringbuffer.h"
+#include "dewepxi_scan_decoder.h"
+#include "dewepxi_types.h"
+#include <vector>
+
+
+namespace trion
+{
+    /**
+     * Scans of one board belonging to a merged frame range.
+     */
+    struct MergedBoard
+    {
+        uint32 board_index;     // index within the AcquisitionEngine
+        ScanSpans spans;        // counter and discrete samples of the frames
+        ScanSpans analog_spans; // analog samples of the frames, shifted by the ADC delay
+        uint64 first_scan;      // board scan index of spans
+    };
+
+    /**
+     * A range of frames: the same frame index refers to the same
+     * sample clock edge on all boards.
+     */
+    struct MergedFrame
+    {
+        int error;              // TRION API error of a board reader, frames is 0 on error
+        uint64 first_frame;
+        uint32 frames;
+        std::vector<MergedBoard> boards;
+    };
+
+
+    /**
+     * Aligns the scans of boards sharing one sample clock (TRION-SYNC-BUS)
+     * into a multi-board frame stream.
+     *
+     * Every board needs BoardCnt0 with Source_A=ACQ_CLK and Reset=OnRestart,
+     * so its counter is the sample clock index. The first counter value of
+     * each board gives its scan offset against the other boards, the
+     * analog samples are additionally delayed by CMD_BOARD_ADC_DELAY scans.
+     *
+     * Alignment is done per block: a frame range is a pair of spans per
+     * board into its circular buffer, no sample is copied. The counter at
+     * the start of every board range is verified.
+     *
+     * After a buffer overrun of a board (BLOCK_FLAG_DATA_LOST) the board
+     * is realigned from the BoardCnt0 of its first block after the
+     * overrun. Frames lost on that board are skipped on all boards, the
+     * next MergedFrame::first_frame continues after them.
+     *
+     * The merger is the consumer of one engine consumer per board and has
+     * to be used by a single thread.
+     */
+    class ScanMerger
+    {
+    public:
+        explicit ScanMerger(AcquisitionEngine& engine);
+
+        /**
+         * Add a board, reads CMD_BOARD_ADC_DELAY and locates BoardCnt0.
+         * @param consumer engine consumer of the board, exclusively used by the merger
+         * @return TRION API error code, ERR_BOARDCNT_CHANNEL_NOT_VALID without BoardCnt0
+         */
+        int addBoard(uint32 board_index, uint32 consumer, const ScanDescriptor& sd);
+
+        /**
+         * Add a board with known layout.
+         * @param counter_offset byte offset of BoardCnt0 within a scan
+         * @param adc_delay analog delay in scans
+         */
+        void addBoard(uint32 board_index, uint32 consumer, uint32 counter_offset, uint32 adc_delay);
+
+        uint32 numBoards() const { return static_cast<uint32>(m_boards.size()); }
+
+        /**
+         * Get the next frames available on all boards.
+         * @param max_frames limits the frames returned
+         * @param timeout_ms time to wait for data of the slowest board
+         * @return false on timeout
+         */
+        bool next(MergedFrame& frame, uint32 max_frames, uint32 timeout_ms);
+
+        /**
+         * Release the frames to the engine, in the order they were received.
+         */
+        void release(const MergedFrame& frame);
+
+        /**
+         * Board ranges whose first counter did not match the frame index.
+         */
+        uint64 misalignments() const { return m_misalignments; }
+
+        /**
+         * Scans of a board skipped to align its first scan to frame 0.
+         */
+        uint64 skippedScans(uint32 board) const { return m_boards[board].skip; }
+
+        /**
+         * Frames skipped because a board lost their scans by an overrun.
+         */
+        uint64 lostFrames() const { return m_lost_frames; }
+
+    private:
+        struct Board
+        {
+            uint32 board_index;
+            uint32 consumer;
+            uint32 counter_offset;
+            uint32 adc_delay;
+
+            bool started;
+            uint64 start_scan;      // first scan received
+            uint32 first_counter;   // BoardCnt0 of start_scan
+            uint64 skip;            // board scan of frame 0 at the first alignment
+            sint64 scan_offset;     // board scan of a frame minus the frame index
+            uint64 base_scan;       // first unreleased scan
+            sint64 base_pos;        // buffer position of base_scan
+            uint64 available_end;   // scans received from the engine
+            BlockDescriptor last;   // last block received, used for the release
+        };
+
+        bool receive(Board& board, uint32 timeout_ms, int& error);
+        void align();
+        void realign(Board& board);
+        uint64 scanOf(const Board& board, uint64 frame) const;
+        sint64 position(const Board& board, uint64 scan) const;
+        uint32 counterAt(const Board& board, uint64 scan) const;
+
+        AcquisitionEngine& m_engine;
+        std::vector<Board> m_boards;
+        bool m_aligned;
+        uint32 m_frame0_counter;    // BoardCnt0 of frame 0
+        uint64 m_next_frame;
+        uint64 m_misalignments;
+        uint64 m_lost_frames;
+    };
+}
@@ -0,0 +1,113 @@
+// Copyright DEWETRON 2024
+
+#pragma once
+
+#include "dewepxi_types.h"
+#include <atomic>
+#include <vector>
+
+
+namespace trion
+{
+    /**
+     * Bounded lock-free single producer / single consumer queue.
+     *
+     * push() may only be called by one thread, pop() by one other thread.
+     * The capacity is rounded up to a power of two.
+     */
+    template <typename T>
+    class SpscQueue
+    {
+    public:
+        explicit SpscQueue(uint32 capacity)
+            : m_mask(0)
+            , m_head(0)
+            , m_cached_tail(0)
+            , m_tail(0)
+            , m_cached_head(0)
+        {
+            uint32 size = 2;
+            while (size < capacity)
+            {
+                size <<= 1;
+            }
+            m_buffer.resize(size);
+            m_mask = size - 1;
+        }
+
+        /**
+         * Producer: append a value.
+         * @return false if the queue is full
+         */
+        bool push(const T& value)
+        {
+            const uint32 tail = m_tail.load(std::memory_order_relaxed);
+            if (tail - m_cached_head > m_mask)
+            {
+                m_cached_head = m_head.load(std::memory_order_acquire);
+                if (tail - m_cached_head > m_mask)
+                {
+                    return false;
+                }
+            }
+
+            m_buffer[tail & m_mask] = value;
+            m_tail.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        /**
+         * Consumer: remove the oldest value.
+         * @return false if the queue is empty
+         */
+        bool pop(T& value)
+        {
+            const uint32 head = m_head.load(std::memory_order_relaxed);
+            if (head == m_cached_tail)
+            {
+                m_cached_tail = m_tail.load(std::memory_order_acquire);
+                if (head == m_cached_tail)
+                {
+                    return false;
+                }
+            }
+
+            value = m_buffer[head & m_mask];
+            m_head.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        /**
+         * Number of queued values, exact only if called by producer or consumer.
+         */
+        uint32 size() const
+        {
+            return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire);
+        }
+
+        bool empty() const
+        {
+            return size() == 0;
+        }
+
+        uint32 capacity() const
+        {
+            return m_mask + 1;
+        }
+
+    private:
+        SpscQueue(const SpscQueue&);
+        SpscQueue& operator=(const SpscQueue&);
+
+        std::vector<T> m_buffer;
+        uint32 m_mask;
+
+        // Consumer side
+        alignas(64) std::atomic<uint32> m_head;
+        uint32 m_cached_tail;
+
+        // Producer side
+        alignas(64) std::atomic<uint32> m_tail;
+        uint32 m_cached_head;
+    };
+}
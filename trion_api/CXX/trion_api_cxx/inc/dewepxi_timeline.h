@@ -0,0 +1,140 @@
+// Copyright DEWETRON 2024
+
+#pragma once
+
+#include "dewepxi_types.h"
+#include <vector>
+
+
+namespace trion
+{
+    /**
+     * Extends a wrapping 32 bit counter to 64 bit.
+     *
+     * Every counter of a batch is unwrapped against the same reference,
+     * the last value of the previous batch, as reference + the signed 32 bit
+     * difference. There is no dependency between the values of a batch, so
+     * batches are converted with SIMD. The reference moves every 256 values.
+     *
+     * Counter values may be unordered (eg frames of several channels), as
+     * long as 256 consecutive values span less than half the counter range
+     * (2^31 ticks, 3.5 minutes of a 10 MHz counter).
+     */
+    class CounterUnwrapper
+    {
+    public:
+        CounterUnwrapper();
+
+        /**
+         * Start over, the next counter defines the upper 32 bit as 0.
+         */
+        void reset();
+
+        /**
+         * Start over at a known 64 bit value.
+         */
+        void reset(uint64 last);
+
+        uint64 unwrap(uint32 counter);
+
+        /**
+         * Unwrap a batch of counters.
+         */
+        void unwrap(const uint32* counters, uint32 count, uint64* out);
+
+        /**
+         * Unwrap a 32 bit field of an array of structures,
+         * eg &frames[0].SyncCounter with stride sizeof(BOARD_CAN_FRAME).
+         */
+        void unwrap(const void* first, uint32 stride, uint32 count, uint64* out);
+
+        /**
+         * Last unwrapped value.
+         */
+        uint64 last() const { return m_last; }
+
+    private:
+        bool m_started;
+        uint64 m_last;
+    };
+
+
+    /**
+     * Unit of a 32 bit counter.
+     */
+    enum CounterBase
+    {
+        COUNTER_BASE_SAMPLES,       // sample clock, eg BoardCnt0 with Source_A=ACQ_CLK or "Sample CNT"
+        COUNTER_BASE_TICKS          // time base counter, eg SyncCounter "10 MHzCount"
+    };
+
+    /**
+     * Common 64 bit time line of one board.
+     *
+     * Every counter stream of the board (BoardCnt of the scans, SyncCounter
+     * of CAN and UART frames, ...) is a source with an own unwrapper. The
+     * unwrapped values are converted to ticks of the time base (10 MHz by
+     * default), so scans and asynchronous frames compare as plain integers.
+     *
+     * All counters have to be reset at the same acquisition start.
+     * A source has to be used by one thread.
+     */
+    class BoardTimeline
+    {
+    public:
+        /**
+         * @param sample_rate sample rate of the board (AcqProp/SampleRate)
+         * @param tick_rate frequency of the time base counter
+         */
+        explicit BoardTimeline(double sample_rate, double tick_rate = 10000000.0);
+
+        /**
+         * @return the source id
+         */
+        uint32 addSource(CounterBase base);
+
+        uint32 numSources() const { return static_cast<uint32>(m_sources.size()); }
+
+        CounterUnwrapper& unwrapper(uint32 source) { return m_sources[source].unwrapper; }
+
+        /**
+         * Reset all sources, at acquisition start.
+         */
+        void reset();
+
+        /**
+         * Unwrap a batch of counters of a source and convert them to ticks.
+         */
+        void toTicks(uint32 source, const uint32* counters, uint32 count, uint64* ticks);
+
+        /**
+         * Strided version for a counter field of an array of structures.
+         */
+        void toTicks(uint32 source, const void* first, uint32 stride, uint32 count, uint64* ticks);
+
+        void toTicks(uint32 source, const BOARD_CAN_FRAME* frames, uint32 count, uint64* ticks);
+        void toTicks(uint32 source, const BOARD_CAN_FD_FRAME* frames, uint32 count, uint64* ticks);
+        void toTicks(uint32 source, const BOARD_UART_RAW_FRAME* frames, uint32 count, uint64* ticks);
+
+        uint64 sampleToTicks(uint64 sample) const;
+        uint64 ticksToSample(uint64 ticks) const;
+
+        double sampleRate() const { return m_sample_rate; }
+        double tickRate() const { return m_tick_rate; }
+
+    private:
+        struct Source
+        {
+            CounterUnwrapper unwrapper;
+            CounterBase base;
+        };
+
+        void convert(const Source& source, uint64* values, uint32 count) const;
+
+        double m_sample_rate;
+        double m_tick_rate;
+        uint64 m_ticks_per_sample;      // 0 if not an integer ratio
+        double m_ticks_per_sample_f;
+        std::vector<Source> m_sources;
+    };
+}
@@ -0,0 +1,1092 @@
+// Copyright DEWETRON 2024
+
+#include "dewepxi_acq_engine.h"
+#include "dewepxi_buffer_telemetry.h"
+#include "dewepxi_release_manager.h"
+#include "dewepxi_spsc_queue.h"
+#include "dewepxi_thread_util.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <new>
+#include <thread>
+
+
+namespace trion
+{
+    namespace
+    {
+        /**
+         * Wait of a reader for a block the driver cannot wait for, as long as
+         * the scan rate is not yet measured. Releases and pops end it early.
+         */
+        const uint64 UNKNOWN_RATE_WAIT_NS = 200000;
+    }
+
+
+    uint64 steadyClockNs()
+    {
+        return static_cast<uint64>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+
+    struct AcquisitionEngine::Consumer
+    {
+        Consumer(uint32 consumer_id, uint32 board_index, int board_id, uint32 queue_capacity)
+            : id(consumer_id)
+            , board(board_index)
+            , board_id(board_id)
+            , queue(queue_capacity)
+            , released_until(0)
+            , dropped(false)
+            , dropped_at(0)
+            , queue_full(0)
+            , lag(0)
+            , max_lag(0)
+            , lost_until(0)
+            , waiting(false)
+            , drop_reported(false)
+            , read_pos(0)
+            , published_until(0)
+            , lost_pending(false)
+            , lost_ns(0)
+            , held_ns(0)
+            , held(false)
+            , pending_error(ERR_NONE)
+            , pending_error_scan(0)
+            , pending_error_ns(0)
+        {
+        }
+
+        // The queue is cache line aligned, which plain new does not honor before C++17
+        static void* operator new(size_t size)
+        {
+            void* memory = allocateAligned(size, alignof(Consumer));
+            if (!memory)
+            {
+                throw std::bad_alloc();
+            }
+            return memory;
+        }
+
+        static void operator delete(void* memory)
+        {
+            freeAligned(memory);
+        }
+
+        void notify();
+        bool popBlock(BlockDescriptor& block);
+
+        uint32 id;
+        uint32 board;
+        int board_id;
+        SpscQueue<BlockDescriptor> queue;
+        std::atomic<uint64> released_until;     // written by the consumer
+        std::atomic<bool> dropped;
+        std::atomic<uint64> dropped_at;
+        std::atomic<uint64> queue_full;
+        std::atomic<uint64> lag;
+        std::atomic<uint64> max_lag;
+        std::atomic<uint64> lost_until;         // queued scans before are overwritten
+
+        // Consumer wake-up, only used if the consumer waits in waitPop()
+        std::mutex wait_mutex;
+        std::condition_variable wait_cv;
+        std::atomic<bool> waiting;
+
+        // Consumer thread state
+        bool drop_reported;
+
+        // Reader thread state
+        sint64 read_pos;                        // first scan not yet published
+        uint64 published_until;
+        bool lost_pending;                      // BLOCK_FLAG_DATA_LOST not yet queued
+        uint64 lost_ns;                         // overrun detection time
+        uint64 held_ns;                         // wake-up of the scans deferred by a full queue, 0 if none
+        std::atomic<bool> held;                 // held_ns != 0, a pop wakes the reader
+
+        // Error descriptor which did not fit into the full queue, delivered once it drained
+        std::atomic<int> pending_error;
+        uint64 pending_error_scan;
+        uint64 pending_error_ns;
+    };
+
+
+    struct AcquisitionEngine::BoardReader
+    {
+        BoardReader(uint32 board_index, int board_id, int buffer)
+            : ring(board_id, buffer)
+            , releaser(ring)
+            , monitor(board_id, buffer)
+            , index(board_index)
+            , running(false)
+            , last_error(ERR_NONE)
+            , lat_count(0)
+            , lat_min(~0ull)
+            , lat_max(0)
+            , lat_total(0)
+            , driver_calls(0)
+            , drop_slowest(false)
+            , drop_scans(0)
+            , recover_overrun(false)
+            , cpu(-1)
+            , fixed_cpu(false)
+            , realtime_priority(0)
+            , pinned(false)
+            , realtime(false)
+            , released_until(0)
+            , scan_base(0)
+            , epoch_start(0)
+            , block_scans(1)
+            , scan_ns(0.0)
+            , rate_scans(0)
+            , rate_ns(0)
+            , progress(0)
+            , idle(false)
+        {
+        }
+
+        void run();
+        void setupThread();
+        uint64 publish(uint64 available_end, uint64 wake_ns, bool tail);
+        bool deferredBlocks() const;
+        uint64 nextBlockEnd(uint64 available_end) const;
+        void updateRate(uint64 available_end, uint64 wake_ns);
+        void publishError(int err, uint64 wake_ns);
+        int clearOverrun(uint64 wake_ns, uint64 available_end);
+        bool publishLost(Consumer& consumer);
+        void dropSlowest(uint64 available_end);
+        uint64 releasedBy(const Consumer& consumer) const;
+        uint64 slowestRelease(uint64 available_end) const;
+        void recordLatency(uint64 ns);
+        void notifyConsumers();
+        void signalProgress();
+        void waitProgress(uint64 seen, uint64 deadline_ns);
+
+        RingBufferView ring;
+        ReleaseManager releaser;
+        BufferMonitor monitor;
+        LatencyHistogram loop_hist;             // wake-up to the next wait
+        LatencyHistogram driver_hist;           // free calls
+        LatencyHistogram recovery_hist;         // overrun to the next publish
+        uint32 index;
+        std::vector<Consumer*> consumers;
+        std::thread thread;
+        std::atomic<bool> running;
+        std::atomic<int> last_error;
+
+        std::atomic<uint64> lat_count;
+        std::atomic<uint64> lat_min;
+        std::atomic<uint64> lat_max;
+        std::atomic<uint64> lat_total;
+        std::atomic<uint64> driver_calls;
+
+        // Drop policy, set before start()
+        bool drop_slowest;
+        uint32 drop_scans;                      // unfreed scans that trigger a drop
+        bool recover_overrun;
+
+        // Thread setup, set before start()
+        int cpu;
+        bool fixed_cpu;                         // set by setBoardCpu()
+        int realtime_priority;
+        std::atomic<bool> pinned;
+        std::atomic<bool> realtime;
+
+        // Reader thread state
+        uint64 released_until;                  // scans handed to the release manager
+        uint64 scan_base;                       // scan index of the release manager start
+        uint64 epoch_start;                     // first scan after the last overrun
+        uint32 block_scans;                     // CMD_BUFFER_0_BLOCK_SIZE, scans per published block
+        double scan_ns;                         // measured scan period, 0 until known
+        uint64 rate_scans;                      // start of the scan period measurement
+        uint64 rate_ns;
+
+        // Reader wake-up by release() and pop() while the consumers hold all scans
+        std::atomic<uint64> progress;
+        std::mutex progress_mutex;
+        std::condition_variable progress_cv;
+        std::atomic<bool> idle;
+    };
+
+
+    void AcquisitionEngine::Consumer::notify()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiting.load(std::memory_order_relaxed))
+        {
+            std::lock_guard<std::mutex> lock(wait_mutex);
+            wait_cv.notify_one();
+        }
+    }
+
+
+    bool AcquisitionEngine::Consumer::popBlock(BlockDescriptor& block)
+    {
+        if (!dropped.load(std::memory_order_acquire))
+        {
+            // Scans queued before an overrun are reused by the driver after the recovery
+            while (queue.pop(block))
+            {
+                if (block.scans == 0 || block.first_scan + block.scans > lost_until.load(std::memory_order_acquire))
+                {
+                    return true;
+                }
+            }
+
+            // The reader error follows all queued blocks
+            const int error = pending_error.exchange(ERR_NONE, std::memory_order_acquire);
+            if (error == ERR_NONE)
+            {
+                return false;
+            }
+            block = BlockDescriptor();
+            block.board_index = board;
+            block.board_id = board_id;
+            block.consumer = id;
+            block.error = error;
+            block.first_scan = pending_error_scan;
+            block.wake_ns = pending_error_ns;
+            block.publish_ns = steadyClockNs();
+            return true;
+        }
+
+        // Queued blocks may already be overwritten, report the drop instead
+        BlockDescriptor discard;
+        while (queue.pop(discard))
+        {
+        }
+        if (drop_reported)
+        {
+            return false;
+        }
+        drop_reported = true;
+
+        block = BlockDescriptor();
+        block.board_index = board;
+        block.board_id = board_id;
+        block.consumer = id;
+        block.flags = BLOCK_FLAG_CONSUMER_DROPPED;
+        block.first_scan = dropped_at.load(std::memory_order_relaxed);
+        block.publish_ns = steadyClockNs();
+        return true;
+    }
+
+
+    void AcquisitionEngine::BoardReader::setupThread()
+    {
+        pinned.store(cpu >= 0 && setCurrentThreadAffinity(cpu));
+        realtime.store(realtime_priority > 0 && setCurrentThreadRealtime(realtime_priority));
+    }
+
+    void AcquisitionEngine::BoardReader::run()
+    {
+        setupThread();
+
+        const int board_id = ring.boardId();
+        const uint32 wait_cmd = bufferCommand(CMD_BUFFER_0_WAIT_AVAIL_NO_SAMPLE, ring.buffer());
+        uint64 available_end = 0;
+        uint64 wait_calls = 0;
+        uint64 call_base = 0;                   // driver calls of previous release manager runs
+        uint64 overrun_ns = 0;                  // pending recovery
+        uint64 due_ns = 0;                      // expected completion of the next block, 0 if not waiting for it
+        bool resync = false;
+        bool failed = false;
+
+        while (running.load(std::memory_order_relaxed))
+        {
+            // Releases and pops from here on end the wait for the next block
+            const uint64 seen = progress.load(std::memory_order_acquire);
+
+            if (resync)
+            {
+                // The driver continues at a new read position after the overrun,
+                // all scans up to available_end are lost or published
+                call_base += releaser.driverCalls();
+                int err = releaser.start();
+                if (err > 0)
+                {
+                    if (err == ERR_BUFFER_OVERWRITE && clearOverrun(overrun_ns, available_end) <= 0)
+                    {
+                        ++call_base;
+                        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                        continue;
+                    }
+                    publishError(err, steadyClockNs());
+                    failed = true;
+                    break;
+                }
+                resync = false;
+                scan_base = available_end;
+                released_until = available_end;
+                epoch_start = available_end;
+                rate_ns = 0;
+                for (Consumer* consumer : consumers)
+                {
+                    consumer->read_pos = releaser.readPos();
+                    consumer->published_until = available_end;
+                }
+            }
+
+            // Hand scans released by all consumers back to the driver
+            uint64 free_until = slowestRelease(available_end);
+            if (free_until > released_until)
+            {
+                const uint64 free_calls = releaser.freeCalls();
+                const uint64 free_ns = steadyClockNs();
+                int err = releaser.release(static_cast<uint32>(free_until - released_until));
+                if (releaser.freeCalls() != free_calls)
+                {
+                    driver_hist.record(steadyClockNs() - free_ns);
+                }
+                if (err > 0)
+                {
+                    last_error.store(err);
+                }
+                released_until = free_until;
+            }
+
+            // Blocks a consumer could not take before its pop
+            if (deferredBlocks())
+            {
+                publish(available_end, steadyClockNs(), false);
+            }
+
+            // The driver wait returns once a block is unfreed. Scans still held by
+            // the consumers or released but not yet freed (coalesced) count as
+            // unfreed, then the wait would return before the next block is
+            // complete: wait until it is due instead.
+            const uint64 missing = nextBlockEnd(available_end) - available_end;
+            const uint64 unfreed = releaser.unfreed();
+            if (missing > 0 && unfreed + missing > block_scans)
+            {
+                const uint64 now_ns = steadyClockNs();
+                if (due_ns == 0)
+                {
+                    due_ns = now_ns + (scan_ns > 0.0 ? static_cast<uint64>(missing * scan_ns) : UNKNOWN_RATE_WAIT_NS);
+                }
+                if (now_ns < due_ns)
+                {
+                    waitProgress(seen, due_ns);
+                    continue;
+                }
+            }
+            due_ns = 0;
+
+            sint32 avail = 0;
+            int err = DeWeGetParam_i32(board_id, wait_cmd, &avail);
+            const uint64 wake_ns = steadyClockNs();
+            driver_calls.store(call_base + ++wait_calls + releaser.driverCalls(), std::memory_order_relaxed);
+
+            if (err > 0)
+            {
+                if (err == ERR_BUFFER_OVERWRITE)
+                {
+                    monitor.overrun(wake_ns);
+                    if (recover_overrun)
+                    {
+                        // Acknowledge, skip this read and resync with the next iteration
+                        overrun_ns = overrun_ns ? overrun_ns : wake_ns;
+                        err = clearOverrun(overrun_ns, available_end);
+                        ++call_base;
+                        if (err <= 0)
+                        {
+                            resync = true;
+                            continue;
+                        }
+                    }
+                }
+                // Report to the consumers and stop reading
+                publishError(err, wake_ns);
+                failed = true;
+                break;
+            }
+
+            // The available count includes scans published but not yet freed
+            const uint32 avail_scans = avail > 0 ? static_cast<uint32>(avail) : 0;
+            const uint64 previous_end = available_end;
+            releaser.noteAvailable(avail_scans);
+            available_end = scan_base + releaser.freedScans() + avail_scans;
+            monitor.update(avail_scans, static_cast<uint32>(available_end - previous_end), wake_ns);
+            updateRate(available_end, wake_ns);
+
+            if (drop_slowest && avail_scans >= drop_scans)
+            {
+                dropSlowest(available_end);
+            }
+
+            const uint64 oldest_ns = publish(available_end, wake_ns, false);
+            const uint64 done_ns = steadyClockNs();
+            loop_hist.record(done_ns - wake_ns);
+            if (oldest_ns)
+            {
+                // Deferred scans count from the wake-up that found them
+                recordLatency(done_ns - oldest_ns);
+                if (overrun_ns)
+                {
+                    recovery_hist.record(done_ns - overrun_ns);
+                    overrun_ns = 0;
+                }
+            }
+        }
+
+        // The incomplete last block
+        if (!failed)
+        {
+            publish(available_end, steadyClockNs(), true);
+        }
+        releaser.commit();
+    }
+
+    uint64 AcquisitionEngine::BoardReader::publish(uint64 available_end, uint64 wake_ns, bool tail)
+    {
+        uint64 oldest_ns = 0;
+        for (Consumer* consumer : consumers)
+        {
+            if (consumer->dropped.load(std::memory_order_relaxed))
+            {
+                continue;
+            }
+
+            // The data lost marker has to precede the scans after the overrun
+            if (consumer->lost_pending && !publishLost(*consumer))
+            {
+                continue;
+            }
+
+            const uint64 lag = available_end - releasedBy(*consumer);
+            consumer->lag.store(lag, std::memory_order_relaxed);
+            if (lag > consumer->max_lag.load(std::memory_order_relaxed))
+            {
+                consumer->max_lag.store(lag, std::memory_order_relaxed);
+            }
+
+            // One descriptor per block counted from the start of the epoch, the
+            // same boundaries for every consumer, also when catching up
+            bool pushed = false;
+            for (;;)
+            {
+                const uint64 fresh = available_end - consumer->published_until;
+                const uint32 scans = static_cast<uint32>(fresh < block_scans ? (tail ? fresh : 0) : block_scans);
+                if (scans == 0)
+                {
+                    break;
+                }
+
+                BlockDescriptor block;
+                block.board_index = index;
+                block.board_id = ring.boardId();
+                block.consumer = consumer->id;
+                block.error = ERR_NONE;
+                block.flags = 0;
+                block.spans = ring.spansAt(consumer->read_pos, scans);
+                block.first_scan = consumer->published_until;
+                block.scans = scans;
+                block.wake_ns = consumer->held_ns ? consumer->held_ns : wake_ns;
+                block.publish_ns = steadyClockNs();
+
+                if (!consumer->queue.push(block))
+                {
+                    // Consumer is behind, the remaining blocks are published once it pops
+                    if (!consumer->held_ns)
+                    {
+                        consumer->queue_full.fetch_add(1, std::memory_order_relaxed);
+                        consumer->held_ns = block.wake_ns;
+                        consumer->held.store(true, std::memory_order_release);
+                    }
+                    break;
+                }
+
+                oldest_ns = oldest_ns == 0 || block.wake_ns < oldest_ns ? block.wake_ns : oldest_ns;
+                if (consumer->held_ns)
+                {
+                    consumer->held_ns = 0;
+                    consumer->held.store(false, std::memory_order_release);
+                }
+                consumer->read_pos = ring.advance(consumer->read_pos, scans);
+                consumer->published_until += scans;
+                pushed = true;
+            }
+            if (pushed)
+            {
+                consumer->notify();
+            }
+        }
+        return oldest_ns;
+    }
+
+    bool AcquisitionEngine::BoardReader::deferredBlocks() const
+    {
+        for (const Consumer* consumer : consumers)
+        {
+            if (consumer->held_ns && !consumer->dropped.load(std::memory_order_relaxed))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    uint64 AcquisitionEngine::BoardReader::nextBlockEnd(uint64 available_end) const
+    {
+        // Consumers with a full queue wait for their pop, not for new scans
+        uint64 end = ~0ull;
+        for (const Consumer* consumer : consumers)
+        {
+            if (!consumer->dropped.load(std::memory_order_relaxed) && !consumer->held_ns && !consumer->lost_pending)
+            {
+                const uint64 next = consumer->published_until + block_scans;
+                end = next < end ? next : end;
+            }
+        }
+        if (end == ~0ull)
+        {
+            end = available_end + block_scans;
+        }
+        return end > available_end ? end : available_end;
+    }
+
+    void AcquisitionEngine::BoardReader::updateRate(uint64 available_end, uint64 wake_ns)
+    {
+        // Averaged since the first wake-up of the epoch, scans buffered before do not count
+        if (rate_ns == 0)
+        {
+            rate_ns = wake_ns;
+            rate_scans = available_end;
+        }
+        else if (available_end > rate_scans && wake_ns > rate_ns)
+        {
+            scan_ns = static_cast<double>(wake_ns - rate_ns) / static_cast<double>(available_end - rate_scans);
+        }
+    }
+
+    void AcquisitionEngine::BoardReader::publishError(int err, uint64 wake_ns)
+    {
+        for (Consumer* consumer : consumers)
+        {
+            if (consumer->dropped.load(std::memory_order_relaxed))
+            {
+                continue;
+            }
+            BlockDescriptor block = BlockDescriptor();
+            block.board_index = index;
+            block.board_id = ring.boardId();
+            block.consumer = consumer->id;
+            block.error = err;
+            block.first_scan = consumer->published_until;
+            block.wake_ns = wake_ns;
+            block.publish_ns = steadyClockNs();
+            if (!consumer->queue.push(block))
+            {
+                // Full queue: popBlock() reports the error once the queue drained
+                consumer->queue_full.fetch_add(1, std::memory_order_relaxed);
+                consumer->pending_error_scan = block.first_scan;
+                consumer->pending_error_ns = wake_ns;
+                consumer->pending_error.store(err, std::memory_order_release);
+            }
+        }
+        last_error.store(err);
+        running.store(false);
+        notifyConsumers();
+    }
+
+    int AcquisitionEngine::BoardReader::clearOverrun(uint64 wake_ns, uint64 available_end)
+    {
+        // Discard queued blocks before the driver reuses their scans
+        for (Consumer* consumer : consumers)
+        {
+            consumer->lost_until.store(available_end, std::memory_order_release);
+        }
+
+        int err = DeWeSetParam_i32(ring.boardId(), bufferCommand(CMD_BUFFER_0_CLEAR_ERROR, ring.buffer()), 0);
+        if (err > 0)
+        {
+            return err;
+        }
+
+        for (Consumer* consumer : consumers)
+        {
+            if (!consumer->lost_pending)
+            {
+                consumer->lost_pending = true;
+                consumer->lost_ns = wake_ns;
+            }
+        }
+        return err;
+    }
+
+    bool AcquisitionEngine::BoardReader::publishLost(Consumer& consumer)
+    {
+        BlockDescriptor block = BlockDescriptor();
+        block.board_index = index;
+        block.board_id = ring.boardId();
+        block.consumer = consumer.id;
+        block.error = ERR_NONE;
+        block.flags = BLOCK_FLAG_DATA_LOST;
+        block.first_scan = consumer.published_until;
+        block.wake_ns = consumer.lost_ns;
+        block.publish_ns = steadyClockNs();
+
+        if (!consumer.queue.push(block))
+        {
+            consumer.queue_full.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        consumer.lost_pending = false;
+        consumer.notify();
+        return true;
+    }
+
+    void AcquisitionEngine::BoardReader::dropSlowest(uint64 available_end)
+    {
+        Consumer* slowest = nullptr;
+        uint32 active = 0;
+        uint64 fastest_release = 0;
+        for (Consumer* consumer : consumers)
+        {
+            if (consumer->dropped.load(std::memory_order_relaxed))
+            {
+                continue;
+            }
+            uint64 released = releasedBy(*consumer);
+            if (!slowest || released < releasedBy(*slowest))
+            {
+                slowest = consumer;
+            }
+            if (released > fastest_release)
+            {
+                fastest_release = released;
+            }
+            ++active;
+        }
+
+        // Only drop if somebody else would free scans
+        if (active < 2 || releasedBy(*slowest) >= fastest_release)
+        {
+            return;
+        }
+
+        // The consumer reports the drop with its next pop()
+        slowest->dropped_at.store(available_end, std::memory_order_relaxed);
+        slowest->dropped.store(true, std::memory_order_release);
+        slowest->notify();
+    }
+
+    uint64 AcquisitionEngine::BoardReader::releasedBy(const Consumer& consumer) const
+    {
+        // Scans before an overrun are gone, whether released or not
+        uint64 released = consumer.released_until.load(std::memory_order_acquire);
+        return released > epoch_start ? released : epoch_start;
+    }
+
+    uint64 AcquisitionEngine::BoardReader::slowestRelease(uint64 available_end) const
+    {
+        // Without active consumers nobody holds scans
+        uint64 slowest = available_end;
+        for (const Consumer* consumer : consumers)
+        {
+            if (consumer->dropped.load(std::memory_order_acquire))
+            {
+                continue;
+            }
+            uint64 released = releasedBy(*consumer);
+            if (released < slowest)
+            {
+                slowest = released;
+            }
+        }
+        return slowest;
+    }
+
+    void AcquisitionEngine::BoardReader::recordLatency(uint64 ns)
+    {
+        // Single writer: plain read-modify-write is sufficient
+        lat_count.store(lat_count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        lat_total.store(lat_total.load(std::memory_order_relaxed) + ns, std::memory_order_relaxed);
+        if (ns < lat_min.load(std::memory_order_relaxed))
+        {
+            lat_min.store(ns, std::memory_order_relaxed);
+        }
+        if (ns > lat_max.load(std::memory_order_relaxed))
+        {
+            lat_max.store(ns, std::memory_order_relaxed);
+        }
+    }
+
+    void AcquisitionEngine::BoardReader::notifyConsumers()
+    {
+        for (Consumer* consumer : consumers)
+        {
+            consumer->notify();
+        }
+    }
+
+    void AcquisitionEngine::BoardReader::signalProgress()
+    {
+        progress.fetch_add(1, std::memory_order_release);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (idle.load(std::memory_order_relaxed))
+        {
+            std::lock_guard<std::mutex> lock(progress_mutex);
+            progress_cv.notify_one();
+        }
+    }
+
+    void AcquisitionEngine::BoardReader::waitProgress(uint64 seen, uint64 deadline_ns)
+    {
+        const std::chrono::steady_clock::time_point deadline{std::chrono::nanoseconds(deadline_ns)};
+        idle.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        {
+            std::unique_lock<std::mutex> lock(progress_mutex);
+            progress_cv.wait_until(lock, deadline, [this, seen]()
+            {
+                return progress.load(std::memory_order_acquire) != seen || !running.load(std::memory_order_relaxed);
+            });
+        }
+        idle.store(false, std::memory_order_relaxed);
+    }
+
+
+    AcquisitionEngine::AcquisitionEngine(uint32 queue_capacity)
+        : m_queue_capacity(queue_capacity)
+        , m_drop_slowest(false)
+        , m_drop_threshold(0.9)
+        , m_release_chunk(0)
+        , m_release_watermark(0)
+        , m_board_mem_interval_ms(1000)
+        , m_overrun_recovery(false)
+        , m_memory_locked(false)
+        , m_running(false)
+    {
+    }
+
+    AcquisitionEngine::~AcquisitionEngine()
+    {
+        stop();
+    }
+
+    int AcquisitionEngine::addBoard(int board_id, int buffer)
+    {
+        std::unique_ptr<BoardReader> reader(new BoardReader(
+            static_cast<uint32>(m_readers.size()), board_id, buffer));
+
+        int err = reader->ring.init();
+        if (err > 0)
+        {
+            return err;
+        }
+
+        m_readers.push_back(std::move(reader));
+        return err;
+    }
+
+    uint32 AcquisitionEngine::numBoards() const
+    {
+        return static_cast<uint32>(m_readers.size());
+    }
+
+    const RingBufferView& AcquisitionEngine::ring(uint32 board_index) const
+    {
+        return m_readers[board_index]->ring;
+    }
+
+    uint32 AcquisitionEngine::addConsumer(uint32 board_index)
+    {
+        const uint32 id = static_cast<uint32>(m_consumers.size());
+        BoardReader& reader = *m_readers[board_index];
+        m_consumers.push_back(std::unique_ptr<Consumer>(new Consumer(id, board_index, reader.ring.boardId(), m_queue_capacity)));
+        reader.consumers.push_back(m_consumers.back().get());
+        return id;
+    }
+
+    uint32 AcquisitionEngine::numConsumers() const
+    {
+        return static_cast<uint32>(m_consumers.size());
+    }
+
+    void AcquisitionEngine::setDropSlowest(bool enable, double fill_threshold)
+    {
+        m_drop_slowest = enable;
+        m_drop_threshold = fill_threshold;
+    }
+
+    void AcquisitionEngine::setReleasePolicy(uint32 chunk_scans, uint32 watermark_bytes)
+    {
+        m_release_chunk = chunk_scans;
+        m_release_watermark = watermark_bytes;
+    }
+
+    void AcquisitionEngine::setBoardMemoryInterval(uint32 interval_ms)
+    {
+        m_board_mem_interval_ms = interval_ms;
+    }
+
+    void AcquisitionEngine::setOverrunRecovery(bool enable)
+    {
+        m_overrun_recovery = enable;
+    }
+
+    void AcquisitionEngine::setThreadOptions(const ReaderThreadOptions& options)
+    {
+        m_thread_options = options;
+    }
+
+    void AcquisitionEngine::setBoardCpu(uint32 board_index, int cpu)
+    {
+        m_readers[board_index]->cpu = cpu;
+        m_readers[board_index]->fixed_cpu = true;
+    }
+
+    ReaderThreadStatus AcquisitionEngine::threadStatus(uint32 board_index) const
+    {
+        const BoardReader& reader = *m_readers[board_index];
+        ReaderThreadStatus status;
+        status.cpu = reader.cpu;
+        status.pinned = reader.pinned.load();
+        status.realtime = reader.realtime.load();
+        status.memory_locked = m_memory_locked;
+        return status;
+    }
+
+    int AcquisitionEngine::start()
+    {
+        if (m_running)
+        {
+            return ERR_NONE;
+        }
+
+        // Every board needs a consumer releasing its scans
+        for (uint32 i = 0; i < numBoards(); ++i)
+        {
+            if (m_readers[i]->consumers.empty())
+            {
+                addConsumer(i);
+            }
+        }
+
+        // Readers track their own read position from here on
+        for (auto& reader : m_readers)
+        {
+            const RingBufferView& ring = reader->ring;
+            int err = reader->releaser.start();
+            if (err > 0)
+            {
+                return err;
+            }
+            const sint64 read_pos = reader->releaser.readPos();
+            reader->releaser.setChunk(m_release_chunk);
+            reader->releaser.setWatermark(m_release_watermark);
+            reader->released_until = 0;
+            reader->scan_base = 0;
+            reader->epoch_start = 0;
+            reader->scan_ns = 0.0;
+            reader->rate_ns = 0;
+
+            // Blocks are published whole, in the size the driver completes them
+            sint32 block_size = 0;
+            err = DeWeGetParam_i32(ring.boardId(), bufferCommand(CMD_BUFFER_0_BLOCK_SIZE, ring.buffer()), &block_size);
+            reader->block_scans = err <= 0 && block_size > 0 ? static_cast<uint32>(block_size) : 1;
+            reader->recover_overrun = m_overrun_recovery;
+            reader->driver_calls.store(0);
+            reader->monitor.reset(ring.capacity());
+            reader->loop_hist.reset();
+            reader->driver_hist.reset();
+            reader->recovery_hist.reset();
+            reader->monitor.setBoardMemoryInterval(m_board_mem_interval_ms);
+            reader->last_error.store(ERR_NONE);
+            reader->drop_slowest = m_drop_slowest;
+            reader->drop_scans = static_cast<uint32>(m_drop_threshold * ring.capacity());
+
+            for (Consumer* consumer : reader->consumers)
+            {
+                consumer->read_pos = read_pos;
+                consumer->published_until = 0;
+                consumer->released_until.store(0);
+                consumer->dropped.store(false);
+                consumer->drop_reported = false;
+                consumer->lost_pending = false;
+                consumer->held_ns = 0;
+                consumer->held.store(false);
+                consumer->pending_error.store(ERR_NONE);
+                consumer->lost_until.store(0);
+                consumer->lag.store(0);
+                consumer->max_lag.store(0);
+            }
+        }
+
+        // Balance the readers without a fixed core on the least used cores
+        const std::vector<int>& cpus = m_thread_options.cpus;
+        std::vector<uint32> load(cpus.size(), 0);
+        for (auto& reader : m_readers)
+        {
+            for (size_t c = 0; reader->fixed_cpu && c < cpus.size(); ++c)
+            {
+                load[c] += cpus[c] == reader->cpu ? 1 : 0;
+            }
+        }
+        for (auto& reader : m_readers)
+        {
+            if (!reader->fixed_cpu)
+            {
+                reader->cpu = -1;
+                size_t least = 0;
+                for (size_t c = 1; c < cpus.size(); ++c)
+                {
+                    least = load[c] < load[least] ? c : least;
+                }
+                if (!cpus.empty())
+                {
+                    reader->cpu = cpus[least];
+                    ++load[least];
+                }
+            }
+            reader->realtime_priority = m_thread_options.realtime_priority;
+            reader->pinned.store(false);
+            reader->realtime.store(false);
+        }
+
+        if (m_thread_options.lock_memory && !m_memory_locked)
+        {
+            m_memory_locked = lockProcessMemory();
+        }
+
+        m_running = true;
+        for (auto& reader : m_readers)
+        {
+            reader->running.store(true);
+            reader->thread = std::thread(&BoardReader::run, reader.get());
+        }
+
+        return ERR_NONE;
+    }
+
+    void AcquisitionEngine::stop()
+    {
+        for (auto& reader : m_readers)
+        {
+            reader->running.store(false);
+            reader->notifyConsumers();
+            reader->signalProgress();
+        }
+
+        for (auto& reader : m_readers)
+        {
+            if (reader->thread.joinable())
+            {
+                reader->thread.join();
+            }
+        }
+
+        m_running = false;
+    }
+
+    bool AcquisitionEngine::isRunning() const
+    {
+        return m_running;
+    }
+
+    bool AcquisitionEngine::pop(uint32 consumer, BlockDescriptor& block)
+    {
+        Consumer& c = *m_consumers[consumer];
+        if (!c.popBlock(block))
+        {
+            return false;
+        }
+        // A queue slot is free for deferred blocks, other pops do not concern the reader
+        if (c.held.load(std::memory_order_acquire))
+        {
+            m_readers[c.board]->signalProgress();
+        }
+        return true;
+    }
+
+    bool AcquisitionEngine::waitPop(uint32 consumer, BlockDescriptor& block, uint32 timeout_ms)
+    {
+        Consumer& c = *m_consumers[consumer];
+        const BoardReader& reader = *m_readers[c.board];
+
+        if (pop(consumer, block))
+        {
+            return true;
+        }
+
+        c.waiting.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        {
+            std::unique_lock<std::mutex> lock(c.wait_mutex);
+            c.wait_cv.wait_for(lock, std::chrono::milliseconds(timeout_ms), [&c, &reader]()
+            {
+                return !c.queue.empty() || !reader.running.load() || c.dropped.load();
+            });
+        }
+        c.waiting.store(false, std::memory_order_relaxed);
+
+        return pop(consumer, block);
+    }
+
+    void AcquisitionEngine::release(const BlockDescriptor& block)
+    {
+        if (block.scans > 0)
+        {
+            Consumer& c = *m_consumers[block.consumer];
+            c.released_until.store(block.first_scan + block.scans, std::memory_order_release);
+            m_readers[c.board]->signalProgress();
+        }
+    }
+
+    LatencyStats AcquisitionEngine::latency(uint32 board_index) const
+    {
+        const BoardReader& reader = *m_readers[board_index];
+        LatencyStats stats;
+        stats.count = reader.lat_count.load(std::memory_order_relaxed);
+        stats.min_ns = stats.count ? reader.lat_min.load(std::memory_order_relaxed) : 0;
+        stats.max_ns = reader.lat_max.load(std::memory_order_relaxed);
+        stats.total_ns = reader.lat_total.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+    uint64 AcquisitionEngine::driverCalls(uint32 board_index) const
+    {
+        return m_readers[board_index]->driver_calls.load(std::memory_order_relaxed);
+    }
+
+    const LatencyHistogram& AcquisitionEngine::loopHistogram(uint32 board_index) const
+    {
+        return m_readers[board_index]->loop_hist;
+    }
+
+    const LatencyHistogram& AcquisitionEngine::driverHistogram(uint32 board_index) const
+    {
+        return m_readers[board_index]->driver_hist;
+    }
+
+    const LatencyHistogram& AcquisitionEngine::recoveryHistogram(uint32 board_index) const
+    {
+        return m_readers[board_index]->recovery_hist;
+    }
+
+    void AcquisitionEngine::telemetry(uint32 board_index, BufferTelemetry& telemetry) const
+    {
+        m_readers[board_index]->monitor.snapshot(telemetry);
+    }
+
+    ConsumerStats AcquisitionEngine::consumerStats(uint32 consumer) const
+    {
+        const Consumer& c = *m_consumers[consumer];
+        ConsumerStats stats;
+        stats.released_scans = c.released_until.load(std::memory_order_relaxed);
+        stats.lag_scans = c.lag.load(std::memory_order_relaxed);
+        stats.max_lag_scans = c.max_lag.load(std::memory_order_relaxed);
+        stats.queue_full = c.queue_full.load(std::memory_order_relaxed);
+        stats.dropped = c.dropped.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+    int AcquisitionEngine::lastError(uint32 board_index) const
+    {
+        return m_readers[board_index]->last_error.load();
+    }
+}
@@ -0,0 +1,603 @@
+// Copyright DEWETRON 2024
+
+#include "dewepxi_api_interposer.h"
+#include "dewepxi_acq_engine.h"
+#include "dewepxi_apicore.h"
+#include "dewepxi_spsc_queue.h"
+#include "dewepxi_thread_util.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+
+#if defined(_M_X64) || defined(_M_IX86)
+#  include <intrin.h>
+#  define DEWEPXI_INTERPOSER_TSC 1
+#elif defined(__x86_64__) || defined(__i386__)
+#  include <x86intrin.h>
+#  define DEWEPXI_INTERPOSER_TSC 1
+#endif
+
+
+// All interposed API functions (DeWeErrorConstantToString returns no error code)
+#define TRION_INTERPOSED_FUNCTIONS(X) \
+    X(DeWeDriverInit) \
+    X(DeWeDriverDeInit) \
+    X(DeWeGetParam_i32) \
+    X(DeWeSetParam_i32) \
+    X(DeWeGetParam_i64) \
+    X(DeWeSetParam_i64) \
+    X(DeWeSetParamStruct_str) \
+    X(DeWeGetParamStruct_str) \
+    X(DeWeGetParamStruct_strLEN) \
+    X(DeWeGetParamStructEx_str) \
+    X(DeWeSetParamXML_str) \
+    X(DeWeGetParamXML_str) \
+    X(DeWeGetParamXML_strLEN) \
+    X(DeWeOpenCAN) \
+    X(DeWeCloseCAN) \
+    X(DeWeGetChannelPropCAN) \
+    X(DeWeSetChannelPropCAN) \
+    X(DeWeStartCAN) \
+    X(DeWeStopCAN) \
+    X(DeWeFreeFramesCAN) \
+    X(DeWeErrorCntCAN) \
+    X(DeWeReadCAN) \
+    X(DeWeReadCANRawFrame) \
+    X(DeWeWriteCAN) \
+    X(DeWeReadCANEx) \
+    X(DeWeReadCANRawFrameEx) \
+    X(DeWeWriteCANEx) \
+    X(DeWeReadCANNg) \
+    X(DeWeOpenDmaUart) \
+    X(DeWeCloseDmaUart) \
+    X(DeWeGetChannelPropDmaUart) \
+    X(DeWeSetChannelPropDmaUart) \
+    X(DeWeStartDmaUart) \
+    X(DeWeStopDmaUart) \
+    X(DeWeReadDmaUart) \
+    X(DeWeReadDmaUartRawFrame) \
+    X(DeWeFreeDmaUartRawFrame) \
+    X(DeWeWriteDmaUart)
+
+
+namespace trion
+{
+    namespace
+    {
+        enum InterposedFunction
+        {
+#define TRION_FUNCTION_ID(name) FUNCTION_##name,
+            TRION_INTERPOSED_FUNCTIONS(TRION_FUNCTION_ID)
+#undef TRION_FUNCTION_ID
+            FUNCTION_COUNT
+        };
+
+        const char* const FUNCTION_NAMES[] =
+        {
+#define TRION_FUNCTION_NAME(name) #name,
+            TRION_INTERPOSED_FUNCTIONS(TRION_FUNCTION_NAME)
+#undef TRION_FUNCTION_NAME
+        };
+
+        const struct
+        {
+            uint32 id;
+            const char* name;
+        } COMMAND_NAMES[] =
+        {
+#define TRION_COMMAND(name, val) { val, "CMD_" #name },
+#include "dewepxi_commands.inc"
+#undef TRION_COMMAND
+        };
+
+        /**
+         * A call as recorded by the thunk, times in ticks.
+         */
+        struct RawCall
+        {
+            uint64 start;
+            uint64 duration;
+            uint32 function;
+            uint32 command;
+            sint32 board;
+            sint32 error;
+        };
+
+        /**
+         * Ring of one calling thread, retired when the thread ends.
+         */
+        struct ThreadRing
+        {
+            explicit ThreadRing(uint32 capacity, uint32 index)
+                : queue(capacity)
+                , index(index)
+                , retired(false)
+            {
+            }
+
+            // The queue is cache line aligned, which plain new does not honor before C++17
+            static void* operator new(size_t size)
+            {
+                void* memory = allocateAligned(size, alignof(ThreadRing));
+                if (!memory)
+                {
+                    throw std::bad_alloc();
+                }
+                return memory;
+            }
+
+            static void operator delete(void* memory)
+            {
+                freeAligned(memory);
+            }
+
+            SpscQueue<RawCall> queue;
+            uint32 index;
+            std::atomic<bool> retired;
+        };
+
+        std::atomic<bool> g_enabled(false);
+        std::atomic<uint32> g_generation(1);    // rings of older generations are deleted
+        std::atomic<uint64> g_dropped(0);
+        std::mutex g_rings_mutex;
+        std::vector<ThreadRing*> g_rings;
+        uint32 g_ring_capacity = 0;
+        uint32 g_next_thread = 0;
+
+        /**
+         * Retires the ring of a thread at its exit.
+         */
+        struct RingOwner
+        {
+            RingOwner()
+                : ring(nullptr)
+                , generation(0)
+            {
+            }
+
+            ~RingOwner()
+            {
+                std::lock_guard<std::mutex> lock(g_rings_mutex);
+                if (ring && generation == g_generation.load())
+                {
+                    ring->retired.store(true);
+                }
+            }
+
+            ThreadRing* ring;
+            uint32 generation;
+        };
+
+        // Hot path: trivially destructible, no guard on access
+        thread_local ThreadRing* t_ring = nullptr;
+        thread_local uint32 t_generation = 0;
+        thread_local RingOwner t_owner;
+
+        inline uint64 ticks()
+        {
+#if defined(DEWEPXI_INTERPOSER_TSC)
+            return __rdtsc();
+#else
+            return steadyClockNs();
+#endif
+        }
+
+        /**
+         * Mean cost of one ticks() in ns, two are part of every recorded call.
+         */
+        double measureTickNs()
+        {
+            // Neither __rdtsc nor the clock is optimized away
+            const uint32 reads = 10000;
+            const uint64 start_ns = steadyClockNs();
+            for (uint32 i = 0; i < reads; ++i)
+            {
+                ticks();
+            }
+            return static_cast<double>(steadyClockNs() - start_ns) / reads;
+        }
+
+        ThreadRing* registerThread()
+        {
+            std::lock_guard<std::mutex> lock(g_rings_mutex);
+            if (g_ring_capacity == 0)
+            {
+                return nullptr;
+            }
+            ThreadRing* ring = new ThreadRing(g_ring_capacity, g_next_thread++);
+            g_rings.push_back(ring);
+            t_ring = ring;
+            t_generation = g_generation.load();
+            t_owner.ring = ring;
+            t_owner.generation = t_generation;
+            return ring;
+        }
+
+        inline void record(uint32 function, sint32 board, uint32 command, uint64 start, uint64 end, int error)
+        {
+            ThreadRing* ring = t_ring;
+            if (!ring || t_generation != g_generation.load(std::memory_order_relaxed))
+            {
+                ring = registerThread();
+                if (!ring)
+                {
+                    return;
+                }
+            }
+            RawCall call;
+            call.start = start;
+            call.duration = end - start;
+            call.function = function;
+            call.command = command;
+            call.board = board;
+            call.error = error;
+            if (!ring->queue.push(call))
+            {
+                g_dropped.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        /**
+         * Board of a target like "BoardID2/AI0", -1 otherwise.
+         */
+        sint32 targetBoard(const char* target)
+        {
+            static const char prefix[] = "boardid";
+            if (!target)
+            {
+                return -1;
+            }
+            size_t i = 0;
+            for (; i < sizeof(prefix) - 1; ++i)
+            {
+                if (target[i] == 0 || (target[i] | 0x20) != prefix[i])
+                {
+                    return -1;
+                }
+            }
+            if (target[i] < '0' || target[i] > '9')
+            {
+                return -1;
+            }
+            return std::atoi(target + i);
+        }
+
+        struct CallKey
+        {
+            sint32 board;
+            uint32 command;
+        };
+
+        // Board and command from the arguments of the different API signatures
+        inline CallKey callKey()
+        {
+            CallKey key = { -1, 0 };
+            return key;
+        }
+
+        template <typename T>
+        inline CallKey callKey(int board, unsigned int command, T)
+        {
+            CallKey key = { board, command };
+            return key;
+        }
+
+        template <typename... T>
+        inline CallKey callKey(int board, T...)
+        {
+            CallKey key = { board, 0 };
+            return key;
+        }
+
+        template <typename... T>
+        inline CallKey callKey(const char* target, T...)
+        {
+            CallKey key = { targetBoard(target), 0 };
+            return key;
+        }
+
+        template <typename... T>
+        inline CallKey callKey(int*, T...)
+        {
+            return callKey();
+        }
+
+        template <uint32 Function, typename Fn>
+        struct Thunk;
+
+        /**
+         * Replaces one API function pointer, forwards to the original.
+         */
+        template <uint32 Function, typename... A>
+        struct Thunk<Function, int (RT_IMPORT *)(A...)>
+        {
+            static int (RT_IMPORT *original)(A...);
+
+            static int RT_IMPORT call(A... args)
+            {
+                if (!g_enabled.load(std::memory_order_relaxed))
+                {
+                    return original(args...);
+                }
+                const uint64 start = ticks();
+                const int error = original(args...);
+                const uint64 end = ticks();
+                const CallKey key = callKey(args...);
+                record(Function, key.board, key.command, start, end, error);
+                return error;
+            }
+        };
+
+        template <uint32 Function, typename... A>
+        int (RT_IMPORT *Thunk<Function, int (RT_IMPORT *)(A...)>::original)(A...) = nullptr;
+
+        template <uint32 Function, typename Fn>
+        void wrap(Fn& pointer)
+        {
+            typedef Thunk<Function, Fn> FunctionThunk;
+            if (pointer && pointer != &FunctionThunk::call)
+            {
+                FunctionThunk::original = pointer;
+                pointer = &FunctionThunk::call;
+            }
+        }
+
+        template <uint32 Function, typename Fn>
+        void unwrap(Fn& pointer)
+        {
+            typedef Thunk<Function, Fn> FunctionThunk;
+            if (pointer == &FunctionThunk::call)
+            {
+                pointer = FunctionThunk::original;
+            }
+        }
+    }
+
+
+    const char* apiCommandName(uint32 command)
+    {
+        for (size_t i = 0; i < sizeof(COMMAND_NAMES) / sizeof(COMMAND_NAMES[0]); ++i)
+        {
+            if (COMMAND_NAMES[i].id == command)
+            {
+                return COMMAND_NAMES[i].name;
+            }
+        }
+        return nullptr;
+    }
+
+
+    bool ApiInterposer::Key::operator<(const Key& other) const
+    {
+        if (function != other.function)
+        {
+            return function < other.function;
+        }
+        if (command != other.command)
+        {
+            return command < other.command;
+        }
+        return board < other.board;
+    }
+
+    ApiInterposer& ApiInterposer::instance()
+    {
+        static ApiInterposer interposer;
+        return interposer;
+    }
+
+    ApiInterposer::ApiInterposer()
+        : m_tick_origin(0)
+        , m_ns_origin(0)
+        , m_ns_per_tick(1.0)
+        , m_tick_cost_ns(0.0)
+        , m_running(false)
+    {
+    }
+
+    ApiInterposer::~ApiInterposer()
+    {
+        uninstall();
+    }
+
+    void ApiInterposer::install(uint32 ring_capacity, uint32 flush_interval_ms)
+    {
+        if (installed())
+        {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_tick_origin = ticks();
+            m_ns_origin = steadyClockNs();
+            m_ns_per_tick = 1.0;
+            m_tick_cost_ns = measureTickNs();
+        }
+        {
+            std::lock_guard<std::mutex> lock(g_rings_mutex);
+            g_ring_capacity = ring_capacity > 2 ? ring_capacity : 2;
+        }
+
+#define TRION_WRAP_FUNCTION(name) wrap<FUNCTION_##name>(name);
+        TRION_INTERPOSED_FUNCTIONS(TRION_WRAP_FUNCTION)
+#undef TRION_WRAP_FUNCTION
+
+        g_enabled.store(true);
+        m_running.store(true);
+        m_flush_thread = std::thread(&ApiInterposer::run, this, flush_interval_ms);
+    }
+
+    void ApiInterposer::uninstall()
+    {
+        if (!installed())
+        {
+            return;
+        }
+
+        m_running.store(false);
+        m_flush_thread.join();
+
+#define TRION_UNWRAP_FUNCTION(name) unwrap<FUNCTION_##name>(name);
+        TRION_INTERPOSED_FUNCTIONS(TRION_UNWRAP_FUNCTION)
+#undef TRION_UNWRAP_FUNCTION
+
+        g_enabled.store(false);
+        drain();
+
+        // The threads register a new ring with the next generation
+        std::lock_guard<std::mutex> lock(g_rings_mutex);
+        for (ThreadRing* ring : g_rings)
+        {
+            delete ring;
+        }
+        g_rings.clear();
+        g_ring_capacity = 0;
+        g_generation.fetch_add(1);
+    }
+
+    void ApiInterposer::setEnabled(bool enabled)
+    {
+        g_enabled.store(enabled && installed());
+    }
+
+    bool ApiInterposer::enabled() const
+    {
+        return g_enabled.load();
+    }
+
+    void ApiInterposer::setSink(const Sink& sink)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_sink = sink;
+    }
+
+    void ApiInterposer::flush()
+    {
+        drain();
+    }
+
+    std::vector<ApiCallStats> ApiInterposer::stats() const
+    {
+        std::vector<ApiCallStats> result;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        result.reserve(m_stats.size());
+        for (const auto& item : m_stats)
+        {
+            ApiCallStats stats;
+            stats.function = FUNCTION_NAMES[item.first.function];
+            stats.command = item.first.command;
+            stats.board = item.first.board;
+            stats.calls = item.second.calls;
+            stats.errors = item.second.errors;
+            stats.warnings = item.second.warnings;
+            stats.total_ns = item.second.total_ns;
+            stats.latency = item.second.latency->summary();
+            result.push_back(stats);
+        }
+        std::sort(result.begin(), result.end(), [](const ApiCallStats& a, const ApiCallStats& b)
+        {
+            return a.total_ns > b.total_ns;
+        });
+        return result;
+    }
+
+    void ApiInterposer::resetStats()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stats.clear();
+        g_dropped.store(0);
+    }
+
+    uint64 ApiInterposer::dropped() const
+    {
+        return g_dropped.load();
+    }
+
+    double ApiInterposer::tickCostNs() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_tick_cost_ns;
+    }
+
+    void ApiInterposer::run(uint32 interval_ms)
+    {
+        while (m_running.load())
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(interval_ms));
+            drain();
+        }
+    }
+
+    void ApiInterposer::drain()
+    {
+        std::lock_guard<std::mutex> drain_lock(m_drain_mutex);
+        std::unique_lock<std::mutex> stats_lock(m_mutex);
+
+        // Refine the tick rate over the whole time since install
+        const uint64 now_ticks = ticks();
+        const uint64 now_ns = steadyClockNs();
+        if (now_ticks > m_tick_origin && now_ns > m_ns_origin)
+        {
+            m_ns_per_tick = static_cast<double>(now_ns - m_ns_origin) / static_cast<double>(now_ticks - m_tick_origin);
+        }
+
+        m_batch.clear();
+        std::unique_lock<std::mutex> rings_lock(g_rings_mutex);
+        for (size_t r = 0; r < g_rings.size();)
+        {
+            ThreadRing* ring = g_rings[r];
+            const bool retired = ring->retired.load();
+
+            RawCall call;
+            while (ring->queue.pop(call))
+            {
+                ApiCallRecord record;
+                record.start_ns = m_ns_origin + static_cast<uint64>(
+                    static_cast<double>(static_cast<sint64>(call.start - m_tick_origin)) * m_ns_per_tick);
+                record.duration_ns = static_cast<uint64>(static_cast<double>(call.duration) * m_ns_per_tick);
+                record.function = FUNCTION_NAMES[call.function];
+                record.command = call.command;
+                record.board = call.board;
+                record.error = call.error;
+                record.thread = ring->index;
+                m_batch.push_back(record);
+
+                Key key;
+                key.function = call.function;
+                key.command = call.command;
+                key.board = call.board;
+                Entry& entry = m_stats[key];
+                if (!entry.latency)
+                {
+                    entry.latency.reset(new LatencyHistogram());
+                }
+                ++entry.calls;
+                entry.errors += call.error > 0 ? 1 : 0;
+                entry.warnings += call.error < 0 ? 1 : 0;
+                entry.total_ns += record.duration_ns;
+                entry.latency->record(record.duration_ns);
+            }
+
+            // The thread has ended and its ring is empty
+            if (retired)
+            {
+                delete ring;
+                g_rings.erase(g_rings.begin() + r);
+            }
+            else
+            {
+                ++r;
+            }
+        }
+        rings_lock.unlock();
+        const Sink sink = m_sink;
+        stats_lock.unlock();
+
+        // Unlocked: the sink may call the API, stats(), resetStats() or setSink()
+        if (sink && !m_batch.empty())
+        {
+            sink(m_batch.data(), m_batch.size());
+        }
+    }
+}
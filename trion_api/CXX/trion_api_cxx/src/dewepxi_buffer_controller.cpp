@@ -0,0 +1,311 @@
+// Copyright DEWETRON 2024
+
+#include "dewepxi_buffer_controller.h"
+#include "dewepxi_apicxx.h"
+#include "dewepxi_ringbuffer.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+
+
+namespace trion
+{
+    namespace
+    {
+        const uint32 MIN_BLOCK_COUNT = 4;
+
+        uint32 ceilScans(double scans)
+        {
+            return scans < 1.0 ? 1 : static_cast<uint32>(std::ceil(scans));
+        }
+    }
+
+
+    BufferController::BufferController(int board_id, int buffer)
+        : m_board_id(board_id)
+        , m_buffer(buffer)
+        , m_latency_ms(10.0)
+        , m_min_headroom(0.3)
+        , m_reserve_ms(500.0)
+        , m_max_bytes(64 * 1024 * 1024)
+        , m_sample_rate(0.0)
+        , m_scan_size(0)
+    {
+        resetObservations();
+        m_config.block_size = 0;
+        m_config.block_count = 0;
+        m_applied = m_config;
+    }
+
+    void BufferController::setLatencyTarget(double latency_ms)
+    {
+        m_latency_ms = latency_ms;
+    }
+
+    void BufferController::setMinHeadroom(double headroom)
+    {
+        m_min_headroom = headroom;
+    }
+
+    void BufferController::setReserve(double reserve_ms)
+    {
+        m_reserve_ms = reserve_ms;
+    }
+
+    void BufferController::setMaxBufferBytes(uint32 bytes)
+    {
+        m_max_bytes = bytes;
+    }
+
+    void BufferController::setLog(LogFunction log)
+    {
+        m_log = log;
+    }
+
+    void BufferController::setSampleRate(double sample_rate)
+    {
+        m_sample_rate = sample_rate;
+    }
+
+    void BufferController::setScanSize(uint32 scan_size)
+    {
+        m_scan_size = scan_size;
+    }
+
+    int BufferController::configure()
+    {
+        std::string rate;
+        char target[32];
+        std::snprintf(target, sizeof(target), "BoardID%d/AcqProp", m_board_id);
+
+        int err = DeWeGetParamStruct_str_s(target, "SampleRate", rate);
+        if (err > 0)
+        {
+            return err;
+        }
+        m_sample_rate = std::atof(rate.c_str());
+
+        sint32 scan_size = 0;
+        err = DeWeGetParam_i32(m_board_id, bufferCommand(CMD_BUFFER_0_ONE_SCAN_SIZE, m_buffer), &scan_size);
+        if (err > 0)
+        {
+            return err;
+        }
+        m_scan_size = scan_size > 0 ? static_cast<uint32>(scan_size) : 0;
+
+        resetObservations();
+        retune();
+        return apply();
+    }
+
+    void BufferController::observeService(uint32 scans, uint64 service_ns)
+    {
+        const double x = scans;
+        const double y = static_cast<double>(service_ns);
+        m_n += 1.0;
+        m_sum_x += x;
+        m_sum_y += y;
+        m_sum_xx += x * x;
+        m_sum_xy += x * y;
+        if (y > m_max_service_ns)
+        {
+            m_max_service_ns = y;
+        }
+    }
+
+    void BufferController::observeFill(uint32 unfreed_scans)
+    {
+        if (unfreed_scans > m_fill_peak)
+        {
+            m_fill_peak = unfreed_scans;
+        }
+    }
+
+    void BufferController::resetObservations()
+    {
+        m_n = 0.0;
+        m_sum_x = 0.0;
+        m_sum_y = 0.0;
+        m_sum_xx = 0.0;
+        m_sum_xy = 0.0;
+        m_max_service_ns = 0.0;
+        m_fill_peak = 0;
+    }
+
+    BufferConfig BufferController::compute(std::string& reason) const
+    {
+        BufferConfig config;
+        std::ostringstream why;
+
+        const uint32 max_scans = m_scan_size > 0 ? m_max_bytes / m_scan_size : m_max_bytes;
+
+        // One wake-up per latency target
+        uint32 block_size = ceilScans(m_sample_rate * m_latency_ms / 1000.0);
+        why << "latency target";
+
+        if (m_n > 0.0 && m_sample_rate > 0.0)
+        {
+            // Fit service_ns = overhead + per_scan * scans
+            double per_scan = m_sum_x > 0.0 ? m_sum_y / m_sum_x : 0.0;
+            double overhead = 0.0;
+            const double var = m_n * m_sum_xx - m_sum_x * m_sum_x;
+            if (m_n > 1.0 && var > 1e-9 * m_sum_xx * m_n)
+            {
+                per_scan = (m_n * m_sum_xy - m_sum_x * m_sum_y) / var;
+                overhead = (m_sum_y - per_scan * m_sum_x) / m_n;
+                if (per_scan < 0.0)
+                {
+                    per_scan = m_sum_y / m_sum_x;
+                    overhead = 0.0;
+                }
+                else if (overhead < 0.0)
+                {
+                    overhead = 0.0;
+                    per_scan = m_sum_xy / m_sum_xx;
+                }
+            }
+
+            // overhead + per_scan * B <= (1 - headroom) * B * scan_period
+            const double budget_per_scan = (1.0 - m_min_headroom) * 1e9 / m_sample_rate - per_scan;
+            if (budget_per_scan <= 0.0)
+            {
+                block_size = max_scans / MIN_BLOCK_COUNT;
+                why.str("");
+                why << "consumer slower than the acquisition";
+            }
+            else
+            {
+                uint32 needed = ceilScans(overhead / budget_per_scan);
+                if (needed > block_size)
+                {
+                    block_size = needed;
+                    why.str("");
+                    why << "consumer overhead " << overhead / 1000.0 << " us/block";
+                }
+            }
+        }
+
+        // The buffer has to bridge the reserve and the slowest service
+        double bridge_ms = m_reserve_ms;
+        if (4.0 * m_max_service_ns / 1e6 > bridge_ms)
+        {
+            bridge_ms = 4.0 * m_max_service_ns / 1e6;
+        }
+        uint64 bridge_scans = ceilScans(m_sample_rate * bridge_ms / 1000.0);
+
+        // A buffer filled beyond 3/4 before needs more reserve
+        const uint64 capacity = static_cast<uint64>(m_applied.block_size) * m_applied.block_count;
+        if (capacity > 0 && m_fill_peak * 4ull > capacity * 3ull)
+        {
+            bridge_scans = capacity * 2 > bridge_scans ? capacity * 2 : bridge_scans;
+            why << ", buffer fill " << 100 * m_fill_peak / capacity << " %";
+        }
+
+        // Respect the memory limit
+        if (block_size > max_scans / MIN_BLOCK_COUNT)
+        {
+            block_size = max_scans / MIN_BLOCK_COUNT;
+            why << ", limited by memory";
+        }
+        if (block_size == 0)
+        {
+            block_size = 1;
+        }
+
+        uint64 block_count = (bridge_scans + block_size - 1) / block_size + 2;
+        if (block_count < MIN_BLOCK_COUNT)
+        {
+            block_count = MIN_BLOCK_COUNT;
+        }
+        if (block_count * block_size > max_scans)
+        {
+            block_count = max_scans / block_size;
+        }
+
+        config.block_size = block_size;
+        config.block_count = static_cast<uint32>(block_count);
+        reason = why.str();
+        return config;
+    }
+
+    bool BufferController::retune()
+    {
+        std::string reason;
+        BufferConfig config = compute(reason);
+        BufferHeadroom room = headroom();
+
+        // Hysteresis: ignore block size changes below 20 %
+        const bool changed = m_applied.block_size == 0
+            || std::fabs(static_cast<double>(config.block_size) - m_applied.block_size) > 0.2 * m_applied.block_size
+            || config.block_count > m_applied.block_count;
+
+        std::ostringstream line;
+        line << "BoardID" << m_board_id
+             << ": block size " << config.block_size << " scans ("
+             << (m_sample_rate > 0.0 ? config.block_size * 1000.0 / m_sample_rate : 0.0) << " ms)"
+             << ", block count " << config.block_count
+             << ", service utilization " << 100.0 * room.service_utilization << " %"
+             << ", fill peak " << 100.0 * room.fill_peak << " %"
+             << " - " << reason << (changed ? "" : ", kept");
+        log(line.str());
+
+        if (changed)
+        {
+            m_config = config;
+        }
+        return changed;
+    }
+
+    int BufferController::apply()
+    {
+        if (m_config.block_size == 0)
+        {
+            return ERR_NONE;
+        }
+
+        int err = DeWeSetParam_i32(m_board_id, bufferCommand(CMD_BUFFER_0_BLOCK_SIZE, m_buffer), static_cast<sint32>(m_config.block_size));
+        if (err > 0)
+        {
+            return err;
+        }
+        err = DeWeSetParam_i32(m_board_id, bufferCommand(CMD_BUFFER_0_BLOCK_COUNT, m_buffer), static_cast<sint32>(m_config.block_count));
+        if (err > 0)
+        {
+            return err;
+        }
+        err = DeWeSetParam_i32(m_board_id, CMD_UPDATE_PARAM_ACQ_BUFFER, 0);
+        if (err > 0)
+        {
+            return err;
+        }
+
+        m_applied = m_config;
+        resetObservations();
+
+        std::ostringstream line;
+        line << "BoardID" << m_board_id << ": applied block size " << m_applied.block_size
+             << ", block count " << m_applied.block_count;
+        log(line.str());
+        return err;
+    }
+
+    BufferHeadroom BufferController::headroom() const
+    {
+        BufferHeadroom room;
+        const double acquired_ns = m_sample_rate > 0.0 ? m_sum_x * 1e9 / m_sample_rate : 0.0;
+        const uint64 capacity = static_cast<uint64>(m_applied.block_size) * m_applied.block_count;
+        room.service_utilization = acquired_ns > 0.0 ? m_sum_y / acquired_ns : 0.0;
+        room.fill_peak = capacity > 0 ? static_cast<double>(m_fill_peak) / capacity : 0.0;
+        room.max_service_ms = m_max_service_ns / 1e6;
+        return room;
+    }
+
+    void BufferController::log(const std::string& message) const
+    {
+        if (m_log)
+        {
+            m_log(message);
+        }
+    }
+}
@@ -0,0 +1,162 @@
+// Copyright DEWETRON 2024
+
+#include "dewepxi_buffer_telemetry.h"
+#include "dewepxi_ringbuffer.h"
+#include <cstring>
+#include <type_traits>
+
+
+namespace trion
+{
+    namespace
+    {
+        // Rate is measured over windows of at least this length
+        const uint64 RATE_WINDOW_NS = 250000000;
+    }
+
+
+    BufferMonitor::BufferMonitor(int board_id, int buffer)
+        : m_sample_rate(0.0)
+        , m_board_mem_interval_ms(0)
+        , m_board_mem_ns(0)
+        , m_rate_ns(0)
+        , m_rate_scans(0)
+        , m_seq(0)
+    {
+        static_assert(std::is_trivially_copyable<BufferTelemetry>::value, "BufferTelemetry is copied word wise");
+
+        std::memset(&m_data, 0, sizeof(m_data));
+        m_data.board_id = board_id;
+        m_data.buffer = buffer;
+        for (uint32 i = 0; i < WORDS; ++i)
+        {
+            m_words[i].store(0, std::memory_order_relaxed);
+        }
+        reset(0);
+    }
+
+    void BufferMonitor::reset(uint32 capacity_scans, double sample_rate)
+    {
+        const int board_id = m_data.board_id;
+        const int buffer = m_data.buffer;
+
+        std::memset(&m_data, 0, sizeof(m_data));
+        m_data.board_id = board_id;
+        m_data.buffer = buffer;
+        m_data.capacity_scans = capacity_scans;
+        m_data.board_mem_size = -1;
+        m_data.board_mem_free = -1;
+        m_data.board_mem_samples = -1;
+        m_sample_rate = sample_rate;
+        m_board_mem_ns = 0;
+        m_rate_ns = 0;
+        m_rate_scans = 0;
+        publish();
+    }
+
+    void BufferMonitor::setBoardMemoryInterval(uint32 interval_ms)
+    {
+        m_board_mem_interval_ms = interval_ms;
+    }
+
+    void BufferMonitor::update(uint32 avail_scans, uint32 new_scans, uint64 now_ns)
+    {
+        m_data.fill_scans = avail_scans;
+        if (avail_scans > m_data.high_water_scans)
+        {
+            m_data.high_water_scans = avail_scans;
+        }
+        m_data.fill_level = m_data.capacity_scans ? static_cast<double>(avail_scans) / m_data.capacity_scans : 0.0;
+        m_data.scans_total += new_scans;
+
+        if (m_rate_ns == 0)
+        {
+            m_rate_ns = now_ns;
+            m_rate_scans = m_data.scans_total;
+        }
+        else if (now_ns - m_rate_ns >= RATE_WINDOW_NS)
+        {
+            m_data.scans_per_second = (m_data.scans_total - m_rate_scans) * 1e9 / (now_ns - m_rate_ns);
+            m_rate_ns = now_ns;
+            m_rate_scans = m_data.scans_total;
+        }
+
+        const double rate = m_sample_rate > 0.0 ? m_sample_rate : m_data.scans_per_second;
+        const uint32 free_scans = m_data.capacity_scans > avail_scans ? m_data.capacity_scans - avail_scans : 0;
+        m_data.headroom_ms = rate > 0.0 ? free_scans * 1000.0 / rate : 0.0;
+
+        if (m_board_mem_interval_ms > 0 && now_ns - m_board_mem_ns >= m_board_mem_interval_ms * 1000000ull)
+        {
+            m_board_mem_ns = now_ns;
+            pollBoardMemory();
+        }
+
+        m_data.update_ns = now_ns;
+        publish();
+    }
+
+    void BufferMonitor::overrun(uint64 now_ns)
+    {
+        ++m_data.overruns;
+        m_data.update_ns = now_ns;
+        publish();
+    }
+
+    int BufferMonitor::pollBoardMemory()
+    {
+        const int board_id = m_data.board_id;
+        const int buffer = m_data.buffer;
+        sint32 value = 0;
+
+        int err = DeWeGetParam_i32(board_id, bufferCommand(CMD_BUFFER_0_BOARD_MEM_SIZE, buffer), &value);
+        m_data.board_mem_size = err > 0 ? -1 : value;
+        if (err > 0)
+        {
+            return err;
+        }
+        err = DeWeGetParam_i32(board_id, bufferCommand(CMD_BUFFER_0_FREE_BOARD_MEM_SIZE, buffer), &value);
+        m_data.board_mem_free = err > 0 ? -1 : value;
+        if (err > 0)
+        {
+            return err;
+        }
+        err = DeWeGetParam_i32(board_id, bufferCommand(CMD_BUFFER_0_NUM_SAMPLES_IN_BOARD_MEM, buffer), &value);
+        m_data.board_mem_samples = err > 0 ? -1 : value;
+        return err;
+    }
+
+    void BufferMonitor::publish()
+    {
+        uint64 words[WORDS] = { 0 };
+        std::memcpy(words, &m_data, sizeof(m_data));
+
+        // Odd sequence: write in progress
+        const uint32 seq = m_seq.load(std::memory_order_relaxed);
+        m_seq.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (uint32 i = 0; i < WORDS; ++i)
+        {
+            m_words[i].store(words[i], std::memory_order_relaxed);
+        }
+        m_seq.store(seq + 2, std::memory_order_release);
+    }
+
+    void BufferMonitor::snapshot(BufferTelemetry& telemetry) const
+    {
+        uint64 words[WORDS];
+        uint32 seq0;
+        uint32 seq1;
+        do
+        {
+            seq0 = m_seq.load(std::memory_order_acquire);
+            for (uint32 i = 0; i < WORDS; ++i)
+            {
+                words[i] = m_words[i].load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            seq1 = m_seq.load(std::memory_order_relaxed);
+        } while ((seq0 & 1) || seq0 != seq1);
+
+        std::memcpy(&telemetry, words, sizeof(telemetry));
+    }
+}
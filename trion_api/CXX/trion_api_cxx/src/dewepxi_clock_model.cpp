@@ -0,0 +1,378 @@
+// Copyright DEWETRON 2024
+
+#include "dewepxi_clock_model.h"
+#include "dewepxi_apicxx.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <sstream>
+#include <string>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  include <emmintrin.h>
+#  define DEWEPXI_CLOCK_SSE2 1
+#endif
+
+
+namespace trion
+{
+    namespace
+    {
+        const uint32 MAX_STATE_CHANGES = 64;
+        const uint32 STAMP_CHUNK = 1024;    // samples per exact rebase
+        const int FRACTION_BITS = 20;       // fixed point fraction of the slope
+        const uint64 NS_PER_SECOND = 1000000000ull;
+        const uint64 ROLLOVER_WINDOW_NS = 5000000;  // longest poll distance of a time point
+        const uint64 ROLLOVER_GUARD_NS = 20000000;  // fast polling starts this early
+        const uint64 ROLLOVER_POLL_NS = 1000000;    // poll step around a second change
+
+        uint64 steadyNs()
+        {
+            return static_cast<uint64>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count());
+        }
+
+        /**
+         * Days since 1970-01-01 of January 1st of a year (proleptic Gregorian).
+         */
+        sint64 daysToYear(sint64 year)
+        {
+            const sint64 y = year - 1;
+            return 365 * (year - 1970) + (y / 4 - y / 100 + y / 400) - (1969 / 4 - 1969 / 100 + 1969 / 400);
+        }
+
+        int readTimeItem(int board_id, const std::string& item, double& value)
+        {
+            std::string text;
+            int err = DeWeGetParamStruct_str_s("BoardId" + std::to_string(board_id) + "/AcqProp/Timing/SystemTime", item, text);
+            value = 0.0;
+            std::stringstream(text) >> value;
+            return err;
+        }
+
+        /**
+         * out[i] = base + ((i * slope_fx) >> FRACTION_BITS)
+         */
+        void stampChunk(uint64 base, uint64 slope_fx, uint32 count, uint64* out)
+        {
+            uint32 i = 0;
+#if defined(DEWEPXI_CLOCK_SSE2)
+            const __m128i base2 = _mm_set1_epi64x(static_cast<long long>(base));
+            const __m128i step = _mm_set1_epi64x(static_cast<long long>(slope_fx * 2));
+            __m128i acc = _mm_set_epi64x(static_cast<long long>(slope_fx), 0);
+            for (; i + 2 <= count; i += 2)
+            {
+                __m128i ns = _mm_add_epi64(base2, _mm_srli_epi64(acc, FRACTION_BITS));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), ns);
+                acc = _mm_add_epi64(acc, step);
+            }
+#endif
+            for (; i < count; ++i)
+            {
+                out[i] = base + ((i * slope_fx) >> FRACTION_BITS);
+            }
+        }
+    }
+
+
+    ClockModel::ClockModel(int board_id, double sample_rate)
+        : m_board_id(board_id)
+        , m_nominal_ns_per_sample(sample_rate > 0.0 ? 1e9 / sample_rate : 0.0)
+        , m_window(64)
+        , m_rollover_samples(sample_rate > 0.0
+            ? static_cast<uint64>(std::ceil(sample_rate * ROLLOVER_WINDOW_NS * 1e-9))
+            : std::numeric_limits<uint64>::max())
+        , m_poll_locked(false)
+        , m_poll_sample(0)
+        , m_poll_second(0)
+        , m_rollover_steady_ns(0)
+        , m_next_point(0)
+        , m_fit()
+        , m_running(false)
+        , m_last_error(ERR_NONE)
+    {
+        m_fit.ns_per_sample = m_nominal_ns_per_sample;
+        m_fit.timing_state = TIMINGSTATE_NOTRESYNCED;
+    }
+
+    ClockModel::~ClockModel()
+    {
+        stop();
+    }
+
+    void ClockModel::setWindow(uint32 points)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_window = points > 2 ? points : 2;
+        m_points.clear();
+        m_next_point = 0;
+    }
+
+    int ClockModel::update()
+    {
+        sint32 state = 0;
+        int err = DeWeGetParam_i32(m_board_id, CMD_TIMING_STATE, &state);
+        if (err > 0)
+        {
+            m_last_error.store(err);
+            return err;
+        }
+
+        // The latch returns the sample count it was taken at
+        sint32 latch = 0;
+        err = DeWeGetParam_i32(m_board_id, CMD_TIMING_TIME, &latch);
+
+        double year = 0.0;
+        double day = 0.0;
+        double sec = 0.0;
+        if (err <= 0)
+        {
+            err = readTimeItem(m_board_id, "Year", year);
+        }
+        if (err <= 0)
+        {
+            err = readTimeItem(m_board_id, "Day", day);
+        }
+        if (err <= 0)
+        {
+            err = readTimeItem(m_board_id, "Sec", sec);
+        }
+        m_last_error.store(err > 0 ? err : ERR_NONE);
+        if (err > 0)
+        {
+            m_poll_locked = false;
+            return err;
+        }
+
+        const uint64 sample = m_sample_count.unwrap(static_cast<uint32>(latch));
+        setTimingState(sample, state);
+        if (state != TIMINGSTATE_LOCKED || year < 1970.0 || day < 1.0)
+        {
+            m_poll_locked = false;
+            return err;
+        }
+
+        // Day is the day of the year, starting at 1
+        const sint64 days = daysToYear(static_cast<sint64>(year)) + static_cast<sint64>(day) - 1;
+        const uint64 second = static_cast<uint64>(days) * 86400 + static_cast<uint64>(std::floor(sec));
+        if (m_poll_locked && second == m_poll_second + 1 && sample - m_poll_sample <= m_rollover_samples)
+        {
+            // The second started between the two latches
+            addPoint(m_poll_sample + (sample - m_poll_sample) / 2, second * NS_PER_SECOND);
+            m_rollover_steady_ns = steadyNs();
+        }
+        m_poll_locked = true;
+        m_poll_sample = sample;
+        m_poll_second = second;
+        return err;
+    }
+
+    void ClockModel::addPoint(uint64 sample, uint64 time_ns)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Point point;
+        point.sample = sample;
+        point.time_ns = time_ns;
+        if (m_points.size() < m_window)
+        {
+            m_points.push_back(point);
+        }
+        else
+        {
+            m_points[m_next_point] = point;
+        }
+        m_next_point = (m_next_point + 1) % m_window;
+        refit();
+    }
+
+    void ClockModel::setTimingState(uint64 sample, sint32 state)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_fit.timing_state = state;
+        if (!m_states.empty() && m_states.back().state == state)
+        {
+            return;
+        }
+        if (m_states.size() >= MAX_STATE_CHANGES)
+        {
+            m_states.erase(m_states.begin());
+        }
+        StateChange change;
+        change.sample = sample;
+        change.state = state;
+        m_states.push_back(change);
+    }
+
+    void ClockModel::refit()
+    {
+        // Least squares relative to the first point, centered for double precision
+        const uint64 x0 = m_points[0].sample;
+        const uint64 y0 = m_points[0].time_ns;
+        const double n = static_cast<double>(m_points.size());
+        double mean_x = 0.0;
+        double mean_y = 0.0;
+        for (const Point& p : m_points)
+        {
+            mean_x += static_cast<double>(static_cast<sint64>(p.sample - x0));
+            mean_y += static_cast<double>(static_cast<sint64>(p.time_ns - y0));
+        }
+        mean_x /= n;
+        mean_y /= n;
+
+        double sxx = 0.0;
+        double sxy = 0.0;
+        for (const Point& p : m_points)
+        {
+            const double x = static_cast<double>(static_cast<sint64>(p.sample - x0)) - mean_x;
+            const double y = static_cast<double>(static_cast<sint64>(p.time_ns - y0)) - mean_y;
+            sxx += x * x;
+            sxy += x * y;
+        }
+
+        const double slope = m_points.size() >= 2 && sxx > 0.0 ? sxy / sxx : m_nominal_ns_per_sample;
+
+        double residual = 0.0;
+        for (const Point& p : m_points)
+        {
+            const double x = static_cast<double>(static_cast<sint64>(p.sample - x0)) - mean_x;
+            const double y = static_cast<double>(static_cast<sint64>(p.time_ns - y0)) - mean_y;
+            const double r = y - x * slope;
+            residual += r * r;
+        }
+
+        // Reference at the centroid, the best determined point of the fit
+        m_fit.ref_sample = x0 + static_cast<uint64>(static_cast<sint64>(std::floor(mean_x + 0.5)));
+        m_fit.ref_ns = y0 + static_cast<uint64>(static_cast<sint64>(std::floor(
+            mean_y + (static_cast<double>(static_cast<sint64>(m_fit.ref_sample - x0)) - mean_x) * slope + 0.5)));
+        m_fit.ns_per_sample = slope;
+        m_fit.residual_ns = std::sqrt(residual / n);
+        m_fit.points = static_cast<uint32>(m_points.size());
+    }
+
+    bool ClockModel::degraded(uint64 first_sample, uint64 end_sample) const
+    {
+        // State valid at first_sample, then the changes within the block
+        sint32 state = TIMINGSTATE_NOTRESYNCED;
+        for (const StateChange& change : m_states)
+        {
+            if (change.sample >= end_sample)
+            {
+                break;
+            }
+            if (change.sample > first_sample && state != TIMINGSTATE_LOCKED)
+            {
+                return true;
+            }
+            state = change.state;
+        }
+        return state != TIMINGSTATE_LOCKED;
+    }
+
+    uint32 ClockModel::stamp(uint64 first_sample, uint32 count, uint64* time_ns) const
+    {
+        ClockFit fit;
+        uint32 flags = 0;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            fit = m_fit;
+            if (degraded(first_sample, first_sample + (count ? count : 1)))
+            {
+                flags |= CLOCK_FLAG_DEGRADED;
+            }
+        }
+        if (fit.points < 2)
+        {
+            flags |= CLOCK_FLAG_UNFITTED;
+        }
+
+        const uint64 slope_fx = static_cast<uint64>(fit.ns_per_sample * (1 << FRACTION_BITS) + 0.5);
+        for (uint32 i = 0; i < count; i += STAMP_CHUNK)
+        {
+            // Exact base per chunk, the fixed point slope only spans one chunk
+            const sint64 delta = static_cast<sint64>(first_sample + i - fit.ref_sample);
+            const uint64 base = fit.ref_ns + static_cast<uint64>(static_cast<sint64>(
+                std::floor(static_cast<double>(delta) * fit.ns_per_sample + 0.5)));
+            stampChunk(base, slope_fx, count - i < STAMP_CHUNK ? count - i : STAMP_CHUNK, time_ns + i);
+        }
+        return flags;
+    }
+
+    uint64 ClockModel::timeOf(uint64 sample) const
+    {
+        uint64 ns = 0;
+        stamp(sample, 1, &ns);
+        return ns;
+    }
+
+    ClockFit ClockModel::fit() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_fit;
+    }
+
+    void ClockModel::start(uint32 interval_ms)
+    {
+        if (m_running.load())
+        {
+            return;
+        }
+        m_running.store(true);
+        m_thread = std::thread(&ClockModel::run, this, interval_ms);
+    }
+
+    void ClockModel::stop()
+    {
+        m_running.store(false);
+        if (m_thread.joinable())
+        {
+            m_thread.join();
+        }
+    }
+
+    void ClockModel::run(uint32 interval_ms)
+    {
+        const uint64 interval_ns = static_cast<uint64>(interval_ms) * 1000000ull;
+        const uint64 period_ns = std::max<uint64>((interval_ns + NS_PER_SECOND / 2) / NS_PER_SECOND, 1) * NS_PER_SECOND;
+        while (m_running.load())
+        {
+            update();
+
+            // Poll every millisecond until a second change was seen, then
+            // sleep until shortly before the one expected a period later.
+            // Not locked: nothing to fit, poll at the interval
+            const uint64 now = steadyNs();
+            uint64 wake = now + ROLLOVER_POLL_NS;
+            if (!m_poll_locked)
+            {
+                wake = now + std::max(interval_ns, ROLLOVER_POLL_NS);
+            }
+            else if (m_rollover_steady_ns != 0)
+            {
+                // A change missed by more than the guard is retried at the following second
+                uint64 next = m_rollover_steady_ns + period_ns;
+                while (now > next + ROLLOVER_GUARD_NS)
+                {
+                    next += NS_PER_SECOND;
+                }
+                wake = std::max(wake, next - ROLLOVER_GUARD_NS);
+            }
+            sleepUntil(wake);
+        }
+    }
+
+    void ClockModel::sleepUntil(uint64 steady_ns) const
+    {
+        // Sleep in short steps to stop quickly, toward a deadline so the oversleeps do not add up
+        const uint64 STEP_NS = 10000000;
+        while (m_running.load())
+        {
+            const uint64 now = steadyNs();
+            if (now >= steady_ns)
+            {
+                return;
+            }
+            std::this_thread::sleep_for(std::chrono::nanoseconds(std::min(steady_ns - now, STEP_NS)));
+        }
+    }
+}
@@ -0,0 +1,284 @@
+// Copyright DEWETRON 2024
+
+#include "dewepxi_config_executor.h"
+#include "dewepxi_acq_engine.h"
+#include "dewepxi_apicore.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <thread>
+
+
+namespace trion
+{
+    namespace
+    {
+        // A parallel phase below this speedup is treated as serialized by the driver
+        const double MIN_PARALLEL_SPEEDUP = 1.25;
+
+        // Phases shorter than this are not used to detect serialization
+        const uint64 MIN_JUDGED_PHASE_NS = 5000000;
+
+        bool equalsNoCase(const std::string& a, const std::string& b)
+        {
+            if (a.size() != b.size())
+            {
+                return false;
+            }
+            for (size_t i = 0; i < a.size(); ++i)
+            {
+                if (std::tolower(static_cast<unsigned char>(a[i])) != std::tolower(static_cast<unsigned char>(b[i])))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+    }
+
+
+    BoardSetup::BoardSetup(int board_id, BoardRole role)
+        : board_id(board_id)
+        , role(role)
+        , open(true)
+        , reset(true)
+        , update(true)
+    {
+    }
+
+    BoardSetup& BoardSetup::set(const std::string& target, const std::string& item, const std::string& value)
+    {
+        ConfigStep step;
+        step.target = target;
+        step.item = item;
+        step.value = value;
+        step.command = 0;
+        step.command_value = 0;
+        steps.push_back(step);
+        return *this;
+    }
+
+    BoardSetup& BoardSetup::command(uint32 command, sint32 value)
+    {
+        ConfigStep step;
+        step.command = command;
+        step.command_value = value;
+        steps.push_back(step);
+        return *this;
+    }
+
+    std::string BoardSetup::boardTarget(const std::string& target) const
+    {
+        return "BoardID" + std::to_string(board_id) + (target.empty() ? "" : "/" + target);
+    }
+
+
+    ConfigExecutor::ConfigExecutor(uint32 workers)
+        : m_workers(workers ? workers : std::max(1u, std::thread::hardware_concurrency()))
+        , m_report()
+    {
+    }
+
+    uint32 ConfigExecutor::addBoard(const BoardSetup& setup)
+    {
+        m_boards.push_back(setup);
+        return static_cast<uint32>(m_boards.size() - 1);
+    }
+
+    void ConfigExecutor::setTrig7Driver(int board_id)
+    {
+        for (BoardSetup& setup : m_boards)
+        {
+            if (setup.role == BOARD_ROLE_CONTROLLER)
+            {
+                // Controller-V2: the controller drives TRIG7 by SYNC_OUT7
+                if (setup.board_id == board_id)
+                {
+                    setup.set("SYNC_OUT7", "Source", "Low");
+                    setup.set("SYNC_OUT7", "Inverted", "False");
+                }
+                continue;
+            }
+            setup.set("Trig7", "Source", setup.board_id == board_id ? "Low" : "Disable");
+            setup.set("Trig7", "Inverted", "False");
+        }
+    }
+
+    bool ConfigExecutor::trig7Unique() const
+    {
+        uint32 drivers = 0;
+        for (const BoardSetup& setup : m_boards)
+        {
+            // The controller drives TRIG7 by SYNC_OUT7, the other boards by Trig7
+            const char* line = setup.role == BOARD_ROLE_CONTROLLER ? "SYNC_OUT7" : "Trig7";
+
+            // The last Source setting of a board counts
+            bool driving = false;
+            for (const ConfigStep& step : setup.steps)
+            {
+                if (equalsNoCase(step.target, line) && equalsNoCase(step.item, "Source"))
+                {
+                    driving = !equalsNoCase(step.value, "Disable");
+                }
+            }
+            drivers += driving ? 1 : 0;
+        }
+        return drivers <= 1;
+    }
+
+    int ConfigExecutor::run()
+    {
+        m_report = StartupReport();
+        m_report.boards.resize(m_boards.size());
+        for (size_t i = 0; i < m_boards.size(); ++i)
+        {
+            m_report.boards[i] = BoardStartupReport();
+            m_report.boards[i].board_id = m_boards[i].board_id;
+        }
+
+        if (!trig7Unique())
+        {
+            return ERR_INVALID_VALUE;
+        }
+
+        const uint64 start_ns = steadyClockNs();
+        for (int phase = 0; phase < CONFIG_PHASE_COUNT; ++phase)
+        {
+            runPhase(static_cast<ConfigPhase>(phase));
+        }
+        m_report.total_ns = steadyClockNs() - start_ns;
+
+        for (const BoardStartupReport& board : m_report.boards)
+        {
+            if (board.error > 0)
+            {
+                return board.error;
+            }
+        }
+        return ERR_NONE;
+    }
+
+    int ConfigExecutor::runStep(BoardSetup& setup, ConfigPhase phase)
+    {
+        switch (phase)
+        {
+        case CONFIG_PHASE_OPEN:
+            return setup.open ? DeWeSetParam_i32(setup.board_id, CMD_OPEN_BOARD, 0) : ERR_NONE;
+        case CONFIG_PHASE_RESET:
+            return setup.reset ? DeWeSetParam_i32(setup.board_id, CMD_RESET_BOARD, 0) : ERR_NONE;
+        case CONFIG_PHASE_CONFIGURE:
+            for (const ConfigStep& step : setup.steps)
+            {
+                int err = step.target.empty()
+                    ? DeWeSetParam_i32(setup.board_id, step.command, step.command_value)
+                    : DeWeSetParamStruct_str(setup.boardTarget(step.target).c_str(), step.item.c_str(), step.value.c_str());
+                if (err > 0)
+                {
+                    return err;
+                }
+            }
+            return ERR_NONE;
+        case CONFIG_PHASE_UPDATE:
+            return setup.update ? DeWeSetParam_i32(setup.board_id, CMD_UPDATE_PARAM_ALL, 0) : ERR_NONE;
+        default:
+            return ERR_NONE;
+        }
+    }
+
+    void ConfigExecutor::runPhase(ConfigPhase phase)
+    {
+        const uint64 phase_start = steadyClockNs();
+
+        auto runBoard = [this, phase](size_t i)
+        {
+            BoardStartupReport& report = m_report.boards[i];
+            if (report.error > 0)
+            {
+                return;
+            }
+            const uint64 start = steadyClockNs();
+            int err = runStep(m_boards[i], phase);
+            report.phase_ns[phase] = steadyClockNs() - start;
+            if (err > 0)
+            {
+                report.error = err;
+            }
+        };
+
+        // Chassis controller, then the master, one after the other
+        std::vector<size_t> slaves;
+        for (int role = BOARD_ROLE_CONTROLLER; role <= BOARD_ROLE_SLAVE; ++role)
+        {
+            for (size_t i = 0; i < m_boards.size(); ++i)
+            {
+                if (m_boards[i].role != role)
+                {
+                    continue;
+                }
+                if (role == BOARD_ROLE_SLAVE)
+                {
+                    slaves.push_back(i);
+                }
+                else
+                {
+                    runBoard(i);
+                }
+            }
+        }
+
+        // Slaves on the worker threads
+        const uint32 workers = static_cast<uint32>(std::min<size_t>(m_workers, slaves.size()));
+        const bool parallel = workers > 1 && !m_report.serial_fallback;
+        const uint64 slaves_start = steadyClockNs();
+        if (parallel)
+        {
+            std::atomic<size_t> next(0);
+            std::vector<std::thread> threads;
+            for (uint32 w = 0; w < workers; ++w)
+            {
+                threads.emplace_back([&]()
+                {
+                    for (size_t n = next++; n < slaves.size(); n = next++)
+                    {
+                        runBoard(slaves[n]);
+                    }
+                });
+            }
+            for (std::thread& thread : threads)
+            {
+                thread.join();
+            }
+        }
+        else
+        {
+            for (size_t i : slaves)
+            {
+                runBoard(i);
+            }
+        }
+        const uint64 slaves_ns = steadyClockNs() - slaves_start;
+
+        m_report.phase_ns[phase] = steadyClockNs() - phase_start;
+        m_report.phase_parallel[phase] = parallel;
+
+        // No speedup: the driver serializes the calls, run the next phases serially.
+        // The fastest slave waited least for the driver, it estimates the cost of one call
+        if (parallel && slaves_ns >= MIN_JUDGED_PHASE_NS)
+        {
+            uint64 fastest_ns = ~0ull;
+            for (size_t i : slaves)
+            {
+                // Boards skipped after an error did not call the driver
+                if (m_report.boards[i].phase_ns[phase])
+                {
+                    fastest_ns = std::min(fastest_ns, m_report.boards[i].phase_ns[phase]);
+                }
+            }
+            const double serial_ns = static_cast<double>(fastest_ns) * static_cast<double>(slaves.size());
+            if (fastest_ns != ~0ull && serial_ns < MIN_PARALLEL_SPEEDUP * static_cast<double>(slaves_ns))
+            {
+                m_report.serial_fallback = true;
+            }
+        }
+    }
+}
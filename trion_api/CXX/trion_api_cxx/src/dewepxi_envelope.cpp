@@ -0,0 +1,277 @@
+// Copyright DEWETRON 2024
+
+#include "dewepxi_envelope.h"
+#include <algorithm>
+#include <limits>
+
+
+namespace trion
+{
+    namespace
+    {
+        void resetAccumulator(float& min, float& max, double& sum, uint32& count)
+        {
+            min = std::numeric_limits<float>::infinity();
+            max = -std::numeric_limits<float>::infinity();
+            sum = 0.0;
+            count = 0;
+        }
+
+        EnvelopeBucket emptyBucket()
+        {
+            EnvelopeBucket bucket = { 0.0f, 0.0f, 0.0f, 0 };
+            return bucket;
+        }
+    }
+
+
+    EnvelopePyramid::EnvelopePyramid(uint32 base_samples, uint32 factor)
+        : m_base_samples(std::max<uint32>(base_samples, 1))
+        , m_factor(std::max<uint32>(factor, 2))
+        , m_samples(0)
+    {
+        clear();
+    }
+
+    void EnvelopePyramid::append(const sint32* samples, uint32 count)
+    {
+        appendSamples(samples, count);
+    }
+
+    void EnvelopePyramid::append(const float* samples, uint32 count)
+    {
+        appendSamples(samples, count);
+    }
+
+    void EnvelopePyramid::append(const double* samples, uint32 count)
+    {
+        appendSamples(samples, count);
+    }
+
+    void EnvelopePyramid::clear()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_levels.clear();
+        m_levels.resize(1);
+        resetAccumulator(m_levels[0].open.min, m_levels[0].open.max, m_levels[0].open.sum, m_levels[0].open.count);
+        resetAccumulator(m_base.min, m_base.max, m_base.sum, m_base.count);
+        m_samples = 0;
+    }
+
+    uint64 EnvelopePyramid::samples() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_samples;
+    }
+
+    uint32 EnvelopePyramid::numLevels() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return static_cast<uint32>(m_levels.size());
+    }
+
+    uint64 EnvelopePyramid::bucketSamples(uint32 level) const
+    {
+        uint64 samples = m_base_samples;
+        for (uint32 i = 0; i < level; ++i)
+        {
+            samples *= m_factor;
+        }
+        return samples;
+    }
+
+    uint64 EnvelopePyramid::memoryBytes() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        uint64 bytes = 0;
+        for (const Level& level : m_levels)
+        {
+            bytes += level.buckets.capacity() * sizeof(EnvelopeBucket);
+        }
+        return bytes;
+    }
+
+    template <typename T>
+    void EnvelopePyramid::appendSamples(const T* samples, uint32 count)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_samples += count;
+        while (count > 0)
+        {
+            const uint32 n = std::min(count, m_base_samples - m_base.count);
+            // Written to vectorize: no branches, independent min, max and sum
+            float min = m_base.min;
+            float max = m_base.max;
+            double sum = 0.0;
+            for (uint32 i = 0; i < n; ++i)
+            {
+                const float value = static_cast<float>(samples[i]);
+                min = value < min ? value : min;
+                max = value > max ? value : max;
+                sum += static_cast<double>(samples[i]);
+            }
+            m_base.min = min;
+            m_base.max = max;
+            m_base.sum += sum;
+            m_base.count += n;
+            samples += n;
+            count -= n;
+
+            if (m_base.count == m_base_samples)
+            {
+                completeBase();
+            }
+        }
+    }
+
+    void EnvelopePyramid::completeBase()
+    {
+        // Close the level 0 bucket and carry it up while the levels above complete
+        Accumulator* source = &m_base;
+        for (size_t level = 0;; ++level)
+        {
+            EnvelopeBucket bucket;
+            bucket.min = source->min;
+            bucket.max = source->max;
+            bucket.mean = static_cast<float>(source->sum / source->count);
+            bucket.count = source->count;
+            resetAccumulator(source->min, source->max, source->sum, source->count);
+
+            m_levels[level].buckets.push_back(bucket);
+            if (level + 1 == m_levels.size())
+            {
+                m_levels.resize(level + 2);
+                Accumulator& open = m_levels[level + 1].open;
+                resetAccumulator(open.min, open.max, open.sum, open.count);
+            }
+
+            Accumulator& up = m_levels[level + 1].open;
+            up.min = std::min(up.min, bucket.min);
+            up.max = std::max(up.max, bucket.max);
+            up.sum += static_cast<double>(bucket.mean) * bucket.count;
+            up.count += bucket.count;
+            if (up.count < bucketSamples(static_cast<uint32>(level + 1)))
+            {
+                return;
+            }
+            source = &up;
+        }
+    }
+
+    EnvelopeBucket EnvelopePyramid::openBucket(uint32 level) const
+    {
+        // The incomplete bucket of a level holds the incomplete buckets of all levels below
+        Accumulator acc = m_base;
+        for (uint32 i = 1; i <= level; ++i)
+        {
+            const Accumulator& open = m_levels[i].open;
+            acc.min = std::min(acc.min, open.min);
+            acc.max = std::max(acc.max, open.max);
+            acc.sum += open.sum;
+            acc.count += open.count;
+        }
+        if (acc.count == 0)
+        {
+            return emptyBucket();
+        }
+        EnvelopeBucket bucket = { acc.min, acc.max, static_cast<float>(acc.sum / acc.count), acc.count };
+        return bucket;
+    }
+
+    uint32 EnvelopePyramid::query(uint64 first_sample, uint64 end_sample, uint32 pixels, std::vector<EnvelopeBucket>& out) const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        out.assign(pixels, emptyBucket());
+        end_sample = std::min(end_sample, m_samples);
+        if (pixels == 0 || first_sample >= end_sample)
+        {
+            return 0;
+        }
+
+        // Coarsest level with at least one bucket per pixel
+        const uint64 span = end_sample - first_sample;
+        uint32 level = 0;
+        while (level + 1 < m_levels.size() && bucketSamples(level + 1) * pixels <= span)
+        {
+            ++level;
+        }
+        const uint64 bucket_samples = bucketSamples(level);
+        const std::vector<EnvelopeBucket>& buckets = m_levels[level].buckets;
+        const EnvelopeBucket open = openBucket(level);
+
+        uint32 filled = 0;
+        for (uint32 p = 0; p < pixels; ++p)
+        {
+            const uint64 s0 = first_sample + span * p / pixels;
+            const uint64 s1 = std::max(first_sample + span * (p + 1) / pixels, s0 + 1);
+            if (s0 >= end_sample)
+            {
+                break;
+            }
+
+            float min = std::numeric_limits<float>::infinity();
+            float max = -std::numeric_limits<float>::infinity();
+            double sum = 0.0;
+            uint32 count = 0;
+            for (uint64 b = s0 / bucket_samples; b <= (s1 - 1) / bucket_samples; ++b)
+            {
+                const EnvelopeBucket& bucket = b < buckets.size() ? buckets[static_cast<size_t>(b)] : open;
+                min = std::min(min, bucket.min);
+                max = std::max(max, bucket.max);
+                sum += static_cast<double>(bucket.mean) * bucket.count;
+                count += bucket.count;
+            }
+
+            EnvelopeBucket& pixel = out[p];
+            pixel.min = min;
+            pixel.max = max;
+            pixel.mean = static_cast<float>(sum / count);
+            pixel.count = count;
+            ++filled;
+        }
+        return filled;
+    }
+
+
+    EnvelopeSet::EnvelopeSet(uint32 num_channels, uint32 base_samples, uint32 factor)
+    {
+        m_channels.reserve(num_channels);
+        for (uint32 c = 0; c < num_channels; ++c)
+        {
+            m_channels.push_back(std::unique_ptr<EnvelopePyramid>(new EnvelopePyramid(base_samples, factor)));
+        }
+    }
+
+    template <typename T>
+    void EnvelopeSet::appendBlock(const SampleBlock<T>& block)
+    {
+        const uint32 channels = std::min(block.numChannels(), numChannels());
+        for (uint32 c = 0; c < channels; ++c)
+        {
+            m_channels[c]->append(block.channel(c), block.scans());
+        }
+    }
+
+    void EnvelopeSet::append(const DecodedBlock& block)
+    {
+        appendBlock(block);
+    }
+
+    void EnvelopeSet::append(const ScaledBlockF32& block)
+    {
+        appendBlock(block);
+    }
+
+    void EnvelopeSet::append(const ScaledBlockF64& block)
+    {
+        appendBlock(block);
+    }
+
+    void EnvelopeSet::clear()
+    {
+        for (auto& channel : m_channels)
+        {
+            channel->clear();
+        }
+    }
+}
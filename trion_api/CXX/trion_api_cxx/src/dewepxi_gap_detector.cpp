@@ -0,0 +1,106 @@
+// Copyright DEWETRON 2024
+
+#include "dewepxi_gap_detector.h"
+#include <cstring>
+
+
+namespace trion
+{
+    GapDetector::GapDetector()
+        : m_counter_offset(0)
+        , m_adc_delay(0)
+        , m_started(false)
+        , m_next_sample(0)
+        , m_lost_ns(0)
+        , m_gaps(0)
+        , m_lost_samples(0)
+        , m_resyncs(0)
+    {
+    }
+
+    int GapDetector::init(sint32 board_id, const ScanDescriptor& sd)
+    {
+        sint32 adc_delay = 0;
+        int err = DeWeGetParam_i32(board_id, CMD_BOARD_ADC_DELAY, &adc_delay);
+        if (err > 0)
+        {
+            return err;
+        }
+        return init(sd, adc_delay > 0 ? static_cast<uint32>(adc_delay) : 0);
+    }
+
+    int GapDetector::init(const ScanDescriptor& sd, uint32 adc_delay)
+    {
+        int index = sd.findChannel("BoardCnt0");
+        if (index < 0)
+        {
+            return ERR_BOARDCNT_CHANNEL_NOT_VALID;
+        }
+
+        init(sd.channels()[index].sample_offset / 8, adc_delay);
+        return ERR_NONE;
+    }
+
+    void GapDetector::init(uint32 counter_offset, uint32 adc_delay)
+    {
+        m_counter_offset = counter_offset;
+        m_adc_delay = adc_delay;
+        reset();
+    }
+
+    void GapDetector::reset()
+    {
+        m_started = false;
+        m_next_sample = 0;
+        m_lost_ns = 0;
+    }
+
+    bool GapDetector::process(const BlockDescriptor& block, GapRecord& gap)
+    {
+        if (block.flags & BLOCK_FLAG_DATA_LOST)
+        {
+            m_lost_ns = m_lost_ns ? m_lost_ns : block.wake_ns;
+            return false;
+        }
+        if (block.scans == 0 || block.spans.count == 0)
+        {
+            return false;
+        }
+
+        uint32 first;
+        std::memcpy(&first, block.spans.span[0].data + m_counter_offset, sizeof(first));
+
+        bool lost = false;
+        if (!m_started)
+        {
+            m_started = true;
+            m_next_sample = first;
+        }
+        else
+        {
+            // The 32 bit difference handles the counter wrap around
+            const uint32 diff = first - static_cast<uint32>(m_next_sample);
+            if (diff >= 0x80000000u)
+            {
+                ++m_resyncs;
+                m_next_sample = first;
+            }
+            else if (diff > 0)
+            {
+                gap.first_sample = m_next_sample;
+                gap.samples = diff;
+                gap.first_analog_sample = m_next_sample > m_adc_delay ? m_next_sample - m_adc_delay : 0;
+                gap.first_scan = block.first_scan;
+                gap.recovery_ns = m_lost_ns && block.publish_ns > m_lost_ns ? block.publish_ns - m_lost_ns : 0;
+                m_next_sample += diff;
+                m_lost_samples += diff;
+                ++m_gaps;
+                lost = true;
+            }
+        }
+
+        m_lost_ns = 0;
+        m_next_sample += block.scans;
+        return lost;
+    }
+}
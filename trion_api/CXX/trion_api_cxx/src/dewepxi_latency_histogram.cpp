@@ -0,0 +1,85 @@
+// Copyright DEWETRON 2024
+
+#include "dewepxi_latency_histogram.h"
+
+
+namespace trion
+{
+    LatencyHistogram::LatencyHistogram()
+    {
+        reset();
+    }
+
+    void LatencyHistogram::reset()
+    {
+        for (uint32 i = 0; i < NUM_BUCKETS; ++i)
+        {
+            m_counts[i].store(0, std::memory_order_relaxed);
+        }
+        m_count.store(0, std::memory_order_relaxed);
+        m_total.store(0, std::memory_order_relaxed);
+        m_max.store(0, std::memory_order_relaxed);
+    }
+
+    double LatencyHistogram::mean() const
+    {
+        const uint64 n = count();
+        return n ? static_cast<double>(m_total.load(std::memory_order_relaxed)) / n : 0.0;
+    }
+
+    uint64 LatencyHistogram::bucketUpper(uint32 index)
+    {
+        if (index < 2 * SUB_BUCKETS)
+        {
+            return index;
+        }
+        const uint32 shift = index / SUB_BUCKETS - 1;
+        const uint64 sub = index % SUB_BUCKETS + SUB_BUCKETS;
+        return ((sub + 1) << shift) - 1;
+    }
+
+    uint64 LatencyHistogram::percentile(double percentile) const
+    {
+        uint64 total = 0;
+        for (uint32 i = 0; i < NUM_BUCKETS; ++i)
+        {
+            total += m_counts[i].load(std::memory_order_relaxed);
+        }
+        if (total == 0)
+        {
+            return 0;
+        }
+
+        uint64 rank = static_cast<uint64>(percentile / 100.0 * total + 0.5);
+        if (rank < 1)
+        {
+            rank = 1;
+        }
+
+        uint64 seen = 0;
+        for (uint32 i = 0; i < NUM_BUCKETS; ++i)
+        {
+            seen += m_counts[i].load(std::memory_order_relaxed);
+            if (seen >= rank)
+            {
+                // Never report above the recorded maximum
+                const uint64 upper = bucketUpper(i);
+                const uint64 max_ns = max();
+                return upper < max_ns ? upper : max_ns;
+            }
+        }
+        return max();
+    }
+
+    LatencySummary LatencyHistogram::summary() const
+    {
+        LatencySummary summary;
+        summary.count = count();
+        summary.p50_ns = percentile(50.0);
+        summary.p99_ns = percentile(99.0);
+        summary.p999_ns = percentile(99.9);
+        summary.max_ns = max();
+        summary.mean_ns = mean();
+        return summary;
+    }
+}
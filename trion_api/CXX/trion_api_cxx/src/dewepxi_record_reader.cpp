@@ -0,0 +1,420 @@
+// Copyright DEWETRON 2024
+
+#include "dewepxi_record_reader.h"
+#include "dewepxi_sample_codec.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+namespace trion
+{
+    RecordReader::RecordReader()
+        : m_data(nullptr)
+        , m_size(0)
+#if defined(_WIN32)
+        , m_file(INVALID_HANDLE_VALUE)
+        , m_mapping(nullptr)
+#endif
+        , m_total_scans(0)
+    {
+        std::memset(&m_header, 0, sizeof(m_header));
+    }
+
+    RecordReader::~RecordReader()
+    {
+        close();
+    }
+
+    bool RecordReader::open(const std::string& path)
+    {
+        close();
+        m_error.clear();
+
+#if defined(_WIN32)
+        m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        LARGE_INTEGER size;
+        if (m_file == INVALID_HANDLE_VALUE || !GetFileSizeEx(m_file, &size) || size.QuadPart == 0)
+        {
+            m_error = "Cannot open " + path;
+            close();
+            return false;
+        }
+        m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        const void* view = m_mapping ? MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+        if (!view)
+        {
+            m_error = "Cannot map " + path;
+            close();
+            return false;
+        }
+        m_data = static_cast<const uint8*>(view);
+        m_size = static_cast<uint64>(size.QuadPart);
+#else
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        struct stat st;
+        if (fd < 0 || fstat(fd, &st) != 0 || st.st_size == 0)
+        {
+            m_error = "Cannot open " + path;
+            if (fd >= 0)
+            {
+                ::close(fd);
+            }
+            return false;
+        }
+        void* view = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (view == MAP_FAILED)
+        {
+            m_error = "Cannot map " + path;
+            return false;
+        }
+        m_data = static_cast<const uint8*>(view);
+        m_size = static_cast<uint64>(st.st_size);
+#endif
+
+        if (m_size < sizeof(RecordFileHeader))
+        {
+            m_error = "No recording";
+            close();
+            return false;
+        }
+        std::memcpy(&m_header, m_data, sizeof(m_header));
+        if (std::memcmp(m_header.magic, "TRIONREC", sizeof(m_header.magic)) != 0)
+        {
+            m_error = "No recording";
+            close();
+            return false;
+        }
+        if (m_header.version != RECORD_VERSION)
+        {
+            m_error = "Unsupported recording version";
+            close();
+            return false;
+        }
+        const uint64 channels_end = m_header.channel_offset + static_cast<uint64>(sizeof(RecordChannelInfo)) * m_header.num_channels;
+        if (m_header.header_size > m_size || channels_end > m_header.header_size
+            || static_cast<uint64>(m_header.xml_offset) + m_header.xml_size > m_header.header_size)
+        {
+            m_error = "Corrupt recording header";
+            close();
+            return false;
+        }
+
+        m_channels.resize(m_header.num_channels);
+        if (!m_channels.empty())
+        {
+            std::memcpy(m_channels.data(), m_data + m_header.channel_offset, sizeof(RecordChannelInfo) * m_channels.size());
+        }
+
+        if (m_header.scan_size)
+        {
+            try
+            {
+                m_decoder.reset(new ScanDecoder(scanDescriptor()));
+            }
+            catch (const std::runtime_error&)
+            {
+            }
+            if (!m_decoder || m_decoder->scanSize() != m_header.scan_size || m_decoder->numChannels() != numChannels())
+            {
+                m_error = "Unsupported scan descriptor";
+                close();
+                return false;
+            }
+        }
+
+        if (!buildIndex())
+        {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void RecordReader::close()
+    {
+#if defined(_WIN32)
+        if (m_data)
+        {
+            UnmapViewOfFile(m_data);
+        }
+        if (m_mapping)
+        {
+            CloseHandle(m_mapping);
+        }
+        if (m_file != INVALID_HANDLE_VALUE)
+        {
+            CloseHandle(m_file);
+        }
+        m_mapping = nullptr;
+        m_file = INVALID_HANDLE_VALUE;
+#else
+        if (m_data)
+        {
+            munmap(const_cast<uint8*>(m_data), static_cast<size_t>(m_size));
+        }
+#endif
+        m_data = nullptr;
+        m_size = 0;
+        m_channels.clear();
+        m_decoder.reset();
+        m_index.clear();
+        m_stamped.clear();
+        m_total_scans = 0;
+    }
+
+    bool RecordReader::buildIndex()
+    {
+        const uint32 num_channels = numChannels();
+        uint64 pos = m_header.header_size;
+
+        // Follow the chunk headers, an interrupted recording ends with an incomplete chunk
+        while (pos + sizeof(RecordChunkHeader) <= m_size)
+        {
+            RecordChunkHeader chunk;
+            std::memcpy(&chunk, m_data + pos, sizeof(chunk));
+            if (std::memcmp(chunk.magic, "TRCK", sizeof(chunk.magic)) != 0
+                || chunk.chunk_size < sizeof(RecordChunkHeader) + sizeof(RecordColumn) || pos + chunk.chunk_size > m_size)
+            {
+                break;
+            }
+
+            // Raw scan chunks have one column holding all channels
+            RecordColumn first_column;
+            std::memcpy(&first_column, m_data + pos + sizeof(chunk), sizeof(first_column));
+            const bool raw_scans = chunk.num_columns == 1 && first_column.encoding == RECORD_ENCODING_RAW_SCANS;
+            const uint32 num_columns = raw_scans ? 1 : num_channels;
+            if (chunk.num_columns != num_columns || chunk.first_scan != m_total_scans
+                || sizeof(RecordChunkHeader) + sizeof(RecordColumn) * static_cast<uint64>(num_columns) > chunk.header_size)
+            {
+                m_error = "Corrupt chunk";
+                return false;
+            }
+            for (uint32 c = 0; c < num_columns; ++c)
+            {
+                RecordColumn column;
+                std::memcpy(&column, m_data + pos + sizeof(chunk) + sizeof(column) * c, sizeof(column));
+                if (raw_scans)
+                {
+                    if (!m_decoder || column.size != static_cast<uint64>(chunk.scans) * m_header.scan_size)
+                    {
+                        m_error = "Corrupt chunk";
+                        return false;
+                    }
+                }
+                else if (column.encoding != RECORD_ENCODING_RAW_I32 && column.encoding != RECORD_ENCODING_DELTA_PACKED)
+                {
+                    m_error = "Unsupported column encoding";
+                    return false;
+                }
+                const bool raw = column.encoding == RECORD_ENCODING_RAW_I32;
+                if ((raw && column.size != static_cast<uint64>(chunk.scans) * sizeof(sint32))
+                    || column.offset % sizeof(sint32) != 0 || column.offset + column.size > chunk.chunk_size)
+                {
+                    m_error = "Corrupt chunk";
+                    return false;
+                }
+            }
+
+            RecordChunkIndex entry;
+            entry.first_scan = chunk.first_scan;
+            entry.scans = chunk.scans;
+            entry.offset = pos;
+            entry.time_ns = chunk.time_ns;
+            if (entry.time_ns)
+            {
+                m_stamped.push_back(m_index.size());
+            }
+            m_index.push_back(entry);
+
+            m_total_scans += chunk.scans;
+            pos += chunk.chunk_size;
+        }
+        return true;
+    }
+
+    int RecordReader::findChannel(const std::string& name) const
+    {
+        for (size_t i = 0; i < m_channels.size(); ++i)
+        {
+            if (name == m_channels[i].name)
+            {
+                return static_cast<int>(i);
+            }
+        }
+        return -1;
+    }
+
+    std::string RecordReader::scanDescriptor() const
+    {
+        if (!isOpen())
+        {
+            return std::string();
+        }
+        return std::string(reinterpret_cast<const char*>(m_data + m_header.xml_offset), m_header.xml_size);
+    }
+
+    size_t RecordReader::chunkOf(uint64 scan) const
+    {
+        auto it = std::upper_bound(m_index.begin(), m_index.end(), scan,
+            [](uint64 value, const RecordChunkIndex& entry) { return value < entry.first_scan; });
+        return it == m_index.begin() ? 0 : static_cast<size_t>(it - m_index.begin()) - 1;
+    }
+
+    RecordColumn RecordReader::column(const RecordChunkIndex& entry, uint32 channel_index) const
+    {
+        RecordColumn column;
+        const uint8* table = m_data + entry.offset + sizeof(RecordChunkHeader);
+        std::memcpy(&column, table, sizeof(column));
+        if (column.encoding != RECORD_ENCODING_RAW_SCANS)
+        {
+            std::memcpy(&column, table + sizeof(column) * channel_index, sizeof(column));
+        }
+        return column;
+    }
+
+    uint64 RecordReader::spans(uint32 channel_index, uint64 first_scan, uint64 end_scan, std::vector<RecordSpan>& spans) const
+    {
+        spans.clear();
+        if (channel_index >= numChannels())
+        {
+            return 0;
+        }
+        end_scan = std::min(end_scan, m_total_scans);
+
+        uint64 scan = first_scan;
+        for (size_t i = chunkOf(scan); i < m_index.size() && scan < end_scan; ++i)
+        {
+            const RecordChunkIndex& entry = m_index[i];
+            const uint8* chunk = m_data + entry.offset;
+            const RecordColumn column = this->column(entry, channel_index);
+
+            RecordSpan span;
+            span.data = column.encoding == RECORD_ENCODING_RAW_I32
+                ? reinterpret_cast<const sint32*>(chunk + column.offset) + (scan - entry.first_scan) : nullptr;
+            span.first_scan = scan;
+            span.scans = static_cast<uint32>(std::min(end_scan, entry.first_scan + entry.scans) - scan);
+            if (span.scans)
+            {
+                spans.push_back(span);
+            }
+            scan += span.scans;
+        }
+        return scan > first_scan ? scan - first_scan : 0;
+    }
+
+    uint64 RecordReader::read(uint32 channel_index, uint64 first_scan, uint64 end_scan, sint32* dst) const
+    {
+        if (channel_index >= numChannels())
+        {
+            return 0;
+        }
+        end_scan = std::min(end_scan, m_total_scans);
+
+        std::vector<sint32> decoded;
+        uint64 scan = first_scan;
+        for (size_t i = chunkOf(scan); i < m_index.size() && scan < end_scan; ++i)
+        {
+            const RecordChunkIndex& entry = m_index[i];
+            const uint8* chunk = m_data + entry.offset;
+            const RecordColumn column = this->column(entry, channel_index);
+
+            const uint32 skip = static_cast<uint32>(scan - entry.first_scan);
+            const uint32 count = static_cast<uint32>(std::min(end_scan, entry.first_scan + entry.scans) - scan);
+            sint32* out = dst + (scan - first_scan);
+            if (column.encoding == RECORD_ENCODING_RAW_I32)
+            {
+                std::memcpy(out, chunk + column.offset + skip * sizeof(sint32), count * sizeof(sint32));
+            }
+            else if (column.encoding == RECORD_ENCODING_RAW_SCANS)
+            {
+                const ScanSpan span = { chunk + column.offset + static_cast<uint64>(skip) * m_header.scan_size, count };
+                m_decoder->decodeChannel(channel_index, span, out);
+            }
+            else if (skip == 0)
+            {
+                if (!decodeSamples(chunk + column.offset, column.size, count, out))
+                {
+                    break;
+                }
+            }
+            else
+            {
+                // The prediction needs the scans before the range
+                decoded.resize(skip + count);
+                if (!decodeSamples(chunk + column.offset, column.size, skip + count, decoded.data()))
+                {
+                    break;
+                }
+                std::memcpy(out, decoded.data() + skip, count * sizeof(sint32));
+            }
+            scan += count;
+        }
+        return scan > first_scan ? scan - first_scan : 0;
+    }
+
+    uint64 RecordReader::spansForTime(uint32 channel_index, double t0, double t1, std::vector<RecordSpan>& spans) const
+    {
+        // Scan k belongs to the time k / sample_rate
+        const double first = std::ceil(std::max(t0, 0.0) * m_header.sample_rate);
+        const double end = std::ceil(std::max(t1, 0.0) * m_header.sample_rate);
+        return this->spans(channel_index, static_cast<uint64>(first), static_cast<uint64>(end), spans);
+    }
+
+    uint64 RecordReader::spansForAbsoluteTime(uint32 channel_index, uint64 t0_ns, uint64 t1_ns, std::vector<RecordSpan>& spans) const
+    {
+        uint64 first = 0;
+        uint64 end = 0;
+        if (!scanAtTime(t0_ns, first) || !scanAtTime(t1_ns, end))
+        {
+            spans.clear();
+            return 0;
+        }
+        return this->spans(channel_index, first, end, spans);
+    }
+
+    bool RecordReader::scanAtTime(uint64 time_ns, uint64& scan) const
+    {
+        if (m_stamped.empty())
+        {
+            return false;
+        }
+
+        // Last stamped chunk starting at or before the time, the first one for earlier times
+        auto it = std::upper_bound(m_stamped.begin(), m_stamped.end(), time_ns,
+            [this](uint64 value, size_t entry) { return value < m_index[entry].time_ns; });
+        const RecordChunkIndex& entry = m_index[it == m_stamped.begin() ? *it : *(it - 1)];
+
+        const double offset = std::ceil((static_cast<double>(time_ns) - static_cast<double>(entry.time_ns))
+                                        * m_header.sample_rate * 1e-9);
+        const double result = static_cast<double>(entry.first_scan) + offset;
+        scan = result <= 0.0 ? 0 : std::min(static_cast<uint64>(result), m_total_scans);
+        return true;
+    }
+
+    bool RecordReader::timeOfScan(uint64 scan, uint64& time_ns) const
+    {
+        if (m_index.empty() || scan >= m_total_scans)
+        {
+            return false;
+        }
+        const RecordChunkIndex& entry = m_index[chunkOf(scan)];
+        if (!entry.time_ns)
+        {
+            return false;
+        }
+        time_ns = entry.time_ns + static_cast<uint64>(std::llround((scan - entry.first_scan) * 1e9 / m_header.sample_rate));
+        return true;
+    }
+}
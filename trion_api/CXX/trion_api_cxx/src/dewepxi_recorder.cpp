@@ -0,0 +1,723 @@
+// Copyright DEWETRON 2024
+
+#include "dewepxi_recorder.h"
+#include "dewepxi_acq_engine.h"
+#include "dewepxi_envelope.h"
+#include "dewepxi_sample_codec.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(_WIN32)
+#include <fcntl.h>
+#include <io.h>
+#include <malloc.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+
+namespace trion
+{
+    namespace
+    {
+        uint8* allocateAligned(uint64 size)
+        {
+#if defined(_WIN32)
+            return static_cast<uint8*>(_aligned_malloc(static_cast<size_t>(size), RECORD_ALIGNMENT));
+#else
+            void* memory = nullptr;
+            return posix_memalign(&memory, RECORD_ALIGNMENT, static_cast<size_t>(size)) == 0
+                ? static_cast<uint8*>(memory) : nullptr;
+#endif
+        }
+
+        void freeAligned(uint8* memory)
+        {
+#if defined(_WIN32)
+            _aligned_free(memory);
+#else
+            std::free(memory);
+#endif
+        }
+
+        /**
+         * File header, channel table and scan descriptor, padded to RECORD_ALIGNMENT.
+         * Fills the remaining fields of header, the caller sets sample_rate,
+         * chunk_scans and scan_size.
+         */
+        std::vector<uint8> makeFileHeader(const ScanDescriptor& sd, const ScanDecoder& decoder, RecordFileHeader& header)
+        {
+            const std::string& xml = sd.xml();
+            const uint32 num_channels = decoder.numChannels();
+            const uint32 channel_offset = sizeof(RecordFileHeader);
+            const uint32 xml_offset = channel_offset + static_cast<uint32>(sizeof(RecordChannelInfo)) * num_channels;
+            const uint32 header_size = static_cast<uint32>(recordAlign(xml_offset + xml.size(), RECORD_ALIGNMENT));
+
+            std::memcpy(header.magic, "TRIONREC", sizeof(header.magic));
+            header.version = RECORD_VERSION;
+            header.header_size = header_size;
+            header.num_channels = num_channels;
+            header.channel_offset = channel_offset;
+            header.xml_offset = xml_offset;
+            header.xml_size = static_cast<uint32>(xml.size());
+
+            std::vector<uint8> data(header_size, 0);
+            std::memcpy(data.data(), &header, sizeof(header));
+            for (uint32 c = 0; c < num_channels; ++c)
+            {
+                const ScanChannel& channel = decoder.channel(c);
+                const ChannelScaling& scaling = decoder.scaling(c);
+                RecordChannelInfo info;
+                std::memset(&info, 0, sizeof(info));
+                std::strncpy(info.name, channel.name.c_str(), sizeof(info.name) - 1);
+                info.channel_type = channel.channel_type;
+                info.index = channel.index;
+                info.sample_size = channel.sample_size;
+                info.sample_offset = channel.sample_offset;
+                info.scale_value = scaling.gain;
+                info.scale_offset = -scaling.offset;
+                std::memcpy(data.data() + channel_offset + sizeof(info) * c, &info, sizeof(info));
+            }
+            std::memcpy(data.data() + xml_offset, xml.data(), xml.size());
+            return data;
+        }
+    }
+
+
+    Recorder::Recorder()
+        : m_file(nullptr)
+        , m_num_channels(0)
+        , m_chunk_scans(0)
+        , m_chunk_header_size(0)
+        , m_column_size(0)
+        , m_chunk_size(0)
+        , m_encoding(RECORD_ENCODING_RAW_I32)
+        , m_envelopes(nullptr)
+        , m_memory(nullptr)
+        , m_packed(nullptr)
+        , m_fill_buffer(0)
+        , m_fill_scans(0)
+        , m_scans(0)
+        , m_chunk_index(0)
+        , m_stalls(0)
+        , m_stall_ns(0)
+        , m_clock(nullptr)
+        , m_clock_first_sample(0)
+        , m_pending(nullptr)
+        , m_stop(false)
+        , m_failed(false)
+        , m_bytes_written(0)
+    {
+        std::memset(&m_header, 0, sizeof(m_header));
+    }
+
+    Recorder::~Recorder()
+    {
+        close();
+    }
+
+    bool Recorder::open(const std::string& path, const ScanDescriptor& sd, const ScanDecoder& decoder,
+                        double sample_rate, uint32 chunk_scans)
+    {
+        if (isOpen())
+        {
+            m_error = "Recording already open";
+            return false;
+        }
+        if (chunk_scans == 0 || decoder.numChannels() == 0)
+        {
+            m_error = "No channels or empty chunks";
+            return false;
+        }
+
+        m_error.clear();
+        m_num_channels = decoder.numChannels();
+        m_chunk_scans = chunk_scans;
+        m_chunk_header_size = static_cast<uint32>(recordAlign(
+            sizeof(RecordChunkHeader) + sizeof(RecordColumn) * m_num_channels, RECORD_COLUMN_ALIGNMENT));
+        m_column_size = recordAlign(static_cast<uint64>(chunk_scans) * sizeof(sint32), RECORD_COLUMN_ALIGNMENT);
+        m_chunk_size = recordAlign(m_chunk_header_size + m_column_size * m_num_channels, RECORD_ALIGNMENT);
+
+        std::memset(&m_header, 0, sizeof(m_header));
+        m_header.sample_rate = sample_rate;
+        m_header.chunk_scans = chunk_scans;
+        const std::vector<uint8> header = makeFileHeader(sd, decoder, m_header);
+
+        // Worst case of a packed chunk, slightly larger than a raw one
+        const uint64 packed_size = m_encoding == RECORD_ENCODING_DELTA_PACKED
+            ? recordAlign(m_chunk_header_size + recordAlign(sampleCodecMaxSize(chunk_scans), RECORD_COLUMN_ALIGNMENT) * m_num_channels,
+                          RECORD_ALIGNMENT)
+            : 0;
+        m_memory = allocateAligned(m_chunk_size * 2);
+        m_packed = packed_size ? allocateAligned(packed_size) : nullptr;
+        if (!m_memory || (packed_size && !m_packed))
+        {
+            m_error = "Out of memory";
+            freeAligned(m_memory);
+            freeAligned(m_packed);
+            m_memory = nullptr;
+            m_packed = nullptr;
+            return false;
+        }
+        // Touch the buffers now, not while recording
+        std::memset(m_memory, 0, static_cast<size_t>(m_chunk_size * 2));
+        if (m_packed)
+        {
+            std::memset(m_packed, 0, static_cast<size_t>(packed_size));
+        }
+        m_buffers[0].data = m_memory;
+        m_buffers[1].data = m_memory + m_chunk_size;
+        m_buffers[0].size = 0;
+        m_buffers[1].size = 0;
+
+        m_file = std::fopen(path.c_str(), "wb");
+        if (!m_file)
+        {
+            m_error = "Cannot create " + path;
+            freeAligned(m_memory);
+            freeAligned(m_packed);
+            m_memory = nullptr;
+            m_packed = nullptr;
+            return false;
+        }
+        // The chunks are written in one piece, bypass the stdio buffer
+        std::setvbuf(m_file, nullptr, _IONBF, 0);
+
+        m_bytes_written = 0;
+        m_stop = false;
+        m_failed = false;
+        m_pending = nullptr;
+        if (!writeFile(header.data(), header.size()))
+        {
+            m_error = "Cannot write " + path;
+            std::fclose(m_file);
+            m_file = nullptr;
+            freeAligned(m_memory);
+            freeAligned(m_packed);
+            m_memory = nullptr;
+            m_packed = nullptr;
+            return false;
+        }
+        m_bytes_written = header.size();
+
+        m_fill_buffer = 0;
+        m_scans = 0;
+        m_chunk_index = 0;
+        m_stalls = 0;
+        m_stall_ns = 0;
+        startChunk();
+        m_writer = std::thread(&Recorder::run, this);
+        return true;
+    }
+
+    bool Recorder::close()
+    {
+        if (!isOpen())
+        {
+            return true;
+        }
+
+        bool ok = true;
+        if (m_fill_scans > 0)
+        {
+            ok = submitChunk();
+        }
+
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cv.wait(lock, [this]() { return m_pending == nullptr; });
+            m_stop = true;
+        }
+        m_cv.notify_all();
+        m_writer.join();
+        ok = ok && !m_failed;
+
+        // Complete the header
+        m_header.total_scans = m_scans;
+        m_header.num_chunks = m_chunk_index;
+        if (std::fseek(m_file, 0, SEEK_SET) != 0 || !writeFile(&m_header, sizeof(m_header)))
+        {
+            ok = false;
+        }
+        if (std::fclose(m_file) != 0)
+        {
+            ok = false;
+        }
+        m_file = nullptr;
+        if (!ok && m_error.empty())
+        {
+            m_error = "Write failed";
+        }
+
+        freeAligned(m_memory);
+        freeAligned(m_packed);
+        m_memory = nullptr;
+        m_packed = nullptr;
+        return ok;
+    }
+
+    void Recorder::setEncoding(RecordEncoding encoding)
+    {
+        if (!isOpen())
+        {
+            m_encoding = encoding;
+        }
+    }
+
+    void Recorder::setEnvelopes(EnvelopeSet* envelopes)
+    {
+        if (!isOpen())
+        {
+            m_envelopes = envelopes;
+        }
+    }
+
+    void Recorder::setClock(const ClockModel* clock, uint64 first_sample)
+    {
+        m_clock = clock;
+        m_clock_first_sample = first_sample;
+    }
+
+    bool Recorder::write(const DecodedBlock& block)
+    {
+        if (!isOpen() || block.numChannels() != m_num_channels)
+        {
+            return false;
+        }
+
+        const uint32 scans = block.scans();
+        uint32 done = 0;
+        while (done < scans)
+        {
+            const uint32 count = std::min(scans - done, m_chunk_scans - m_fill_scans);
+            uint8* columns = m_buffers[m_fill_buffer].data + m_chunk_header_size;
+            for (uint32 c = 0; c < m_num_channels; ++c)
+            {
+                sint32* dst = reinterpret_cast<sint32*>(columns + m_column_size * c) + m_fill_scans;
+                std::memcpy(dst, block.channel(c) + done, count * sizeof(sint32));
+            }
+            m_fill_scans += count;
+            m_scans += count;
+            done += count;
+
+            if (m_fill_scans == m_chunk_scans && !submitChunk())
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    uint64 Recorder::bytesWritten() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_bytes_written;
+    }
+
+    void Recorder::startChunk()
+    {
+        m_fill_scans = 0;
+    }
+
+    bool Recorder::submitChunk()
+    {
+        ChunkBuffer& buffer = m_buffers[m_fill_buffer];
+        uint64 column_size = m_column_size;
+        uint64 chunk_size = m_chunk_size;
+
+        if (m_fill_scans < m_chunk_scans)
+        {
+            // Last chunk: move the columns together
+            column_size = recordAlign(static_cast<uint64>(m_fill_scans) * sizeof(sint32), RECORD_COLUMN_ALIGNMENT);
+            chunk_size = recordAlign(m_chunk_header_size + column_size * m_num_channels, RECORD_ALIGNMENT);
+            uint8* columns = buffer.data + m_chunk_header_size;
+            const size_t bytes = static_cast<size_t>(m_fill_scans) * sizeof(sint32);
+            for (uint32 c = 0; c < m_num_channels; ++c)
+            {
+                uint8* dst = columns + column_size * c;
+                std::memmove(dst, columns + m_column_size * c, bytes);
+                std::memset(dst + bytes, 0, static_cast<size_t>(column_size - bytes));
+            }
+            const uint64 used = m_chunk_header_size + column_size * m_num_channels;
+            std::memset(buffer.data + used, 0, static_cast<size_t>(chunk_size - used));
+        }
+
+        RecordChunkHeader header;
+        std::memcpy(header.magic, "TRCK", sizeof(header.magic));
+        header.scans = m_fill_scans;
+        header.first_scan = m_chunk_index * m_chunk_scans;
+        header.chunk_size = chunk_size;
+        header.num_columns = m_num_channels;
+        header.header_size = m_chunk_header_size;
+        header.time_ns = 0;
+        if (m_clock)
+        {
+            uint64 time_ns = 0;
+            const uint32 flags = m_clock->stamp(m_clock_first_sample + header.first_scan, 1, &time_ns);
+            if (!(flags & (CLOCK_FLAG_DEGRADED | CLOCK_FLAG_UNFITTED)))
+            {
+                header.time_ns = time_ns;
+            }
+        }
+        std::memcpy(buffer.data, &header, sizeof(header));
+
+        for (uint32 c = 0; c < m_num_channels; ++c)
+        {
+            RecordColumn column;
+            column.encoding = RECORD_ENCODING_RAW_I32;
+            column.reserved = 0;
+            column.offset = m_chunk_header_size + column_size * c;
+            column.size = static_cast<uint64>(m_fill_scans) * sizeof(sint32);
+            std::memcpy(buffer.data + sizeof(header) + sizeof(column) * c, &column, sizeof(column));
+        }
+        buffer.size = chunk_size;
+
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (m_pending)
+            {
+                // The writer still stores the other buffer
+                const uint64 wait_start = steadyClockNs();
+                m_cv.wait(lock, [this]() { return m_pending == nullptr || m_failed; });
+                ++m_stalls;
+                m_stall_ns += steadyClockNs() - wait_start;
+            }
+            if (m_failed)
+            {
+                return false;
+            }
+            m_pending = &buffer;
+        }
+        m_cv.notify_all();
+
+        m_fill_buffer ^= 1;
+        ++m_chunk_index;
+        startChunk();
+        return true;
+    }
+
+    void Recorder::run()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (;;)
+        {
+            m_cv.wait(lock, [this]() { return m_pending != nullptr || m_stop; });
+            if (!m_pending)
+            {
+                return;
+            }
+
+            ChunkBuffer* buffer = m_pending;
+            lock.unlock();
+            const uint8* data = buffer->data;
+            uint64 size = buffer->size;
+            if (m_envelopes)
+            {
+                appendEnvelopes(buffer->data);
+            }
+            if (m_packed)
+            {
+                size = packChunk(buffer->data, m_packed);
+                data = m_packed;
+            }
+            const bool ok = writeFile(data, size);
+            lock.lock();
+
+            if (ok)
+            {
+                m_bytes_written += size;
+            }
+            else
+            {
+                m_failed = true;
+            }
+            m_pending = nullptr;
+            m_cv.notify_all();
+        }
+    }
+
+    void Recorder::appendEnvelopes(const uint8* chunk) const
+    {
+        RecordChunkHeader header;
+        std::memcpy(&header, chunk, sizeof(header));
+        const uint32 channels = std::min(m_num_channels, m_envelopes->numChannels());
+        for (uint32 c = 0; c < channels; ++c)
+        {
+            RecordColumn column;
+            std::memcpy(&column, chunk + sizeof(header) + sizeof(column) * c, sizeof(column));
+            m_envelopes->channel(c).append(reinterpret_cast<const sint32*>(chunk + column.offset), header.scans);
+        }
+    }
+
+    uint64 Recorder::packChunk(const uint8* chunk, uint8* dst) const
+    {
+        RecordChunkHeader header;
+        std::memcpy(&header, chunk, sizeof(header));
+        const uint64 raw_size = static_cast<uint64>(header.scans) * sizeof(sint32);
+
+        uint64 pos = m_chunk_header_size;
+        for (uint32 c = 0; c < m_num_channels; ++c)
+        {
+            RecordColumn column;
+            std::memcpy(&column, chunk + sizeof(header) + sizeof(column) * c, sizeof(column));
+            const sint32* samples = reinterpret_cast<const sint32*>(chunk + column.offset);
+
+            column.encoding = RECORD_ENCODING_DELTA_PACKED;
+            column.size = encodeSamples(samples, header.scans, dst + pos);
+            if (column.size >= raw_size)
+            {
+                column.encoding = RECORD_ENCODING_RAW_I32;
+                column.size = raw_size;
+                std::memcpy(dst + pos, samples, static_cast<size_t>(raw_size));
+            }
+            column.offset = pos;
+            std::memcpy(dst + sizeof(header) + sizeof(column) * c, &column, sizeof(column));
+
+            const uint64 end = recordAlign(pos + column.size, RECORD_COLUMN_ALIGNMENT);
+            std::memset(dst + pos + column.size, 0, static_cast<size_t>(end - pos - column.size));
+            pos = end;
+        }
+
+        header.chunk_size = recordAlign(pos, RECORD_ALIGNMENT);
+        std::memset(dst + pos, 0, static_cast<size_t>(header.chunk_size - pos));
+        std::memcpy(dst, &header, sizeof(header));
+        // Padding of the column table
+        const uint64 table_end = sizeof(header) + sizeof(RecordColumn) * static_cast<uint64>(m_num_channels);
+        std::memset(dst + table_end, 0, static_cast<size_t>(m_chunk_header_size - table_end));
+        return header.chunk_size;
+    }
+
+    bool Recorder::writeFile(const void* data, uint64 size)
+    {
+        return std::fwrite(data, 1, static_cast<size_t>(size), m_file) == size;
+    }
+
+
+    RawRecorder::RawRecorder()
+        : m_fd(-1)
+        , m_scan_size(0)
+        , m_scans(0)
+        , m_chunks(0)
+        , m_bytes_written(0)
+        , m_write_ns(0)
+        , m_clock(nullptr)
+        , m_clock_first_sample(0)
+    {
+        std::memset(&m_header, 0, sizeof(m_header));
+    }
+
+    RawRecorder::~RawRecorder()
+    {
+        close();
+    }
+
+    bool RawRecorder::open(const std::string& path, const ScanDescriptor& sd, const ScanDecoder& decoder, double sample_rate)
+    {
+        if (isOpen())
+        {
+            m_error = "Recording already open";
+            return false;
+        }
+        if (sd.scanSize() == 0 || sd.scanSize() % 4 != 0 || decoder.scanSize() != sd.scanSize())
+        {
+            m_error = "Unsupported scan size";
+            return false;
+        }
+
+        m_error.clear();
+        m_scan_size = sd.scanSize();
+        std::memset(&m_header, 0, sizeof(m_header));
+        m_header.sample_rate = sample_rate;
+        m_header.scan_size = m_scan_size;
+        const std::vector<uint8> header = makeFileHeader(sd, decoder, m_header);
+
+#if defined(_WIN32)
+        m_fd = _open(path.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+        m_fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+#endif
+        if (m_fd < 0)
+        {
+            m_error = "Cannot create " + path;
+            return false;
+        }
+
+        m_scans = 0;
+        m_chunks = 0;
+        m_bytes_written = 0;
+        m_write_ns = 0;
+        WritePart part = { header.data(), header.size() };
+        if (!writeParts(&part, 1))
+        {
+            m_error = "Cannot write " + path;
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    bool RawRecorder::close()
+    {
+        if (!isOpen())
+        {
+            return true;
+        }
+
+        // Complete the header
+        m_header.total_scans = m_scans;
+        m_header.num_chunks = m_chunks;
+#if defined(_WIN32)
+        bool ok = _lseeki64(m_fd, 0, SEEK_SET) == 0
+            && _write(m_fd, &m_header, sizeof(m_header)) == static_cast<int>(sizeof(m_header));
+        ok = _close(m_fd) == 0 && ok;
+#else
+        bool ok = pwrite(m_fd, &m_header, sizeof(m_header), 0) == static_cast<ssize_t>(sizeof(m_header));
+        ok = ::close(m_fd) == 0 && ok;
+#endif
+        m_fd = -1;
+        if (!ok && m_error.empty())
+        {
+            m_error = "Write failed";
+        }
+        return ok;
+    }
+
+    void RawRecorder::setClock(const ClockModel* clock, uint64 first_sample)
+    {
+        m_clock = clock;
+        m_clock_first_sample = first_sample;
+    }
+
+    bool RawRecorder::write(const ScanSpans& spans)
+    {
+        if (!isOpen())
+        {
+            return false;
+        }
+        const uint32 scans = spans.totalScans();
+        if (scans == 0)
+        {
+            return true;
+        }
+
+        // Chunk header and column table, followed by the scans in place
+        struct
+        {
+            RecordChunkHeader header;
+            RecordColumn column;
+        } chunk;
+        static_assert(sizeof(chunk) == 64, "raw scan chunk header");
+
+        const uint64 data_size = static_cast<uint64>(scans) * m_scan_size;
+        std::memcpy(chunk.header.magic, "TRCK", sizeof(chunk.header.magic));
+        chunk.header.scans = scans;
+        chunk.header.first_scan = m_scans;
+        chunk.header.chunk_size = sizeof(chunk) + data_size;
+        chunk.header.num_columns = 1;
+        chunk.header.header_size = sizeof(chunk);
+        chunk.header.time_ns = 0;
+        if (m_clock)
+        {
+            uint64 time_ns = 0;
+            const uint32 flags = m_clock->stamp(m_clock_first_sample + m_scans, 1, &time_ns);
+            if (!(flags & (CLOCK_FLAG_DEGRADED | CLOCK_FLAG_UNFITTED)))
+            {
+                chunk.header.time_ns = time_ns;
+            }
+        }
+        chunk.column.encoding = RECORD_ENCODING_RAW_SCANS;
+        chunk.column.reserved = 0;
+        chunk.column.offset = sizeof(chunk);
+        chunk.column.size = data_size;
+
+        WritePart parts[3];
+        uint32 count = 0;
+        parts[count].data = &chunk;
+        parts[count++].size = sizeof(chunk);
+        for (uint32 i = 0; i < spans.count; ++i)
+        {
+            parts[count].data = spans.span[i].data;
+            parts[count++].size = static_cast<uint64>(spans.span[i].scans) * m_scan_size;
+        }
+
+        if (!writeParts(parts, count))
+        {
+            m_error = "Write failed";
+            return false;
+        }
+        m_scans += scans;
+        ++m_chunks;
+        return true;
+    }
+
+    bool RawRecorder::writeParts(const WritePart* parts, uint32 count)
+    {
+        const uint64 start_ns = steadyClockNs();
+        uint64 written = 0;
+#if defined(_WIN32)
+        for (uint32 i = 0; i < count; ++i)
+        {
+            const uint8* data = static_cast<const uint8*>(parts[i].data);
+            uint64 left = parts[i].size;
+            while (left > 0)
+            {
+                const unsigned int size = static_cast<unsigned int>(std::min<uint64>(left, 0x40000000));
+                const int result = _write(m_fd, data, size);
+                if (result <= 0)
+                {
+                    m_write_ns += steadyClockNs() - start_ns;
+                    m_bytes_written += written;
+                    return false;
+                }
+                data += result;
+                left -= static_cast<uint64>(result);
+                written += static_cast<uint64>(result);
+            }
+        }
+#else
+        struct iovec iov[3];        // chunk header and two spans
+        uint32 first = 0;
+        for (uint32 i = 0; i < count; ++i)
+        {
+            iov[i].iov_base = const_cast<void*>(parts[i].data);
+            iov[i].iov_len = static_cast<size_t>(parts[i].size);
+        }
+        while (first < count)
+        {
+            const ssize_t result = writev(m_fd, iov + first, static_cast<int>(count - first));
+            if (result < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (result <= 0)
+            {
+                m_write_ns += steadyClockNs() - start_ns;
+                m_bytes_written += written;
+                return false;
+            }
+
+            // Partial write: continue behind the accepted bytes
+            written += static_cast<uint64>(result);
+            size_t done = static_cast<size_t>(result);
+            while (first < count && done >= iov[first].iov_len)
+            {
+                done -= iov[first].iov_len;
+                ++first;
+            }
+            if (first < count)
+            {
+                iov[first].iov_base = static_cast<uint8*>(iov[first].iov_base) + done;
+                iov[first].iov_len -= done;
+            }
+        }
+#endif
+        m_write_ns += steadyClockNs() - start_ns;
+        m_bytes_written += written;
+        return true;
+    }
+}
@@ -0,0 +1,147 @@
+// Copyright DEWETRON 2024
+
+#include "dewepxi_release_manager.h"
+#include <chrono>
+
+
+namespace trion
+{
+    namespace
+    {
+        uint64 nowNs()
+        {
+            return static_cast<uint64>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count());
+        }
+    }
+
+
+    ReleaseManager::ReleaseManager(RingBufferView& ring)
+        : m_ring(ring)
+        , m_chunk(0)
+        , m_watermark(0)
+        , m_read_pos(0)
+        , m_outstanding(0)
+        , m_unfreed(0)
+        , m_pending(0)
+        , m_freed(0)
+        , m_free_calls(0)
+        , m_driver_calls(0)
+        , m_rate_calls(0)
+        , m_rate_start_ns(nowNs())
+    {
+    }
+
+    void ReleaseManager::setChunk(uint32 chunk_scans)
+    {
+        m_chunk = chunk_scans;
+    }
+
+    void ReleaseManager::setWatermark(uint32 watermark_bytes)
+    {
+        m_watermark = watermark_bytes;
+    }
+
+    int ReleaseManager::start()
+    {
+        m_outstanding = 0;
+        m_unfreed = 0;
+        m_pending = 0;
+        m_freed = 0;
+        m_free_calls = 0;
+        m_driver_calls = 1;
+        m_rate_calls = 0;
+        m_rate_start_ns = nowNs();
+
+        return DeWeGetParam_i64(m_ring.boardId(), bufferCommand(CMD_BUFFER_0_ACT_SAMPLE_POS, m_ring.buffer()), &m_read_pos);
+    }
+
+    int ReleaseManager::acquire(ScanSpans& spans, uint32 max_scans)
+    {
+        sint32 avail = 0;
+
+        spans.count = 0;
+
+        ++m_driver_calls;
+        auto err = DeWeGetParam_i32(m_ring.boardId(), bufferCommand(CMD_BUFFER_0_AVAIL_NO_SAMPLE, m_ring.buffer()), &avail);
+        if (err > 0 || avail <= 0)
+        {
+            return err;
+        }
+
+        noteAvailable(static_cast<uint32>(avail));
+
+        // The available count includes scans handed out but not yet freed
+        uint32 scans = static_cast<uint32>(avail) > m_outstanding ? static_cast<uint32>(avail) - m_outstanding : 0;
+        if (scans > max_scans)
+        {
+            scans = max_scans;
+        }
+
+        spans = m_ring.spansAt(m_read_pos, scans);
+        m_read_pos = m_ring.advance(m_read_pos, scans);
+        m_outstanding += scans;
+        return err;
+    }
+
+    void ReleaseManager::noteAvailable(uint32 avail_scans)
+    {
+        m_unfreed = avail_scans;
+    }
+
+    int ReleaseManager::release(uint32 scans)
+    {
+        m_pending += scans;
+
+        if (m_pending >= m_chunk || (m_watermark > 0 && freeMemory() < m_watermark))
+        {
+            return commit();
+        }
+        return ERR_NONE;
+    }
+
+    int ReleaseManager::commit()
+    {
+        if (m_pending == 0)
+        {
+            return ERR_NONE;
+        }
+
+        ++m_driver_calls;
+        ++m_free_calls;
+        auto err = m_ring.release(m_pending);
+        if (err > 0)
+        {
+            return err;
+        }
+
+        m_outstanding = m_outstanding > m_pending ? m_outstanding - m_pending : 0;
+        m_unfreed = m_unfreed > m_pending ? m_unfreed - m_pending : 0;
+        m_freed += m_pending;
+        m_pending = 0;
+        return err;
+    }
+
+    int ReleaseManager::queryFreeMemory(sint32& free_bytes)
+    {
+        ++m_driver_calls;
+        return DeWeGetParam_i32(m_ring.boardId(), bufferCommand(CMD_BUFFER_0_AVAIL_FREE_MEM, m_ring.buffer()), &free_bytes);
+    }
+
+    uint32 ReleaseManager::freeMemory() const
+    {
+        uint64 used = static_cast<uint64>(m_unfreed) * m_ring.scanSize();
+        return used < m_ring.totalSize() ? m_ring.totalSize() - static_cast<uint32>(used) : 0;
+    }
+
+    double ReleaseManager::driverCallsPerSecond()
+    {
+        const uint64 now = nowNs();
+        const uint64 calls = m_driver_calls - m_rate_calls;
+        const double seconds = (now - m_rate_start_ns) * 1e-9;
+
+        m_rate_calls = m_driver_calls;
+        m_rate_start_ns = now;
+        return seconds > 0.0 ? calls / seconds : 0.0;
+    }
+}
@@ -0,0 +1,211 @@
+// Copyright DEWETRON 2024
+
+#include "dewepxi_ringbuffer.h"
+#include <cstring>
+
+
+namespace trion
+{
+    RingBufferView::RingBufferView(int board_id, int buffer)
+        : m_board_id(board_id)
+        , m_buffer(buffer)
+        , m_start_pos(0)
+        , m_end_pos(0)
+        , m_total_size(0)
+        , m_scan_size(0)
+    {
+    }
+
+    int RingBufferView::init()
+    {
+        sint64 start_pos = 0;
+        sint64 end_pos = 0;
+        sint32 total_size = 0;
+        sint32 scan_size = 0;
+
+        auto err = DeWeGetParam_i64(m_board_id, bufferCommand(CMD_BUFFER_0_START_POINTER, m_buffer), &start_pos);
+        if (err > 0) return err;
+        err = DeWeGetParam_i64(m_board_id, bufferCommand(CMD_BUFFER_0_END_POINTER, m_buffer), &end_pos);
+        if (err > 0) return err;
+        err = DeWeGetParam_i32(m_board_id, bufferCommand(CMD_BUFFER_0_TOTAL_MEM_SIZE, m_buffer), &total_size);
+        if (err > 0) return err;
+        err = DeWeGetParam_i32(m_board_id, bufferCommand(CMD_BUFFER_0_ONE_SCAN_SIZE, m_buffer), &scan_size);
+        if (err > 0) return err;
+
+        if (total_size <= 0 || scan_size <= 0)
+        {
+            return ERR_BUFFER_NOT_ASSIGNED;
+        }
+
+        // Older drivers may not report a start pointer
+        if (start_pos == 0)
+        {
+            start_pos = end_pos - total_size;
+        }
+
+        setGeometry(start_pos, end_pos, static_cast<uint32>(scan_size));
+        return err;
+    }
+
+    void RingBufferView::setGeometry(sint64 start_pos, sint64 end_pos, uint32 scan_size)
+    {
+        m_start_pos = start_pos;
+        m_end_pos = end_pos;
+        m_total_size = static_cast<uint32>(end_pos - start_pos);
+        m_scan_size = scan_size;
+    }
+
+    int RingBufferView::acquire(ScanSpans& spans, uint32 max_scans)
+    {
+        sint32 avail_scans = 0;
+        sint64 read_pos = 0;
+
+        spans.count = 0;
+
+        auto err = DeWeGetParam_i32(m_board_id, bufferCommand(CMD_BUFFER_0_AVAIL_NO_SAMPLE, m_buffer), &avail_scans);
+        if (err > 0 || avail_scans <= 0)
+        {
+            return err;
+        }
+
+        err = DeWeGetParam_i64(m_board_id, bufferCommand(CMD_BUFFER_0_ACT_SAMPLE_POS, m_buffer), &read_pos);
+        if (err > 0)
+        {
+            return err;
+        }
+
+        uint32 scans = static_cast<uint32>(avail_scans);
+        if (scans > max_scans)
+        {
+            scans = max_scans;
+        }
+
+        spans = spansAt(read_pos, scans);
+        return err;
+    }
+
+    ScanSpans RingBufferView::spansAt(sint64 read_pos, uint32 scans) const
+    {
+        ScanSpans spans;
+        spans.count = 0;
+
+        if (scans == 0 || m_scan_size == 0)
+        {
+            return spans;
+        }
+
+        if (read_pos >= m_end_pos)
+        {
+            read_pos -= m_total_size;
+        }
+
+        uint32 scans_to_end = static_cast<uint32>((m_end_pos - read_pos) / m_scan_size);
+
+        spans.span[0].data = reinterpret_cast<const uint8*>(read_pos);
+        if (scans <= scans_to_end)
+        {
+            spans.span[0].scans = scans;
+            spans.count = 1;
+        }
+        else
+        {
+            spans.span[0].scans = scans_to_end;
+            spans.span[1].data = reinterpret_cast<const uint8*>(m_start_pos);
+            spans.span[1].scans = scans - scans_to_end;
+            spans.count = 2;
+        }
+
+        return spans;
+    }
+
+    sint64 RingBufferView::advance(sint64 pos, uint32 scans) const
+    {
+        pos += static_cast<sint64>(scans) * m_scan_size;
+        if (pos >= m_end_pos)
+        {
+            pos -= m_total_size;
+        }
+        return pos;
+    }
+
+    int RingBufferView::release(uint32 scans)
+    {
+        return DeWeSetParam_i32(m_board_id, bufferCommand(CMD_BUFFER_0_FREE_NO_SAMPLE, m_buffer), static_cast<sint32>(scans));
+    }
+
+
+    ScanStitcher::ScanStitcher(uint32 scan_size, uint32 block_scans)
+        : m_scan_size(scan_size)
+        , m_block_scans(block_scans ? block_scans : 1)
+        , m_scratch(static_cast<size_t>(scan_size) * (block_scans ? block_scans : 1))
+        , m_span(0)
+        , m_offset(0)
+        , m_stitched_bytes(0)
+        , m_passed_bytes(0)
+        , m_stitched_blocks(0)
+        , m_passed_blocks(0)
+    {
+        m_spans.count = 0;
+    }
+
+    void ScanStitcher::begin(const ScanSpans& spans)
+    {
+        m_spans = spans;
+        m_span = 0;
+        m_offset = 0;
+    }
+
+    bool ScanStitcher::next(ScanSpan& block)
+    {
+        while (m_span < m_spans.count && m_offset >= m_spans.span[m_span].scans)
+        {
+            ++m_span;
+            m_offset = 0;
+        }
+        if (m_span >= m_spans.count)
+        {
+            block.data = nullptr;
+            block.scans = 0;
+            return false;
+        }
+
+        const ScanSpan& span = m_spans.span[m_span];
+        const uint32 left = span.scans - m_offset;
+        const uint8* data = span.data + static_cast<size_t>(m_offset) * m_scan_size;
+
+        // Fast path: the block ends within the span or nothing follows
+        if (left >= m_block_scans || m_span + 1 >= m_spans.count)
+        {
+            block.data = data;
+            block.scans = left < m_block_scans ? left : m_block_scans;
+            m_offset += block.scans;
+            m_passed_bytes += static_cast<uint64>(block.scans) * m_scan_size;
+            ++m_passed_blocks;
+            return true;
+        }
+
+        // The block crosses the buffer end: copy the tail and the head of the next span
+        const ScanSpan& following = m_spans.span[m_span + 1];
+        const uint32 head = following.scans < m_block_scans - left ? following.scans : m_block_scans - left;
+        const size_t tail_bytes = static_cast<size_t>(left) * m_scan_size;
+        const size_t head_bytes = static_cast<size_t>(head) * m_scan_size;
+        std::memcpy(m_scratch.data(), data, tail_bytes);
+        std::memcpy(m_scratch.data() + tail_bytes, following.data, head_bytes);
+
+        block.data = m_scratch.data();
+        block.scans = left + head;
+        ++m_span;
+        m_offset = head;
+        m_stitched_bytes += tail_bytes + head_bytes;
+        ++m_stitched_blocks;
+        return true;
+    }
+
+    void ScanStitcher::resetStats()
+    {
+        m_stitched_bytes = 0;
+        m_passed_bytes = 0;
+        m_stitched_blocks = 0;
+        m_passed_blocks = 0;
+    }
+}
@@ -0,0 +1,230 @@
+// Copyright DEWETRON 2024
+
+#include "dewepxi_sample_codec_isa.h"
+#include <algorithm>
+#include <cstring>
+
+
+namespace trion
+{
+    namespace
+    {
+        inline void storeWord(uint8* dst, uint32 index, uint32 value)
+        {
+            std::memcpy(dst + index * sizeof(uint32), &value, sizeof(value));
+        }
+
+        inline uint32 loadWord(const uint8* src, uint32 index)
+        {
+            uint32 value;
+            std::memcpy(&value, src + index * sizeof(uint32), sizeof(value));
+            return value;
+        }
+
+        uint32 scalarEncodeBlock(const sint32* src, const sint32 history[2], uint8* dst)
+        {
+            uint32 residuals[3][SAMPLE_CODEC_BLOCK];
+            uint32 used[3] = { 0, 0, 0 };
+            uint32 p2 = static_cast<uint32>(history[0]);
+            uint32 p1 = static_cast<uint32>(history[1]);
+            for (uint32 i = 0; i < SAMPLE_CODEC_BLOCK; ++i)
+            {
+                const uint32 x = static_cast<uint32>(src[i]);
+                residuals[0][i] = zigzagEncode(x);
+                residuals[1][i] = zigzagEncode(x - p1);
+                residuals[2][i] = zigzagEncode(x - 2 * p1 + p2);
+                used[0] |= residuals[0][i];
+                used[1] |= residuals[1][i];
+                used[2] |= residuals[2][i];
+                p2 = p1;
+                p1 = x;
+            }
+
+            uint32 width = 0;
+            const SamplePredictor predictor = choosePredictor(used, width);
+            dst[0] = blockHeader(predictor, width);
+            uint8* words = dst + 1;
+            if (width == 0)
+            {
+                return 1;
+            }
+
+            const uint32* z = residuals[predictor];
+            for (uint32 lane = 0; lane < 4; ++lane)
+            {
+                uint64 acc = 0;
+                uint32 fill = 0;
+                uint32 word = lane;
+                for (uint32 row = 0; row < SAMPLE_CODEC_ROWS; ++row)
+                {
+                    acc |= static_cast<uint64>(z[row * 4 + lane]) << fill;
+                    fill += width;
+                    if (fill >= 32)
+                    {
+                        storeWord(words, word, static_cast<uint32>(acc));
+                        word += 4;
+                        acc >>= 32;
+                        fill -= 32;
+                    }
+                }
+            }
+            return 1 + width * 16;
+        }
+
+        uint32 scalarDecodeBlock(const uint8* src, uint64 size, const sint32 history[2], sint32* dst)
+        {
+            SamplePredictor predictor;
+            uint32 width;
+            if (!parseBlockHeader(src, size, predictor, width))
+            {
+                return 0;
+            }
+
+            uint32 residuals[SAMPLE_CODEC_BLOCK];
+            const uint8* words = src + 1;
+            const uint64 mask = (1ull << width) - 1;
+            for (uint32 lane = 0; lane < 4; ++lane)
+            {
+                uint64 acc = 0;
+                uint32 fill = 0;
+                uint32 word = lane;
+                for (uint32 row = 0; row < SAMPLE_CODEC_ROWS; ++row)
+                {
+                    if (fill < width)
+                    {
+                        acc |= static_cast<uint64>(loadWord(words, word)) << fill;
+                        word += 4;
+                        fill += 32;
+                    }
+                    residuals[row * 4 + lane] = zigzagDecode(static_cast<uint32>(acc & mask));
+                    acc >>= width;
+                    fill -= width;
+                }
+            }
+
+            uint32 p2 = static_cast<uint32>(history[0]);
+            uint32 p1 = static_cast<uint32>(history[1]);
+            for (uint32 i = 0; i < SAMPLE_CODEC_BLOCK; ++i)
+            {
+                uint32 x = residuals[i];
+                if (predictor == SAMPLE_PREDICTOR_DELTA)
+                {
+                    x += p1;
+                }
+                else if (predictor == SAMPLE_PREDICTOR_LINEAR)
+                {
+                    x += 2 * p1 - p2;
+                }
+                dst[i] = static_cast<sint32>(x);
+                p2 = p1;
+                p1 = x;
+            }
+            return 1 + width * 16;
+        }
+
+        const SampleCodecKernels* selectSampleCodecKernels()
+        {
+            for (int level = detectSimdLevel(); level > SIMD_LEVEL_SCALAR; --level)
+            {
+                const SampleCodecKernels* kernels = sampleCodecKernels(static_cast<SimdLevel>(level));
+                if (kernels)
+                {
+                    return kernels;
+                }
+            }
+            return sampleCodecKernelsScalar();
+        }
+    }
+
+    const SampleCodecKernels* sampleCodecKernelsScalar()
+    {
+        static const SampleCodecKernels kernels = {
+            SIMD_LEVEL_SCALAR,
+            &scalarEncodeBlock,
+            &scalarDecodeBlock
+        };
+        return &kernels;
+    }
+
+    const SampleCodecKernels* sampleCodecKernels(SimdLevel level)
+    {
+        if (level > detectSimdLevel())
+        {
+            return nullptr;
+        }
+
+        // The 4 lane block layout gains nothing from wider registers
+        switch (level)
+        {
+        case SIMD_LEVEL_SCALAR: return sampleCodecKernelsScalar();
+        case SIMD_LEVEL_SSE41:  return sampleCodecKernelsSse41();
+        default:                return nullptr;
+        }
+    }
+
+    const SampleCodecKernels& sampleCodecKernels()
+    {
+        static const SampleCodecKernels* selected = selectSampleCodecKernels();
+        return *selected;
+    }
+
+    uint64 encodeSamples(const sint32* src, uint32 count, uint8* dst)
+    {
+        return encodeSamples(sampleCodecKernels(), src, count, dst);
+    }
+
+    uint64 encodeSamples(const SampleCodecKernels& kernels, const sint32* src, uint32 count, uint8* dst)
+    {
+        sint32 history[2] = { 0, 0 };
+        uint64 size = 0;
+        uint32 i = 0;
+        for (; i + SAMPLE_CODEC_BLOCK <= count; i += SAMPLE_CODEC_BLOCK)
+        {
+            size += kernels.encode_block(src + i, history, dst + size);
+            history[0] = src[i + SAMPLE_CODEC_BLOCK - 2];
+            history[1] = src[i + SAMPLE_CODEC_BLOCK - 1];
+        }
+        if (i < count)
+        {
+            // Pad the last block with its last sample
+            sint32 block[SAMPLE_CODEC_BLOCK];
+            std::copy(src + i, src + count, block);
+            std::fill(block + (count - i), block + SAMPLE_CODEC_BLOCK, src[count - 1]);
+            size += kernels.encode_block(block, history, dst + size);
+        }
+        return size;
+    }
+
+    bool decodeSamples(const uint8* src, uint64 size, uint32 count, sint32* dst)
+    {
+        return decodeSamples(sampleCodecKernels(), src, size, count, dst);
+    }
+
+    bool decodeSamples(const SampleCodecKernels& kernels, const uint8* src, uint64 size, uint32 count, sint32* dst)
+    {
+        sint32 history[2] = { 0, 0 };
+        uint64 pos = 0;
+        uint32 i = 0;
+        for (; i + SAMPLE_CODEC_BLOCK <= count; i += SAMPLE_CODEC_BLOCK)
+        {
+            const uint32 bytes = kernels.decode_block(src + pos, size - pos, history, dst + i);
+            if (bytes == 0)
+            {
+                return false;
+            }
+            pos += bytes;
+            history[0] = dst[i + SAMPLE_CODEC_BLOCK - 2];
+            history[1] = dst[i + SAMPLE_CODEC_BLOCK - 1];
+        }
+        if (i < count)
+        {
+            sint32 block[SAMPLE_CODEC_BLOCK];
+            if (kernels.decode_block(src + pos, size - pos, history, block) == 0)
+            {
+                return false;
+            }
+            std::copy(block, block + (count - i), dst + i);
+        }
+        return true;
+    }
+}
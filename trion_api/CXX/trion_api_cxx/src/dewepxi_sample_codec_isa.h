@@ -0,0 +1,80 @@
+// Copyright DEWETRON 2024
+
+#pragma once
+
+#include "dewepxi_sample_codec.h"
+#include "dewepxi_sample_kernels_isa.h"
+
+
+namespace trion
+{
+    // Residual rows of a block: 4 lanes, SAMPLE_CODEC_BLOCK / 4 rows
+    const uint32 SAMPLE_CODEC_ROWS = SAMPLE_CODEC_BLOCK / 4;
+
+    static inline uint32 zigzagEncode(uint32 residual)
+    {
+        return (residual << 1) ^ static_cast<uint32>(static_cast<sint32>(residual) >> 31);
+    }
+
+    static inline uint32 zigzagDecode(uint32 value)
+    {
+        return (value >> 1) ^ (0u - (value & 1));
+    }
+
+    /**
+     * Bits needed for value, 0 for 0.
+     */
+    static inline uint32 bitWidth(uint32 value)
+    {
+        uint32 width = 0;
+        while (value)
+        {
+            ++width;
+            value >>= 1;
+        }
+        return width;
+    }
+
+    static inline uint8 blockHeader(SamplePredictor predictor, uint32 width)
+    {
+        return static_cast<uint8>((predictor << 6) | width);
+    }
+
+    /**
+     * Predictor of the smallest width, the simpler one on equal widths.
+     */
+    static inline SamplePredictor choosePredictor(const uint32 used[3], uint32& width)
+    {
+        SamplePredictor predictor = SAMPLE_PREDICTOR_NONE;
+        width = bitWidth(used[0]);
+        for (int p = SAMPLE_PREDICTOR_DELTA; p <= SAMPLE_PREDICTOR_LINEAR; ++p)
+        {
+            const uint32 w = bitWidth(used[p]);
+            if (w < width)
+            {
+                width = w;
+                predictor = static_cast<SamplePredictor>(p);
+            }
+        }
+        return predictor;
+    }
+
+    /**
+     * Parse a block header.
+     * @return false if corrupt or truncated
+     */
+    static inline bool parseBlockHeader(const uint8* src, uint64 size, SamplePredictor& predictor, uint32& width)
+    {
+        if (size < 1)
+        {
+            return false;
+        }
+        predictor = static_cast<SamplePredictor>(src[0] >> 6);
+        width = src[0] & 0x3f;
+        return predictor <= SAMPLE_PREDICTOR_LINEAR && width <= 32 && size >= 1 + width * 16ull;
+    }
+
+    // Codec kernel tables per instruction set, nullptr if not built in
+    const SampleCodecKernels* sampleCodecKernelsScalar();
+    const SampleCodecKernels* sampleCodecKernelsSse41();
+}
@@ -0,0 +1,182 @@
+// Copyright DEWETRON 2024
+// Compiled with SSE4.1 code generation enabled (see CMakeLists.txt)
+
+#include "dewepxi_sample_codec_isa.h"
+
+#if defined(DEWEPXI_SIMD_X86)
+#include <smmintrin.h>
+
+
+namespace trion
+{
+    namespace
+    {
+        inline __m128i zigzag(__m128i r)
+        {
+            return _mm_xor_si128(_mm_slli_epi32(r, 1), _mm_srai_epi32(r, 31));
+        }
+
+        inline __m128i unzigzag(__m128i z)
+        {
+            const __m128i sign = _mm_sub_epi32(_mm_setzero_si128(), _mm_and_si128(z, _mm_set1_epi32(1)));
+            return _mm_xor_si128(_mm_srli_epi32(z, 1), sign);
+        }
+
+        inline uint32 horizontalOr(__m128i v)
+        {
+            v = _mm_or_si128(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+            v = _mm_or_si128(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+            return static_cast<uint32>(_mm_cvtsi128_si32(v));
+        }
+
+        /**
+         * Running sum of the 4 lanes continuing carry (the sum before, in all lanes).
+         */
+        inline __m128i prefixSum(__m128i v, __m128i& carry)
+        {
+            v = _mm_add_epi32(v, _mm_slli_si128(v, 4));
+            v = _mm_add_epi32(v, _mm_slli_si128(v, 8));
+            v = _mm_add_epi32(v, carry);
+            carry = _mm_shuffle_epi32(v, _MM_SHUFFLE(3, 3, 3, 3));
+            return v;
+        }
+
+        uint32 sse41EncodeBlock(const sint32* src, const sint32 history[2], uint8* dst)
+        {
+            __m128i residuals[3][SAMPLE_CODEC_ROWS];
+            __m128i used[3] = { _mm_setzero_si128(), _mm_setzero_si128(), _mm_setzero_si128() };
+            __m128i last = _mm_setr_epi32(0, 0, history[0], history[1]);
+            for (uint32 row = 0; row < SAMPLE_CODEC_ROWS; ++row)
+            {
+                const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + row * 4));
+                const __m128i p1 = _mm_alignr_epi8(x, last, 12);
+                const __m128i p2 = _mm_alignr_epi8(x, last, 8);
+                const __m128i delta = _mm_sub_epi32(x, p1);
+                const __m128i linear = _mm_sub_epi32(delta, _mm_sub_epi32(p1, p2));
+                residuals[0][row] = zigzag(x);
+                residuals[1][row] = zigzag(delta);
+                residuals[2][row] = zigzag(linear);
+                used[0] = _mm_or_si128(used[0], residuals[0][row]);
+                used[1] = _mm_or_si128(used[1], residuals[1][row]);
+                used[2] = _mm_or_si128(used[2], residuals[2][row]);
+                last = x;
+            }
+
+            const uint32 used_bits[3] = { horizontalOr(used[0]), horizontalOr(used[1]), horizontalOr(used[2]) };
+            uint32 width = 0;
+            const SamplePredictor predictor = choosePredictor(used_bits, width);
+            dst[0] = blockHeader(predictor, width);
+            if (width == 0)
+            {
+                return 1;
+            }
+
+            const __m128i* z = residuals[predictor];
+            __m128i* out = reinterpret_cast<__m128i*>(dst + 1);
+            __m128i acc = _mm_setzero_si128();
+            uint32 shift = 0;
+            for (uint32 row = 0; row < SAMPLE_CODEC_ROWS; ++row)
+            {
+                acc = _mm_or_si128(acc, _mm_sll_epi32(z[row], _mm_cvtsi32_si128(static_cast<int>(shift))));
+                shift += width;
+                if (shift >= 32)
+                {
+                    _mm_storeu_si128(out++, acc);
+                    shift -= 32;
+                    // Bits of the residual which did not fit
+                    acc = shift ? _mm_srl_epi32(z[row], _mm_cvtsi32_si128(static_cast<int>(width - shift)))
+                                : _mm_setzero_si128();
+                }
+            }
+            return 1 + width * 16;
+        }
+
+        template <SamplePredictor PREDICTOR>
+        void unpackBlock(const __m128i* in, uint32 width, const sint32 history[2], sint32* dst)
+        {
+            const __m128i mask = _mm_set1_epi32(width == 32 ? -1 : static_cast<int>((1u << width) - 1));
+            __m128i carry = _mm_set1_epi32(history[1]);
+            __m128i carry_delta = _mm_set1_epi32(static_cast<int>(static_cast<uint32>(history[1]) - static_cast<uint32>(history[0])));
+            __m128i word = width ? _mm_loadu_si128(in++) : _mm_setzero_si128();
+            uint32 shift = 0;
+            for (uint32 row = 0; row < SAMPLE_CODEC_ROWS; ++row)
+            {
+                __m128i v = _mm_srl_epi32(word, _mm_cvtsi32_si128(static_cast<int>(shift)));
+                if (shift + width > 32)
+                {
+                    // The residual continues in the next word
+                    word = _mm_loadu_si128(in++);
+                    v = _mm_or_si128(v, _mm_sll_epi32(word, _mm_cvtsi32_si128(static_cast<int>(32 - shift))));
+                    shift = shift + width - 32;
+                }
+                else
+                {
+                    shift += width;
+                    if (shift == 32 && row + 1 < SAMPLE_CODEC_ROWS)
+                    {
+                        word = _mm_loadu_si128(in++);
+                        shift = 0;
+                    }
+                }
+                v = unzigzag(_mm_and_si128(v, mask));
+
+                if (PREDICTOR == SAMPLE_PREDICTOR_DELTA)
+                {
+                    v = prefixSum(v, carry);
+                }
+                else if (PREDICTOR == SAMPLE_PREDICTOR_LINEAR)
+                {
+                    v = prefixSum(prefixSum(v, carry_delta), carry);
+                }
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + row * 4), v);
+            }
+        }
+
+        uint32 sse41DecodeBlock(const uint8* src, uint64 size, const sint32 history[2], sint32* dst)
+        {
+            SamplePredictor predictor;
+            uint32 width;
+            if (!parseBlockHeader(src, size, predictor, width))
+            {
+                return 0;
+            }
+
+            const __m128i* in = reinterpret_cast<const __m128i*>(src + 1);
+            switch (predictor)
+            {
+            case SAMPLE_PREDICTOR_NONE:
+                unpackBlock<SAMPLE_PREDICTOR_NONE>(in, width, history, dst);
+                break;
+            case SAMPLE_PREDICTOR_DELTA:
+                unpackBlock<SAMPLE_PREDICTOR_DELTA>(in, width, history, dst);
+                break;
+            case SAMPLE_PREDICTOR_LINEAR:
+                unpackBlock<SAMPLE_PREDICTOR_LINEAR>(in, width, history, dst);
+                break;
+            }
+            return 1 + width * 16;
+        }
+    }
+
+    const SampleCodecKernels* sampleCodecKernelsSse41()
+    {
+        static const SampleCodecKernels kernels = {
+            SIMD_LEVEL_SSE41,
+            &sse41EncodeBlock,
+            &sse41DecodeBlock
+        };
+        return &kernels;
+    }
+}
+
+#else
+
+namespace trion
+{
+    const SampleCodecKernels* sampleCodecKernelsSse41()
+    {
+        return nullptr;
+    }
+}
+
+#endif
@@ -0,0 +1,239 @@
+// Copyright DEWETRON 2024
+
+#include "dewepxi_sample_kernels_isa.h"
+
+#if defined(DEWEPXI_SIMD_X86)
+#  if defined(_MSC_VER)
+#    include <intrin.h>
+#  else
+#    include <cpuid.h>
+#  endif
+#endif
+
+
+namespace trion
+{
+    namespace
+    {
+        template <bool LEFT>
+        void scalarI32(const uint32* src, uint32 stride, uint32 count, sint32* dst)
+        {
+            for (uint32 i = 0; i < count; ++i, src += stride)
+            {
+                dst[i] = extractScalar24<LEFT>(*src);
+            }
+        }
+
+        template <bool LEFT>
+        void scalarF32(const uint32* src, uint32 stride, uint32 count, float* dst)
+        {
+            for (uint32 i = 0; i < count; ++i, src += stride)
+            {
+                dst[i] = static_cast<float>(extractScalar24<LEFT>(*src));
+            }
+        }
+
+        template <bool LEFT>
+        void scalarScaledF32(const uint32* src, uint32 stride, uint32 count, double gain, double offset, float* dst)
+        {
+            const float g = static_cast<float>(gain);
+            const float o = static_cast<float>(offset);
+            for (uint32 i = 0; i < count; ++i, src += stride)
+            {
+                dst[i] = scaleScalar24<LEFT>(*src, g, o);
+            }
+        }
+
+        template <bool LEFT>
+        void scalarScaledF64(const uint32* src, uint32 stride, uint32 count, double gain, double offset, double* dst)
+        {
+            for (uint32 i = 0; i < count; ++i, src += stride)
+            {
+                dst[i] = scaleScalar24<LEFT>(*src, gain, offset);
+            }
+        }
+
+        template <bool LEFT>
+        void scalarX8I32(const uint32* src, uint32 stride, uint32 count, sint32* const* dst)
+        {
+            convertTail24x8<LEFT>(src, stride, 0, count, dst);
+        }
+
+        template <bool LEFT>
+        void scalarX8F32(const uint32* src, uint32 stride, uint32 count, float* const* dst)
+        {
+            convertTail24x8<LEFT>(src, stride, 0, count, dst);
+        }
+
+        template <bool LEFT>
+        void scalarX8ScaledF32(const uint32* src, uint32 stride, uint32 count,
+                               const double* gain, const double* offset, float* const* dst)
+        {
+            float g[SAMPLE24_GROUP];
+            float o[SAMPLE24_GROUP];
+            for (uint32 c = 0; c < SAMPLE24_GROUP; ++c)
+            {
+                g[c] = static_cast<float>(gain[c]);
+                o[c] = static_cast<float>(offset[c]);
+            }
+            scaleTail24x8<LEFT>(src, stride, 0, count, g, o, dst);
+        }
+
+        template <bool LEFT>
+        void scalarX8ScaledF64(const uint32* src, uint32 stride, uint32 count,
+                               const double* gain, const double* offset, double* const* dst)
+        {
+            scaleTail24x8<LEFT>(src, stride, 0, count, gain, offset, dst);
+        }
+
+#if defined(DEWEPXI_SIMD_X86)
+        void cpuid(uint32 leaf, uint32 subleaf, uint32 regs[4])
+        {
+#  if defined(_MSC_VER)
+            int r[4];
+            __cpuidex(r, static_cast<int>(leaf), static_cast<int>(subleaf));
+            for (int i = 0; i < 4; ++i) regs[i] = static_cast<uint32>(r[i]);
+#  else
+            __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#  endif
+        }
+
+        /**
+         * Register state enabled by the operating system (XCR0).
+         */
+        uint64 xgetbv0()
+        {
+#  if defined(_MSC_VER)
+            return _xgetbv(0);
+#  else
+            uint32 eax = 0;
+            uint32 edx = 0;
+            __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+            return (static_cast<uint64>(edx) << 32) | eax;
+#  endif
+        }
+#endif
+    }
+
+
+    const SampleKernels* sampleKernelsScalar()
+    {
+        static const SampleKernels kernels = {
+            SIMD_LEVEL_SCALAR,
+            &scalarI32<false>,
+            &scalarI32<true>,
+            &scalarF32<false>,
+            &scalarF32<true>,
+            &scalarScaledF32<false>,
+            &scalarScaledF32<true>,
+            &scalarScaledF64<false>,
+            &scalarScaledF64<true>,
+            &scalarX8I32<false>,
+            &scalarX8I32<true>,
+            &scalarX8F32<false>,
+            &scalarX8F32<true>,
+            &scalarX8ScaledF32<false>,
+            &scalarX8ScaledF32<true>,
+            &scalarX8ScaledF64<false>,
+            &scalarX8ScaledF64<true>
+        };
+        return &kernels;
+    }
+
+    SimdLevel detectSimdLevel()
+    {
+#if defined(DEWEPXI_SIMD_X86)
+        uint32 regs[4] = { 0 };
+        cpuid(0, 0, regs);
+        const uint32 max_leaf = regs[0];
+
+        cpuid(1, 0, regs);
+        const bool sse41 = (regs[2] & (1u << 19)) != 0;
+        const bool osxsave = (regs[2] & (1u << 27)) != 0;
+        const bool avx = (regs[2] & (1u << 28)) != 0;
+
+        if (!sse41)
+        {
+            return SIMD_LEVEL_SCALAR;
+        }
+        if (!osxsave || !avx || max_leaf < 7)
+        {
+            return SIMD_LEVEL_SSE41;
+        }
+
+        const uint64 xcr0 = xgetbv0();
+        if ((xcr0 & 0x06) != 0x06)
+        {
+            // YMM state not saved by the OS
+            return SIMD_LEVEL_SSE41;
+        }
+
+        cpuid(7, 0, regs);
+        const bool avx2 = (regs[1] & (1u << 5)) != 0;
+        const bool avx512f = (regs[1] & (1u << 16)) != 0;
+
+        if (!avx2)
+        {
+            return SIMD_LEVEL_SSE41;
+        }
+        if (avx512f && (xcr0 & 0xe6) == 0xe6)
+        {
+            return SIMD_LEVEL_AVX512;
+        }
+        return SIMD_LEVEL_AVX2;
+#else
+        return SIMD_LEVEL_SCALAR;
+#endif
+    }
+
+    const char* simdLevelName(SimdLevel level)
+    {
+        switch (level)
+        {
+        case SIMD_LEVEL_SCALAR: return "scalar";
+        case SIMD_LEVEL_SSE41:  return "sse4.1";
+        case SIMD_LEVEL_AVX2:   return "avx2";
+        case SIMD_LEVEL_AVX512: return "avx512";
+        }
+        return "unknown";
+    }
+
+    namespace
+    {
+        const SampleKernels* selectSampleKernels()
+        {
+            for (int level = detectSimdLevel(); level > SIMD_LEVEL_SCALAR; --level)
+            {
+                const SampleKernels* kernels = sampleKernels(static_cast<SimdLevel>(level));
+                if (kernels)
+                {
+                    return kernels;
+                }
+            }
+            return sampleKernelsScalar();
+        }
+    }
+
+    const SampleKernels* sampleKernels(SimdLevel level)
+    {
+        if (level > detectSimdLevel())
+        {
+            return nullptr;
+        }
+
+        switch (level)
+        {
+        case SIMD_LEVEL_SCALAR: return sampleKernelsScalar();
+        case SIMD_LEVEL_SSE41:  return sampleKernelsSse41();
+        case SIMD_LEVEL_AVX2:   return sampleKernelsAvx2();
+        case SIMD_LEVEL_AVX512: return sampleKernelsAvx512();
+        }
+        return nullptr;
+    }
+
+    const SampleKernels& sampleKernels()
+    {
+        static const SampleKernels* selected = selectSampleKernels();
+        return *selected;
+    }
+}
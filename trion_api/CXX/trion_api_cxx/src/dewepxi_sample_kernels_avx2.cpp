@@ -0,0 +1,260 @@
+// Copyright DEWETRON 2024
+// Compiled with AVX2 code generation enabled (see CMakeLists.txt)
+
+#include "dewepxi_sample_kernels_isa.h"
+
+#if defined(DEWEPXI_SIMD_X86)
+#include <immintrin.h>
+
+
+namespace trion
+{
+    namespace
+    {
+        template <bool LEFT>
+        inline __m256i extract24(__m256i v)
+        {
+            if (LEFT)
+            {
+                // round toward zero: add 255 to negative values before the shift
+                __m256i bias = _mm256_and_si256(_mm256_srai_epi32(v, 31), _mm256_set1_epi32(0xff));
+                return _mm256_srai_epi32(_mm256_add_epi32(v, bias), 8);
+            }
+            return _mm256_srai_epi32(_mm256_slli_epi32(v, 8), 8);
+        }
+
+        /**
+         * Load 8 scans of 8 adjacent channels and transpose them:
+         * v[c] holds channel c of the 8 scans.
+         */
+        template <bool LEFT>
+        inline void load8x8(const uint32* src, uint32 stride, __m256i v[8])
+        {
+            __m256i t[8];
+            for (int k = 0; k < 8; ++k)
+            {
+                v[k] = extract24<LEFT>(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + k * stride)));
+            }
+            for (int k = 0; k < 8; k += 4)
+            {
+                __m256i lo0 = _mm256_unpacklo_epi32(v[k], v[k + 1]);
+                __m256i hi0 = _mm256_unpackhi_epi32(v[k], v[k + 1]);
+                __m256i lo1 = _mm256_unpacklo_epi32(v[k + 2], v[k + 3]);
+                __m256i hi1 = _mm256_unpackhi_epi32(v[k + 2], v[k + 3]);
+                t[k] = _mm256_unpacklo_epi64(lo0, lo1);
+                t[k + 1] = _mm256_unpackhi_epi64(lo0, lo1);
+                t[k + 2] = _mm256_unpacklo_epi64(hi0, hi1);
+                t[k + 3] = _mm256_unpackhi_epi64(hi0, hi1);
+            }
+            for (int c = 0; c < 4; ++c)
+            {
+                v[c] = _mm256_permute2x128_si256(t[c], t[c + 4], 0x20);
+                v[c + 4] = _mm256_permute2x128_si256(t[c], t[c + 4], 0x31);
+            }
+        }
+
+        // Single channel kernels: vector loads for contiguous samples,
+        // strided samples are loaded one by one (a gather is not faster)
+        template <bool LEFT>
+        void extractI32(const uint32* src, uint32 stride, uint32 count, sint32* dst)
+        {
+            if (stride != 1)
+            {
+                convertStrided24<LEFT>(src, stride, count, dst);
+                return;
+            }
+            uint32 i = 0;
+            for (; i + 8 <= count; i += 8)
+            {
+                __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), extract24<LEFT>(v));
+            }
+            convertStrided24<LEFT>(src + i, 1, count - i, dst + i);
+        }
+
+        template <bool LEFT>
+        void extractF32(const uint32* src, uint32 stride, uint32 count, float* dst)
+        {
+            if (stride != 1)
+            {
+                convertStrided24<LEFT>(src, stride, count, dst);
+                return;
+            }
+            uint32 i = 0;
+            for (; i + 8 <= count; i += 8)
+            {
+                __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+                _mm256_storeu_ps(dst + i, _mm256_cvtepi32_ps(extract24<LEFT>(v)));
+            }
+            convertStrided24<LEFT>(src + i, 1, count - i, dst + i);
+        }
+
+        template <bool LEFT>
+        void scaleF32(const uint32* src, uint32 stride, uint32 count, double gain, double offset, float* dst)
+        {
+            const float gf = static_cast<float>(gain);
+            const float of = static_cast<float>(offset);
+            if (stride != 1)
+            {
+                scaleStrided24<LEFT>(src, stride, count, gf, of, dst);
+                return;
+            }
+            const __m256 g = _mm256_set1_ps(gf);
+            const __m256 o = _mm256_set1_ps(of);
+            uint32 i = 0;
+            for (; i + 8 <= count; i += 8)
+            {
+                __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+                __m256 f = _mm256_cvtepi32_ps(extract24<LEFT>(v));
+                _mm256_storeu_ps(dst + i, _mm256_add_ps(_mm256_mul_ps(f, g), o));
+            }
+            scaleStrided24<LEFT>(src + i, 1, count - i, gf, of, dst + i);
+        }
+
+        template <bool LEFT>
+        void scaleF64(const uint32* src, uint32 stride, uint32 count, double gain, double offset, double* dst)
+        {
+            if (stride != 1)
+            {
+                scaleStrided24<LEFT>(src, stride, count, gain, offset, dst);
+                return;
+            }
+            const __m256d g = _mm256_set1_pd(gain);
+            const __m256d o = _mm256_set1_pd(offset);
+            uint32 i = 0;
+            for (; i + 8 <= count; i += 8)
+            {
+                __m256i v = extract24<LEFT>(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i)));
+                __m256d lo = _mm256_cvtepi32_pd(_mm256_castsi256_si128(v));
+                __m256d hi = _mm256_cvtepi32_pd(_mm256_extracti128_si256(v, 1));
+                _mm256_storeu_pd(dst + i, _mm256_add_pd(_mm256_mul_pd(lo, g), o));
+                _mm256_storeu_pd(dst + i + 4, _mm256_add_pd(_mm256_mul_pd(hi, g), o));
+            }
+            scaleStrided24<LEFT>(src + i, 1, count - i, gain, offset, dst + i);
+        }
+
+        // Group kernels: 8 scans per iteration, transposed in registers
+        template <bool LEFT>
+        void extractX8I32(const uint32* src, uint32 stride, uint32 count, sint32* const* dst)
+        {
+            uint32 i = 0;
+            for (; i + 8 <= count; i += 8, src += 8 * stride)
+            {
+                __m256i v[8];
+                load8x8<LEFT>(src, stride, v);
+                for (int c = 0; c < 8; ++c)
+                {
+                    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst[c] + i), v[c]);
+                }
+            }
+            convertTail24x8<LEFT>(src, stride, i, count, dst);
+        }
+
+        template <bool LEFT>
+        void extractX8F32(const uint32* src, uint32 stride, uint32 count, float* const* dst)
+        {
+            uint32 i = 0;
+            for (; i + 8 <= count; i += 8, src += 8 * stride)
+            {
+                __m256i v[8];
+                load8x8<LEFT>(src, stride, v);
+                for (int c = 0; c < 8; ++c)
+                {
+                    _mm256_storeu_ps(dst[c] + i, _mm256_cvtepi32_ps(v[c]));
+                }
+            }
+            convertTail24x8<LEFT>(src, stride, i, count, dst);
+        }
+
+        template <bool LEFT>
+        void scaleX8F32(const uint32* src, uint32 stride, uint32 count,
+                        const double* gain, const double* offset, float* const* dst)
+        {
+            float gf[8];
+            float of[8];
+            __m256 g[8];
+            __m256 o[8];
+            for (int c = 0; c < 8; ++c)
+            {
+                gf[c] = static_cast<float>(gain[c]);
+                of[c] = static_cast<float>(offset[c]);
+                g[c] = _mm256_set1_ps(gf[c]);
+                o[c] = _mm256_set1_ps(of[c]);
+            }
+            uint32 i = 0;
+            for (; i + 8 <= count; i += 8, src += 8 * stride)
+            {
+                __m256i v[8];
+                load8x8<LEFT>(src, stride, v);
+                for (int c = 0; c < 8; ++c)
+                {
+                    _mm256_storeu_ps(dst[c] + i, _mm256_add_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(v[c]), g[c]), o[c]));
+                }
+            }
+            scaleTail24x8<LEFT>(src, stride, i, count, gf, of, dst);
+        }
+
+        template <bool LEFT>
+        void scaleX8F64(const uint32* src, uint32 stride, uint32 count,
+                        const double* gain, const double* offset, double* const* dst)
+        {
+            __m256d g[8];
+            __m256d o[8];
+            for (int c = 0; c < 8; ++c)
+            {
+                g[c] = _mm256_set1_pd(gain[c]);
+                o[c] = _mm256_set1_pd(offset[c]);
+            }
+            uint32 i = 0;
+            for (; i + 8 <= count; i += 8, src += 8 * stride)
+            {
+                __m256i v[8];
+                load8x8<LEFT>(src, stride, v);
+                for (int c = 0; c < 8; ++c)
+                {
+                    __m256d lo = _mm256_cvtepi32_pd(_mm256_castsi256_si128(v[c]));
+                    __m256d hi = _mm256_cvtepi32_pd(_mm256_extracti128_si256(v[c], 1));
+                    _mm256_storeu_pd(dst[c] + i, _mm256_add_pd(_mm256_mul_pd(lo, g[c]), o[c]));
+                    _mm256_storeu_pd(dst[c] + i + 4, _mm256_add_pd(_mm256_mul_pd(hi, g[c]), o[c]));
+                }
+            }
+            scaleTail24x8<LEFT>(src, stride, i, count, gain, offset, dst);
+        }
+    }
+
+    const SampleKernels* sampleKernelsAvx2()
+    {
+        static const SampleKernels kernels = {
+            SIMD_LEVEL_AVX2,
+            &extractI32<false>,
+            &extractI32<true>,
+            &extractF32<false>,
+            &extractF32<true>,
+            &scaleF32<false>,
+            &scaleF32<true>,
+            &scaleF64<false>,
+            &scaleF64<true>,
+            &extractX8I32<false>,
+            &extractX8I32<true>,
+            &extractX8F32<false>,
+            &extractX8F32<true>,
+            &scaleX8F32<false>,
+            &scaleX8F32<true>,
+            &scaleX8F64<false>,
+            &scaleX8F64<true>
+        };
+        return &kernels;
+    }
+}
+
+#else
+
+namespace trion
+{
+    const SampleKernels* sampleKernelsAvx2()
+    {
+        return nullptr;
+    }
+}
+
+#endif
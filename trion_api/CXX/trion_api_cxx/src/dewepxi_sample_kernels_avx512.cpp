@@ -0,0 +1,279 @@
+// Copyright DEWETRON 2024
+// Compiled with AVX-512F code generation enabled (see CMakeLists.txt)
+
+#include "dewepxi_sample_kernels_isa.h"
+
+#if defined(DEWEPXI_SIMD_X86)
+#include <immintrin.h>
+
+
+namespace trion
+{
+    namespace
+    {
+        // The zero masking forms are used with all lanes set: the unmasked
+        // intrinsics of GCC pass an undefined source vector, which trips
+        // -Wmaybe-uninitialized
+        const __mmask16 ALL_LANES = 0xffff;
+
+        inline __mmask16 tailMask(uint32 remaining)
+        {
+            return remaining >= 16 ? static_cast<__mmask16>(0xffff)
+                                   : static_cast<__mmask16>((1u << remaining) - 1);
+        }
+
+        template <bool LEFT>
+        inline __m512i extract24(__m512i v)
+        {
+            if (LEFT)
+            {
+                // round toward zero: add 255 to negative values before the shift
+                __m512i bias = _mm512_and_si512(_mm512_maskz_srai_epi32(ALL_LANES, v, 31), _mm512_set1_epi32(0xff));
+                return _mm512_maskz_srai_epi32(ALL_LANES, _mm512_add_epi32(v, bias), 8);
+            }
+            return _mm512_maskz_srai_epi32(ALL_LANES, _mm512_maskz_slli_epi32(ALL_LANES, v, 8), 8);
+        }
+
+        /**
+         * Load 16 scans of 8 adjacent channels and transpose them:
+         * v[c] holds channel c of the 16 scans. Row k holds the scans
+         * k and k + 8, the last step merges the 128 bit lanes of two rows.
+         */
+        template <bool LEFT>
+        inline void load16x8(const uint32* src, uint32 stride, __m512i v[8])
+        {
+            __m512i t[8];
+            for (uint32 k = 0; k < 8; ++k)
+            {
+                __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + k * stride));
+                __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + (k + 8) * stride));
+                v[k] = extract24<LEFT>(_mm512_maskz_inserti64x4(0xff, _mm512_castsi256_si512(lo), hi, 1));
+            }
+            for (int k = 0; k < 8; k += 4)
+            {
+                __m512i lo0 = _mm512_maskz_unpacklo_epi32(ALL_LANES, v[k], v[k + 1]);
+                __m512i hi0 = _mm512_maskz_unpackhi_epi32(ALL_LANES, v[k], v[k + 1]);
+                __m512i lo1 = _mm512_maskz_unpacklo_epi32(ALL_LANES, v[k + 2], v[k + 3]);
+                __m512i hi1 = _mm512_maskz_unpackhi_epi32(ALL_LANES, v[k + 2], v[k + 3]);
+                t[k] = _mm512_maskz_unpacklo_epi64(0xff, lo0, lo1);
+                t[k + 1] = _mm512_maskz_unpackhi_epi64(0xff, lo0, lo1);
+                t[k + 2] = _mm512_maskz_unpacklo_epi64(0xff, hi0, hi1);
+                t[k + 3] = _mm512_maskz_unpackhi_epi64(0xff, hi0, hi1);
+            }
+            const __m512i lower = _mm512_set_epi64(13, 12, 5, 4, 9, 8, 1, 0);
+            const __m512i upper = _mm512_set_epi64(15, 14, 7, 6, 11, 10, 3, 2);
+            for (int c = 0; c < 4; ++c)
+            {
+                v[c] = _mm512_permutex2var_epi64(t[c], lower, t[c + 4]);
+                v[c + 4] = _mm512_permutex2var_epi64(t[c], upper, t[c + 4]);
+            }
+        }
+
+        // Single channel kernels: masked vector loads for contiguous samples,
+        // strided samples are loaded one by one (a gather is not faster)
+        template <bool LEFT>
+        void extractI32(const uint32* src, uint32 stride, uint32 count, sint32* dst)
+        {
+            if (stride != 1)
+            {
+                convertStrided24<LEFT>(src, stride, count, dst);
+                return;
+            }
+            for (uint32 i = 0; i < count; i += 16)
+            {
+                __mmask16 mask = tailMask(count - i);
+                _mm512_mask_storeu_epi32(dst + i, mask, extract24<LEFT>(_mm512_maskz_loadu_epi32(mask, src + i)));
+            }
+        }
+
+        template <bool LEFT>
+        void extractF32(const uint32* src, uint32 stride, uint32 count, float* dst)
+        {
+            if (stride != 1)
+            {
+                convertStrided24<LEFT>(src, stride, count, dst);
+                return;
+            }
+            for (uint32 i = 0; i < count; i += 16)
+            {
+                __mmask16 mask = tailMask(count - i);
+                __m512i v = extract24<LEFT>(_mm512_maskz_loadu_epi32(mask, src + i));
+                _mm512_mask_storeu_ps(dst + i, mask, _mm512_maskz_cvtepi32_ps(mask, v));
+            }
+        }
+
+        template <bool LEFT>
+        void scaleF32(const uint32* src, uint32 stride, uint32 count, double gain, double offset, float* dst)
+        {
+            const float gf = static_cast<float>(gain);
+            const float of = static_cast<float>(offset);
+            if (stride != 1)
+            {
+                scaleStrided24<LEFT>(src, stride, count, gf, of, dst);
+                return;
+            }
+            const __m512 g = _mm512_set1_ps(gf);
+            const __m512 o = _mm512_set1_ps(of);
+            for (uint32 i = 0; i < count; i += 16)
+            {
+                __mmask16 mask = tailMask(count - i);
+                __m512 v = _mm512_maskz_cvtepi32_ps(mask, extract24<LEFT>(_mm512_maskz_loadu_epi32(mask, src + i)));
+                _mm512_mask_storeu_ps(dst + i, mask, _mm512_add_ps(_mm512_mul_ps(v, g), o));
+            }
+        }
+
+        inline __m512d cvtLower8(__m512i v, __mmask8 mask)
+        {
+            return _mm512_maskz_cvtepi32_pd(mask, _mm512_maskz_extracti64x4_epi64(0xf, v, 0));
+        }
+
+        inline __m512d cvtUpper8(__m512i v, __mmask8 mask)
+        {
+            return _mm512_maskz_cvtepi32_pd(mask, _mm512_maskz_extracti64x4_epi64(0xf, v, 1));
+        }
+
+        template <bool LEFT>
+        void scaleF64(const uint32* src, uint32 stride, uint32 count, double gain, double offset, double* dst)
+        {
+            if (stride != 1)
+            {
+                scaleStrided24<LEFT>(src, stride, count, gain, offset, dst);
+                return;
+            }
+            const __m512d g = _mm512_set1_pd(gain);
+            const __m512d o = _mm512_set1_pd(offset);
+            for (uint32 i = 0; i < count; i += 16)
+            {
+                __mmask16 mask = tailMask(count - i);
+                __m512i v = extract24<LEFT>(_mm512_maskz_loadu_epi32(mask, src + i));
+                __m512d lo = cvtLower8(v, static_cast<__mmask8>(mask));
+                __m512d hi = cvtUpper8(v, static_cast<__mmask8>(mask >> 8));
+                _mm512_mask_storeu_pd(dst + i, static_cast<__mmask8>(mask), _mm512_add_pd(_mm512_mul_pd(lo, g), o));
+                _mm512_mask_storeu_pd(dst + i + 8, static_cast<__mmask8>(mask >> 8), _mm512_add_pd(_mm512_mul_pd(hi, g), o));
+            }
+        }
+
+        // Group kernels: 16 scans per iteration, transposed in registers
+        template <bool LEFT>
+        void extractX8I32(const uint32* src, uint32 stride, uint32 count, sint32* const* dst)
+        {
+            uint32 i = 0;
+            for (; i + 16 <= count; i += 16, src += 16 * stride)
+            {
+                __m512i v[8];
+                load16x8<LEFT>(src, stride, v);
+                for (int c = 0; c < 8; ++c)
+                {
+                    _mm512_storeu_si512(dst[c] + i, v[c]);
+                }
+            }
+            convertTail24x8<LEFT>(src, stride, i, count, dst);
+        }
+
+        template <bool LEFT>
+        void extractX8F32(const uint32* src, uint32 stride, uint32 count, float* const* dst)
+        {
+            uint32 i = 0;
+            for (; i + 16 <= count; i += 16, src += 16 * stride)
+            {
+                __m512i v[8];
+                load16x8<LEFT>(src, stride, v);
+                for (int c = 0; c < 8; ++c)
+                {
+                    _mm512_storeu_ps(dst[c] + i, _mm512_maskz_cvtepi32_ps(ALL_LANES, v[c]));
+                }
+            }
+            convertTail24x8<LEFT>(src, stride, i, count, dst);
+        }
+
+        template <bool LEFT>
+        void scaleX8F32(const uint32* src, uint32 stride, uint32 count,
+                        const double* gain, const double* offset, float* const* dst)
+        {
+            float gf[8];
+            float of[8];
+            __m512 g[8];
+            __m512 o[8];
+            for (int c = 0; c < 8; ++c)
+            {
+                gf[c] = static_cast<float>(gain[c]);
+                of[c] = static_cast<float>(offset[c]);
+                g[c] = _mm512_set1_ps(gf[c]);
+                o[c] = _mm512_set1_ps(of[c]);
+            }
+            uint32 i = 0;
+            for (; i + 16 <= count; i += 16, src += 16 * stride)
+            {
+                __m512i v[8];
+                load16x8<LEFT>(src, stride, v);
+                for (int c = 0; c < 8; ++c)
+                {
+                    __m512 f = _mm512_maskz_cvtepi32_ps(ALL_LANES, v[c]);
+                    _mm512_storeu_ps(dst[c] + i, _mm512_add_ps(_mm512_mul_ps(f, g[c]), o[c]));
+                }
+            }
+            scaleTail24x8<LEFT>(src, stride, i, count, gf, of, dst);
+        }
+
+        template <bool LEFT>
+        void scaleX8F64(const uint32* src, uint32 stride, uint32 count,
+                        const double* gain, const double* offset, double* const* dst)
+        {
+            __m512d g[8];
+            __m512d o[8];
+            for (int c = 0; c < 8; ++c)
+            {
+                g[c] = _mm512_set1_pd(gain[c]);
+                o[c] = _mm512_set1_pd(offset[c]);
+            }
+            uint32 i = 0;
+            for (; i + 16 <= count; i += 16, src += 16 * stride)
+            {
+                __m512i v[8];
+                load16x8<LEFT>(src, stride, v);
+                for (int c = 0; c < 8; ++c)
+                {
+                    _mm512_storeu_pd(dst[c] + i, _mm512_add_pd(_mm512_mul_pd(cvtLower8(v[c], 0xff), g[c]), o[c]));
+                    _mm512_storeu_pd(dst[c] + i + 8, _mm512_add_pd(_mm512_mul_pd(cvtUpper8(v[c], 0xff), g[c]), o[c]));
+                }
+            }
+            scaleTail24x8<LEFT>(src, stride, i, count, gain, offset, dst);
+        }
+    }
+
+    const SampleKernels* sampleKernelsAvx512()
+    {
+        static const SampleKernels kernels = {
+            SIMD_LEVEL_AVX512,
+            &extractI32<false>,
+            &extractI32<true>,
+            &extractF32<false>,
+            &extractF32<true>,
+            &scaleF32<false>,
+            &scaleF32<true>,
+            &scaleF64<false>,
+            &scaleF64<true>,
+            &extractX8I32<false>,
+            &extractX8I32<true>,
+            &extractX8F32<false>,
+            &extractX8F32<true>,
+            &scaleX8F32<false>,
+            &scaleX8F32<true>,
+            &scaleX8F64<false>,
+            &scaleX8F64<true>
+        };
+        return &kernels;
+    }
+}
+
+#else
+
+namespace trion
+{
+    const SampleKernels* sampleKernelsAvx512()
+    {
+        return nullptr;
+    }
+}
+
+#endif
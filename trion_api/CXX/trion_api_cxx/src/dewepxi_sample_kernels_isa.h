@@ -0,0 +1,100 @@
+// Copyright DEWETRON 2024
+
+#pragma once
+
+#include "dewepxi_sample_kernels.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define DEWEPXI_SIMD_X86 1
+#endif
+
+
+namespace trion
+{
+    /**
+     * Scalar reference formulas, shared by all kernel tails.
+     * Left aligned samples are divided by 256 rounding toward zero,
+     * matching formatRawData(value, 24, 8).
+     */
+    static inline sint32 extractRight24(uint32 raw)
+    {
+        return static_cast<sint32>(raw << 8) >> 8;
+    }
+
+    static inline sint32 extractLeft24(uint32 raw)
+    {
+        sint32 value = static_cast<sint32>(raw);
+        return (value + ((value >> 31) & 0xff)) >> 8;
+    }
+
+    template <bool LEFT>
+    static inline sint32 extractScalar24(uint32 raw)
+    {
+        return LEFT ? extractLeft24(raw) : extractRight24(raw);
+    }
+
+    /**
+     * Scaled sample: raw * gain + offset, computed in the precision of T.
+     */
+    template <bool LEFT, typename T>
+    static inline T scaleScalar24(uint32 raw, T gain, T offset)
+    {
+        return static_cast<T>(extractScalar24<LEFT>(raw)) * gain + offset;
+    }
+
+    /**
+     * Strided single channel loops, used by the SIMD kernels for strides
+     * where vector loads would only hold one sample each.
+     */
+    template <bool LEFT, typename T>
+    static inline void convertStrided24(const uint32* src, uint32 stride, uint32 count, T* dst)
+    {
+        for (uint32 i = 0; i < count; ++i, src += stride)
+        {
+            dst[i] = static_cast<T>(extractScalar24<LEFT>(*src));
+        }
+    }
+
+    template <bool LEFT, typename T>
+    static inline void scaleStrided24(const uint32* src, uint32 stride, uint32 count, T gain, T offset, T* dst)
+    {
+        for (uint32 i = 0; i < count; ++i, src += stride)
+        {
+            dst[i] = scaleScalar24<LEFT>(*src, gain, offset);
+        }
+    }
+
+    /**
+     * Group kernel scans from scan begin on, src points to scan begin.
+     */
+    template <bool LEFT, typename T>
+    static inline void convertTail24x8(const uint32* src, uint32 stride, uint32 begin, uint32 count, T* const* dst)
+    {
+        for (uint32 i = begin; i < count; ++i, src += stride)
+        {
+            for (uint32 c = 0; c < SAMPLE24_GROUP; ++c)
+            {
+                dst[c][i] = static_cast<T>(extractScalar24<LEFT>(src[c]));
+            }
+        }
+    }
+
+    template <bool LEFT, typename T>
+    static inline void scaleTail24x8(const uint32* src, uint32 stride, uint32 begin, uint32 count,
+                                     const T* gain, const T* offset, T* const* dst)
+    {
+        for (uint32 i = begin; i < count; ++i, src += stride)
+        {
+            for (uint32 c = 0; c < SAMPLE24_GROUP; ++c)
+            {
+                dst[c][i] = scaleScalar24<LEFT>(src[c], gain[c], offset[c]);
+            }
+        }
+    }
+
+    // Kernel tables per instruction set, nullptr if not built in
+    const SampleKernels* sampleKernelsScalar();
+    const SampleKernels* sampleKernelsSse41();
+    const SampleKernels* sampleKernelsAvx2();
+    const SampleKernels* sampleKernelsAvx512();
+}
@@ -0,0 +1,250 @@
+// Copyright DEWETRON 2024
+// Compiled with SSE4.1 code generation enabled (see CMakeLists.txt)
+
+#include "dewepxi_sample_kernels_isa.h"
+
+#if defined(DEWEPXI_SIMD_X86)
+#include <smmintrin.h>
+
+
+namespace trion
+{
+    namespace
+    {
+        inline __m128i load4(const uint32* src, uint32 stride)
+        {
+            if (stride == 1)
+            {
+                return _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+            }
+            return _mm_setr_epi32(static_cast<int>(src[0]), static_cast<int>(src[stride]),
+                                  static_cast<int>(src[2 * stride]), static_cast<int>(src[3 * stride]));
+        }
+
+        template <bool LEFT>
+        inline __m128i extract24(__m128i v)
+        {
+            if (LEFT)
+            {
+                // round toward zero: add 255 to negative values before the shift
+                __m128i bias = _mm_and_si128(_mm_srai_epi32(v, 31), _mm_set1_epi32(0xff));
+                return _mm_srai_epi32(_mm_add_epi32(v, bias), 8);
+            }
+            return _mm_srai_epi32(_mm_slli_epi32(v, 8), 8);
+        }
+
+        /**
+         * Load 4 scans of 8 adjacent channels and transpose them:
+         * v[c] holds channel c of the 4 scans.
+         */
+        template <bool LEFT>
+        inline void load4x8(const uint32* src, uint32 stride, __m128i v[8])
+        {
+            for (int half = 0; half < 8; half += 4)
+            {
+                __m128i r[4];
+                for (int k = 0; k < 4; ++k)
+                {
+                    r[k] = extract24<LEFT>(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + k * stride + half)));
+                }
+                __m128i lo0 = _mm_unpacklo_epi32(r[0], r[1]);
+                __m128i lo1 = _mm_unpacklo_epi32(r[2], r[3]);
+                __m128i hi0 = _mm_unpackhi_epi32(r[0], r[1]);
+                __m128i hi1 = _mm_unpackhi_epi32(r[2], r[3]);
+                v[half] = _mm_unpacklo_epi64(lo0, lo1);
+                v[half + 1] = _mm_unpackhi_epi64(lo0, lo1);
+                v[half + 2] = _mm_unpacklo_epi64(hi0, hi1);
+                v[half + 3] = _mm_unpackhi_epi64(hi0, hi1);
+            }
+        }
+
+        template <bool LEFT>
+        void extractI32(const uint32* src, uint32 stride, uint32 count, sint32* dst)
+        {
+            uint32 i = 0;
+            for (; i + 4 <= count; i += 4, src += 4 * stride)
+            {
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), extract24<LEFT>(load4(src, stride)));
+            }
+            for (; i < count; ++i, src += stride)
+            {
+                dst[i] = extractScalar24<LEFT>(*src);
+            }
+        }
+
+        template <bool LEFT>
+        void extractF32(const uint32* src, uint32 stride, uint32 count, float* dst)
+        {
+            uint32 i = 0;
+            for (; i + 4 <= count; i += 4, src += 4 * stride)
+            {
+                _mm_storeu_ps(dst + i, _mm_cvtepi32_ps(extract24<LEFT>(load4(src, stride))));
+            }
+            for (; i < count; ++i, src += stride)
+            {
+                dst[i] = static_cast<float>(extractScalar24<LEFT>(*src));
+            }
+        }
+
+        template <bool LEFT>
+        void scaleF32(const uint32* src, uint32 stride, uint32 count, double gain, double offset, float* dst)
+        {
+            const __m128 g = _mm_set1_ps(static_cast<float>(gain));
+            const __m128 o = _mm_set1_ps(static_cast<float>(offset));
+            uint32 i = 0;
+            for (; i + 4 <= count; i += 4, src += 4 * stride)
+            {
+                __m128 v = _mm_cvtepi32_ps(extract24<LEFT>(load4(src, stride)));
+                _mm_storeu_ps(dst + i, _mm_add_ps(_mm_mul_ps(v, g), o));
+            }
+            for (; i < count; ++i, src += stride)
+            {
+                dst[i] = scaleScalar24<LEFT>(*src, static_cast<float>(gain), static_cast<float>(offset));
+            }
+        }
+
+        template <bool LEFT>
+        void scaleF64(const uint32* src, uint32 stride, uint32 count, double gain, double offset, double* dst)
+        {
+            const __m128d g = _mm_set1_pd(gain);
+            const __m128d o = _mm_set1_pd(offset);
+            uint32 i = 0;
+            for (; i + 4 <= count; i += 4, src += 4 * stride)
+            {
+                __m128i v = extract24<LEFT>(load4(src, stride));
+                __m128d lo = _mm_cvtepi32_pd(v);
+                __m128d hi = _mm_cvtepi32_pd(_mm_unpackhi_epi64(v, v));
+                _mm_storeu_pd(dst + i, _mm_add_pd(_mm_mul_pd(lo, g), o));
+                _mm_storeu_pd(dst + i + 2, _mm_add_pd(_mm_mul_pd(hi, g), o));
+            }
+            for (; i < count; ++i, src += stride)
+            {
+                dst[i] = scaleScalar24<LEFT>(*src, gain, offset);
+            }
+        }
+
+        // Group kernels: 4 scans per iteration, transposed in registers
+        template <bool LEFT>
+        void extractX8I32(const uint32* src, uint32 stride, uint32 count, sint32* const* dst)
+        {
+            uint32 i = 0;
+            for (; i + 4 <= count; i += 4, src += 4 * stride)
+            {
+                __m128i v[8];
+                load4x8<LEFT>(src, stride, v);
+                for (int c = 0; c < 8; ++c)
+                {
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst[c] + i), v[c]);
+                }
+            }
+            convertTail24x8<LEFT>(src, stride, i, count, dst);
+        }
+
+        template <bool LEFT>
+        void extractX8F32(const uint32* src, uint32 stride, uint32 count, float* const* dst)
+        {
+            uint32 i = 0;
+            for (; i + 4 <= count; i += 4, src += 4 * stride)
+            {
+                __m128i v[8];
+                load4x8<LEFT>(src, stride, v);
+                for (int c = 0; c < 8; ++c)
+                {
+                    _mm_storeu_ps(dst[c] + i, _mm_cvtepi32_ps(v[c]));
+                }
+            }
+            convertTail24x8<LEFT>(src, stride, i, count, dst);
+        }
+
+        template <bool LEFT>
+        void scaleX8F32(const uint32* src, uint32 stride, uint32 count,
+                        const double* gain, const double* offset, float* const* dst)
+        {
+            float gf[8];
+            float of[8];
+            __m128 g[8];
+            __m128 o[8];
+            for (int c = 0; c < 8; ++c)
+            {
+                gf[c] = static_cast<float>(gain[c]);
+                of[c] = static_cast<float>(offset[c]);
+                g[c] = _mm_set1_ps(gf[c]);
+                o[c] = _mm_set1_ps(of[c]);
+            }
+            uint32 i = 0;
+            for (; i + 4 <= count; i += 4, src += 4 * stride)
+            {
+                __m128i v[8];
+                load4x8<LEFT>(src, stride, v);
+                for (int c = 0; c < 8; ++c)
+                {
+                    _mm_storeu_ps(dst[c] + i, _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(v[c]), g[c]), o[c]));
+                }
+            }
+            scaleTail24x8<LEFT>(src, stride, i, count, gf, of, dst);
+        }
+
+        template <bool LEFT>
+        void scaleX8F64(const uint32* src, uint32 stride, uint32 count,
+                        const double* gain, const double* offset, double* const* dst)
+        {
+            __m128d g[8];
+            __m128d o[8];
+            for (int c = 0; c < 8; ++c)
+            {
+                g[c] = _mm_set1_pd(gain[c]);
+                o[c] = _mm_set1_pd(offset[c]);
+            }
+            uint32 i = 0;
+            for (; i + 4 <= count; i += 4, src += 4 * stride)
+            {
+                __m128i v[8];
+                load4x8<LEFT>(src, stride, v);
+                for (int c = 0; c < 8; ++c)
+                {
+                    __m128d lo = _mm_cvtepi32_pd(v[c]);
+                    __m128d hi = _mm_cvtepi32_pd(_mm_unpackhi_epi64(v[c], v[c]));
+                    _mm_storeu_pd(dst[c] + i, _mm_add_pd(_mm_mul_pd(lo, g[c]), o[c]));
+                    _mm_storeu_pd(dst[c] + i + 2, _mm_add_pd(_mm_mul_pd(hi, g[c]), o[c]));
+                }
+            }
+            scaleTail24x8<LEFT>(src, stride, i, count, gain, offset, dst);
+        }
+    }
+
+    const SampleKernels* sampleKernelsSse41()
+    {
+        static const SampleKernels kernels = {
+            SIMD_LEVEL_SSE41,
+            &extractI32<false>,
+            &extractI32<true>,
+            &extractF32<false>,
+            &extractF32<true>,
+            &scaleF32<false>,
+            &scaleF32<true>,
+            &scaleF64<false>,
+            &scaleF64<true>,
+            &extractX8I32<false>,
+            &extractX8I32<true>,
+            &extractX8F32<false>,
+            &extractX8F32<true>,
+            &scaleX8F32<false>,
+            &scaleX8F32<true>,
+            &scaleX8F64<false>,
+            &scaleX8F64<true>
+        };
+        return &kernels;
+    }
+}
+
+#else
+
+namespace trion
+{
+    const SampleKernels* sampleKernelsSse41()
+    {
+        return nullptr;
+    }
+}
+
+#endif
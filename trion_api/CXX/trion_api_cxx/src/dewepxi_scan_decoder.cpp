@@ -0,0 +1,519 @@
+// Copyright DEWETRON 2024
+
+#include "dewepxi_scan_decoder.h"
+#include "dewepxi_sample_kernels.h"
+#include "dewepxi_sample_kernels_isa.h"
+#include "pugixml.hpp"
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+
+namespace trion
+{
+    namespace
+    {
+        /**
+         * Number of scans decoded per channel before switching to the
+         * next channel. Keeps the source scans cache resident while all
+         * channels are extracted.
+         */
+        const uint32 DECODE_TILE_SCANS = 256;
+
+        ChannelType toChannelType(const std::string& type)
+        {
+            if (type == "Analog") return CHANNEL_TYPE_ANALOG;
+            if (type == "Counter") return CHANNEL_TYPE_COUNTER;
+            if (type == "Discrete") return CHANNEL_TYPE_DISCRETE;
+            return CHANNEL_TYPE_OTHER;
+        }
+
+        /**
+         * Extract SIZE bits at bit position SHIFT of a container value.
+         * Signed samples are sign extended by the MSB of the sample.
+         * Signed left aligned 24 bit samples round toward zero like the
+         * SIMD kernels, independent of the scan size.
+         */
+        template <int SHIFT, int SIZE, bool SIGNED>
+        inline sint32 extractBits(uint32 raw)
+        {
+            if (SIGNED && SHIFT == 8 && SIZE == 24)
+            {
+                return extractLeft24(raw);
+            }
+            else if (SIGNED)
+            {
+                return static_cast<sint32>(raw << (32 - SHIFT - SIZE)) >> (32 - SIZE);
+            }
+            else
+            {
+                return static_cast<sint32>((raw >> SHIFT) & (0xffffffffu >> (32 - SIZE)));
+            }
+        }
+
+        template <typename CONTAINER, int SHIFT, int SIZE, bool SIGNED>
+        void extractFixed(const uint8* src, uint32 stride, uint32 nr_scans, sint32* dst, uint32, uint32)
+        {
+            for (uint32 i = 0; i < nr_scans; ++i)
+            {
+                CONTAINER raw;
+                std::memcpy(&raw, src, sizeof(raw));
+                dst[i] = extractBits<SHIFT, SIZE, SIGNED>(raw);
+                src += stride;
+            }
+        }
+
+        template <typename CONTAINER, bool SIGNED>
+        void extractGeneric(const uint8* src, uint32 stride, uint32 nr_scans, sint32* dst,
+                            uint32 bit_shift, uint32 bit_size)
+        {
+            const uint32 left = 32 - bit_shift - bit_size;
+            const uint32 right = 32 - bit_size;
+
+            for (uint32 i = 0; i < nr_scans; ++i)
+            {
+                CONTAINER raw;
+                std::memcpy(&raw, src, sizeof(raw));
+                uint32 value = static_cast<uint32>(raw) << left;
+                dst[i] = SIGNED ? (static_cast<sint32>(value) >> right)
+                                : static_cast<sint32>(value >> right);
+                src += stride;
+            }
+        }
+
+        /**
+         * 24 bit analog samples in 32 bit scan words,
+         * using the runtime selected SIMD kernel.
+         */
+        void extractSimdRight24(const uint8* src, uint32 stride, uint32 nr_scans, sint32* dst, uint32, uint32)
+        {
+            sampleKernels().right_i32(reinterpret_cast<const uint32*>(src), stride / 4, nr_scans, dst);
+        }
+
+        void extractSimdLeft24(const uint8* src, uint32 stride, uint32 nr_scans, sint32* dst, uint32, uint32)
+        {
+            sampleKernels().left_i32(reinterpret_cast<const uint32*>(src), stride / 4, nr_scans, dst);
+        }
+
+        /**
+         * Select the extraction kernel for a sample.
+         * Common TRION layouts get a kernel with compile time shifts,
+         * everything else is handled by the generic kernel.
+         */
+        ExtractKernel selectKernel(uint32 container_bytes, uint32 bit_shift, uint32 bit_size, bool is_signed,
+                                   uint32 scan_size_bytes)
+        {
+            // The SIMD kernels read whole 32 bit scan words, the fixed
+            // kernels decode the same values from any scan size
+            if (container_bytes == 4)
+            {
+                if (bit_shift == 0 && bit_size == 24 && is_signed && (scan_size_bytes % 4) == 0) return &extractSimdRight24;
+                if (bit_shift == 8 && bit_size == 24 && is_signed && (scan_size_bytes % 4) == 0) return &extractSimdLeft24;
+                if (bit_shift == 0 && bit_size == 24) return is_signed ? &extractFixed<uint32, 0, 24, true> : &extractFixed<uint32, 0, 24, false>;
+                if (bit_shift == 8 && bit_size == 24) return is_signed ? &extractFixed<uint32, 8, 24, true> : &extractFixed<uint32, 8, 24, false>;
+                if (bit_shift == 0 && bit_size == 32) return is_signed ? &extractFixed<uint32, 0, 32, true> : &extractFixed<uint32, 0, 32, false>;
+                if (bit_shift == 0 && bit_size == 16) return is_signed ? &extractFixed<uint32, 0, 16, true> : &extractFixed<uint32, 0, 16, false>;
+                if (bit_shift == 16 && bit_size == 16) return is_signed ? &extractFixed<uint32, 16, 16, true> : &extractFixed<uint32, 16, 16, false>;
+                return is_signed ? &extractGeneric<uint32, true> : &extractGeneric<uint32, false>;
+            }
+
+            if (bit_shift == 0 && bit_size == 16) return is_signed ? &extractFixed<uint16, 0, 16, true> : &extractFixed<uint16, 0, 16, false>;
+            return is_signed ? &extractGeneric<uint16, true> : &extractGeneric<uint16, false>;
+        }
+    }
+
+
+    ScanDescriptor::ScanDescriptor(const std::string& sd_xml)
+        : m_xml(sd_xml)
+        , m_scan_size_bytes(0)
+    {
+        pugi::xml_document sd_doc;
+        if (pugi::status_ok != sd_doc.load_string(sd_xml.c_str()).status)
+        {
+            throw std::runtime_error("ScanDescriptor parse error");
+        }
+
+        auto scan_description_node = sd_doc.select_node("ScanDescriptor/*/ScanDescription").node();
+        if (!scan_description_node)
+        {
+            throw std::runtime_error("ScanDescriptor unexpected element");
+        }
+
+        if (3 != scan_description_node.attribute("version").as_int())
+        {
+            throw std::runtime_error("Unsupported version");
+        }
+
+        m_board_target = scan_description_node.parent().name();
+        m_scan_size_bytes = scan_description_node.attribute("scan_size").as_uint() / 8;
+
+        for (auto channel = scan_description_node.child("Channel"); channel; channel = channel.next_sibling("Channel"))
+        {
+            for (auto sample = channel.child("Sample"); sample; sample = sample.next_sibling("Sample"))
+            {
+                ScanChannel sc;
+                sc.name = channel.attribute("name").as_string();
+                sc.type = channel.attribute("type").as_string();
+                sc.channel_type = toChannelType(sc.type);
+                sc.index = channel.attribute("index").as_uint();
+                sc.sample_size = sample.attribute("size").as_uint();
+                sc.sample_offset = sample.attribute("offset").as_uint();
+                sc.sub_channel = sample.attribute("subChannel").as_int(-1);
+                m_channels.push_back(sc);
+            }
+        }
+    }
+
+    int ScanDescriptor::findChannel(const std::string& name) const
+    {
+        for (size_t i = 0; i < m_channels.size(); ++i)
+        {
+            if (m_channels[i].name == name)
+            {
+                return static_cast<int>(i);
+            }
+        }
+        return -1;
+    }
+
+
+    int readChannelScaling(const std::string& target, ChannelScaling& scaling)
+    {
+        char buffer[64] = { 0 };
+        double scalevalue = 1.0;
+        double scaleoffset = 0.0;
+
+        auto err = DeWeGetParamStruct_str(target.c_str(), "scalevalue", buffer, sizeof(buffer));
+        if (err > 0) return err;
+        sscanf(buffer, "%lf", &scalevalue);
+
+        err = DeWeGetParamStruct_str(target.c_str(), "scaleoffset", buffer, sizeof(buffer));
+        if (err > 0) return err;
+        sscanf(buffer, "%lf", &scaleoffset);
+
+        scaling.gain = scalevalue;
+        scaling.offset = -scaleoffset;
+        return err;
+    }
+
+
+    ScanDecoder::ScanDecoder(const ScanDescriptor& sd)
+        : m_board_target(sd.boardTarget())
+        , m_scan_size_bytes(sd.scanSize())
+        , m_channels(sd.channels())
+    {
+        compile();
+    }
+
+    ScanDecoder::ScanDecoder(const std::string& sd_xml)
+        : m_scan_size_bytes(0)
+    {
+        ScanDescriptor sd(sd_xml);
+        m_board_target = sd.boardTarget();
+        m_scan_size_bytes = sd.scanSize();
+        m_channels = sd.channels();
+        compile();
+    }
+
+    void ScanDecoder::compile()
+    {
+        const ChannelScaling unity = { 1.0, 0.0 };
+
+        m_plan.clear();
+        m_plan.reserve(m_channels.size());
+        m_scaling.assign(m_channels.size(), unity);
+
+        for (const auto& sc : m_channels)
+        {
+            if (sc.sample_size == 0 || sc.sample_size > 32)
+            {
+                throw std::runtime_error("Unsupported sample size");
+            }
+
+            // Smallest naturally aligned container holding the whole sample
+            uint32 container_bytes = 2;
+            if (sc.sample_size > 16 || (sc.sample_offset % 16) + sc.sample_size > 16)
+            {
+                container_bytes = 4;
+            }
+            if ((sc.sample_offset % 32) + sc.sample_size > 32)
+            {
+                throw std::runtime_error("Unsupported sample alignment");
+            }
+
+            const uint32 container_bits = container_bytes * 8;
+
+            DecodeStep step;
+            step.byte_offset = (sc.sample_offset / container_bits) * container_bytes;
+            step.bit_shift = sc.sample_offset % container_bits;
+            step.bit_size = sc.sample_size;
+            step.is_signed = sc.channel_type == CHANNEL_TYPE_ANALOG;
+            step.simd24 = SIMD24_NONE;
+            step.group = 0;
+            if (step.is_signed && container_bytes == 4 && step.bit_size == 24 && (m_scan_size_bytes % 4) == 0)
+            {
+                if (step.bit_shift == 0) step.simd24 = SIMD24_RIGHT;
+                if (step.bit_shift == 8) step.simd24 = SIMD24_LEFT;
+            }
+            step.kernel = selectKernel(container_bytes, step.bit_shift, step.bit_size,
+                                       step.is_signed, m_scan_size_bytes);
+
+            if (step.byte_offset + container_bytes > m_scan_size_bytes)
+            {
+                throw std::runtime_error("Sample exceeds scan size");
+            }
+
+            m_plan.push_back(step);
+        }
+
+        // Runs of SIMD channels in adjacent scan words form groups
+        for (size_t first = 0; first + SAMPLE24_GROUP <= m_plan.size(); )
+        {
+            uint32 run = 0;
+            while (run < SAMPLE24_GROUP
+                && m_plan[first + run].simd24 != SIMD24_NONE
+                && m_plan[first + run].simd24 == m_plan[first].simd24
+                && m_plan[first + run].byte_offset == m_plan[first].byte_offset + 4 * run)
+            {
+                ++run;
+            }
+            if (run == SAMPLE24_GROUP)
+            {
+                m_plan[first].group = SAMPLE24_GROUP;
+                first += SAMPLE24_GROUP;
+            }
+            else
+            {
+                ++first;
+            }
+        }
+    }
+
+    int ScanDecoder::findChannel(const std::string& name) const
+    {
+        for (size_t i = 0; i < m_channels.size(); ++i)
+        {
+            if (m_channels[i].name == name)
+            {
+                return static_cast<int>(i);
+            }
+        }
+        return -1;
+    }
+
+    uint32 ScanDecoder::decode(const ScanSpan& span, DecodedBlock& block, uint32 dst_offset) const
+    {
+        if (dst_offset >= block.capacity() || block.numChannels() < m_plan.size())
+        {
+            return 0;
+        }
+
+        uint32 scans = span.scans;
+        if (scans > block.capacity() - dst_offset)
+        {
+            scans = block.capacity() - dst_offset;
+        }
+
+        for (uint32 tile = 0; tile < scans; tile += DECODE_TILE_SCANS)
+        {
+            uint32 tile_scans = scans - tile;
+            if (tile_scans > DECODE_TILE_SCANS)
+            {
+                tile_scans = DECODE_TILE_SCANS;
+            }
+
+            const uint8* tile_src = span.data + static_cast<size_t>(tile) * m_scan_size_bytes;
+
+            for (size_t chn = 0; chn < m_plan.size(); ++chn)
+            {
+                const DecodeStep& step = m_plan[chn];
+                if (step.group)
+                {
+                    sint32* dst[SAMPLE24_GROUP];
+                    for (uint32 c = 0; c < SAMPLE24_GROUP; ++c)
+                    {
+                        dst[c] = block.channel(static_cast<uint32>(chn + c)) + dst_offset + tile;
+                    }
+                    extract24x8(reinterpret_cast<const uint32*>(tile_src + step.byte_offset), m_scan_size_bytes / 4, tile_scans,
+                                step.simd24 == SIMD24_LEFT ? SAMPLE24_LEFT_ALIGNED : SAMPLE24_RIGHT_ALIGNED, dst);
+                    chn += SAMPLE24_GROUP - 1;
+                    continue;
+                }
+                step.kernel(tile_src + step.byte_offset, m_scan_size_bytes, tile_scans,
+                            block.channel(static_cast<uint32>(chn)) + dst_offset + tile,
+                            step.bit_shift, step.bit_size);
+            }
+        }
+
+        return scans;
+    }
+
+    uint32 ScanDecoder::decode(const ScanSpans& spans, DecodedBlock& block) const
+    {
+        uint32 scans = 0;
+        for (uint32 i = 0; i < spans.count; ++i)
+        {
+            scans += decode(spans.span[i], block, scans);
+        }
+        block.setScans(scans);
+        return scans;
+    }
+
+    uint32 ScanDecoder::decodeChannel(uint32 channel_index, const ScanSpan& span, sint32* dst) const
+    {
+        if (channel_index >= m_plan.size())
+        {
+            return 0;
+        }
+        const DecodeStep& step = m_plan[channel_index];
+        step.kernel(span.data + step.byte_offset, m_scan_size_bytes, span.scans, dst, step.bit_shift, step.bit_size);
+        return span.scans;
+    }
+
+    int ScanDecoder::readScaling()
+    {
+        int err = ERR_NONE;
+        for (size_t i = 0; i < m_channels.size(); ++i)
+        {
+            if (m_channels[i].channel_type != CHANNEL_TYPE_ANALOG)
+            {
+                continue;
+            }
+
+            err = readChannelScaling(m_board_target + "/" + m_channels[i].name, m_scaling[i]);
+            if (err > 0)
+            {
+                return err;
+            }
+        }
+        return err;
+    }
+
+    void ScanDecoder::setScaling(uint32 channel_index, const ChannelScaling& scaling)
+    {
+        m_scaling[channel_index] = scaling;
+    }
+
+    namespace
+    {
+        inline void scaleFused(const uint8* src, uint32 stride, uint32 count, bool left, const ChannelScaling& s, float* dst)
+        {
+            const SampleKernels& kernels = sampleKernels();
+            (left ? kernels.left_scaled_f32 : kernels.right_scaled_f32)(
+                reinterpret_cast<const uint32*>(src), stride / 4, count, s.gain, s.offset, dst);
+        }
+
+        inline void scaleFused(const uint8* src, uint32 stride, uint32 count, bool left, const ChannelScaling& s, double* dst)
+        {
+            const SampleKernels& kernels = sampleKernels();
+            (left ? kernels.left_scaled_f64 : kernels.right_scaled_f64)(
+                reinterpret_cast<const uint32*>(src), stride / 4, count, s.gain, s.offset, dst);
+        }
+    }
+
+    template <typename T>
+    uint32 ScanDecoder::decodeScaled(const ScanSpan& span, SampleBlock<T>& block, uint32 dst_offset) const
+    {
+        if (dst_offset >= block.capacity() || block.numChannels() < m_plan.size())
+        {
+            return 0;
+        }
+
+        uint32 scans = span.scans;
+        if (scans > block.capacity() - dst_offset)
+        {
+            scans = block.capacity() - dst_offset;
+        }
+
+        sint32 raw[DECODE_TILE_SCANS];
+
+        for (uint32 tile = 0; tile < scans; tile += DECODE_TILE_SCANS)
+        {
+            uint32 tile_scans = scans - tile;
+            if (tile_scans > DECODE_TILE_SCANS)
+            {
+                tile_scans = DECODE_TILE_SCANS;
+            }
+
+            const uint8* tile_src = span.data + static_cast<size_t>(tile) * m_scan_size_bytes;
+
+            for (size_t chn = 0; chn < m_plan.size(); ++chn)
+            {
+                const DecodeStep& step = m_plan[chn];
+                const ChannelScaling& scaling = m_scaling[chn];
+                T* dst = block.channel(static_cast<uint32>(chn)) + dst_offset + tile;
+
+                if (step.group)
+                {
+                    double gain[SAMPLE24_GROUP];
+                    double offset[SAMPLE24_GROUP];
+                    T* group_dst[SAMPLE24_GROUP];
+                    for (uint32 c = 0; c < SAMPLE24_GROUP; ++c)
+                    {
+                        gain[c] = m_scaling[chn + c].gain;
+                        offset[c] = m_scaling[chn + c].offset;
+                        group_dst[c] = block.channel(static_cast<uint32>(chn + c)) + dst_offset + tile;
+                    }
+                    scale24x8(reinterpret_cast<const uint32*>(tile_src + step.byte_offset), m_scan_size_bytes / 4, tile_scans,
+                              step.simd24 == SIMD24_LEFT ? SAMPLE24_LEFT_ALIGNED : SAMPLE24_RIGHT_ALIGNED,
+                              gain, offset, group_dst);
+                    chn += SAMPLE24_GROUP - 1;
+                    continue;
+                }
+                if (step.simd24 != SIMD24_NONE)
+                {
+                    scaleFused(tile_src + step.byte_offset, m_scan_size_bytes, tile_scans,
+                               step.simd24 == SIMD24_LEFT, scaling, dst);
+                    continue;
+                }
+
+                // Other layouts: extract to a cache resident tile, then scale
+                step.kernel(tile_src + step.byte_offset, m_scan_size_bytes, tile_scans, raw,
+                            step.bit_shift, step.bit_size);
+
+                const T gain = static_cast<T>(scaling.gain);
+                const T offset = static_cast<T>(scaling.offset);
+                for (uint32 i = 0; i < tile_scans; ++i)
+                {
+                    T value = step.is_signed ? static_cast<T>(raw[i])
+                                             : static_cast<T>(static_cast<uint32>(raw[i]));
+                    dst[i] = value * gain + offset;
+                }
+            }
+        }
+
+        return scans;
+    }
+
+    uint32 ScanDecoder::decode(const ScanSpan& span, ScaledBlockF32& block, uint32 dst_offset) const
+    {
+        return decodeScaled(span, block, dst_offset);
+    }
+
+    uint32 ScanDecoder::decode(const ScanSpan& span, ScaledBlockF64& block, uint32 dst_offset) const
+    {
+        return decodeScaled(span, block, dst_offset);
+    }
+
+    uint32 ScanDecoder::decode(const ScanSpans& spans, ScaledBlockF32& block) const
+    {
+        uint32 scans = 0;
+        for (uint32 i = 0; i < spans.count; ++i)
+        {
+            scans += decodeScaled(spans.span[i], block, scans);
+        }
+        block.setScans(scans);
+        return scans;
+    }
+
+    uint32 ScanDecoder::decode(const ScanSpans& spans, ScaledBlockF64& block) const
+    {
+        uint32 scans = 0;
+        for (uint32 i = 0; i < spans.count; ++i)
+        {
+            scans += decodeScaled(spans.span[i], block, scans);
+        }
+        block.setScans(scans);
+        return scans;
+    }
+}
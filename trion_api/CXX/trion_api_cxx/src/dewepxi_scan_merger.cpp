@@ -0,0 +1,274 @@
+// Copyright DEWETRON 2024
+
+#include "dewepxi_scan_merger.h"
+#include <cstring>
+
+
+namespace trion
+{
+    ScanMerger::ScanMerger(AcquisitionEngine& engine)
+        : m_engine(engine)
+        , m_aligned(false)
+        , m_frame0_counter(0)
+        , m_next_frame(0)
+        , m_misalignments(0)
+        , m_lost_frames(0)
+    {
+    }
+
+    int ScanMerger::addBoard(uint32 board_index, uint32 consumer, const ScanDescriptor& sd)
+    {
+        int index = sd.findChannel("BoardCnt0");
+        if (index < 0)
+        {
+            return ERR_BOARDCNT_CHANNEL_NOT_VALID;
+        }
+
+        sint32 adc_delay = 0;
+        int err = DeWeGetParam_i32(m_engine.ring(board_index).boardId(), CMD_BOARD_ADC_DELAY, &adc_delay);
+        if (err > 0)
+        {
+            return err;
+        }
+
+        addBoard(board_index, consumer, sd.channels()[index].sample_offset / 8,
+                 adc_delay > 0 ? static_cast<uint32>(adc_delay) : 0);
+        return err;
+    }
+
+    void ScanMerger::addBoard(uint32 board_index, uint32 consumer, uint32 counter_offset, uint32 adc_delay)
+    {
+        Board board = Board();
+        board.board_index = board_index;
+        board.consumer = consumer;
+        board.counter_offset = counter_offset;
+        board.adc_delay = adc_delay;
+        m_boards.push_back(board);
+    }
+
+    bool ScanMerger::receive(Board& board, uint32 timeout_ms, int& error)
+    {
+        BlockDescriptor block;
+        bool received = false;
+
+        while ((timeout_ms > 0 && !received)
+            ? m_engine.waitPop(board.consumer, block, timeout_ms)
+            : m_engine.pop(board.consumer, block))
+        {
+            received = true;
+            if (block.error > 0)
+            {
+                error = block.error;
+                return true;
+            }
+            if (block.flags & BLOCK_FLAG_DATA_LOST)
+            {
+                // The scans before are overwritten, restart with the next block
+                board.started = false;
+                continue;
+            }
+            if (block.scans == 0)
+            {
+                continue;
+            }
+
+            if (!board.started)
+            {
+                board.started = true;
+                board.start_scan = block.first_scan;
+                board.base_scan = block.first_scan;
+                board.base_pos = reinterpret_cast<sint64>(block.spans.span[0].data);
+                board.first_counter = counterAt(board, block.first_scan);
+                if (m_aligned)
+                {
+                    realign(board);
+                }
+            }
+            board.available_end = block.first_scan + block.scans;
+            board.last = block;
+        }
+        return received;
+    }
+
+    void ScanMerger::align()
+    {
+        // The board that started last defines frame 0
+        sint32 latest = 0;
+        for (const Board& board : m_boards)
+        {
+            sint32 offset = static_cast<sint32>(board.first_counter - m_boards[0].first_counter);
+            if (offset > latest)
+            {
+                latest = offset;
+            }
+        }
+
+        m_frame0_counter = m_boards[0].first_counter + static_cast<uint32>(latest);
+        for (Board& board : m_boards)
+        {
+            sint32 offset = static_cast<sint32>(board.first_counter - m_boards[0].first_counter);
+            board.skip = board.base_scan + static_cast<uint64>(latest - offset);
+            board.scan_offset = static_cast<sint64>(board.skip);
+        }
+        m_aligned = true;
+    }
+
+    void ScanMerger::realign(Board& board)
+    {
+        // The counter gives the frame of the first scan after the overrun
+        const sint64 frame = static_cast<sint32>(board.first_counter - m_frame0_counter);
+        board.scan_offset = static_cast<sint64>(board.start_scan) - frame;
+
+        // Frames not received by this board are skipped on all boards
+        if (frame > static_cast<sint64>(m_next_frame))
+        {
+            m_lost_frames += static_cast<uint64>(frame) - m_next_frame;
+            m_next_frame = static_cast<uint64>(frame);
+        }
+    }
+
+    uint64 ScanMerger::scanOf(const Board& board, uint64 frame) const
+    {
+        return static_cast<uint64>(static_cast<sint64>(frame) + board.scan_offset);
+    }
+
+    sint64 ScanMerger::position(const Board& board, uint64 scan) const
+    {
+        return m_engine.ring(board.board_index).advance(board.base_pos, static_cast<uint32>(scan - board.base_scan));
+    }
+
+    uint32 ScanMerger::counterAt(const Board& board, uint64 scan) const
+    {
+        uint32 counter;
+        std::memcpy(&counter, reinterpret_cast<const void*>(position(board, scan) + board.counter_offset), sizeof(counter));
+        return counter;
+    }
+
+    bool ScanMerger::next(MergedFrame& frame, uint32 max_frames, uint32 timeout_ms)
+    {
+        frame.error = ERR_NONE;
+        frame.first_frame = m_next_frame;
+        frame.frames = 0;
+        frame.boards.resize(m_boards.size());
+
+        if (m_boards.empty())
+        {
+            return false;
+        }
+
+        for (;;)
+        {
+            // Frames available on all boards, analog samples arrive adc_delay scans later
+            uint64 available = ~0ull;
+            Board* slowest = nullptr;
+            for (Board& board : m_boards)
+            {
+                int error = ERR_NONE;
+                receive(board, 0, error);
+                if (error > 0)
+                {
+                    frame.error = error;
+                    return true;
+                }
+
+                uint64 frames = 0;
+                if (board.started && m_aligned)
+                {
+                    const sint64 end = static_cast<sint64>(board.available_end - board.adc_delay) - board.scan_offset;
+                    if (board.available_end >= board.adc_delay && end > 0)
+                    {
+                        frames = static_cast<uint64>(end);
+                    }
+                }
+                if (!board.started || frames < available)
+                {
+                    available = board.started ? frames : 0;
+                    slowest = &board;
+                }
+            }
+
+            if (!m_aligned)
+            {
+                bool all_started = true;
+                for (const Board& board : m_boards)
+                {
+                    all_started = all_started && board.started;
+                }
+                if (all_started)
+                {
+                    align();
+                    continue;
+                }
+            }
+
+            if (m_aligned && available > m_next_frame)
+            {
+                uint64 frames = available - m_next_frame;
+                frame.frames = static_cast<uint32>(frames < max_frames ? frames : max_frames);
+                break;
+            }
+
+            // Wait for the slowest board
+            int error = ERR_NONE;
+            if (!receive(*slowest, timeout_ms, error))
+            {
+                return false;
+            }
+            if (error > 0)
+            {
+                frame.error = error;
+                return true;
+            }
+        }
+
+        for (uint32 i = 0; i < m_boards.size(); ++i)
+        {
+            const Board& board = m_boards[i];
+            const RingBufferView& ring = m_engine.ring(board.board_index);
+            const uint64 scan = scanOf(board, m_next_frame);
+
+            MergedBoard& merged = frame.boards[i];
+            merged.board_index = board.board_index;
+            merged.first_scan = scan;
+            merged.spans = ring.spansAt(position(board, scan), frame.frames);
+            merged.analog_spans = ring.spansAt(position(board, scan + board.adc_delay), frame.frames);
+
+            // The counter advances by one per scan
+            const uint32 expected = board.first_counter + static_cast<uint32>(scan - board.start_scan);
+            if (counterAt(board, scan) != expected)
+            {
+                ++m_misalignments;
+            }
+        }
+
+        m_next_frame += frame.frames;
+        return true;
+    }
+
+    void ScanMerger::release(const MergedFrame& frame)
+    {
+        if (frame.frames == 0)
+        {
+            return;
+        }
+
+        const uint64 frame_end = frame.first_frame + frame.frames;
+        for (Board& board : m_boards)
+        {
+            // Analog samples of later frames are behind the released scans
+            const uint64 release_end = scanOf(board, frame_end);
+            if (release_end <= board.base_scan)
+            {
+                continue;
+            }
+
+            BlockDescriptor block = board.last;
+            block.first_scan = board.base_scan;
+            block.scans = static_cast<uint32>(release_end - board.base_scan);
+            m_engine.release(block);
+
+            board.base_pos = position(board, release_end);
+            board.base_scan = release_end;
+        }
+    }
+}
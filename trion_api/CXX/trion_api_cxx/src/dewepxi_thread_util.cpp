@@ -0,0 +1,120 @@
+// Copyright DEWETRON 2024
+
+#include "dewepxi_thread_util.h"
+#include <cstdlib>
+#include <thread>
+
+#if defined(_WIN32)
+#include <malloc.h>
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#endif
+
+
+namespace trion
+{
+    uint32 numCpus()
+    {
+        uint32 cpus = std::thread::hardware_concurrency();
+        return cpus > 0 ? cpus : 1;
+    }
+
+    void* allocateAligned(size_t size, size_t alignment)
+    {
+#if defined(_WIN32)
+        return _aligned_malloc(size, alignment);
+#else
+        void* memory = nullptr;
+        return posix_memalign(&memory, alignment, size) == 0 ? memory : nullptr;
+#endif
+    }
+
+    void freeAligned(void* memory)
+    {
+#if defined(_WIN32)
+        _aligned_free(memory);
+#else
+        std::free(memory);
+#endif
+    }
+
+#if defined(_WIN32)
+
+    bool setCurrentThreadAffinity(int cpu)
+    {
+        if (cpu < 0 || cpu >= static_cast<int>(sizeof(DWORD_PTR) * 8))
+        {
+            return false;
+        }
+        return SetThreadAffinityMask(GetCurrentThread(), static_cast<DWORD_PTR>(1) << cpu) != 0;
+    }
+
+    bool setCurrentThreadRealtime(int priority)
+    {
+        (void)priority;
+        return SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL) != 0;
+    }
+
+    bool lockProcessMemory()
+    {
+        // Windows has no process wide lock, raise the working set minimum instead
+        SIZE_T min_size = 0;
+        SIZE_T max_size = 0;
+        HANDLE process = GetCurrentProcess();
+        if (!GetProcessWorkingSetSize(process, &min_size, &max_size))
+        {
+            return false;
+        }
+        const SIZE_T locked = 256 * 1024 * 1024;
+        return SetProcessWorkingSetSize(process, min_size > locked ? min_size : locked,
+                                        max_size > locked * 2 ? max_size : locked * 2) != 0;
+    }
+
+#elif defined(__linux__)
+
+    bool setCurrentThreadAffinity(int cpu)
+    {
+        if (cpu < 0 || cpu >= CPU_SETSIZE)
+        {
+            return false;
+        }
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+    }
+
+    bool setCurrentThreadRealtime(int priority)
+    {
+        sched_param param;
+        param.sched_priority = priority;
+        return pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0;
+    }
+
+    bool lockProcessMemory()
+    {
+        return mlockall(MCL_CURRENT | MCL_FUTURE) == 0;
+    }
+
+#else
+
+    bool setCurrentThreadAffinity(int)
+    {
+        return false;
+    }
+
+    bool setCurrentThreadRealtime(int)
+    {
+        return false;
+    }
+
+    bool lockProcessMemory()
+    {
+        return false;
+    }
+
+#endif
+}
@@ -0,0 +1,46 @@
+// Copyright DEWETRON 2024
+// Platform specific thread setup and memory of the acquisition engine
+
+#pragma once
+
+#include "dewepxi_types.h"
+#include <cstddef>
+
+
+namespace trion
+{
+    /**
+     * Number of logical processors.
+     */
+    uint32 numCpus();
+
+    /**
+     * Pin the calling thread to one logical processor.
+     * @return false if not supported or not permitted
+     */
+    bool setCurrentThreadAffinity(int cpu);
+
+    /**
+     * Run the calling thread with real-time priority
+     * (SCHED_FIFO on Linux, time critical on Windows).
+     * @param priority SCHED_FIFO priority 1..99
+     * @return false if not supported or not permitted
+     */
+    bool setCurrentThreadRealtime(int priority);
+
+    /**
+     * Lock the current and future memory of the process into RAM.
+     * @return false if not supported or not permitted
+     */
+    bool lockProcessMemory();
+
+    /**
+     * Allocate memory with an alignment beyond the one of plain new,
+     * eg for objects holding cache line aligned members (C++11 new
+     * ignores their alignment).
+     * @param alignment power of two, multiple of sizeof(void*)
+     * @return nullptr if out of memory
+     */
+    void* allocateAligned(size_t size, size_t alignment);
+    void freeAligned(void* memory);
+}
@@ -0,0 +1,217 @@
+// Copyright DEWETRON 2024
+
+#include "dewepxi_timeline.h"
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  include <emmintrin.h>
+#  define DEWEPXI_TIMELINE_SSE2 1
+#endif
+
+
+namespace trion
+{
+    namespace
+    {
+        const uint32 BATCH = 256;
+
+        inline uint64 unwrapScalar(uint64 ref, uint32 counter)
+        {
+            return ref + static_cast<uint64>(static_cast<sint64>(static_cast<sint32>(counter - static_cast<uint32>(ref))));
+        }
+
+        /**
+         * out[i] = ref + (sint32)(counters[i] - (uint32)ref)
+         */
+        void unwrapBatch(uint64 ref, const uint32* counters, uint32 count, uint64* out)
+        {
+            uint32 i = 0;
+#if defined(DEWEPXI_TIMELINE_SSE2)
+            const __m128i ref32 = _mm_set1_epi32(static_cast<int>(static_cast<uint32>(ref)));
+            const __m128i ref64 = _mm_set1_epi64x(static_cast<long long>(ref));
+            for (; i + 4 <= count; i += 4)
+            {
+                __m128i diff = _mm_sub_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(counters + i)), ref32);
+                __m128i sign = _mm_srai_epi32(diff, 31);
+                __m128i lo = _mm_add_epi64(_mm_unpacklo_epi32(diff, sign), ref64);
+                __m128i hi = _mm_add_epi64(_mm_unpackhi_epi32(diff, sign), ref64);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), lo);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 2), hi);
+            }
+#endif
+            for (; i < count; ++i)
+            {
+                out[i] = unwrapScalar(ref, counters[i]);
+            }
+        }
+    }
+
+
+    CounterUnwrapper::CounterUnwrapper()
+        : m_started(false)
+        , m_last(0)
+    {
+    }
+
+    void CounterUnwrapper::reset()
+    {
+        m_started = false;
+        m_last = 0;
+    }
+
+    void CounterUnwrapper::reset(uint64 last)
+    {
+        m_started = true;
+        m_last = last;
+    }
+
+    uint64 CounterUnwrapper::unwrap(uint32 counter)
+    {
+        if (!m_started)
+        {
+            reset(counter);
+            return m_last;
+        }
+        m_last = unwrapScalar(m_last, counter);
+        return m_last;
+    }
+
+    void CounterUnwrapper::unwrap(const uint32* counters, uint32 count, uint64* out)
+    {
+        if (count == 0)
+        {
+            return;
+        }
+        if (!m_started)
+        {
+            reset(counters[0]);
+        }
+
+        for (uint32 i = 0; i < count; i += BATCH)
+        {
+            const uint32 n = count - i < BATCH ? count - i : BATCH;
+            unwrapBatch(m_last, counters + i, n, out + i);
+            m_last = out[i + n - 1];
+        }
+    }
+
+    void CounterUnwrapper::unwrap(const void* first, uint32 stride, uint32 count, uint64* out)
+    {
+        // Gather into a contiguous batch, then unwrap with SIMD
+        const uint8* src = static_cast<const uint8*>(first);
+        uint32 counters[BATCH];
+        for (uint32 i = 0; i < count; i += BATCH)
+        {
+            const uint32 n = count - i < BATCH ? count - i : BATCH;
+            for (uint32 k = 0; k < n; ++k)
+            {
+                std::memcpy(&counters[k], src + static_cast<size_t>(i + k) * stride, sizeof(uint32));
+            }
+            unwrap(counters, n, out + i);
+        }
+    }
+
+
+    BoardTimeline::BoardTimeline(double sample_rate, double tick_rate)
+        : m_sample_rate(sample_rate)
+        , m_tick_rate(tick_rate)
+        , m_ticks_per_sample(0)
+        , m_ticks_per_sample_f(sample_rate > 0.0 ? tick_rate / sample_rate : 0.0)
+    {
+        // Exact integer conversion for the usual rates (eg 10 MHz / 10 kHz)
+        double ratio = std::floor(m_ticks_per_sample_f + 0.5);
+        if (ratio >= 1.0 && std::fabs(ratio - m_ticks_per_sample_f) < 1e-9 * ratio)
+        {
+            m_ticks_per_sample = static_cast<uint64>(ratio);
+        }
+    }
+
+    uint32 BoardTimeline::addSource(CounterBase base)
+    {
+        Source source;
+        source.base = base;
+        m_sources.push_back(source);
+        return static_cast<uint32>(m_sources.size() - 1);
+    }
+
+    void BoardTimeline::reset()
+    {
+        for (Source& source : m_sources)
+        {
+            source.unwrapper.reset();
+        }
+    }
+
+    void BoardTimeline::toTicks(uint32 source, const uint32* counters, uint32 count, uint64* ticks)
+    {
+        Source& s = m_sources[source];
+        s.unwrapper.unwrap(counters, count, ticks);
+        convert(s, ticks, count);
+    }
+
+    void BoardTimeline::toTicks(uint32 source, const void* first, uint32 stride, uint32 count, uint64* ticks)
+    {
+        Source& s = m_sources[source];
+        s.unwrapper.unwrap(first, stride, count, ticks);
+        convert(s, ticks, count);
+    }
+
+    void BoardTimeline::toTicks(uint32 source, const BOARD_CAN_FRAME* frames, uint32 count, uint64* ticks)
+    {
+        toTicks(source, &frames->SyncCounter, sizeof(BOARD_CAN_FRAME), count, ticks);
+    }
+
+    void BoardTimeline::toTicks(uint32 source, const BOARD_CAN_FD_FRAME* frames, uint32 count, uint64* ticks)
+    {
+        toTicks(source, &frames->SyncCounter, sizeof(BOARD_CAN_FD_FRAME), count, ticks);
+    }
+
+    void BoardTimeline::toTicks(uint32 source, const BOARD_UART_RAW_FRAME* frames, uint32 count, uint64* ticks)
+    {
+        toTicks(source, &frames->SyncCounter, sizeof(BOARD_UART_RAW_FRAME), count, ticks);
+    }
+
+    void BoardTimeline::convert(const Source& source, uint64* values, uint32 count) const
+    {
+        if (source.base == COUNTER_BASE_TICKS)
+        {
+            return;
+        }
+
+        if (m_ticks_per_sample)
+        {
+            const uint64 factor = m_ticks_per_sample;
+            for (uint32 i = 0; i < count; ++i)
+            {
+                values[i] *= factor;
+            }
+        }
+        else
+        {
+            for (uint32 i = 0; i < count; ++i)
+            {
+                values[i] = sampleToTicks(values[i]);
+            }
+        }
+    }
+
+    uint64 BoardTimeline::sampleToTicks(uint64 sample) const
+    {
+        if (m_ticks_per_sample)
+        {
+            return sample * m_ticks_per_sample;
+        }
+        return static_cast<uint64>(static_cast<double>(sample) * m_ticks_per_sample_f + 0.5);
+    }
+
+    uint64 BoardTimeline::ticksToSample(uint64 ticks) const
+    {
+        if (m_ticks_per_sample)
+        {
+            return ticks / m_ticks_per_sample;
+        }
+        return m_ticks_per_sample_f > 0.0 ? static_cast<uint64>(static_cast<double>(ticks) / m_ticks_per_sample_f) : 0;
+    }
+}
@@ -0,0 +1,272 @@
+"""
+Copyright DEWETRON GmbH 2024
+
+dewepxi_record module
+
+Random access to recordings of the C++ Recorder (dewepxi_record_format.h).
+The file is memory mapped, channel data is returned as numpy arrays
+viewing the mapped chunks, one array per chunk, without copying.
+Packed columns (dewepxi_sample_codec.h) and raw scans (RawRecorder)
+are decoded into new arrays.
+
+    from trion_sdk.dewepxi_record import RecordReader
+
+    with RecordReader("board1.trec") as rec:
+        ai0 = rec.find_channel("AI0")
+        for first_scan, raw in rec.spans_for_time(ai0, 1.0, 2.0):
+            volts = rec.scale(ai0, raw)
+"""
+
+
+import bisect
+import math
+import mmap
+import struct
+
+import numpy as np
+
+
+RECORD_VERSION = 1
+RECORD_ENCODING_RAW_I32 = 0
+RECORD_ENCODING_DELTA_PACKED = 1
+RECORD_ENCODING_RAW_SCANS = 2
+CHANNEL_TYPE_ANALOG = 0
+SAMPLE_CODEC_BLOCK = 128
+
+_FILE_HEADER = struct.Struct("<8sIIdIIIIIIQQ")
+_CHANNEL_INFO = struct.Struct("<48sIIIIdd")
+_CHUNK_HEADER = struct.Struct("<4sIQQIIQ")
+_COLUMN = struct.Struct("<IIQQ")
+
+
+def decode_samples(data, offset, size, count):
+    """First count samples of a packed column as int32 array (see dewepxi_sample_codec.h)"""
+    blocks = -(-count // SAMPLE_CODEC_BLOCK)
+    out = np.empty(blocks * SAMPLE_CODEC_BLOCK, dtype=np.uint32)
+    end = offset + size
+    p1 = p2 = np.uint32(0)
+    row_bits = np.arange(SAMPLE_CODEC_BLOCK // 4, dtype=np.uint64)
+    for b in range(blocks):
+        if offset >= end:
+            raise ValueError("Corrupt packed column")
+        predictor = data[offset] >> 6
+        width = data[offset] & 0x3f
+        if predictor > 2 or width > 32 or offset + 1 + width * 16 > end:
+            raise ValueError("Corrupt packed column")
+
+        if width:
+            # Lane j packs the residuals j, j + 4, ... from the lowest bit up
+            words = np.zeros((width + 1, 4), dtype=np.uint64)
+            words[:width] = np.frombuffer(data, dtype="<u4", count=width * 4, offset=offset + 1).reshape(width, 4)
+            bit = row_bits * np.uint64(width)
+            index = (bit >> np.uint64(5)).astype(np.intp)
+            pairs = words[index] | (words[index + 1] << np.uint64(32))
+            z = ((pairs >> (bit & np.uint64(31))[:, None]) & np.uint64((1 << width) - 1)).astype(np.uint32).ravel()
+        else:
+            z = np.zeros(SAMPLE_CODEC_BLOCK, dtype=np.uint32)
+        x = (z >> np.uint32(1)) ^ (np.uint32(0) - (z & np.uint32(1)))
+
+        # Residuals modulo 2^32, the prediction continues over the blocks
+        if predictor == 1:
+            x = np.cumsum(x, dtype=np.uint32) + p1
+        elif predictor == 2:
+            delta = np.uint32((int(p1) - int(p2)) & 0xffffffff)
+            x = np.cumsum(np.cumsum(x, dtype=np.uint32) + delta, dtype=np.uint32) + p1
+        out[b * SAMPLE_CODEC_BLOCK:(b + 1) * SAMPLE_CODEC_BLOCK] = x
+        p2, p1 = x[-2], x[-1]
+        offset += 1 + width * 16
+    return out[:count].view(np.int32)
+
+
+def decode_scans(data, offset, scan_size, scans, channel):
+    """Samples of a channel in raw scans as int32 array, like the C++ ScanDecoder"""
+    raw = np.frombuffer(data, dtype=np.uint8, count=scans * scan_size, offset=offset).reshape(scans, scan_size)
+    size = channel.sample_size
+    # Smallest naturally aligned container holding the whole sample
+    container = 2 if size <= 16 and channel.sample_offset % 16 + size <= 16 else 4
+    byte_offset = channel.sample_offset // (container * 8) * container
+    shift = channel.sample_offset % (container * 8)
+    words = raw[:, byte_offset:byte_offset + container].copy().view("<u%d" % container).ravel().astype(np.uint32)
+    words <<= np.uint32(32 - shift - size)
+    if channel.channel_type == CHANNEL_TYPE_ANALOG and container == 4 and shift == 8 and size == 24:
+        # Left aligned 24 bit samples round toward zero, like formatRawData(value, 24, 8)
+        values = words.view(np.int32)
+        return (values + ((values >> np.int32(31)) & np.int32(0xff))) >> np.int32(8)
+    if channel.channel_type == CHANNEL_TYPE_ANALOG:
+        return words.view(np.int32) >> np.int32(32 - size)
+    return (words >> np.uint32(32 - size)).view(np.int32)
+
+
+class RecordChannel:
+    """Channel of a recording"""
+    def __init__(self, name, channel_type, index, sample_size, sample_offset, scale_value, scale_offset):
+        self.name = name
+        self.channel_type = channel_type
+        self.index = index
+        self.sample_size = sample_size
+        self.sample_offset = sample_offset
+        self.scale_value = scale_value
+        self.scale_offset = scale_offset
+
+
+class RecordChunk:
+    """Index entry of one chunk"""
+    def __init__(self, first_scan, scans, offset, time_ns, columns):
+        self.first_scan = first_scan
+        self.scans = scans
+        self.offset = offset
+        self.time_ns = time_ns
+        self.columns = columns
+
+
+class RecordReader:
+    """Memory mapped reader of a recording file"""
+    def __init__(self, path):
+        self._file = open(path, "rb")
+        try:
+            self._map = mmap.mmap(self._file.fileno(), 0, access=mmap.ACCESS_READ)
+        except ValueError:
+            self._file.close()
+            raise ValueError("Empty file: %s" % path)
+
+        (magic, version, header_size, self.sample_rate, num_channels, self.chunk_scans,
+         channel_offset, xml_offset, xml_size, self.scan_size, _, _) = _FILE_HEADER.unpack_from(self._map, 0)
+        if magic != b"TRIONREC":
+            self.close()
+            raise ValueError("No recording: %s" % path)
+        if version != RECORD_VERSION:
+            self.close()
+            raise ValueError("Unsupported recording version %d" % version)
+
+        self.channels = []
+        for c in range(num_channels):
+            name, channel_type, index, sample_size, sample_offset, scale_value, scale_offset = \
+                _CHANNEL_INFO.unpack_from(self._map, channel_offset + c * _CHANNEL_INFO.size)
+            self.channels.append(RecordChannel(name.split(b"\0", 1)[0].decode(), channel_type, index,
+                                               sample_size, sample_offset, scale_value, scale_offset))
+        self.scan_descriptor = bytes(self._map[xml_offset:xml_offset + xml_size]).decode()
+
+        self.chunks = []
+        self._first_scans = []
+        self._stamped = []
+        self._stamped_times = []
+        self.total_scans = 0
+        self._build_index(header_size, num_channels)
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *args):
+        self.close()
+
+    def close(self):
+        """Close the file, the mapping is released with the last array viewing it"""
+        if self._map is not None:
+            try:
+                self._map.close()
+            except BufferError:
+                pass
+            self._map = None
+        self._file.close()
+
+    def _build_index(self, pos, num_channels):
+        size = len(self._map)
+        # Follow the chunk headers, an interrupted recording ends with an incomplete chunk
+        while pos + _CHUNK_HEADER.size <= size:
+            magic, scans, first_scan, chunk_size, num_columns, _, time_ns = _CHUNK_HEADER.unpack_from(self._map, pos)
+            if magic != b"TRCK" or chunk_size < _CHUNK_HEADER.size + _COLUMN.size or pos + chunk_size > size:
+                break
+            # Raw scan chunks have one column holding all channels
+            raw_scans = num_columns == 1 and \
+                _COLUMN.unpack_from(self._map, pos + _CHUNK_HEADER.size)[0] == RECORD_ENCODING_RAW_SCANS
+            if num_columns != (1 if raw_scans else num_channels) or first_scan != self.total_scans:
+                raise ValueError("Corrupt chunk at %d" % pos)
+
+            columns = []
+            for c in range(num_columns):
+                encoding, _, offset, column_size = _COLUMN.unpack_from(self._map, pos + _CHUNK_HEADER.size + c * _COLUMN.size)
+                if raw_scans:
+                    if not self.scan_size or column_size != scans * self.scan_size:
+                        raise ValueError("Corrupt chunk at %d" % pos)
+                elif encoding not in (RECORD_ENCODING_RAW_I32, RECORD_ENCODING_DELTA_PACKED):
+                    raise ValueError("Unsupported column encoding %d" % encoding)
+                if (encoding == RECORD_ENCODING_RAW_I32 and column_size != scans * 4) or offset + column_size > chunk_size:
+                    raise ValueError("Corrupt chunk at %d" % pos)
+                columns.append((encoding, pos + offset, column_size))
+
+            if time_ns:
+                self._stamped.append(len(self.chunks))
+                self._stamped_times.append(time_ns)
+            self.chunks.append(RecordChunk(first_scan, scans, pos, time_ns, columns))
+            self._first_scans.append(first_scan)
+            self.total_scans += scans
+            pos += chunk_size
+
+    def find_channel(self, name):
+        """Index of a channel or -1"""
+        for i, channel in enumerate(self.channels):
+            if channel.name == name:
+                return i
+        return -1
+
+    def spans(self, channel, first_scan, end_scan):
+        """Scans [first_scan, end_scan) of a channel as (first_scan, int32 array) per chunk,
+        zero copy for raw columns"""
+        result = []
+        end_scan = min(end_scan, self.total_scans)
+        scan = max(first_scan, 0)
+        i = max(bisect.bisect_right(self._first_scans, scan) - 1, 0)
+        while i < len(self.chunks) and scan < end_scan:
+            chunk = self.chunks[i]
+            count = min(end_scan, chunk.first_scan + chunk.scans) - scan
+            if count > 0:
+                encoding, offset, size = chunk.columns[0 if len(chunk.columns) == 1 else channel]
+                skip = scan - chunk.first_scan
+                if encoding == RECORD_ENCODING_RAW_I32:
+                    samples = np.frombuffer(self._map, dtype="<i4", count=count, offset=offset + skip * 4)
+                elif encoding == RECORD_ENCODING_RAW_SCANS:
+                    samples = decode_scans(self._map, offset + skip * self.scan_size, self.scan_size, count,
+                                           self.channels[channel])
+                else:
+                    samples = decode_samples(self._map, offset, size, skip + count)[skip:]
+                result.append((scan, samples))
+                scan += count
+            i += 1
+        return result
+
+    def spans_for_time(self, channel, t0, t1):
+        """Spans of [t0, t1), in seconds since the recording start"""
+        first = int(math.ceil(max(t0, 0.0) * self.sample_rate))
+        end = int(math.ceil(max(t1, 0.0) * self.sample_rate))
+        return self.spans(channel, first, end)
+
+    def spans_for_absolute_time(self, channel, t0_ns, t1_ns):
+        """Spans of [t0_ns, t1_ns), in ns since 1970, empty without time stamps"""
+        first = self.scan_at_time(t0_ns)
+        end = self.scan_at_time(t1_ns)
+        if first is None or end is None:
+            return []
+        return self.spans(channel, first, end)
+
+    def scan_at_time(self, time_ns):
+        """First scan at or after an absolute time, None without time stamps"""
+        if not self._stamped:
+            return None
+        k = bisect.bisect_right(self._stamped_times, time_ns)
+        chunk = self.chunks[self._stamped[k - 1 if k > 0 else 0]]
+        scan = chunk.first_scan + math.ceil((time_ns - chunk.time_ns) * self.sample_rate * 1e-9)
+        return min(max(scan, 0), self.total_scans)
+
+    def time_of_scan(self, scan):
+        """Absolute time of a scan in ns, None if its chunk has no time stamp"""
+        if scan < 0 or scan >= self.total_scans:
+            return None
+        chunk = self.chunks[bisect.bisect_right(self._first_scans, scan) - 1]
+        if not chunk.time_ns:
+            return None
+        return chunk.time_ns + int(round((scan - chunk.first_scan) * 1e9 / self.sample_rate))
+
+    def scale(self, channel, raw):
+        """Scaled values of raw samples (a new float64 array)"""
+        info = self.channels[channel]
+        return raw * info.scale_value - info.scale_offset
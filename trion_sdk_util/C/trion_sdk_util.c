@@ -1136,29 +1136,66 @@ uint64 TRION_StopWatch_GetMS(TRION_StopWatchHandle* sw)
 }
 
 #else
+
+#include <stdlib.h>
+#include <time.h>
+
+#define NS_PER_US 1000
+
+// CLOCK_MONOTONIC_RAW is not slewed by NTP
+#ifdef CLOCK_MONOTONIC_RAW
+#define TRION_STOPWATCH_CLOCK CLOCK_MONOTONIC_RAW
+#else
+#define TRION_STOPWATCH_CLOCK CLOCK_MONOTONIC
+#endif
+
+typedef struct
+{
+    struct timespec m_time_start;
+    uint64 m_last_time;
+} TRION_StopWatchHandleImp;
+
 void TRION_StopWatch_Create(TRION_StopWatchHandle* sw)
 {
+    TRION_StopWatchHandleImp* handle_imp = (TRION_StopWatchHandleImp*)malloc(sizeof(TRION_StopWatchHandleImp));
+    memset(handle_imp, 0, sizeof(TRION_StopWatchHandleImp));
+    *sw = handle_imp;
 }
 
 void TRION_StopWatch_Destroy(TRION_StopWatchHandle* sw)
 {
+    TRION_StopWatchHandleImp* handle_imp = (TRION_StopWatchHandleImp * )*sw;
+    free(handle_imp);
+    *sw = NULL;
 }
+
 void TRION_StopWatch_Start(TRION_StopWatchHandle* sw)
 {
+    TRION_StopWatchHandleImp* handle_imp = (TRION_StopWatchHandleImp*)(sw);
+    clock_gettime(TRION_STOPWATCH_CLOCK, &handle_imp->m_time_start);
 }
 
 void TRION_StopWatch_Stop(TRION_StopWatchHandle* sw)
 {
+    TRION_StopWatchHandleImp* handle_imp = (TRION_StopWatchHandleImp*)(sw);
+    struct timespec time_end;
+    sint64 time_diff_ns;
+    clock_gettime(TRION_STOPWATCH_CLOCK, &time_end);
+    time_diff_ns = (sint64)(time_end.tv_sec - handle_imp->m_time_start.tv_sec) * 1000000000
+                 + (time_end.tv_nsec - handle_imp->m_time_start.tv_nsec);
+    handle_imp->m_last_time = time_diff_ns > 0 ? (uint64)time_diff_ns / NS_PER_US : 0;
 }
 
 uint64 TRION_StopWatch_GetUS(TRION_StopWatchHandle* sw)
 {
-    return 0;
+    TRION_StopWatchHandleImp* handle_imp = (TRION_StopWatchHandleImp*)(sw);
+    return handle_imp->m_last_time;
 }
 
 uint64 TRION_StopWatch_GetMS(TRION_StopWatchHandle* sw)
 {
-    return 0;
+    TRION_StopWatchHandleImp* handle_imp = (TRION_StopWatchHandleImp*)(sw);
+    return handle_imp->m_last_time / 1000;
 }
 #endif
 